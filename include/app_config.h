@@ -38,7 +38,7 @@ extern const int TB_PORT;
 
 // Main switches
 
-volatile const FLAGS_T FLAGS
+static volatile const FLAGS_T FLAGS
 {
     /** Debug mode enabled - set by build env*/
     #ifdef DEBUG
@@ -106,7 +106,21 @@ volatile const FLAGS_T FLAGS
     EXTERNAL_RTC_ENABLED: true,
 
     /** Submit data to IPFS */
-    IPFS: true
+    IPFS: true,
+
+    /** Send telemetry request bodies gzip compressed (Content-Encoding: gzip).
+     * Only for servers that decompress them, eg. the telemetry gateway. */
+    TELEMETRY_GZIP: false,
+
+    /** Submit the telemetry of all stores in merged requests, in time order with
+     * values of a timestamp in one object, instead of requests per store.
+     * Stores are read oldest first, without the priority window. */
+    TELEMETRY_MERGED: false,
+
+    /** Deep sleep between wake ups instead of light sleep. Only RTC memory is
+     * kept, state needed after waking up is kept there and setup() resumes
+     * without a full boot. */
+    DEEP_SLEEP_ENABLED: false
 }; 
 
 /** Print serial comms between the MCU and the GSM module (used by tinyGSM) */
@@ -167,6 +181,31 @@ const uint8_t LIGHTNING_TUNE_CAP = 8;
 #error Invalid Lightning sensor module specified
 #endif
 
+/**
+ * File system data stores are kept in (SPIFFS/LITTLEFS). Both use the spiffs
+ * partition, LittleFS needs the LittleFS_esp32 library (see platformio.ini).
+ */
+#define STORAGE_BACKEND STORAGE_BACKEND_SPIFFS
+
+/**
+ * Backend to migrate store files from when STORAGE_BACKEND doesn't mount, 0
+ * for none. Set to the previous backend when changing it on deployed units.
+ */
+#define STORAGE_MIGRATE_FROM 0
+
+#ifndef STORAGE_BACKEND
+#error "Storage backend not set"
+#endif
+
+#if STORAGE_BACKEND != STORAGE_BACKEND_SPIFFS && STORAGE_BACKEND != STORAGE_BACKEND_LITTLEFS && \
+    !(defined(NATIVE) && STORAGE_BACKEND == STORAGE_BACKEND_RAM)
+#error Invalid storage backend specified
+#endif
+
+#if STORAGE_MIGRATE_FROM == STORAGE_BACKEND
+#error Storage backend can not migrate from itself
+#endif
+
 /**
  * Battery gauge
  */
@@ -4,6 +4,7 @@
 #include "app_config.h"
 #include "struct.h"
 #include "data_store.h"
+#include "entry_schema.h"
 
 namespace Atmos41Data
 {
@@ -78,6 +79,8 @@ namespace Atmos41Data
 
     DataStore<Entry>* get_store();
 
+    const EntrySchema::Field* get_schema(int *field_count);
+
     void print(const Entry *data);
 }
 
@@ -0,0 +1,18 @@
+#ifndef ATMOS41_DATA_CBOR_BUILDER_H
+#define ATMOS41_DATA_CBOR_BUILDER_H
+
+#include "struct.h"
+#include "const.h"
+#include "atmos41_data.h"
+#include "cbor_builder_base.h"
+
+/******************************************************************************
+* Helper class to build binary (CBOR) telemetry from Atmos41 data structures
+******************************************************************************/
+class Atmos41DataCborBuilder : public CborBuilderBase<Atmos41Data::Entry, TELEMETRY_CBOR_BUFF_SIZE>
+{
+public:
+	RetResult add(const Atmos41Data::Entry *entry);
+};
+
+#endif
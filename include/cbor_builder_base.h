@@ -0,0 +1,62 @@
+#ifndef CBOR_BUILDER_BASE_H
+#define CBOR_BUILDER_BASE_H
+
+#include "struct.h"
+#include "const.h"
+#include "entry_schema.h"
+#include "cbor_writer.h"
+
+/******************************************************************************
+* Template base for classes that build binary (CBOR) telemetry out of structs,
+* the compact alternative to the TB JSON builders. Entries are described by
+* their schema, a request is:
+*
+*   [version, telemetry_id, first_tstamp, [_ entry, entry, ...]]
+*
+* - version: TELEMETRY_CBOR_VERSION
+* - telemetry_id: EntrySchema::telemetry_id() of the entries' schema
+* - first_tstamp: timestamp (sec) of first entry
+* - entry: [tstamp_delta, value_1, ..., value_n], tstamp_delta in sec from
+*   previous entry, value_i the i-th schema field with a JSON key (field id
+*   i). Floats with decimals are ints scaled by 10^decimals, other floats the
+*   shortest float (or int if integral) holding the value, bools 0/1. Fields
+*   of an all zero FLAG_ZERO_GROUP are null.
+*
+* Decoded to the TB JSON of the same entries by the host telemetry decoder
+* (native/), which needs the same schemas.
+******************************************************************************/
+template <typename TStruct, int TBuffSize>
+class CborBuilderBase
+{
+public:
+    CborBuilderBase();
+
+    virtual ~CborBuilderBase() {}
+
+    virtual RetResult add(const TStruct *entry) = 0;
+
+    RetResult build(uint8_t *buff_out, int buff_size, int *size_out);
+
+    bool is_empty();
+
+    RetResult reset();
+
+    void print();
+
+protected:
+    RetResult add_schema_entry(const TStruct *entry, const EntrySchema::Field *fields, int field_count);
+
+    /** Encoded entries */
+    uint8_t _buff[TBuffSize];
+    CborWriter _writer;
+
+    int _entry_count = 0;
+
+    /** Of first entry's schema */
+    uint32_t _telemetry_id = 0;
+
+    uint32_t _first_tstamp = 0;
+    uint32_t _last_tstamp = 0;
+};
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef CBOR_WRITER_H
+#define CBOR_WRITER_H
+
+#include <inttypes.h>
+#include <stddef.h>
+#include "struct.h"
+
+/******************************************************************************
+ * CborWriter
+ * Writes CBOR (RFC 8949) items into a caller's buffer. Only what telemetry
+ * needs: integers, floats, null and arrays. Every item takes its shortest
+ * form, floats included (half/single/double, whichever keeps the value).
+ * Writes past the end of the buffer are dropped and flag the writer full, so
+ * a payload can be built without checking every item.
+ ******************************************************************************/
+class CborWriter
+{
+public:
+    /** Major types, top 3 bits of an item's first byte */
+    enum MajorType
+    {
+        MAJOR_UNSIGNED = 0,
+        MAJOR_NEGATIVE = 1,
+        MAJOR_ARRAY = 4,
+        MAJOR_SIMPLE = 7
+    };
+
+    /** Low 5 bits of first byte: simple values, floats, indefinite length */
+    enum AdditionalInfo
+    {
+        SIMPLE_NULL = 22,
+        SIMPLE_HALF = 25,
+        SIMPLE_SINGLE = 26,
+        SIMPLE_DOUBLE = 27,
+        INDEFINITE = 31
+    };
+
+    /** Ends an indefinite length item */
+    static const uint8_t BREAK = 0xFF;
+
+    CborWriter(uint8_t *buff, int buff_size);
+
+    void write_uint(uint64_t value);
+
+    void write_int(int64_t value);
+
+    void write_double(double value);
+
+    void write_null();
+
+    void begin_array(int count);
+
+    void begin_array();
+
+    void end_array();
+
+    int get_size() const;
+
+    bool is_full() const;
+
+    void set_size(int size);
+
+private:
+    // Default constructor private
+    CborWriter();
+
+    void write_head(uint8_t major_type, uint64_t value);
+
+    void write_byte(uint8_t byte);
+
+    void write_be(uint64_t value, int bytes);
+
+    static bool to_half(float value, uint16_t *half);
+
+    uint8_t *_buff = NULL;
+    int _buff_size = 0;
+    int _size = 0;
+
+    /** A write didn't fit */
+    bool _full = false;
+};
+
+#endif
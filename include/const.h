@@ -31,6 +31,10 @@ const int MAX_SLEEP_TIME_SEC = 60 * 60 * 24; // One day
 
 const int MAX_SLEEP_CORRECTION_SEC = 60 * 5; // 5 mins
 
+/** RTC memory for DataStore buffers kept over deep sleep. Fits full buffers of
+ * the stores usually in use, the rest are committed before sleeping. */
+const int DEEP_SLEEP_PARK_SIZE = 2048;
+
 /** Min/max allowed values for calling home interval (mins) */
 const int CALL_HOME_INT_MINS_MIN = 1;           // 1 min
 const int CALL_HOME_INT_MINS_MAX = 24 * 60 * 2; // 2 days
@@ -82,11 +86,119 @@ const int FILE_PATH_BUFFER_SIZE = 25;
 /** Max tries when looking for an unused filename before failing */
 const int FILENAME_POSTFIX_MAX = 100;
 
+/** Dir where store manifests are kept. Manifest path is this + store dir path. */
+const char* const DATA_STORE_MANIFEST_DIR = "/mf";
+
+/** Manifest file magic ("DSMF") and format version */
+const uint32_t DATA_STORE_MANIFEST_MAGIC = 0x464D5344;
+const uint8_t DATA_STORE_MANIFEST_VERSION = 2;
+
+/** Data file header magic ("DSFH") and format version, see DataStoreFileHeader */
+const uint32_t DATA_STORE_FILE_MAGIC = 0x48465344;
+const uint8_t DATA_STORE_FILE_VERSION = 1;
+
+/** Compact manifest when it has at least this many records and most are deleted */
+const int DATA_STORE_MANIFEST_COMPACT_MIN_RECORDS = 32;
+
+/** SPIFFS space kept free by evicting old files before committing. SPIFFS
+ * needs free blocks for garbage collection, a write to a full partition can
+ * take seconds before it fails. */
+const int DATA_STORE_EVICT_MIN_FREE_BYTES = 8192;
+
+/** Max files evicted by a single commit, bounds commit time */
+const int DATA_STORE_EVICT_MAX_FILES = 4;
+
+/** Entries block readers (call home) read at once, buffer is on the stack.
+ * A whole file of every store. */
+const int DATA_STORE_READ_BLOCK_ENTRIES = 8;
+
+/** Files a newest-first reader orders per pass over the manifest. Every pass
+ * reads all records, so a store of N files is read in N / this passes. */
+const int DATA_STORE_READ_ORDER_BATCH = 16;
+
+/** Max entries per file of stores that can be compacted, a merged file is
+ * built on the stack */
+const int DATA_STORE_COMPACT_MAX_ENTRIES = 8;
+
+/** Time spent compacting stores before going to sleep. Whatever is left is
+ * compacted before the next sleep. */
+const int DATA_STORE_COMPACT_BUDGET_MS = 300;
+
+/** Largest entry (excl. CRC) a store can encode */
+const int DATA_STORE_CODEC_MAX_ENTRY_SIZE = 96;
+
+/** Max fields in an encoding layout */
+const int DATA_STORE_CODEC_MAX_FIELDS = 24;
+
+/** Max size of an encoded block incl. header. Fits a full buffer of most
+ * stores, so a commit is a single write. Blocks are built on the stack. */
+const int DATA_STORE_CODEC_BLOCK_SIZE = 512;
+
+/******************************************************************************
+ * Storage (file system backend of data stores)
+ *****************************************************************************/
+/*
+ * Storage backends
+ */
+#define STORAGE_BACKEND_SPIFFS 1
+#define STORAGE_BACKEND_LITTLEFS 2
+/** Host RAM, native builds only */
+#define STORAGE_BACKEND_RAM 3
+
+/** Max files open at once */
+const int STORAGE_MAX_OPEN_FILES = 25;
+
+/** Files are staged in RAM while the partition is reformatted for the new
+ * backend. A backlog that doesn't fit is not migrated, the previous backend is
+ * kept until call homes have submitted enough of it. */
+const int STORAGE_MIGRATION_MAX_BYTES = 64 * 1024;
+
+/** Max files migrated, more also keep the previous backend */
+const int STORAGE_MIGRATION_MAX_FILES = 256;
+
+/******************************************************************************
+ * Data log (ring log storage on raw flash partition)
+ *****************************************************************************/
+/** Label of data partition used for ring logs. When it is not in the partition
+ * table, stores keep using SPIFFS. */
+const char* const DATA_LOG_PARTITION_LABEL = "datalog";
+
+/** Ring log sector header magic ("RLOG") */
+const uint32_t RING_LOG_SECTOR_MAGIC = 0x474F4C52;
+
+/** Largest record a ring log can store */
+const int RING_LOG_MAX_RECORD_SIZE = 128;
+
+/******************************************************************************
+ * Flash wear counters
+ *****************************************************************************/
+/** Max stores with their own counters, the rest are only counted in totals */
+const int FLASH_STATS_MAX_STORES = 10;
+
+/** SPIFFS page data size (256 B page - 5 B header), to estimate page programs */
+const int FLASH_SPIFFS_PAGE_DATA_SIZE = 251;
+
+/** SPIFFS pages per erase block (4 KB block / 256 B page), to estimate erases */
+const int FLASH_SPIFFS_PAGES_PER_BLOCK = 16;
+
 /******************************************************************************
  * Telemetry data
  *****************************************************************************/
 const int TELEMETRY_DATA_JSON_OUTPUT_BUFF_SIZE = 2048;
 
+/** JSON of a single entry, when a request's JSON is streamed (see
+ * TelemetryJsonBody) */
+const int TELEMETRY_ENTRY_JSON_BUFF_SIZE = 512;
+
+/** Binary (CBOR) telemetry, see CborBuilderBase. Version changes with the
+ * request layout. */
+const int TELEMETRY_CBOR_VERSION = 1;
+
+/** Encoded entries of a CBOR request, a request of any entry type fits */
+const int TELEMETRY_CBOR_BUFF_SIZE = 512;
+
+const char TELEMETRY_CBOR_CONTENT_TYPE[] = "application/cbor";
+
 /******************************************************************************
  * Water Sensor data
  *****************************************************************************/
@@ -212,10 +324,23 @@ const int LOG_ENTRIES_PER_SUBMIT_REQ = 8;
 const int LOG_JSON_DOC_SIZE = 1024;
 /** JSON output buffer size */
 const int LOG_JSON_OUTPUT_BUFF_SIZE = 1024;
+/** Log entries staged in RTC memory before they are written to the store.
+ * Stage survives sleep and resets, only lost with power. */
+const int LOG_STAGE_CAPACITY = 32;
+/** Stage is written to the store when it has this many entries (a full store
+ * buffer, so a single commit) */
+const int LOG_STAGE_FLUSH_ENTRIES = 10;
+/** ...or when its oldest entry is older than this */
+const int LOG_STAGE_MAX_AGE_SEC = 60 * 60;
+/** Marks stage in RTC memory as initialized ("LGST") */
+const uint32_t LOG_STAGE_MAGIC = 0x5453474C;
 
 /******************************************************************************
 * SDI12 debug log
 ******************************************************************************/
+/** Path in data store where SDI12 log data is stored */
+const char* const SDI12_LOG_DATA_PATH = "/sdi12";
+
 const int SDI12_LOG_JSON_DOC_SIZE = 1024;
 
 // Telemetry key names
@@ -248,7 +373,7 @@ const char RC_TB_KEY_FW_MD5[] = "fw_md5";
  * Client attributes
  *****************************************************************************/
 /** JSON doc size for client attributes request body */
-const int CLIENT_ATTRIBUTES_JSON_DOC_SIZE = 1024;
+const int CLIENT_ATTRIBUTES_JSON_DOC_SIZE = 1536;
 
 // Client attribute names
 const char TB_ATTR_CUR_FW_V[] = "cur_fw_v";
@@ -262,6 +387,10 @@ const char TB_ATTR_CUR_SYSTEM_TIME[] = "cur_time";
 const char TB_ATTR_UPTIME[] = "uptime";
 const char TB_ATTR_FLAGS[] = "flags";
 const char TB_ATTR_AQUATROLL_MODEL[] = "troll_model";
+/** Flash wear counters, see Flash::Stats for order */
+const char TB_ATTR_FLASH_WEAR[] = "fl_wear";
+/** Per store counters, {dir: [data bytes, manifest bytes, evicted files]} */
+const char TB_ATTR_FLASH_STORES[] = "fl_stores";
 
 /******************************************************************************
  * Calling home
@@ -287,6 +416,37 @@ const char TB_SHARED_ATTRIBUTES_URL_FORMAT[] = "/api/v1/%s/attributes?sharedKeys
 /** Max failed requests before aborting telemetry submission */
 
 const int FAILED_TELEMETRY_REQ_THRESHOLD = 3;
+
+/**
+ * Entries of a request are only limited by its body budget while requests
+ * succeed. Every failed request halves the entries of the next ones down to
+ * this, every successful one doubles them back, so on a poor link less is
+ * resent per failure. Entries of successful requests are acked.
+ * Smaller requests cost request overhead though: in the native submit bench
+ * this sends 3-5% more bytes than resending whole files at a 1 KiB success
+ * rate of 0.7 to 0.9, it only sends less at 0.5 or worse.
+ */
+const int TELEMETRY_MIN_ENTRIES_PER_REQ = 2;
+
+/**
+ * Entries of several files are packed in a request, up to this many body bytes
+ * (JSON, before compression), as files often hold only a few entries. The last
+ * file of a request may be continued by the next one.
+ */
+const int TELEMETRY_REQ_BODY_BUDGET = 8192;
+
+/** Max files covered by a request, every one is acked or deleted with it */
+const int TELEMETRY_MAX_FILES_PER_REQ = 16;
+
+/** Max stores submitted together in merged requests */
+const int TELEMETRY_MAX_MERGED_STREAMS = 8;
+
+/**
+ * Files with entries of the last hours are submitted first, newest first, so
+ * after a long outage fresh data goes out before air time runs out. Older
+ * files are backfilled afterwards, oldest first (next in line for eviction).
+ */
+const int TELEMETRY_PRIORITY_WINDOW_HOURS = 24;
 /******************************************************************************
 * DeviceConfig store
 ******************************************************************************/
@@ -336,6 +496,36 @@ const int HTTP_CLIENT_STREAM_TIMEOUT = 3000;
 /** HTTP response timeout */
 const int HTTL_CLIENT_REPONSE_TIMEOUT = 15000;
 
+/** Streamed request bodies are passed to the client in pieces (chunks when
+ * chunked) of up to this size. Every piece is a send command to the modem. */
+const int HTTP_BODY_CHUNK_SIZE = 512;
+
+/** Telemetry requests kept in flight at once, each on a modem socket of its
+ * own, so server round trips overlap with sending the next requests.
+ * 1 sends a request at a time. A third socket gains nothing over GPRS, the
+ * uplink is already busy with two. */
+const int UPLOAD_PIPELINE_SOCKETS = 2;
+
+/** Max sockets of an upload pipeline (and of the HTTP session) */
+const int UPLOAD_PIPELINE_MAX_SOCKETS = 4;
+
+/** Modem socket (mux) of the first HTTP session socket. Sockets before it are
+ * left to requests opening their own connection. */
+const int HTTP_SESSION_FIRST_MUX = 1;
+
+/** Deflate encoder (gzip request bodies) history window, a power of 2 up to
+ * 16 KiB. Encoder RAM is about 5 times this. */
+const int DEFLATE_WINDOW_SIZE = 2048;
+
+/** Hash table of deflate encoder: 2^bits entries of 2 bytes */
+const int DEFLATE_HASH_BITS = 10;
+
+/** Max earlier positions tried per match, more compress better but slower */
+const int DEFLATE_MAX_CHAIN = 32;
+
+/** Compressed bytes buffered before passing them on */
+const int DEFLATE_OUT_BUFF_SIZE = 128;
+
 /******************************************************************************
  * SDI12 Sensors
  *****************************************************************************/
@@ -0,0 +1,22 @@
+#ifndef CRC_H
+#define CRC_H
+#include <inttypes.h>
+#include <stddef.h>
+
+/******************************************************************************
+ * CRC32 engine
+ * Standard CRC-32 (IEEE 802.3, reflected, init/xorout 0xFFFFFFFF), the same
+ * as the CRC32 library, so data already stored stays valid.
+ * On the ESP32 the ROM crc32_le is used. On host (NATIVE) a slicing-by-8
+ * table is used, 8 bytes per step.
+ ******************************************************************************/
+namespace Crc
+{
+    uint32_t crc32(const void *data, size_t size);
+
+    uint32_t crc32_update(uint32_t crc, const void *data, size_t size);
+
+    const char* get_engine_name();
+}
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef DATA_LOG_H
+#define DATA_LOG_H
+
+#include "struct.h"
+
+/******************************************************************************
+ * Data log
+ * Moves data stores from SPIFFS to ring logs on a dedicated raw flash
+ * partition, when the partition table has one.
+ *****************************************************************************/
+namespace DataLog
+{
+    RetResult init();
+
+    bool is_enabled();
+
+    void print_info();
+}
+
+#endif
@@ -2,10 +2,13 @@
 #define DATA_STORE_H
 
 #include <inttypes.h>
-#include "SPIFFS.h"
+#include "storage.h"
 #include "app_config.h"
 #include "struct.h"
 #include "const.h"
+#include "data_store_manifest.h"
+#include "ring_log.h"
+#include "data_store_codec.h"
 
 template <typename TStruct>
 class DataStore
@@ -25,21 +28,101 @@ public:
         TStruct data;
     }__attribute__((packed));
 
+    /**
+     * Header at the start of every data file, so a file of another format
+     * (eg. written before an OTA changed the entry struct) is told apart
+     * without reading its entries. Files without one are legacy, written by
+     * firmware before headers.
+     */
+    struct FileHeader
+    {
+        /** Must be DATA_STORE_FILE_MAGIC */
+        uint32_t magic;
+
+        /** DATA_STORE_FILE_VERSION file was written with */
+        uint8_t version;
+
+        /** FileFlags */
+        uint8_t flags;
+
+        /** sizeof(Entry) file was written with */
+        uint16_t entry_size;
+
+        /** Schema/layout id of entries, 0 if unknown */
+        uint32_t schema_id;
+
+        /** Timestamp of first entry written to file */
+        uint64_t first_tstamp;
+
+        /** CRC32 of all of the above */
+        uint32_t crc32;
+    }__attribute__((packed));
+
+    enum FileFlags
+    {
+        // File holds DataStoreCodec blocks after header
+        FILE_ENCODED = 0x01
+    };
+
     DataStore(const char *dir_path, int max_entries_per_file);
 
+    DataStore(const char *dir_path, int max_entries_per_file, uint32_t schema_id);
+
+    DataStore(const char *dir_path, int max_entries_per_file,
+        const DataStoreCodec::Field *layout, int layout_field_count,
+        DataStoreCodec::BlockLayout block_layout = DataStoreCodec::BLOCK_ROWS);
+
     RetResult add(TStruct *data);
 
     RetResult commit();
+
+    void set_commit_mode(DataStoreCommitMode mode);
+
+    DataStoreCommitMode get_commit_mode() const;
     
     RetResult clear_buffer();
 
     RetResult clear_all();
 
+    RetResult park_buffer();
+
+    RetResult restore_buffer();
+
     unsigned int get_buffer_element_count() const;
 
     const Entry* get_buffer_element(unsigned int index) const;
 
 	const char* get_dir_path() const;
+
+    RetResult load_manifest();
+
+    DataStoreManifest* get_manifest();
+
+    RetResult set_acked_entries(int record_index, uint16_t acked_entries);
+
+    RetResult delete_file(int record_index);
+
+    void set_ring_log(RingLog *ring_log);
+
+    RingLog* get_ring_log();
+
+    int get_max_entries_per_file() const;
+
+    RetResult set_encoding(const DataStoreCodec::Field *layout, int layout_field_count,
+        DataStoreCodec::BlockLayout block_layout = DataStoreCodec::BLOCK_ROWS);
+
+    const DataStoreCodec::Field* get_encoding(int *layout_field_count) const;
+
+    RetResult scan_encoded_file(File &f, DataStoreManifest::Record *record,
+        DataStoreCodec::History *history, size_t *valid_size);
+
+    RetResult cleanup_store(uint32_t budget_ms, int *files_merged);
+
+    uint32_t get_schema_id() const;
+
+    DataStoreFileFormat read_file_header(File &f, FileHeader *header);
+
+    RetResult upgrade_files(int *files_upgraded, int *files_dropped);
 protected:
 	// Default constructor private
 	DataStore();
@@ -50,11 +133,48 @@ private:
     // Methods
     //
 
-    RetResult update_current_data_file_path();
+    RetResult commit_files();
+
+    RetResult commit_per_entry();
+
+    RetResult commit_bulk();
+
+    RetResult commit_ring_log();
+
+    RetResult commit_encoded();
+
+    RetResult restore_codec_history();
+
+    void remove_buffer_head(unsigned int count);
+
+    RetResult update_current_data_file_path(uint64_t first_tstamp, bool new_file = false);
+
+    bool current_file_usable();
+
+    RetResult write_file_header(File &f, uint64_t first_tstamp, bool encoded);
+
+    size_t data_offset(const DataStoreManifest::Record *record) const;
+
+    RetResult upgrade_file(int record_index, DataStoreManifest::Record *record, bool *dropped);
+
+    RetResult decide_new_file_path(DataStoreManifest::Record *record, char *path, int path_size);
+
+    RetResult update_current_record(const Entry *entries, int count);
 
-    File open_file();
+    static void restore_manifest_record(void *store);
 
-    RetResult cleanup_store();
+    void restore_current_record();
+
+    RetResult rebuild_manifest();
+
+    File open_file(const DataStoreManifest::Record *record, const char *mode);
+
+    int read_live_entries(const DataStoreManifest::Record *record, Entry *entries, bool *dropped);
+
+    RetResult write_merged_file(const Entry *entries, int count, const DataStoreManifest::Record *sources,
+        const int *source_indexes, int source_count, int *files_merged);
+
+    RetResult remove_file(int record_index, const DataStoreManifest::Record *record);
 
     //
     // Vars
@@ -63,6 +183,15 @@ private:
     /** Holds path of file where last data was written, to avoid finding it every time */
     char _current_data_file_path[FILE_PATH_BUFFER_SIZE] = {0};
 
+    /** List of files in store */
+    DataStoreManifest _manifest;
+
+    /** Manifest record of current data file (kept in sync with manifest) */
+    DataStoreManifest::Record _current_record = {0};
+
+    /** Index of _current_record in manifest, -1 if none */
+    int _current_record_index = -1;
+
     /** Data buffer. Data is stored temporarily here until buffer is full or when
      * commit() is called in which case it is saved into flash memory and emptied */
     Entry _buffer[DATA_STORE_BUFFER_ELEMENTS];
@@ -76,6 +205,29 @@ private:
     /** When writing data to flash, break it into x elements per file.
   	 *	A file is removed only when all of its data is marked as deleted. */
     int _max_entries_per_file = 0;
+
+    /** When set and ready, data is committed here instead of SPIFFS */
+    RingLog *_ring_log = NULL;
+
+    /** Field layout of TStruct. When set, files are written as encoded blocks. */
+    const DataStoreCodec::Field *_layout = NULL;
+    int _layout_field_count = 0;
+
+    /** Layout of blocks written */
+    DataStoreCodec::BlockLayout _block_layout = DataStoreCodec::BLOCK_ROWS;
+
+    /** Last entries written to current file, to encode the next ones against */
+    DataStoreCodec::History _codec_history = {0};
+
+    /** _codec_history matches the end of the current file */
+    bool _codec_history_valid = false;
+
+    /** Id of TStruct's schema written to file headers, files with another
+     * id are not read. 0 if unknown, only entry size is checked. */
+    uint32_t _schema_id = 0;
+
+    /** How buffer is written to flash on commit */
+    DataStoreCommitMode _commit_mode = DATA_STORE_COMMIT_BULK;
 };
 
 #endif
\ No newline at end of file
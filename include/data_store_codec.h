@@ -0,0 +1,185 @@
+#ifndef DATA_STORE_CODEC_H
+#define DATA_STORE_CODEC_H
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <type_traits>
+#include "struct.h"
+#include "const.h"
+
+/** Field of entry struct TStruct, for a layout. Column type is deduced. */
+#define DATA_STORE_CODEC_FIELD(TStruct, field, kind) \
+    { (uint8_t)sizeof(((TStruct*)0)->field), DataStoreCodec::kind, \
+        DataStoreCodec::ColumnTypeOf<decltype(((TStruct*)0)->field)>::value }
+
+/******************************************************************************
+ * DataStoreCodec
+ * Encodes runs of store entries into checksummed blocks. Every field of an
+ * entry is stored as the zigzag varint of its difference from the same field
+ * of the previous entry, with a bitmap of changed fields in front so fields
+ * that didn't change take no space. Timestamps can be stored as the
+ * difference of differences, so fixed intervals take no space either.
+ * The first entry of a file is stored raw (keyframe), so every file can be
+ * decoded on its own.
+ * Blocks can also be columnar: each field of all entries of the block is
+ * stored contiguously, after a summary with the min/max of every column.
+ * Columnar blocks don't depend on previous blocks, so they can be skipped
+ * (eg. by timestamp range) without decoding them.
+ * The codec doesn't know entry types, it works on a layout: the list of field
+ * sizes/types of the packed struct, in order. The first field must be the
+ * entry timestamp.
+ ******************************************************************************/
+namespace DataStoreCodec
+{
+    /** How a field is encoded */
+    enum FieldKind
+    {
+        // Difference from previous entry
+        FIELD_DELTA,
+        // Difference from previous difference (timestamps, counters)
+        FIELD_DELTA2,
+        // Copied as is when changed (strings)
+        FIELD_RAW
+    };
+
+    /** Value type of a field, for column min/max */
+    enum ColumnType
+    {
+        COLUMN_UNSIGNED,
+        COLUMN_SIGNED,
+        COLUMN_FLOAT,
+        // No min/max (arrays)
+        COLUMN_BYTES
+    };
+
+    /** ColumnType of a C++ type */
+    template <typename T>
+    struct ColumnTypeOf
+    {
+        static const uint8_t value =
+            std::is_floating_point<T>::value ? COLUMN_FLOAT :
+            std::is_signed<T>::value ? COLUMN_SIGNED :
+            std::is_arithmetic<T>::value || std::is_enum<T>::value ? COLUMN_UNSIGNED :
+            COLUMN_BYTES;
+    };
+
+    /** How blocks are laid out */
+    enum BlockLayout
+    {
+        // Entry after entry, each encoded against the previous one
+        BLOCK_ROWS,
+        // Column after column, block independent of others
+        BLOCK_COLUMNS
+    };
+
+    /** Field of entry layout */
+    struct Field
+    {
+        uint8_t size;
+        uint8_t kind;
+        uint8_t type;
+    };
+
+    /** Precedes every block in a data file */
+    struct BlockHeader
+    {
+        /** Entries in block */
+        uint8_t entries;
+
+        /** BlockFlags */
+        uint8_t flags;
+
+        /** Size of payload following the header */
+        uint16_t payload_size;
+
+        /** CRC32 of payload */
+        uint32_t crc32;
+    }__attribute__((packed));
+
+    enum BlockFlags
+    {
+        // First entry of block is stored raw, decoding history is reset
+        BLOCK_KEYFRAME = 0x01,
+        // Payload is column summary and columns
+        BLOCK_COLUMNAR = 0x02
+    };
+
+    /**
+     * Entries before the one being encoded/decoded. Must be the same when
+     * encoding and decoding a block.
+     */
+    struct History
+    {
+        /** Previous and the one before it */
+        uint8_t prev[2][DATA_STORE_CODEC_MAX_ENTRY_SIZE];
+
+        /** Valid entries in prev, 0 - 2 */
+        int count;
+    };
+
+    /** Read position in each column of a columnar block */
+    struct ColumnCursor
+    {
+        uint16_t pos[DATA_STORE_CODEC_MAX_FIELDS];
+
+        /** Next entry to decode */
+        int entry;
+    };
+
+    /** Seed of layout ids (FNV-1a offset basis) */
+    const uint32_t LAYOUT_ID_SEED = 2166136261u;
+
+    constexpr uint32_t hash_byte(uint32_t hash, uint8_t byte)
+    {
+        return (hash ^ byte) * 16777619u;
+    }
+
+    constexpr uint32_t hash_field(uint32_t hash, const Field &field)
+    {
+        return hash_byte(hash_byte(hash_byte(hash, field.size), field.kind), field.type);
+    }
+
+    /**
+     * Id of a layout, changes with the size, type or encoding of any field.
+     * Data files keep the id of the layout they were written with.
+     */
+    constexpr uint32_t layout_id(const Field *layout, int field_count, uint32_t hash = LAYOUT_ID_SEED)
+    {
+        return field_count == 0 ? hash : layout_id(layout + 1, field_count - 1, hash_field(hash, layout[0]));
+    }
+
+    RetResult check_layout(const Field *layout, int field_count, size_t entry_size);
+
+    void reset_history(History *history);
+
+    int encode_block(const Field *layout, int field_count, size_t entry_size, History *history,
+        const uint8_t *entries, size_t entry_stride, int entry_count, uint8_t *block, int block_size,
+        int *entries_encoded);
+
+    RetResult read_block_header(const uint8_t *data, int size, BlockHeader *header);
+
+    bool block_crc_valid(const BlockHeader *header, const uint8_t *payload);
+
+    int decode_entry(const Field *layout, int field_count, size_t entry_size, History *history,
+        bool keyframe, const uint8_t *payload, int payload_size, uint8_t *entry);
+
+    int encode_columnar_block(const Field *layout, int field_count, size_t entry_size,
+        const uint8_t *entries, size_t entry_stride, int entry_count, uint8_t *block, int block_size,
+        int *entries_encoded);
+
+    int get_summary_size(const Field *layout, int field_count);
+
+    void get_column_range(const Field *layout, int field_count, const uint8_t *summary, int column,
+        uint8_t *min, uint8_t *max);
+
+    bool summary_in_time_range(const Field *layout, int field_count, const uint8_t *summary,
+        uint64_t from, uint64_t to);
+
+    RetResult begin_columnar_block(const Field *layout, int field_count, const BlockHeader *header,
+        const uint8_t *payload, ColumnCursor *cursor);
+
+    RetResult decode_columnar_entry(const Field *layout, int field_count, size_t entry_size, History *history,
+        const BlockHeader *header, const uint8_t *payload, ColumnCursor *cursor, uint8_t *entry);
+}
+
+#endif
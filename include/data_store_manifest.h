@@ -0,0 +1,215 @@
+#ifndef DATA_STORE_MANIFEST_H
+#define DATA_STORE_MANIFEST_H
+
+#include <inttypes.h>
+#include "storage.h"
+#include "struct.h"
+#include "const.h"
+
+/******************************************************************************
+ * DataStoreManifest
+ * Keeps the list of data files of a DataStore in a single file, so that the
+ * store never has to list the partition (which is O(all files) and gets
+ * slower as the offline backlog grows).
+ * The manifest is a fixed size header followed by one fixed size record per
+ * data file, in creation order. Records are updated in place and deleted ones
+ * are only flagged; the file is compacted when it becomes sparse.
+ * Entry count and timestamps of the file currently written to change on every
+ * commit. They are kept in RAM and only written with the next write of the
+ * record (file acked, switched or deleted). Whoever loads the manifest (the
+ * store, eviction, printing), the store's restore callback rebuilds them from
+ * the file.
+ * Every store has a priority and optionally a quota (max data files). When
+ * flash runs out, the oldest files of stores over their quota and then of the
+ * lowest priority store are evicted (deleted unsubmitted) through their
+ * manifest.
+ ******************************************************************************/
+class DataStoreManifest
+{
+public:
+    //
+    // Structs
+    //
+
+    /** Manifest file header */
+    struct Header
+    {
+        /** Must be MANIFEST_MAGIC */
+        uint32_t magic;
+
+        /** Format version */
+        uint8_t version;
+
+        /** sizeof(Record) the manifest was written with */
+        uint8_t record_size;
+
+        uint16_t reserved;
+
+        /** Number of records in file (incl. deleted) */
+        uint32_t record_count;
+
+        /** Number of records not deleted */
+        uint32_t live_files;
+
+        /** Record of file currently written to, -1 if none */
+        int32_t current_record;
+
+        /** CRC32 of all of the above */
+        uint32_t crc32;
+    }__attribute__((packed));
+
+    /** A single data file */
+    struct Record
+    {
+        /** File name is <store dir>/<name_tstamp>_<name_postfix> */
+        uint32_t name_tstamp;
+        uint8_t name_postfix;
+
+        /** RecordFlags */
+        uint8_t flags;
+
+        /** Entries written to file */
+        uint16_t entries;
+
+        /** Leading entries already submitted, skipped by readers */
+        uint16_t acked_entries;
+
+        /** Oldest/newest entry timestamp (units of the store's entries) */
+        uint64_t min_tstamp;
+        uint64_t max_tstamp;
+    }__attribute__((packed));
+
+    enum RecordFlags
+    {
+        RECORD_DELETED = 0x01,
+        // File holds DataStoreCodec blocks instead of raw entries
+        RECORD_ENCODED = 0x02,
+        // File starts with a DataStore::FileHeader
+        RECORD_HEADER = 0x04,
+        // File header doesn't match store (another schema), skipped by
+        // readers until evicted
+        RECORD_MISMATCH = 0x08
+    };
+
+    /** Brings the current record up to date with its file on load */
+    typedef void (*RestoreCallback)(void *store);
+
+    DataStoreManifest(const char *store_dir_path);
+
+    ~DataStoreManifest();
+
+    RetResult load();
+
+    RetResult create();
+
+    void unload();
+
+    bool is_loaded() const;
+
+    void set_restore_callback(RestoreCallback callback, void *store);
+
+    RetResult append_record(const Record *record, int *index, bool make_current = true);
+
+    RetResult update_record(int index, const Record *record);
+
+    RetResult cache_current_record(const Record *record);
+
+    RetResult delete_record(int index);
+
+    RetResult get_record(int index, Record *record);
+
+    File open_records();
+
+    bool read_next_record(File &f, Record *record, int *index);
+
+    RetResult set_current_record(int index);
+
+    int get_current_record() const;
+
+    uint32_t get_live_files() const;
+
+    uint32_t get_record_count() const;
+
+    void get_file_path(const Record *record, char *buff, int buff_size) const;
+
+    DataStorePriority get_priority() const;
+
+    int get_max_files() const;
+
+    RetResult evict_oldest(bool keep_current);
+
+    static RetResult evict(DataStoreManifest *requester);
+
+    void reader_opened();
+
+    void reader_closed();
+
+    void print_summary();
+
+    static void print_all();
+
+    static void unload_all();
+
+    static DataStorePriority get_dir_priority(const char *store_dir_path);
+
+private:
+	// Default constructor private
+	DataStoreManifest();
+
+    RetResult write_header(File &f);
+
+    RetResult flush_current_record();
+
+    RetResult compact();
+
+    RetResult find_oldest_record(Record *record, int *index, bool keep_current);
+
+    uint32_t header_crc() const;
+
+    //
+    // Vars
+    //
+
+    /** Manifest file path */
+    char _path[FILE_PATH_BUFFER_SIZE] = {0};
+
+    /** Dir of the store this manifest describes */
+    const char *_store_dir_path = NULL;
+
+    /** Priority of store's data, lowest is evicted first */
+    DataStorePriority _priority = DATA_STORE_PRIORITY_PRIMARY;
+
+    /** Data files kept when flash runs out, files over this are evicted
+     * first. 0 for no quota. */
+    int _max_files = 0;
+
+    /** Copy of header in file */
+    Header _header = {0};
+
+    /** Header has been loaded or created */
+    bool _loaded = false;
+
+    /** Called on load to restore the current record, with the store owning
+     * the manifest */
+    RestoreCallback _restore_callback = NULL;
+    void *_restore_store = NULL;
+
+    /** Current record as last updated, returned instead of the one in file */
+    Record _current = {0};
+    bool _current_cached = false;
+
+    /** _current has changes not written to file yet */
+    bool _current_dirty = false;
+
+    /** Readers iterating records. Manifest is not compacted while > 0,
+     * since readers track records by index. */
+    int _open_readers = 0;
+
+    /** Next manifest in the list of all manifests */
+    DataStoreManifest *_next = NULL;
+
+    /** First manifest in the list of all manifests */
+    static DataStoreManifest *_first;
+};
+
+#endif
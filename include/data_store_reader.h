@@ -11,15 +11,64 @@
 
 #include "data_store.h"
 
+/******************************************************************************
+ * Entries read at once by DataStoreReader::next_entries(), in a buffer owned
+ * by the caller. Entries of raw files are read straight into it and used in
+ * place. Only valid entries (CRC ok, in time range) are kept.
+ ******************************************************************************/
+template <class TStruct>
+struct DataStoreSpan
+{
+    typedef typename DataStore<TStruct>::Entry Entry;
+
+    DataStoreSpan(Entry *buff, int capacity) : buff(buff), capacity(capacity)
+    {}
+
+    const TStruct* get(int index) const
+    {
+        return &buff[index].data;
+    }
+
+    /** Buffer and its size in entries */
+    Entry *buff;
+    int capacity;
+
+    /** Valid entries in buffer */
+    int count = 0;
+
+    /** Entries read from store that failed their CRC, dropped */
+    int crc_failures = 0;
+};
+
+/******************************************************************************
+ * Position of a DataStoreReader in a file (or ring log group), taken with
+ * DataStoreReader::mark(). Entries read up to it can be acked after the
+ * reader has moved on, eg. when the response of a pipelined request arrives.
+ ******************************************************************************/
+struct DataStoreReadMark
+{
+    /** Mark is in ring log, not a file */
+    bool ring_log;
+
+    /** Manifest record of file and entries read from it, -1 if none */
+    int record_index;
+    int entries_read;
+
+    /** Ring log records read since the previous mark */
+    RingLog::Cursor ring_from;
+    RingLog::Cursor ring_to;
+};
+
 template <class TStruct>
 class DataStoreReader
 {
 public:
     ~DataStoreReader();
-	DataStoreReader(const DataStore<TStruct> *store);
+	DataStoreReader(DataStore<TStruct> *store);
 
     bool next_file();
     TStruct* next_entry();
+    bool next_entries(DataStoreSpan<TStruct> *span, int max_entries);
 
     RetResult begin();
     void reset();
@@ -27,21 +76,145 @@ public:
     bool entry_crc_valid();
     RetResult delete_file();
 
+    RetResult ack();
+
+    void mark(DataStoreReadMark *mark);
+
+    RetResult ack(const DataStoreReadMark *mark);
+
+    RetResult delete_file(const DataStoreReadMark *mark);
+
+    void set_time_range(uint64_t from, uint64_t to);
+
+    void set_file_range(uint64_t from, uint64_t to);
+
+    void set_order(DataStoreReadOrder order);
+
+    void set_ring_log_enabled(bool enabled);
+
 private:
 	// Default constructor private
     DataStoreReader();
 
     RetResult reset_data_state();
 
+    void begin_next_source();
+
+    bool begin_files();
+
+    bool begin_ring_log();
+
+    bool next_record(DataStoreManifest::Record *record);
+
+    bool next_newest_record(DataStoreManifest::Record *record);
+
+    bool fill_order_batch();
+
+    bool file_in_range(const DataStoreManifest::Record *record) const;
+
+    TStruct* read_next_entry();
+
+    bool in_time_range(uint64_t tstamp) const;
+
+    void filter_entries(DataStoreSpan<TStruct> *span, int count, bool check_crc);
+
+    bool next_encoded_entry();
+
+    bool read_block();
+
+    void skip_acked_entries(int acked_entries);
+
     /** Data store to traverse */
-    const DataStore<TStruct> *_store = NULL;
+    DataStore<TStruct> *_store = NULL;
+
+    /** Manifest of store, lists its files */
+    DataStoreManifest *_manifest = NULL;
+
+    /** Handle to manifest records */
+    File _records;
+
+    /** Manifest record index of current file */
+    int _cur_record_index = -1;
+
+    /** Order files are returned in */
+    DataStoreReadOrder _order = DATA_STORE_READ_OLDEST_FIRST;
+
+    /** Newest-first: records of next files (index, newest entry), newest
+     * first, and the position in them */
+    struct OrderedRecord
+    {
+        int index;
+        uint64_t max_tstamp;
+    };
+
+    OrderedRecord _order_batch[DATA_STORE_READ_ORDER_BATCH];
+    int _order_batch_count = 0;
+    int _order_batch_pos = 0;
 
-    /** Handle to store dir */
-    File _dir;
+    /** Newest-first: last file returned, next batch is of files older than it */
+    bool _order_started = false;
+    OrderedRecord _order_last = {0};
+
+    /** Files and ring log have been read (or tried) */
+    bool _files_done = false;
+    bool _ring_log_done = false;
+
+    /** Read ring log too */
+    bool _ring_log_enabled = true;
+
+    /** Ring log of store, read after files */
+    RingLog *_ring_log = NULL;
+
+    /** Next ring log record to read */
+    RingLog::Cursor _ring_cursor = {0};
+
+    /** First record of current group of ring log records */
+    RingLog::Cursor _ring_file_start = {0};
+
+    /** Records read in current group */
+    int _ring_file_entries = 0;
 
     /** Current file (when iterating) */
     File _cur_file;
 
+    /** Entries read from current file (or ring log group), incl. acked ones
+     * skipped when opening it */
+    int _file_entries_read = 0;
+
+    /** Bytes before first entry/block of current file (its header) */
+    size_t _cur_file_data_offset = 0;
+
+    /** Current file holds encoded blocks */
+    bool _cur_file_encoded = false;
+
+    /** Encoding layout of store */
+    const DataStoreCodec::Field *_layout = NULL;
+    int _layout_field_count = 0;
+
+    /** Current block of encoded file */
+    DataStoreCodec::BlockHeader _block_header = {0};
+    uint8_t _block[DATA_STORE_CODEC_BLOCK_SIZE];
+
+    /** Entries decoded from current block and read position in its payload */
+    int _block_entries_read = 0;
+    int _block_pos = 0;
+
+    /** Decoding history, reset at every keyframe */
+    DataStoreCodec::History _history = {0};
+
+    /** Column positions in current block, when columnar */
+    DataStoreCodec::ColumnCursor _column_cursor = {{0}, 0};
+
+    /** Only entries with timestamps in [_time_from, _time_to] are returned */
+    bool _time_range_set = false;
+    uint64_t _time_from = 0;
+    uint64_t _time_to = 0;
+
+    /** Only files with their newest entry in [_file_from, _file_to] are read */
+    bool _file_range_set = false;
+    uint64_t _file_from = 0;
+    uint64_t _file_to = 0;
+
     /** Buffer to which entries are read and their data field  returned */
     typename DataStore<TStruct>::Entry _cur_entry = {0};
 
@@ -56,6 +229,7 @@ private:
     {
         STATE_PREPARE = 1,
         STATE_READING,
+        STATE_READING_RING_LOG,
         STATE_READING_FINISHED
     };
 };
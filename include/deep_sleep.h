@@ -0,0 +1,33 @@
+#ifndef DEEP_SLEEP_H
+#define DEEP_SLEEP_H
+
+#include <inttypes.h>
+#include <stddef.h>
+#include "struct.h"
+
+/******************************************************************************
+ * Deep sleep state
+ * In deep sleep only RTC slow memory is kept, the device resets on wake up.
+ * Module state needed after waking up is kept in RTC_DATA_ATTR vars in each
+ * module. DataStore buffers are too large to keep for every store, so before
+ * deep sleep the entries in them are parked here (only as many bytes as
+ * there are entries) and put back on resume.
+ * RTC_DATA_ATTR memory is initialized on every boot except deep sleep wake
+ * ups, so nothing parked survives a reset or power loss.
+ ******************************************************************************/
+namespace DeepSleep
+{
+    RetResult park(const char *key, const void *data, size_t size);
+
+    RetResult unpark(const char *key, void *data, size_t max_size, size_t *size);
+
+    void clear();
+
+    size_t get_parked_bytes();
+
+    RetResult park_state();
+
+    RetResult restore_state();
+}
+
+#endif
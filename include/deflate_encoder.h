@@ -0,0 +1,72 @@
+#ifndef DEFLATE_ENCODER_H
+#define DEFLATE_ENCODER_H
+
+#include <inttypes.h>
+#include <stddef.h>
+#include "struct.h"
+#include "const.h"
+#include "http_body.h"
+
+/******************************************************************************
+ * Streaming deflate (RFC 1951) encoder with a fixed memory budget
+ * LZ77 over a DEFLATE_WINDOW_SIZE history with hash chains, coded in a single
+ * block with the fixed Huffman codes, so no code tables are built or sent.
+ * Meant for repetitive text like telemetry JSON, where most of the gain is
+ * in matches. Input is compressed as it is written, output is passed to a
+ * sink a small buffer at a time.
+ ******************************************************************************/
+class DeflateEncoder
+{
+public:
+    void begin(HttpBodySink *out);
+
+    RetResult write(const uint8_t *data, int size);
+
+    RetResult finish();
+
+    int get_out_size();
+
+private:
+    void compress(bool flush);
+
+    int longest_match(int *distance);
+
+    void insert_hash(int pos);
+
+    uint32_t hash(int pos);
+
+    void slide();
+
+    void put_bits(uint32_t bits, int count);
+
+    void put_code(uint32_t code, int length);
+
+    void put_literal(int literal);
+
+    void put_match(int length, int distance);
+
+    void flush_out();
+
+    HttpBodySink *_out = NULL;
+
+    /** History and lookahead. Next byte to code at _pos, bytes up to _end. */
+    uint8_t _window[2 * DEFLATE_WINDOW_SIZE];
+    int _pos = 0;
+    int _end = 0;
+
+    /** Newest position of every hash and previous one of same hash by position */
+    uint16_t _head[1 << DEFLATE_HASH_BITS];
+    uint16_t _prev[DEFLATE_WINDOW_SIZE];
+
+    /** Bits not filling a byte yet, LSB first */
+    uint32_t _bits = 0;
+    int _bit_count = 0;
+
+    uint8_t _out_buff[DEFLATE_OUT_BUFF_SIZE];
+    int _out_buff_size = 0;
+    int _out_size = 0;
+
+    bool _failed = false;
+};
+
+#endif
@@ -0,0 +1,191 @@
+#ifndef ENTRY_SCHEMA_H
+#define ENTRY_SCHEMA_H
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <type_traits>
+#include "struct.h"
+#include "data_store_codec.h"
+
+/**
+ * Field of entry struct TStruct, for a schema. Offset, size and type are
+ * deduced.
+ * @param key JSON key, NULL if not sent
+ * @param decimals Floats are rounded to, EntrySchema::DECIMALS_ALL to send as is
+ * @param codec_kind DataStoreCodec::FieldKind the field is stored with
+ * @param flags EntrySchema::FieldFlags
+ */
+#define ENTRY_SCHEMA_FIELD(TStruct, field, key, label, decimals, codec_kind, flags) \
+    { key, label, (uint16_t)offsetof(TStruct, field), (uint8_t)sizeof(((TStruct*)0)->field), \
+        EntrySchema::FieldTypeOf<decltype(((TStruct*)0)->field)>::value, decimals, \
+        DataStoreCodec::codec_kind, flags }
+
+/** Fields in a schema */
+#define ENTRY_SCHEMA_FIELD_COUNT(schema) ((int)(sizeof(schema) / sizeof(schema[0])))
+
+/**
+ * Fail build if schema doesn't describe every byte of TStruct, in order.
+ * Catches members added to an entry but not to its schema.
+ */
+#define ENTRY_SCHEMA_CHECK(TStruct, schema) \
+    static_assert(EntrySchema::fields_contiguous(schema, ENTRY_SCHEMA_FIELD_COUNT(schema)) && \
+        EntrySchema::fields_size(schema, ENTRY_SCHEMA_FIELD_COUNT(schema)) == sizeof(TStruct), \
+        "Schema of " #TStruct " does not match its members")
+
+/******************************************************************************
+ * EntrySchema
+ * Describes the members of a store entry struct in a constexpr table: JSON
+ * key, label, offset, size and type, decimals sent and how the store codec
+ * encodes it. Telemetry JSON, print() and store encoding layouts are
+ * generated from the table, so adding a value to an entry is adding the
+ * member and its line in the schema.
+ * Tables are checked at compile time against their struct (ENTRY_SCHEMA_CHECK)
+ * and encoding layouts are generated at compile time (CodecLayout).
+ ******************************************************************************/
+namespace EntrySchema
+{
+    /** Value type of a field */
+    enum FieldType
+    {
+        TYPE_BOOL,
+        TYPE_UNSIGNED,
+        TYPE_SIGNED,
+        TYPE_FLOAT
+    };
+
+    enum FieldFlags
+    {
+        FLAG_NONE = 0x00,
+        // Sent only if any field of the entry with this flag is not zero
+        // (eg. sensor not attached)
+        FLAG_ZERO_GROUP = 0x01
+    };
+
+    /** Send float as is, not rounded */
+    const int8_t DECIMALS_ALL = -1;
+
+    /** FieldType of a C++ type */
+    template <typename T>
+    struct FieldTypeOf
+    {
+        static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value,
+            "Schema fields must be numbers, bools or enums");
+
+        static const uint8_t value =
+            std::is_same<T, bool>::value ? TYPE_BOOL :
+            std::is_floating_point<T>::value ? TYPE_FLOAT :
+            std::is_signed<T>::value ? TYPE_SIGNED :
+            TYPE_UNSIGNED;
+    };
+
+    struct Field
+    {
+        /** JSON key of value, NULL if not sent */
+        const char *key;
+
+        /** Printed before value */
+        const char *label;
+
+        uint16_t offset;
+
+        uint8_t size;
+
+        /** FieldType */
+        uint8_t type;
+
+        /** Decimals a float is rounded to when sent, DECIMALS_ALL to send as is */
+        int8_t decimals;
+
+        /** DataStoreCodec::FieldKind */
+        uint8_t codec_kind;
+
+        /** FieldFlags */
+        uint8_t flags;
+    };
+
+    /**
+     * Fields follow each other with no gaps, starting at offset
+     */
+    constexpr bool fields_contiguous(const Field *fields, int count, int offset = 0)
+    {
+        return count == 0 ||
+            (fields[0].offset == offset && fields_contiguous(fields + 1, count - 1, offset + fields[0].size));
+    }
+
+    /**
+     * Total size of fields
+     */
+    constexpr int fields_size(const Field *fields, int count)
+    {
+        return count == 0 ? 0 : fields[0].size + fields_size(fields + 1, count - 1);
+    }
+
+    /**
+     * Store encoding of a field
+     */
+    constexpr DataStoreCodec::Field codec_field(const Field &field)
+    {
+        return DataStoreCodec::Field {
+            field.size, field.codec_kind,
+            (uint8_t)(field.type == TYPE_FLOAT ? DataStoreCodec::COLUMN_FLOAT :
+                field.type == TYPE_SIGNED ? DataStoreCodec::COLUMN_SIGNED :
+                DataStoreCodec::COLUMN_UNSIGNED)
+        };
+    }
+
+    /**
+     * Id of a schema, for data file headers. Same as the layout id of its
+     * store encoding (DataStoreCodec::layout_id()).
+     */
+    constexpr uint32_t schema_id(const Field *fields, int count, uint32_t hash = DataStoreCodec::LAYOUT_ID_SEED)
+    {
+        return count == 0 ? hash : schema_id(fields + 1, count - 1, DataStoreCodec::hash_field(hash, codec_field(fields[0])));
+    }
+
+    /** 0 .. N-1 as template parameters */
+    template <int... I>
+    struct Indexes {};
+
+    template <int N, int... I>
+    struct MakeIndexes : MakeIndexes<N - 1, N - 1, I...> {};
+
+    template <int... I>
+    struct MakeIndexes<0, I...>
+    {
+        typedef Indexes<I...> type;
+    };
+
+    template <const Field *TFields, typename TIndexes>
+    struct CodecLayoutOf;
+
+    template <const Field *TFields, int... I>
+    struct CodecLayoutOf<TFields, Indexes<I...>>
+    {
+        static constexpr DataStoreCodec::Field fields[sizeof...(I)] = { codec_field(TFields[I])... };
+    };
+
+    template <const Field *TFields, int... I>
+    constexpr DataStoreCodec::Field CodecLayoutOf<TFields, Indexes<I...>>::fields[sizeof...(I)];
+
+    /**
+     * Store encoding layout of a schema, built at compile time.
+     * Schema must be constexpr and visible where used.
+     * Usage: CodecLayout<SCHEMA, ENTRY_SCHEMA_FIELD_COUNT(SCHEMA)>::fields
+     */
+    template <const Field *TFields, int TCount>
+    struct CodecLayout : CodecLayoutOf<TFields, typename MakeIndexes<TCount>::type> {};
+
+    uint32_t telemetry_id(const Field *fields, int count);
+
+    double decimals_scale(const Field *field);
+
+    double get_value(const Field *field, const void *entry);
+
+    void set_value(const Field *field, void *entry, double value);
+
+    bool is_zero_group_empty(const Field *fields, int count, const void *entry);
+
+    void print(const Field *fields, int count, const void *entry);
+}
+
+#endif
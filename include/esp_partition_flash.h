@@ -0,0 +1,34 @@
+#ifndef ESP_PARTITION_FLASH_H
+#define ESP_PARTITION_FLASH_H
+
+#include "raw_flash.h"
+#include "esp_partition.h"
+
+/******************************************************************************
+ * RawFlash backed by a data partition in the partition table
+ ******************************************************************************/
+class EspPartitionFlash : public RawFlash
+{
+public:
+    EspPartitionFlash();
+
+    RetResult begin(const char *label);
+
+    bool is_ready() const;
+
+    RetResult read(uint32_t addr, void *dest, size_t size);
+
+    RetResult write(uint32_t addr, const void *src, size_t size);
+
+    RetResult erase_sector(uint32_t addr);
+
+    uint32_t get_size() const;
+
+    uint32_t get_sector_size() const;
+
+private:
+    /** Partition found by begin(), NULL if none */
+    const esp_partition_t *_partition = NULL;
+};
+
+#endif
@@ -1,17 +1,98 @@
 #ifndef FLASH_H
 #define FLASH_H
 #include <inttypes.h>
+#include <stddef.h>
 #include "struct.h"
+#include "const.h"
 
 namespace Flash
 {
+    /** Bytes written by a store, key is the store's dir path */
+    struct StoreStats
+    {
+        const char *dir_path;
+
+        /** Bytes written to data files */
+        uint32_t data_bytes;
+
+        /** Bytes written to the store's manifest */
+        uint32_t manifest_bytes;
+
+        /** write() calls, data and manifest */
+        uint32_t writes;
+
+        /** Data files evicted to make room for other stores */
+        uint32_t files_evicted;
+    };
+
+    /**
+     * Flash wear counters since power on (kept over deep sleep)
+     * SPIFFS doesn't report what it does to flash, page programs and erases
+     * are estimated from write sizes and positions: every data page touched
+     * plus the object index page. Raw flash (ring logs) is counted exactly.
+     * Estimates follow SPIFFS whatever the storage backend.
+     */
+    struct Stats
+    {
+        /** Timestamp of first mount, counters start here */
+        uint32_t since_tstamp;
+
+        /** File write() calls and bytes written */
+        uint32_t writes;
+        uint32_t bytes_written;
+
+        /** SPIFFS pages programmed (estimated) */
+        uint32_t pages_programmed;
+
+        /** Raw flash writes, bytes written and sectors erased */
+        uint32_t raw_writes;
+        uint32_t raw_bytes_written;
+        uint32_t raw_erases;
+
+        /** Files created (incl. truncated) and deleted */
+        uint32_t files_created;
+        uint32_t files_deleted;
+
+        /** Data files deleted unsubmitted because flash was full (incl. in files_deleted) */
+        uint32_t files_evicted;
+
+        /** Mounts and duration of last one */
+        uint32_t mounts;
+        uint32_t mount_ms;
+
+        StoreStats stores[FLASH_STATS_MAX_STORES];
+        int store_count;
+    };
+
     RetResult mount();
 
     RetResult read_file(const char *path, uint8_t *dest, int bytes);
 
     RetResult format();
 
-    void ls();
+    void ls(bool list_files = false);
+
+    size_t get_free_bytes();
+
+    void count_write(const char *dir_path, size_t pos, size_t size, bool manifest = false);
+
+    void count_create();
+
+    void count_delete();
+
+    void count_evict(const char *dir_path);
+
+    void count_raw_write(size_t size);
+
+    void count_raw_erase();
+
+    const Stats* get_stats();
+
+    uint32_t get_est_erases();
+
+    void reset_stats();
+
+    void print_stats();
 }
 
-#endif
\ No newline at end of file
+#endif
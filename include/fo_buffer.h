@@ -7,8 +7,9 @@
 
 /******************************************************************************
 * FO Decoded Packet buffer
-* Stores decoded packets which can then be aggregated and commited into a 
-* single FoData store entry
+* Aggregates decoded packets as they are added, commited into a single FoData
+* store entry. Only running totals are kept (not the packets), small enough
+* to be kept in RTC memory over deep sleep.
 ******************************************************************************/
 class FoBuffer
 {
@@ -19,10 +20,7 @@ public:
 
     static void print_packet(FoDecodedPacket *packet);
 private:
-    /** Buffer */
-    FoDecodedPacket _buffer[FO_BUFFER_SIZE];
-
-    /** Count of packets in buffer */
+    /** Count of packets aggregated */
     int _packet_count = 0;
 
     /** Timestamp of first added packet */
@@ -33,6 +31,19 @@ private:
 
     /** Rain count from previously commited packet. Used to calculate hr rate */
     float _prev_rain = -1;
+
+    /** Rain count of first and last added packet */
+    float _first_rain = 0;
+    float _last_rain = 0;
+
+    /** Totals of params to calc averages */
+    float _hum_total = 0, _temp_total = 0;
+    float _wind_speed_total = 0, _wind_gust_total = 0;
+    float _solar_radiation_total = 0;
+    uint32_t _uv_total = 0, _uv_index_total = 0, _light_total = 0;
+
+    /** Total of sin/cos of wind dir, used to calculate mean angle */
+    float _wind_dir_sin_total = 0, _wind_dir_cos_total = 0;
 };
 
 #endif
\ No newline at end of file
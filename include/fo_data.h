@@ -4,6 +4,7 @@
 #include <inttypes.h>
 #include "struct.h"
 #include "data_store.h"
+#include "entry_schema.h"
 
 namespace FoData
 {
@@ -78,7 +79,10 @@ namespace FoData
     DataStore<StoreEntry>* get_store();
 
 	void inc_wakeup_count();
-    void print(FoData::StoreEntry *packet);
+
+    const EntrySchema::Field* get_schema(int *field_count);
+
+    void print(const StoreEntry *data);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,18 @@
+#ifndef FO_DATA_CBOR_BUILDER_H
+#define FO_DATA_CBOR_BUILDER_H
+
+#include "struct.h"
+#include "const.h"
+#include "fo_data.h"
+#include "cbor_builder_base.h"
+
+/******************************************************************************
+* Helper class to build binary (CBOR) telemetry from FO data structures
+******************************************************************************/
+class FoDataCborBuilder : public CborBuilderBase<FoData::StoreEntry, TELEMETRY_CBOR_BUFF_SIZE>
+{
+public:
+	RetResult add(const FoData::StoreEntry *entry);
+};
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef GZIP_BODY_H
+#define GZIP_BODY_H
+
+#include <inttypes.h>
+#include <stddef.h>
+#include "struct.h"
+#include "const.h"
+#include "http_body.h"
+#include "deflate_encoder.h"
+
+/******************************************************************************
+ * Request body sent gzip compressed (Content-Encoding: gzip)
+ * Wraps another body and compresses it as it is written, so neither the plain
+ * nor the compressed body has to fit in RAM. The compressed length is not
+ * known up front, the body is sent chunked.
+ ******************************************************************************/
+class GzipBodyWriter : public HttpBodyWriter, public HttpBodySink
+{
+public:
+    GzipBodyWriter(HttpBodyWriter *body);
+
+    RetResult write(HttpBodySink *sink);
+
+    int get_length();
+
+    const char* get_content_encoding();
+
+    using HttpBodySink::write;
+
+    RetResult write(const uint8_t *data, int size);
+
+    int get_body_size();
+
+    int get_compressed_size();
+
+    uint32_t get_compress_us();
+
+private:
+    // Default constructor private
+    GzipBodyWriter();
+
+    HttpBodyWriter *_body = NULL;
+
+    DeflateEncoder _encoder;
+
+    /** CRC32 and size of plain body, for the gzip trailer */
+    uint32_t _crc = 0;
+    int _body_size = 0;
+
+    /** Time spent compressing the last body */
+    uint32_t _compress_us = 0;
+};
+
+#endif
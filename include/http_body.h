@@ -0,0 +1,81 @@
+#ifndef HTTP_BODY_H
+#define HTTP_BODY_H
+
+#include <inttypes.h>
+#include <stddef.h>
+#include "struct.h"
+#include "const.h"
+
+/******************************************************************************
+ * Destination of a streamed request body (eg. the socket)
+ ******************************************************************************/
+class HttpBodySink
+{
+public:
+    virtual ~HttpBodySink() {}
+
+    virtual RetResult write(const uint8_t *data, int size) = 0;
+
+    RetResult write(const char *str);
+};
+
+/******************************************************************************
+ * Producer of a request body, written a piece at a time to a sink so the body
+ * doesn't have to fit in RAM. Bodies of unknown length are sent with chunked
+ * transfer encoding.
+ ******************************************************************************/
+class HttpBodyWriter
+{
+public:
+    virtual ~HttpBodyWriter() {}
+
+    virtual RetResult write(HttpBodySink *sink) = 0;
+
+    /** Body length if known before writing it (Content-Length), -1 if not */
+    virtual int get_length() = 0;
+
+    virtual const char* get_content_encoding();
+};
+
+/******************************************************************************
+ * Sink that collects writes into pieces of up to HTTP_BODY_CHUNK_SIZE before
+ * passing them on, as every write to the modem is a command of its own.
+ * Pieces are framed as chunks of chunked transfer encoding when chunked.
+ ******************************************************************************/
+class HttpBodyStream : public HttpBodySink
+{
+public:
+    HttpBodyStream(HttpBodySink *out, bool chunked);
+
+    using HttpBodySink::write;
+
+    RetResult write(const uint8_t *data, int size);
+
+    RetResult finish();
+
+    int get_body_size();
+
+    int get_bytes_sent();
+
+private:
+    // Default constructor private
+    HttpBodyStream();
+
+    RetResult flush();
+
+    RetResult send(const uint8_t *data, int size);
+
+    HttpBodySink *_out = NULL;
+    bool _chunked = false;
+
+    uint8_t _buff[HTTP_BODY_CHUNK_SIZE];
+    int _buff_size = 0;
+
+    /** Body bytes written and bytes passed on (incl. chunk framing) */
+    int _body_size = 0;
+    int _bytes_sent = 0;
+
+    bool _failed = false;
+};
+
+#endif
@@ -5,6 +5,7 @@
 #include "const.h"
 #include <ArduinoHttpClient.h>
 #include "gsm.h"
+#include "http_body.h"
 
 class HttpRequest
 {
@@ -13,11 +14,16 @@ public:
 	RetResult get(const char *path, char *resp_buff, int resp_buff_size);
 	RetResult post(const char *path, const unsigned char *body, int body_len, char *content_type, 
 		char *resp_buff, int resp_buff_size);
+	RetResult post(const char *path, HttpBodyWriter *body, const char *content_type,
+		char *resp_buff, int resp_buff_size);
 
 	uint16_t get_response_code();
 	int get_response_length();
 
 	RetResult set_port(int port);
+
+	static int post_streamed(HttpClient *http_client, const char *path, HttpBodyWriter *body,
+		const char *content_type);
 private:
 	enum Method
 	{
@@ -26,7 +32,11 @@ private:
 	};
 
 	RetResult req(Method method, const char *path, char *resp_buff, int resp_buff_size,
-		const unsigned char *body, int body_len, char *content_type);
+		const unsigned char *body, int body_len, HttpBodyWriter *body_writer, const char *content_type);
+
+	RetResult exchange(HttpClient *http_client, Method method, const char *path, char *resp_buff,
+		int resp_buff_size, const unsigned char *body, int body_len, HttpBodyWriter *body_writer,
+		const char *content_type);
 
 	int _port = 80;
 	char *_server = NULL;
@@ -0,0 +1,35 @@
+#ifndef HTTP_SESSION_H
+#define HTTP_SESSION_H
+
+#include "app_config.h"
+#include "struct.h"
+#include "const.h"
+#include "upload_pipeline.h"
+#include <ArduinoHttpClient.h>
+
+/******************************************************************************
+ * Persistent (keep-alive) HTTP connections to a server
+ * While a session is open, every HttpRequest to its server and port goes over
+ * the same connection instead of opening (and closing) one per request, which
+ * costs a TCP handshake over GPRS each time. The connection is opened by the
+ * first request and reopened by the next request after one fails.
+ * The session has UPLOAD_PIPELINE_SOCKETS connections, each on a modem socket
+ * of its own, for pipelined uploads. HttpRequest uses the first one.
+ * Opened for the call home window, closed before the modem is powered off.
+ ******************************************************************************/
+namespace HttpSession
+{
+    RetResult open(const char *server, int port);
+
+    void close();
+
+    bool is_open_for(const char *server, int port);
+
+    HttpClient* begin_request();
+
+    void end_request(bool success);
+
+    int get_upload_sockets(UploadSocket **sockets, int max_sockets);
+}
+
+#endif
@@ -2,6 +2,7 @@
 #define JSON_BUILDER_BASE_H
 
 #include "struct.h"
+#include "entry_schema.h"
 
 #define ARDUINOJSON_USE_LONG_LONG 1
 #include "ArduinoJson.h"
@@ -15,6 +16,8 @@ class JsonBuilderBase
 public:
     JsonBuilderBase();
 
+    virtual ~JsonBuilderBase() {}
+
     virtual RetResult add(const TStruct *entry) = 0;
 
     RetResult build(char *buff_out, int buff_size, bool beautify);
@@ -27,6 +30,9 @@ public:
 
     StaticJsonDocument<TDocSize>* get_json_doc();
 protected:
+    RetResult add_schema_entry(const TStruct *entry, const EntrySchema::Field *fields, int field_count,
+        const char *timestamp_key);
+
     StaticJsonDocument<TDocSize> _json_doc;
     JsonArray _root_array;
 };
@@ -0,0 +1,18 @@
+#ifndef LIGHTNING_DATA_CBOR_BUILDER_H
+#define LIGHTNING_DATA_CBOR_BUILDER_H
+
+#include "struct.h"
+#include "const.h"
+#include "lightning_data.h"
+#include "cbor_builder_base.h"
+
+/******************************************************************************
+* Helper class to build binary (CBOR) telemetry from lightning data structures
+******************************************************************************/
+class LightningDataCborBuilder : public CborBuilderBase<LightningData::Entry, TELEMETRY_CBOR_BUFF_SIZE>
+{
+public:
+	RetResult add(const LightningData::Entry *entry);
+};
+
+#endif
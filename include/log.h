@@ -22,10 +22,14 @@ namespace Log
         int meta2;
     }__attribute__((packed));
 
+    void begin();
+
     bool log(Log::Code code, uint32_t meta1 = 0, uint32_t meta2 = 0);
     
     RetResult commit();
 
+    int get_staged_count();
+
     void print(const Log::Entry *entry);
 
     DataStore<Entry>* get_store();
@@ -286,6 +286,7 @@ namespace Log
 
         //
         // Calling home finished
+        // Meta1: Duration (sec)
         //
         CALLING_HOME_END = 71,
 
@@ -406,6 +407,20 @@ namespace Log
         //
         DATA_STORE_COMMIT_FAILED = 97,
 
+        //
+        // Log stage was full and could not be written to flash, oldest
+        // entries were overwritten
+        // Meta1: Entries lost
+        LOG_STAGE_OVERFLOW = 98,
+
+        //
+        // Log stage in RTC memory was lost (eg. brown-out) with the entries
+        // not yet written to flash (at most LOG_STAGE_FLUSH_ENTRIES, logged
+        // within LOG_STAGE_MAX_AGE_SEC)
+        // Meta1: Reset reason
+        // Meta2: Seconds since newest log in flash, 0 if unknown
+        LOG_STAGE_LOST = 99,
+
         //
         // GSM errors
         // All 1XX codes
@@ -505,7 +520,55 @@ namespace Log
         * Could not calc wake up time
         * Meta1: 
         */
-        SLEEP_COULD_NOT_CALC_WAKEUP_TIME = 214
+        SLEEP_COULD_NOT_CALC_WAKEUP_TIME = 214,
+
+        /*
+        * Going to deep sleep
+        * Meta1: Bytes of store buffers parked in RTC memory
+        */
+        DEEP_SLEEP = 215,
+
+        /*
+        * Store files migrated to storage backend from previous one
+        * Meta1: Files migrated
+        * Meta2: Files dropped (could not be written)
+        */
+        STORAGE_MIGRATED = 216,
+
+        /*
+        * Store files too big to migrate to storage backend, previous one kept
+        * Meta1: Store files
+        * Meta2: Bytes of store files
+        */
+        STORAGE_MIGRATION_DEFERRED = 217,
+
+        /*
+        * Undersized store files merged before sleep
+        * Meta1: Files merged or removed
+        * Meta2: Time spent (ms)
+        */
+        STORES_COMPACTED = 218,
+
+        /*
+        * Store files without header rewritten with one, at first boot after OTA
+        * Meta1: Files upgraded
+        * Meta2: Files dropped (entries of another format)
+        */
+        STORES_UPGRADED = 219,
+
+        /*
+        * Keep-alive HTTP session of call home closed
+        * Meta1: Requests sent over it
+        * Meta2: Connections opened for them
+        */
+        HTTP_SESSION_CLOSED = 220,
+
+        /*
+        * Telemetry of call home sent gzip compressed
+        * Meta1: Body bytes
+        * Meta2: Compressed bytes
+        */
+        TELEMETRY_COMPRESSED = 221
     };
 }
 
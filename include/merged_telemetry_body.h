@@ -0,0 +1,81 @@
+#ifndef MERGED_TELEMETRY_BODY_H
+#define MERGED_TELEMETRY_BODY_H
+
+#include "struct.h"
+#include "const.h"
+#include "http_body.h"
+
+/******************************************************************************
+ * Entries of a store in time order, as TB telemetry values, for a merged body
+ * Entries written to a request are acked (or their files deleted) by
+ * ack_request() once it succeeds, or read again after rollback().
+ ******************************************************************************/
+class TelemetryStream
+{
+public:
+    /** Streams are deleted by their base, their readers must be closed */
+    virtual ~TelemetryStream() {}
+
+    /** Timestamp (ms) of next entry, false if none left for the request */
+    virtual bool peek(uint64_t *tstamp) = 0;
+
+    /** Write values of next entry (without braces) and move past it */
+    virtual RetResult write_values(HttpBodySink *sink) = 0;
+
+    virtual RetResult ack_request() = 0;
+
+    virtual void rollback() = 0;
+
+    /** Start a submission over, reader closed and counts cleared */
+    virtual void reset() = 0;
+
+    virtual int get_crc_failures() = 0;
+};
+
+/******************************************************************************
+ * TB telemetry JSON of several stores in one request
+ * Entries of all streams are merged in time order, values of entries that
+ * share a timestamp are joined in one {"ts", "values"} object (an entry per
+ * stream, keys of stores don't collide). Requests end when the byte budget is
+ * reached (the last object may go over it) or the streams are out of entries.
+ ******************************************************************************/
+class MergedTelemetryBody : public HttpBodyWriter, public HttpBodySink
+{
+public:
+    MergedTelemetryBody(TelemetryStream **streams, int stream_count, int max_bytes);
+
+    bool begin();
+
+    RetResult write(HttpBodySink *sink);
+
+    int get_length();
+
+    using HttpBodySink::write;
+
+    RetResult write(const uint8_t *data, int size);
+
+    int get_entry_count();
+
+    int get_object_count();
+
+private:
+    // Default constructor private
+    MergedTelemetryBody();
+
+    bool next_tstamp(uint64_t *tstamp);
+
+    TelemetryStream *_streams[TELEMETRY_MAX_MERGED_STREAMS];
+    int _stream_count = 0;
+
+    int _max_bytes = 0;
+
+    /** Sink of body being written */
+    HttpBodySink *_sink = NULL;
+
+    /** Bytes, entries and objects written to request */
+    int _body_size = 0;
+    int _entry_count = 0;
+    int _object_count = 0;
+};
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef RAW_FLASH_H
+#define RAW_FLASH_H
+
+#include <inttypes.h>
+#include <stddef.h>
+#include "struct.h"
+
+/******************************************************************************
+ * RawFlash
+ * Interface to a region of NOR flash, used by storage engines that manage
+ * flash themselves instead of going through a filesystem.
+ * Semantics are those of NOR flash: erase is sector granular and sets all bits
+ * to 1, writes can only clear bits. Addresses are relative to the region.
+ * Implemented by EspPartitionFlash on the device and by EmulatedFlash on the
+ * host.
+ ******************************************************************************/
+class RawFlash
+{
+public:
+    virtual ~RawFlash() {}
+
+    virtual RetResult read(uint32_t addr, void *dest, size_t size) = 0;
+
+    virtual RetResult write(uint32_t addr, const void *src, size_t size) = 0;
+
+    virtual RetResult erase_sector(uint32_t addr) = 0;
+
+    /** Region size in bytes, multiple of sector size */
+    virtual uint32_t get_size() const = 0;
+
+    virtual uint32_t get_sector_size() const = 0;
+};
+
+#endif
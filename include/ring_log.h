@@ -0,0 +1,155 @@
+#ifndef RING_LOG_H
+#define RING_LOG_H
+
+#include <inttypes.h>
+#include "raw_flash.h"
+#include "struct.h"
+
+/******************************************************************************
+ * RingLog
+ * Log-structured storage of fixed size records in a circular region of raw
+ * flash. Records are appended at the head and consumed from the tail. When
+ * the region is full, the oldest sector is erased to make room (oldest-first
+ * eviction). Head/tail are recovered from flash on begin().
+ ******************************************************************************/
+class RingLog
+{
+public:
+    //
+    // Structs
+    //
+
+    /** Written at the start of every sector in use */
+    struct SectorHeader
+    {
+        /** Must be RING_LOG_SECTOR_MAGIC */
+        uint32_t magic;
+
+        /** Incremented every time a sector is opened. Orders sectors in the ring. */
+        uint32_t seq;
+
+        /** Record size the sector was written with */
+        uint16_t record_size;
+
+        uint16_t reserved;
+
+        /** CRC32 of all of the above */
+        uint32_t crc32;
+    }__attribute__((packed));
+
+    /** Precedes every record */
+    struct SlotHeader
+    {
+        /** SlotState */
+        uint8_t state;
+
+        uint8_t reserved[3];
+
+        /** CRC32 of record */
+        uint32_t crc32;
+    }__attribute__((packed));
+
+    /** Slot states. Each state only clears bits of the previous one so
+     * states can be updated in place without erasing. */
+    enum SlotState
+    {
+        SLOT_EMPTY = 0xFF,
+        SLOT_WRITTEN = 0xFE,
+        SLOT_CONSUMED = 0xFC
+    };
+
+    /** Position in ring, used for reading */
+    struct Cursor
+    {
+        uint32_t sector;
+        uint32_t slot;
+    };
+
+    /** Counters since begin() */
+    struct Stats
+    {
+        uint32_t appended;
+        uint32_t consumed;
+        uint32_t evicted;
+        uint32_t sectors_erased;
+        uint32_t invalid_slots;
+    };
+
+    RingLog();
+
+    RetResult begin(RawFlash *flash, uint32_t offset, uint32_t size, uint16_t record_size);
+
+    bool is_ready() const;
+
+    RetResult append(const void *record);
+
+    void get_tail(Cursor *cursor) const;
+
+    bool read_next(Cursor *cursor, void *record, Cursor *record_pos = NULL);
+
+    RetResult consume(const Cursor *from, const Cursor *to);
+
+    bool is_end(const Cursor *cursor) const;
+
+    RetResult erase_all();
+
+    uint32_t count();
+
+    uint32_t get_capacity() const;
+
+    uint16_t get_record_size() const;
+
+    const Stats* get_stats() const;
+
+    void print_info();
+
+private:
+    RetResult open_sector(uint32_t sector);
+
+    RetResult recover_tail();
+
+    bool read_slot_header(uint32_t sector, uint32_t slot, SlotHeader *header);
+
+    uint32_t slot_addr(uint32_t sector, uint32_t slot) const;
+
+    uint32_t next_sector(uint32_t sector) const;
+
+    uint32_t sector_header_crc(const SectorHeader *header) const;
+
+    uint32_t record_crc(const void *record) const;
+
+    //
+    // Vars
+    //
+
+    /** Flash the region is on */
+    RawFlash *_flash = NULL;
+
+    /** Region start/size in flash */
+    uint32_t _offset = 0;
+    uint32_t _sector_count = 0;
+    uint32_t _sector_size = 0;
+
+    /** Record size excl. slot header */
+    uint16_t _record_size = 0;
+
+    uint32_t _slots_per_sector = 0;
+
+    /** Next slot to be written */
+    uint32_t _head_sector = 0;
+    uint32_t _head_slot = 0;
+
+    /** Oldest slot that may hold an unconsumed record */
+    uint32_t _tail_sector = 0;
+    uint32_t _tail_slot = 0;
+
+    /** Seq of head sector */
+    uint32_t _head_seq = 0;
+
+    /** begin() succeeded */
+    bool _ready = false;
+
+    Stats _stats = {0};
+};
+
+#endif
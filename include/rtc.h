@@ -15,6 +15,8 @@ namespace RTC
 
     uint32_t get_last_sync_tick();
 
+    uint32_t get_last_sync_tstamp();
+
     void print_time();
     void print_temp();
 
@@ -12,7 +12,7 @@ namespace SDI12Log
 		unsigned long long timestamp;
 
 		char response[64];
-	};
+	}__attribute__((packed));
 
 	RetResult add(char *data);
 
@@ -32,6 +32,10 @@ namespace SleepScheduler
 
     RetResult sleep_to_next();
 
+    RetResult resume();
+
+    bool deep_sleep_wakeup();
+
     RetResult calc_next_wakeup(uint32_t t_now, const WakeupScheduleEntry schedule[], int *seconds_left, int *event_reasons);
 
     bool wakeup_reason_is(WakeupReason reason);
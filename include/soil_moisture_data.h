@@ -4,6 +4,7 @@
 #include "app_config.h"
 #include "struct.h"
 #include "data_store.h"
+#include "entry_schema.h"
 
 namespace SoilMoistureData
 {
@@ -28,6 +29,8 @@ namespace SoilMoistureData
     RetResult add(Entry *data);
     DataStore<Entry>* get_store();
 
+    const EntrySchema::Field* get_schema(int *field_count);
+
     void print(const Entry *data);
 }
 
@@ -0,0 +1,18 @@
+#ifndef SOIL_MOISTURE_DATA_CBOR_BUILDER_H
+#define SOIL_MOISTURE_DATA_CBOR_BUILDER_H
+
+#include "struct.h"
+#include "const.h"
+#include "soil_moisture_data.h"
+#include "cbor_builder_base.h"
+
+/******************************************************************************
+* Helper class to build binary (CBOR) telemetry from soil moisture data structures
+******************************************************************************/
+class SoilMoistureDataCborBuilder : public CborBuilderBase<SoilMoistureData::Entry, TELEMETRY_CBOR_BUFF_SIZE>
+{
+public:
+	RetResult add(const SoilMoistureData::Entry *entry);
+};
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#include <inttypes.h>
+#include "FS.h"
+#include "struct.h"
+#include "const.h"
+
+/******************************************************************************
+ * Storage
+ * File system data stores, manifests and flash tools use. Backend is chosen
+ * at build time with STORAGE_BACKEND (SPIFFS or LittleFS, host RAM in native
+ * builds), code only sees the fs::FS API plus the few calls that differ
+ * between file systems (begin, format, space).
+ * SPIFFS is flat and "dirs" are name prefixes, LittleFS has real dirs that
+ * must exist before a file is created in them, see make_dirs().
+ *****************************************************************************/
+namespace Storage
+{
+    struct Backend
+    {
+        /** STORAGE_BACKEND_* */
+        int id;
+
+        const char *name;
+
+        fs::FS *fs;
+
+        /** Dirs are real and must be created */
+        bool has_dirs;
+
+        bool (*begin)(bool format_on_fail, uint8_t max_open_files);
+
+        bool (*format)();
+
+        size_t (*total_bytes)();
+
+        size_t (*used_bytes)();
+
+        void (*end)();
+    };
+
+    fs::FS& fs();
+
+    bool begin(bool format_on_fail = false, uint8_t max_open_files = STORAGE_MAX_OPEN_FILES);
+
+    bool format();
+
+    size_t total_bytes();
+
+    size_t used_bytes();
+
+    void end();
+
+    bool is_mounted();
+
+    const char* get_name();
+
+    const Backend* get_backend();
+
+    const Backend* get_backend(int id);
+
+    RetResult set_backend(int id);
+
+    RetResult make_dirs(const char *file_path);
+
+    RetResult migrate(const Backend *from, int *files_migrated, int *files_dropped);
+}
+
+#endif
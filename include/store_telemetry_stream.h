@@ -0,0 +1,76 @@
+#ifndef STORE_TELEMETRY_STREAM_H
+#define STORE_TELEMETRY_STREAM_H
+
+#include "struct.h"
+#include "const.h"
+#include "data_store_reader.h"
+#include "merged_telemetry_body.h"
+
+/******************************************************************************
+ * A store's entries, oldest file first, as a stream of a merged telemetry body
+ * Entries are read one at a time, so the reader can be marked right after the
+ * entries written to a request. The next entry's JSON is built by the type's
+ * builder when peeked, its timestamp and values are taken from it.
+ * A request covers up to TELEMETRY_MAX_FILES_PER_REQ files of a stream, files
+ * read to their end are deleted when it succeeds.
+ ******************************************************************************/
+template <typename TEntry, typename TBuilder>
+class StoreTelemetryStream : public TelemetryStream
+{
+public:
+    StoreTelemetryStream(DataStore<TEntry> *store);
+
+    bool peek(uint64_t *tstamp);
+
+    RetResult write_values(HttpBodySink *sink);
+
+    RetResult ack_request();
+
+    void rollback();
+
+    void reset();
+
+    int get_crc_failures();
+
+private:
+    // Default constructor private
+    StoreTelemetryStream();
+
+    RetResult build_entry(const TEntry *entry);
+
+    void mark();
+
+    DataStoreReader<TEntry> _reader;
+
+    typename DataStore<TEntry>::Entry _entry_buff[1];
+    DataStoreSpan<TEntry> _span;
+
+    TBuilder _builder;
+
+    /** JSON of next entry, its timestamp and values */
+    char _entry_json[TELEMETRY_ENTRY_JSON_BUFF_SIZE];
+    uint64_t _tstamp = 0;
+    const char *_values = NULL;
+    int _values_len = 0;
+
+    /** Next entry read and built, not written yet */
+    bool _has_next = false;
+
+    bool _file_open = false;
+    bool _done = false;
+
+    /** Reader position after the entries written of the current file */
+    DataStoreReadMark _written_mark;
+    bool _has_written_mark = false;
+
+    /** Entries of current file written to request */
+    bool _file_written = false;
+
+    /** Files read to their end in request, deleted once it succeeds */
+    DataStoreReadMark _ended[TELEMETRY_MAX_FILES_PER_REQ];
+    int _ended_count = 0;
+
+    int _crc_failures = 0;
+};
+
+#endif
@@ -186,6 +186,57 @@ enum LightningIntReason
     LIGHTNING_INT_REASON_LIGHTNING = 0x08
 };
 
+/**
+ * How a DataStore writes its buffer to flash on commit
+ */
+enum DataStoreCommitMode
+{
+    // One write() per entry, newest entry first
+    DATA_STORE_COMMIT_PER_ENTRY,
+    // One write() per file for the whole run of entries that fits in it, oldest first
+    DATA_STORE_COMMIT_BULK
+};
+
+/**
+ * How a data file matches the store reading it, from its header
+ */
+enum DataStoreFileFormat
+{
+    // No header, written by firmware before file headers
+    DATA_STORE_FILE_LEGACY,
+    // Header matches store
+    DATA_STORE_FILE_CURRENT,
+    // Entries of another size/schema (eg. written before an OTA), can't be read
+    DATA_STORE_FILE_MISMATCH
+};
+
+/**
+ * Order a DataStoreReader returns a store's files in
+ */
+enum DataStoreReadOrder
+{
+    // Creation order, ring log after files
+    DATA_STORE_READ_OLDEST_FIRST,
+    // By newest entry of every file (manifest time bounds), ring log first
+    DATA_STORE_READ_NEWEST_FIRST
+};
+
+/**
+ * Value of a DataStore's data. When flash is full, files of the lowest
+ * priority store are evicted first.
+ */
+enum DataStorePriority
+{
+    // Debug data (eg. raw SDI12 comms)
+    DATA_STORE_PRIORITY_DEBUG,
+    // Device logs
+    DATA_STORE_PRIORITY_LOG,
+    // Telemetry from optional/external sensors
+    DATA_STORE_PRIORITY_SECONDARY,
+    // Main telemetry
+    DATA_STORE_PRIORITY_PRIMARY
+};
+
 /**
  * Stats of a telemetry data submit operation
  */
@@ -197,6 +248,11 @@ struct DataStoreSubmitStats
     int crc_failed_entries;
     int failed_requests;
     int total_requests;
+
+    /** Bodies compressed: bytes in and out and CPU time taken */
+    uint32_t body_bytes;
+    uint32_t compressed_bytes;
+    uint32_t compress_us;
 };
 
 /**
@@ -233,6 +289,12 @@ struct FLAGS_T
     bool EXTERNAL_RTC_ENABLED : 1;
 
     bool IPFS: 1;
+
+    bool TELEMETRY_GZIP : 1;
+
+    bool TELEMETRY_MERGED : 1;
+
+    bool DEEP_SLEEP_ENABLED : 1;
 };
 
 #endif
\ No newline at end of file
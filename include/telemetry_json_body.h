@@ -0,0 +1,123 @@
+#ifndef TELEMETRY_JSON_BODY_H
+#define TELEMETRY_JSON_BODY_H
+
+#include "struct.h"
+#include "const.h"
+#include "http_body.h"
+#include "data_store_reader.h"
+
+/******************************************************************************
+ * TB telemetry JSON of a store's entries, streamed as a request body
+ * Entries are read from a DataStoreReader while the body is written and their
+ * JSON is built one entry at a time, so a request isn't bounded by a JSON
+ * output buffer or the builder's JSON doc. Bodies are written once, entries
+ * aren't read again, so their length is unknown (sent chunked).
+ *
+ * begin() reads the first entries of a request from the current file (up to
+ * max entries), the rest are read by write(). Entries of a successful request
+ * are acked by the caller, as when building JSON in a buffer.
+ *
+ * With packing set, a request goes on with the next files of a file source
+ * when a file ends, until max entries, a budget of body bytes or
+ * TELEMETRY_MAX_FILES_PER_REQ files. The reader is marked at the end of every
+ * file a request covers, for the caller to ack or delete them all.
+ ******************************************************************************/
+
+/******************************************************************************
+ * Opens the next file of the reader of a packed body
+ ******************************************************************************/
+class TelemetryFileSource
+{
+public:
+    virtual ~TelemetryFileSource() {}
+
+    virtual bool next_file() = 0;
+};
+
+/** File covered by a request: reader position after its entries in it */
+struct TelemetryBodyFile
+{
+    DataStoreReadMark mark;
+
+    /** Valid entries of file in request */
+    int entry_count;
+};
+
+template <typename TEntry, typename TBuilder>
+class TelemetryJsonBody : public HttpBodyWriter
+{
+public:
+    TelemetryJsonBody(DataStoreReader<TEntry> *reader, DataStoreSpan<TEntry> *span);
+
+    void set_packing(TelemetryFileSource *files, int max_bytes);
+
+    bool begin(int max_entries);
+
+    RetResult write(HttpBodySink *sink);
+
+    int get_length();
+
+    bool has_more_entries();
+
+    int get_entry_count();
+
+    int get_entries_read();
+
+    int get_crc_failures();
+
+    const TelemetryBodyFile* get_files(int *count);
+
+    int get_body_size();
+
+private:
+    // Default constructor private
+    TelemetryJsonBody();
+
+    void read_entries();
+
+    int get_read_count();
+
+    bool next_file();
+
+    void end_file();
+
+    RetResult write_entry(HttpBodySink *sink, const TEntry *entry, bool first);
+
+    DataStoreReader<TEntry> *_reader = NULL;
+
+    /** Entries read and not written yet */
+    DataStoreSpan<TEntry> *_span = NULL;
+
+    TBuilder _builder;
+
+    /** JSON of current entry */
+    char _entry_json[TELEMETRY_ENTRY_JSON_BUFF_SIZE];
+
+    int _max_entries = 0;
+
+    /** Valid entries in request */
+    int _entry_count = 0;
+
+    /** Entries read from file for request, incl. ones that failed their CRC */
+    int _entries_read = 0;
+    int _crc_failures = 0;
+
+    /** File has more entries after the ones read */
+    bool _more_entries = false;
+
+    /** Source of next files and body bytes to pack up to, NULL if not packing */
+    TelemetryFileSource *_files = NULL;
+    int _max_bytes = 0;
+
+    /** Files covered by request, the last one is being read */
+    TelemetryBodyFile _covered[TELEMETRY_MAX_FILES_PER_REQ];
+    int _covered_count = 0;
+
+    /** Reader was marked at end of last covered file */
+    bool _file_marked = false;
+
+    /** Entry bytes written, commas included */
+    int _body_size = 0;
+};
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef TELEMETRY_UPLOAD_H
+#define TELEMETRY_UPLOAD_H
+
+#include "struct.h"
+#include "const.h"
+#include "data_store.h"
+#include "upload_pipeline.h"
+#include "merged_telemetry_body.h"
+
+/******************************************************************************
+ * Submission of a store's entries as TB telemetry over an upload pipeline
+ * Requests of the next files are sent while earlier ones wait for their
+ * response, entries are acked (and files deleted) as responses arrive.
+ * Request bodies can be sent gzip compressed.
+ * Stores can also be submitted together, merged in time order.
+ ******************************************************************************/
+namespace TelemetryUpload
+{
+    template <typename TEntry, typename TBuilder>
+    RetResult submit_store(DataStore<TEntry> *store, UploadPipeline *pipeline, const char *path,
+        uint64_t window_start, bool compress, DataStoreSubmitStats *stats);
+
+    RetResult submit_merged(TelemetryStream **streams, int stream_count, UploadPipeline *pipeline, const char *path,
+        bool compress, DataStoreSubmitStats *stats);
+}
+
+#endif
@@ -11,7 +11,8 @@ namespace Tests
 		RTC_FROM_GSM,
 		DATA_STORE,
 		WAKEUP_TIMES,
-		DEVICE_CONFIG
+		DEVICE_CONFIG,
+		CRC
 	};
 
 	RetResult rtc_from_gsm();
@@ -24,6 +25,8 @@ namespace Tests
 
 	RetResult device_config();
 
+	RetResult crc();
+
 	void run(TestId tests[], int count);
 
 	void run_all();
@@ -0,0 +1,60 @@
+#ifndef UPLOAD_PIPELINE_H
+#define UPLOAD_PIPELINE_H
+
+#include "struct.h"
+#include "const.h"
+#include "http_body.h"
+
+/******************************************************************************
+ * Connection requests are sent over, a modem socket. send() returns once the
+ * request is written, its response is read later by read_response(), so
+ * requests can be sent over other sockets meanwhile.
+ ******************************************************************************/
+class UploadSocket
+{
+public:
+    virtual ~UploadSocket() {}
+
+    virtual RetResult send(const char *path, HttpBodyWriter *body, const char *content_type) = 0;
+
+    /** @return HTTP response code of request sent, 0 if none */
+    virtual int read_response() = 0;
+};
+
+/******************************************************************************
+ * Keeps up to a request per socket in flight, so the server round trip of a
+ * request overlaps with writing the next ones to the modem. Responses are
+ * read in the order requests were sent.
+ * Every request gets a ticket (< UPLOAD_PIPELINE_MAX_SOCKETS) by which the
+ * caller keeps what it needs once the request completes, eg. entries to ack.
+ ******************************************************************************/
+class UploadPipeline
+{
+public:
+    UploadPipeline(UploadSocket **sockets, int socket_count);
+
+    int send(const char *path, HttpBodyWriter *body, const char *content_type);
+
+    int complete(bool *success);
+
+    bool is_full();
+
+    int get_in_flight();
+
+private:
+    // Default constructor private
+    UploadPipeline();
+
+    UploadSocket *_sockets[UPLOAD_PIPELINE_MAX_SOCKETS];
+    int _socket_count = 0;
+
+    /** Ticket of oldest request in flight and requests in flight. Ticket is
+     * the index of the request's socket. */
+    int _head = 0;
+    int _in_flight = 0;
+
+    /** Request could not be sent, there is no response to read */
+    bool _send_failed[UPLOAD_PIPELINE_MAX_SOCKETS];
+};
+
+#endif
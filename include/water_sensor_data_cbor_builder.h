@@ -0,0 +1,18 @@
+#ifndef WATER_SENSOR_DATA_CBOR_BUILDER_H
+#define WATER_SENSOR_DATA_CBOR_BUILDER_H
+
+#include "struct.h"
+#include "const.h"
+#include "water_sensor_data.h"
+#include "cbor_builder_base.h"
+
+/******************************************************************************
+* Helper class to build binary (CBOR) telemetry from sensor data structures
+******************************************************************************/
+class WaterSensorDataCborBuilder : public CborBuilderBase<WaterSensorData::Entry, TELEMETRY_CBOR_BUFF_SIZE>
+{
+public:
+	RetResult add(const WaterSensorData::Entry *entry);
+};
+
+#endif
@@ -0,0 +1,138 @@
+#include "bench.h"
+#include "Arduino.h"
+#include "SPIFFS.h"
+#include <chrono>
+
+namespace Bench
+{
+	/******************************************************************************
+	 * Privates
+	 ******************************************************************************/
+	/** Pointers to bench functions mapped to their id */
+	RetResult (*bench_funcs[])() = {
+		data_store,
+		data_store_commit,
+		ring_log,
+		data_store_codec,
+		crc,
+		submit,
+		log_stage,
+		deep_sleep,
+		flash,
+		quota,
+		storage,
+		compact,
+		schema,
+		file_header,
+		read_order,
+		telemetry_encoding,
+		stream_body,
+		keep_alive,
+		pipeline,
+		compression,
+		packing,
+		merged
+	};
+
+	/** Bench names mapped to their id */
+	const char *bench_names[] = {
+		"DataStore add/commit/read",
+		"DataStore commit per-entry vs bulk",
+		"RingLog backed DataStore",
+		"DataStore delta encoding",
+		"CRC32 engine",
+		"Telemetry submission over lossy link",
+		"Log write coalescing",
+		"Deep sleep state parking",
+		"Flash wear counters",
+		"Store quotas and eviction",
+		"Storage backends",
+		"Store compaction",
+		"Entry schemas",
+		"Store file headers",
+		"Newest-first reads",
+		"Binary telemetry encoding",
+		"Streamed request bodies",
+		"HTTP keep-alive sessions",
+		"Pipelined uploads",
+		"Compressed request bodies",
+		"Packed requests",
+		"Merged multi-store requests"
+	};
+
+	/** Largest backlog to benchmark */
+	int _max_entries = 100000;
+
+	/******************************************************************************
+	 * Monotonic host time for measurements. Independent of the fake clock.
+	 ******************************************************************************/
+	uint64_t now_us()
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	/******************************************************************************
+	 * Entries per second
+	 ******************************************************************************/
+	double rate(int entries, uint64_t us)
+	{
+		return us == 0 ? 0 : entries * 1000000.0 / us;
+	}
+
+	void set_max_entries(int max_entries)
+	{
+		_max_entries = max_entries;
+	}
+
+	int get_max_entries()
+	{
+		return _max_entries;
+	}
+
+	/******************************************************************************
+	 * Run all benchmarks
+	 ******************************************************************************/
+	RetResult run_all()
+	{
+		int bench_count = sizeof(bench_funcs) / sizeof(bench_funcs[0]);
+
+		BenchId benches[bench_count];
+		for(int i = 0; i < bench_count; i++)
+		{
+			benches[i] = (BenchId)i;
+		}
+
+		return run(benches, bench_count);
+	}
+
+	/******************************************************************************
+	 * Run benchmarks specified by the bench array
+	 * @param benches Array of benchmarks to run
+	 * @param count Array size
+	 ******************************************************************************/
+	RetResult run(BenchId benches[], int count)
+	{
+		bool overall_success = true;
+
+		// Firmware debug output would dominate timings
+		Serial.set_output(NULL);
+
+		for(int i = 0; i < count; i++)
+		{
+			printf("\n==== %s (%d/%d) ====\n", bench_names[benches[i]], i + 1, count);
+
+			if(bench_funcs[benches[i]]() != RET_OK)
+			{
+				printf("[FAILURE] %s\n", bench_names[benches[i]]);
+				overall_success = false;
+			}
+		}
+
+		Serial.set_output(stdout);
+
+		printf("\n%s\n", overall_success ? "All benchmarks completed." : "Benchmarks failed.");
+
+		return overall_success ? RET_OK : RET_ERROR;
+	}
+} // Bench
@@ -0,0 +1,96 @@
+#ifndef BENCH_H
+#define BENCH_H
+#include "struct.h"
+
+/******************************************************************************
+ * Native (host) benchmarks
+ * Built only by [env:native]. Mirrors Tests: each benchmark is a function
+ * mapped to a BenchId, results are printed as tables to stdout.
+ *****************************************************************************/
+namespace Bench
+{
+	/** Available benchmarks. Enum vals are "bench_ids" and must start from 0. */
+	enum BenchId
+	{
+		DATA_STORE,
+		DATA_STORE_COMMIT,
+		RING_LOG,
+		DATA_STORE_CODEC,
+		CRC,
+		SUBMIT,
+		LOG_STAGE,
+		DEEP_SLEEP,
+		FLASH,
+		QUOTA,
+		STORAGE,
+		COMPACT,
+		SCHEMA,
+		FILE_HEADER,
+		READ_ORDER,
+		TELEMETRY_ENCODING,
+		STREAM_BODY,
+		KEEP_ALIVE,
+		PIPELINE,
+		COMPRESSION,
+		PACKING,
+		MERGED
+	};
+
+	RetResult data_store();
+
+	RetResult data_store_commit();
+
+	RetResult ring_log();
+
+	RetResult data_store_codec();
+
+	RetResult crc();
+
+	RetResult submit();
+
+	RetResult log_stage();
+
+	RetResult deep_sleep();
+
+	RetResult flash();
+
+	RetResult quota();
+
+	RetResult storage();
+
+	RetResult compact();
+
+	RetResult schema();
+
+	RetResult file_header();
+
+	RetResult read_order();
+
+	RetResult telemetry_encoding();
+
+	RetResult stream_body();
+
+	RetResult keep_alive();
+
+	RetResult pipeline();
+
+	RetResult compression();
+
+	RetResult packing();
+
+	RetResult merged();
+
+	RetResult run(BenchId benches[], int count);
+
+	RetResult run_all();
+
+	void set_max_entries(int max_entries);
+
+	int get_max_entries();
+
+	uint64_t now_us();
+
+	double rate(int entries, uint64_t us);
+} // Bench
+
+#endif
@@ -0,0 +1,266 @@
+#include "bench.h"
+#include "bench_data.h"
+#include "Arduino.h"
+#include "SPIFFS.h"
+#include "flash.h"
+#include "data_store.h"
+#include "data_store_reader.h"
+#include <algorithm>
+#include <vector>
+
+/******************************************************************************
+ * Store compaction
+ * A backlog left behind by failed call homes: every file is partly
+ * submitted (acked) and some have an entry failing CRC. Stores are compacted
+ * before sleep within a time budget, one pass per sleep, until nothing is
+ * left to merge. Reports files and read cost of submitting the backlog
+ * before and after, passes needed and flash written. Entries submitted after
+ * compaction must be exactly the ones before.
+ ******************************************************************************/
+namespace Bench
+{
+	/** Backlog sizes, in entries */
+	const int COMPACT_BENCH_BACKLOGS[] = {1000, 10000};
+
+	/** Budgets per pass (ms), the firmware one and a tight one */
+	const uint32_t COMPACT_BENCH_BUDGETS_MS[] = {DATA_STORE_COMPACT_BUDGET_MS, 2};
+
+	/** Every n-th file gets an entry failing CRC */
+	const int COMPACT_BENCH_CORRUPT_EVERY = 16;
+
+	/** Seconds between entries */
+	const int COMPACT_BENCH_INTERVAL_SEC = 600;
+
+	/** Pass limit, stop if compaction doesn't converge */
+	const int COMPACT_BENCH_MAX_PASSES = 10000;
+
+	/** Cost of reading a store back like call home does */
+	struct CompactBenchRead
+	{
+		int files;
+		uint64_t us;
+		NativeFs::Stats stats;
+	};
+
+	/******************************************************************************
+	 * Read all entries that would be submitted, with block reads
+	 * @param tstamps Timestamps of entries read, sorted
+	 ******************************************************************************/
+	template <typename TEntry>
+	void compact_bench_read(DataStore<TEntry> *store, std::vector<uint32_t> *tstamps, CompactBenchRead *result)
+	{
+		DataStoreReader<TEntry> reader(store);
+		typename DataStore<TEntry>::Entry entries[DATA_STORE_READ_BLOCK_ENTRIES];
+		DataStoreSpan<TEntry> span(entries, DATA_STORE_READ_BLOCK_ENTRIES);
+
+		tstamps->clear();
+		result->files = 0;
+
+		NativeFs::reset_stats();
+		uint64_t t_start = now_us();
+
+		while(reader.next_file())
+		{
+			result->files++;
+
+			while(reader.next_entries(&span, DATA_STORE_READ_BLOCK_ENTRIES))
+			{
+				for(int i = 0; i < span.count; i++)
+					tstamps->push_back(span.get(i)->timestamp);
+			}
+		}
+
+		result->us = now_us() - t_start;
+		result->stats = *NativeFs::get_stats();
+
+		std::sort(tstamps->begin(), tstamps->end());
+	}
+
+	/******************************************************************************
+	 * Write a backlog, then ack the first entries of every file (0 up to
+	 * entries/file - 1) and corrupt an entry of every COMPACT_BENCH_CORRUPT_EVERY
+	 * file
+	 ******************************************************************************/
+	template <typename TEntry>
+	RetResult compact_bench_fragment(DataStore<TEntry> *store, int count)
+	{
+		TEntry entry;
+
+		for(int i = 0; i < count; i++)
+		{
+			NativeClock::advance_ms((uint64_t)COMPACT_BENCH_INTERVAL_SEC * 1000);
+			BenchData::fill(&entry, time(NULL), i);
+			store->add(&entry);
+
+			if(store->commit() != RET_OK)
+				return RET_ERROR;
+		}
+
+		DataStoreManifest *manifest = store->get_manifest();
+		File records = manifest->open_records();
+		DataStoreManifest::Record record;
+		int index = 0;
+		int file_no = 0;
+
+		while(manifest->read_next_record(records, &record, &index))
+		{
+			int acked = file_no % store->get_max_entries_per_file();
+			if(acked >= record.entries)
+				acked = 0;
+
+			store->set_acked_entries(index, acked);
+
+			if(file_no % COMPACT_BENCH_CORRUPT_EVERY == COMPACT_BENCH_CORRUPT_EVERY - 1)
+			{
+				char path[FILE_PATH_BUFFER_SIZE] = {0};
+				manifest->get_file_path(&record, path, sizeof(path));
+
+				// Flip a byte of the last entry's data
+				File f = SPIFFS.open(path, "r+");
+				size_t pos = f.size() - 1;
+				uint8_t byte = 0;
+
+				f.seek(pos);
+				f.read(&byte, 1);
+				byte ^= 0xFF;
+				f.seek(pos);
+				f.write(&byte, 1);
+			}
+
+			file_no++;
+		}
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * Compact a fragmented backlog with a budget per pass
+	 ******************************************************************************/
+	template <typename TEntry>
+	RetResult compact_bench_run(const char *path, int entries_per_file, int count, uint32_t budget_ms)
+	{
+		SPIFFS.format();
+		DataStoreManifest::unload_all();
+
+		DataStore<TEntry> store(path, entries_per_file);
+
+		if(compact_bench_fragment(&store, count) != RET_OK)
+		{
+			printf("Could not write backlog\n");
+			return RET_ERROR;
+		}
+
+		std::vector<uint32_t> tstamps_before, tstamps_after;
+		CompactBenchRead before, after;
+
+		compact_bench_read(&store, &tstamps_before, &before);
+
+		//
+		// A pass per sleep until there is nothing left to merge
+		//
+		Flash::reset_stats();
+
+		int passes = 0, files_merged = 0;
+		uint64_t compact_us = 0, max_pass_us = 0;
+
+		while(passes < COMPACT_BENCH_MAX_PASSES)
+		{
+			int pass_files_merged = 0;
+
+			uint64_t t_start = now_us();
+			RetResult ret = store.cleanup_store(budget_ms, &pass_files_merged);
+			uint64_t pass_us = now_us() - t_start;
+
+			if(ret != RET_OK)
+			{
+				printf("Compaction failed\n");
+				return RET_ERROR;
+			}
+
+			if(pass_files_merged == 0)
+				break;
+
+			passes++;
+			files_merged += pass_files_merged;
+			compact_us += pass_us;
+			if(pass_us > max_pass_us)
+				max_pass_us = pass_us;
+		}
+
+		const Flash::Stats *flash_stats = Flash::get_stats();
+
+		compact_bench_read(&store, &tstamps_after, &after);
+
+		printf("%6d %5u | %5d %5d | %6d %6d %7.1f %8.1f %7u | %7u %7u | %9.0f %9.0f\n",
+			count, budget_ms, before.files, after.files, passes, files_merged, max_pass_us / 1000.0,
+			compact_us / 1000.0, flash_stats->bytes_written / 1024, before.stats.opens, after.stats.opens,
+			rate(tstamps_before.size(), before.us), rate(tstamps_after.size(), after.us));
+
+		if(tstamps_after != tstamps_before)
+		{
+			printf("Entries submitted after compaction: %d, before: %d\n", (int)tstamps_after.size(),
+				(int)tstamps_before.size());
+			return RET_ERROR;
+		}
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * Compact backlogs of a store type
+	 ******************************************************************************/
+	template <typename TEntry>
+	RetResult compact_bench_type(const char *name, const char *path, int entries_per_file)
+	{
+		RetResult ret = RET_OK;
+
+		printf("\n%s (%s) - entries/file: %d\n", name, path, entries_per_file);
+		printf("%6s %5s | %5s %5s | %6s %6s %7s %8s %7s | %7s %7s | %9s %9s\n", "entries", "ms", "files",
+			"after", "passes", "merged", "max ms", "total ms", "KB wr", "opens", "after", "read/s", "after");
+
+		for(unsigned int i = 0; i < sizeof(COMPACT_BENCH_BACKLOGS) / sizeof(COMPACT_BENCH_BACKLOGS[0]); i++)
+		{
+			if(COMPACT_BENCH_BACKLOGS[i] > get_max_entries())
+				break;
+
+			for(unsigned int j = 0; j < sizeof(COMPACT_BENCH_BUDGETS_MS) / sizeof(COMPACT_BENCH_BUDGETS_MS[0]); j++)
+			{
+				if(compact_bench_run<TEntry>(path, entries_per_file, COMPACT_BENCH_BACKLOGS[i],
+					COMPACT_BENCH_BUDGETS_MS[j]) != RET_OK)
+				{
+					ret = RET_ERROR;
+				}
+			}
+		}
+
+		return ret;
+	}
+
+	/******************************************************************************
+	 * Benchmark store compaction
+	 ******************************************************************************/
+	RetResult compact()
+	{
+		RetResult ret = RET_OK;
+
+		printf("Every file partly acked (0 to entries/file - 1), an entry failing CRC every %d files\n",
+			COMPACT_BENCH_CORRUPT_EVERY);
+
+		if(compact_bench_type<WaterSensorData::Entry>("WaterSensorData", WATER_SENSOR_DATA_PATH,
+			WATER_SENSOR_DATA_ENTRIES_PER_SUBMIT_REQ) != RET_OK)
+		{
+			ret = RET_ERROR;
+		}
+
+		if(compact_bench_type<Atmos41Data::Entry>("Atmos41Data", ATMOS41_DATA_PATH,
+			ATMOS41_DATA_ENTRIES_PER_SUBMIT_REQ) != RET_OK)
+		{
+			ret = RET_ERROR;
+		}
+
+		SPIFFS.format();
+		DataStoreManifest::unload_all();
+
+		return ret;
+	}
+} // Bench
@@ -0,0 +1,288 @@
+#include "bench.h"
+#include "bench_data.h"
+#include "Arduino.h"
+#include "SPIFFS.h"
+#include "data_store.h"
+#include "data_store_reader.h"
+#include "http_body.h"
+#include "telemetry_json_body.h"
+#include "gzip_body.h"
+#include "tb_water_sensor_data_json_builder.h"
+#include "tb_atmos41_data_json_builder.h"
+#include "tb_fo_data_json_builder.h"
+#include "tb_log_json_builder.h"
+#include <zlib.h>
+#include <string>
+#include <vector>
+
+/******************************************************************************
+ * Compressed request bodies
+ * A backlog is turned into telemetry requests, a file per request, as call
+ * home does, and each body is streamed both plain and through a
+ * GzipBodyWriter. Compressed bodies are decompressed with zlib and must match
+ * the plain ones, and every entry must be sent.
+ * Files of the firmware's size and of many more entries are compared.
+ * Reports body bytes per request plain and gzip, ratio, the ratio of zlib
+ * level 6 for reference, compression CPU time on host, bytes saved per call
+ * home (one file per store type) and RAM held by the compressor.
+ ******************************************************************************/
+namespace Bench
+{
+	/** Backlog per run */
+	const int COMPRESSION_BENCH_ENTRIES = 2000;
+
+	/** Entries per file of the large file run */
+	const int COMPRESSION_BENCH_LARGE_FILE_ENTRIES = 64;
+
+	/** Longest plain body */
+	const int COMPRESSION_BENCH_MAX_BODY_SIZE = 256 * 1024;
+
+	/******************************************************************************
+	 * Sink keeping everything written
+	 ******************************************************************************/
+	class CompressionBenchSink : public HttpBodySink
+	{
+	public:
+		using HttpBodySink::write;
+
+		RetResult write(const uint8_t *data, int size)
+		{
+			bytes.append((const char*)data, size);
+			return RET_OK;
+		}
+
+		std::string bytes;
+	};
+
+	/******************************************************************************
+	 * Decompress a gzip body with zlib
+	 * @return False if not valid gzip
+	 ******************************************************************************/
+	bool compression_bench_gunzip(const std::string &gzip, std::string *plain)
+	{
+		static uint8_t out[COMPRESSION_BENCH_MAX_BODY_SIZE];
+		z_stream stream;
+		memset(&stream, 0, sizeof(stream));
+
+		if(inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK)
+			return false;
+
+		stream.next_in = (Bytef*)gzip.data();
+		stream.avail_in = gzip.size();
+		stream.next_out = out;
+		stream.avail_out = sizeof(out);
+
+		int ret = inflate(&stream, Z_FINISH);
+		plain->assign((const char*)out, stream.total_out);
+		inflateEnd(&stream);
+
+		return ret == Z_STREAM_END && stream.avail_in == 0;
+	}
+
+	/******************************************************************************
+	 * Size of a body compressed by zlib (level 6, gzip wrapper)
+	 ******************************************************************************/
+	int compression_bench_zlib_size(const std::string &plain)
+	{
+		static uint8_t out[COMPRESSION_BENCH_MAX_BODY_SIZE];
+		z_stream stream;
+		memset(&stream, 0, sizeof(stream));
+
+		if(deflateInit2(&stream, 6, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+			return 0;
+
+		stream.next_in = (Bytef*)plain.data();
+		stream.avail_in = plain.size();
+		stream.next_out = out;
+		stream.avail_out = sizeof(out);
+
+		deflate(&stream, Z_FINISH);
+		int size = stream.total_out;
+		deflateEnd(&stream);
+
+		return size;
+	}
+
+	/** Result of a run */
+	struct CompressionBenchRun
+	{
+		int requests;
+		int entries;
+		uint64_t body_bytes;
+		uint64_t gzip_bytes;
+		uint64_t zlib_bytes;
+		uint64_t compress_us;
+	};
+
+	/******************************************************************************
+	 * Build the requests of a store's files, deleting nothing
+	 * @param plain Plain bodies, filled when not compressing and compared to
+	 * compressed ones decompressed otherwise
+	 ******************************************************************************/
+	template <typename TEntry, typename TBuilder>
+	RetResult compression_bench_requests(DataStore<TEntry> *store, bool compress, std::vector<std::string> *plain,
+		CompressionBenchRun *result)
+	{
+		DataStoreReader<TEntry> reader(store);
+		typename DataStore<TEntry>::Entry entries[DATA_STORE_READ_BLOCK_ENTRIES];
+		DataStoreSpan<TEntry> span(entries, DATA_STORE_READ_BLOCK_ENTRIES);
+
+		TelemetryJsonBody<TEntry, TBuilder> *body = new TelemetryJsonBody<TEntry, TBuilder>(&reader, &span);
+		GzipBodyWriter *gzip_body = new GzipBodyWriter(body);
+		int max_entries = store->get_max_entries_per_file();
+		RetResult ret = RET_OK;
+
+		while(reader.next_file())
+		{
+			if(!body->begin(max_entries))
+				continue;
+
+			CompressionBenchSink sink;
+
+			if(!compress)
+			{
+				if(body->write(&sink) != RET_OK)
+					ret = RET_ERROR;
+
+				plain->push_back(sink.bytes);
+				result->entries += body->get_entry_count();
+				result->body_bytes += sink.bytes.size();
+				result->zlib_bytes += compression_bench_zlib_size(sink.bytes);
+				result->requests++;
+				continue;
+			}
+
+			int req = result->requests++;
+			std::string unzipped;
+
+			if(gzip_body->write(&sink) != RET_OK || !compression_bench_gunzip(sink.bytes, &unzipped) ||
+				(int)sink.bytes.size() != gzip_body->get_compressed_size() ||
+				gzip_body->get_body_size() != (int)unzipped.size())
+			{
+				ret = RET_ERROR;
+			}
+
+			if(req >= (int)plain->size() || unzipped != (*plain)[req])
+			{
+				if(ret == RET_OK)
+					printf("Request %d differs once decompressed\n", req);
+				ret = RET_ERROR;
+			}
+
+			result->gzip_bytes += sink.bytes.size();
+			result->compress_us += gzip_body->get_compress_us();
+		}
+
+		delete gzip_body;
+		delete body;
+
+		return ret;
+	}
+
+	/******************************************************************************
+	 * Run a type with a file size
+	 ******************************************************************************/
+	template <typename TEntry, typename TBuilder>
+	RetResult compression_bench_run(const char *name, const char *path, int entries_per_file, int interval_sec,
+		int count)
+	{
+		SPIFFS.format();
+		DataStoreManifest::unload_all();
+
+		DataStore<TEntry> store(path, entries_per_file);
+		TEntry entry;
+
+		for(int i = 0; i < count; i++)
+		{
+			// File names come from the clock
+			NativeClock::advance_ms((uint64_t)interval_sec * 1000);
+
+			BenchData::fill(&entry, 1600000000 + i * interval_sec, i);
+			store.add(&entry);
+
+			if(store.commit() != RET_OK)
+			{
+				printf("Could not write backlog\n");
+				return RET_ERROR;
+			}
+		}
+
+		RetResult ret = RET_OK;
+		std::vector<std::string> plain;
+		CompressionBenchRun run = {0};
+
+		if(compression_bench_requests<TEntry, TBuilder>(&store, false, &plain, &run) != RET_OK)
+			ret = RET_ERROR;
+
+		int plain_requests = run.requests;
+		run.requests = 0;
+
+		if(compression_bench_requests<TEntry, TBuilder>(&store, true, &plain, &run) != RET_OK)
+			ret = RET_ERROR;
+
+		if(run.entries != count || run.requests != plain_requests)
+		{
+			printf("Sent entries: %d of %d\n", run.entries, count);
+			ret = RET_ERROR;
+		}
+
+		printf("%16s %4d | %6d | %7.1f %7.1f | %5.2fx %5.2fx | %7.2f | %8.1f\n", name, entries_per_file,
+			run.requests, (double)run.body_bytes / run.requests, (double)run.gzip_bytes / run.requests,
+			(double)run.body_bytes / run.gzip_bytes, (double)run.body_bytes / run.zlib_bytes,
+			run.compress_us * 1024.0 / run.body_bytes, (double)(run.body_bytes - run.gzip_bytes) / run.requests);
+
+		return ret;
+	}
+
+	/******************************************************************************
+	 * Benchmark compressed request bodies
+	 ******************************************************************************/
+	RetResult compression()
+	{
+		int count = get_max_entries() < COMPRESSION_BENCH_ENTRIES ? get_max_entries() : COMPRESSION_BENCH_ENTRIES;
+		RetResult ret = RET_OK;
+
+		printf("%d entries per run, window %d B, compressor RAM %d B\n\n", count, DEFLATE_WINDOW_SIZE,
+			(int)sizeof(GzipBodyWriter));
+		printf("%16s %4s | %6s | %7s %7s | %6s %6s | %7s | %8s\n", "type", "file", "reqs", "B/req", "gz B/req",
+			"ratio", "zlib6", "us/KB", "saved/req");
+
+		int file_sizes[][4] = {
+			{WATER_SENSOR_DATA_ENTRIES_PER_SUBMIT_REQ, ATMOS41_DATA_ENTRIES_PER_SUBMIT_REQ,
+				FO_DATA_STORE_ENTRIES_PER_SUBMIT_REQ, LOG_ENTRIES_PER_SUBMIT_REQ},
+			{COMPRESSION_BENCH_LARGE_FILE_ENTRIES, COMPRESSION_BENCH_LARGE_FILE_ENTRIES,
+				COMPRESSION_BENCH_LARGE_FILE_ENTRIES, COMPRESSION_BENCH_LARGE_FILE_ENTRIES}
+		};
+
+		for(int i = 0; i < 2; i++)
+		{
+			if(compression_bench_run<WaterSensorData::Entry, TbWaterSensorDataJsonBuilder>("WaterSensorData",
+				WATER_SENSOR_DATA_PATH, file_sizes[i][0], 600, count) != RET_OK)
+			{
+				ret = RET_ERROR;
+			}
+
+			if(compression_bench_run<Atmos41Data::Entry, TbAtmos41DataJsonBuilder>("Atmos41Data",
+				ATMOS41_DATA_PATH, file_sizes[i][1], 600, count) != RET_OK)
+			{
+				ret = RET_ERROR;
+			}
+
+			if(compression_bench_run<FoData::StoreEntry, TbFoDataJsonBuilder>("FoData",
+				FO_DATA_STORE_PATH, file_sizes[i][2], 1800, count) != RET_OK)
+			{
+				ret = RET_ERROR;
+			}
+
+			if(compression_bench_run<Log::Entry, TbLogJsonBuilder>("Log",
+				LOG_DATA_PATH, file_sizes[i][3], 60, count) != RET_OK)
+			{
+				ret = RET_ERROR;
+			}
+		}
+
+		SPIFFS.format();
+
+		return ret;
+	}
+} // Bench
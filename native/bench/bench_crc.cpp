@@ -0,0 +1,158 @@
+#include "bench.h"
+#include "bench_data.h"
+#include "CRC32.h"
+#include "crc.h"
+#include "data_store.h"
+
+/******************************************************************************
+ * CRC32 benchmark
+ * Compares the CRC engine to the CRC32 library (nibble table, what the
+ * firmware used before) over buffers of different sizes, and checks both
+ * give the same result so stored data stays valid. Then times the CRC of a
+ * whole backlog of entries, as done when reading it at call home.
+ * On target the engine is the ROM crc32_le, see Tests::crc().
+ ******************************************************************************/
+namespace Bench
+{
+	/** Buffer sizes to time. 53 is a FoData store entry. */
+	const int CRC_BENCH_SIZES[] = {8, 53, 256, 4096, 65536};
+
+	/** Bytes processed per size, so every size runs about as long */
+	const int CRC_BENCH_BYTES = 64 * 1024 * 1024;
+
+	/** Largest buffer checked byte by byte against the library */
+	const int CRC_CHECK_MAX_SIZE = 300;
+
+	/** Check value of CRC-32 for "123456789" */
+	const uint32_t CRC_CHECK_VALUE = 0xCBF43926;
+
+	/** Keeps the compiler from dropping timed calls */
+	volatile uint32_t _sink = 0;
+
+	/******************************************************************************
+	 * Engine must match the library for every size and alignment, and chained
+	 * updates must match a single call
+	 ******************************************************************************/
+	RetResult crc_check(const uint8_t *buff)
+	{
+		if(Crc::crc32("123456789", 9) != CRC_CHECK_VALUE)
+		{
+			printf("Check value mismatch: %08x\n", Crc::crc32("123456789", 9));
+			return RET_ERROR;
+		}
+
+		for(int size = 0; size <= CRC_CHECK_MAX_SIZE; size++)
+		{
+			for(int offset = 0; offset < 8; offset++)
+			{
+				uint32_t expected = CRC32::calculate(buff + offset, size);
+
+				if(Crc::crc32(buff + offset, size) != expected)
+				{
+					printf("Mismatch with library, size: %d, offset: %d\n", size, offset);
+					return RET_ERROR;
+				}
+
+				int split = size / 3;
+				uint32_t chained = Crc::crc32_update(Crc::crc32(buff + offset, split), buff + offset + split, size - split);
+				if(chained != expected)
+				{
+					printf("Chained update mismatch, size: %d, offset: %d\n", size, offset);
+					return RET_ERROR;
+				}
+			}
+		}
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * ns per byte of a CRC function over a buffer
+	 ******************************************************************************/
+	template <typename TFunc>
+	double crc_ns_per_byte(TFunc func, const uint8_t *buff, int size)
+	{
+		int rounds = CRC_BENCH_BYTES / size;
+
+		uint64_t t_start = now_us();
+		for(int i = 0; i < rounds; i++)
+			_sink ^= func(buff, size);
+
+		return (now_us() - t_start) * 1000.0 / ((double)rounds * size);
+	}
+
+	uint32_t crc_library(const uint8_t *buff, int size)
+	{
+		return CRC32::calculate(buff, size);
+	}
+
+	uint32_t crc_engine(const uint8_t *buff, int size)
+	{
+		return Crc::crc32(buff, size);
+	}
+
+	/******************************************************************************
+	 * Time CRC of a backlog of water sensor entries, one CRC per entry
+	 ******************************************************************************/
+	void crc_backlog()
+	{
+		int count = get_max_entries();
+		WaterSensorData::Entry *entries = new WaterSensorData::Entry[count];
+
+		for(int i = 0; i < count; i++)
+			BenchData::fill(&entries[i], 1600000000 + i * 600, i);
+
+		uint64_t t_start = now_us();
+		for(int i = 0; i < count; i++)
+			_sink ^= CRC32::calculate((uint8_t*)&entries[i], sizeof(entries[i]));
+		uint64_t library_us = now_us() - t_start;
+
+		t_start = now_us();
+		for(int i = 0; i < count; i++)
+			_sink ^= Crc::crc32(&entries[i], sizeof(entries[i]));
+		uint64_t engine_us = now_us() - t_start;
+
+		printf("\nBacklog of %d water sensor entries (%d B): library %llu us, engine %llu us\n",
+			count, (int)sizeof(WaterSensorData::Entry), (unsigned long long)library_us,
+			(unsigned long long)engine_us);
+
+		delete[] entries;
+	}
+
+	/******************************************************************************
+	 * Benchmark CRC engine against the library
+	 ******************************************************************************/
+	RetResult crc()
+	{
+		const int max_size = CRC_BENCH_SIZES[sizeof(CRC_BENCH_SIZES) / sizeof(CRC_BENCH_SIZES[0]) - 1];
+
+		uint8_t *buff = new uint8_t[max_size + 8];
+		for(int i = 0; i < max_size + 8; i++)
+			buff[i] = (uint8_t)(i * 2654435761u >> 24);
+
+		if(crc_check(buff) != RET_OK)
+		{
+			delete[] buff;
+			return RET_ERROR;
+		}
+
+		printf("Engine: %s, matches library for 0-%d B at all alignments\n\n",
+			Crc::get_engine_name(), CRC_CHECK_MAX_SIZE);
+		printf("%8s | %12s %12s %8s\n", "size", "library ns/B", "engine ns/B", "speedup");
+
+		for(unsigned int i = 0; i < sizeof(CRC_BENCH_SIZES) / sizeof(CRC_BENCH_SIZES[0]); i++)
+		{
+			int size = CRC_BENCH_SIZES[i];
+			double library = crc_ns_per_byte(crc_library, buff, size);
+			double engine = crc_ns_per_byte(crc_engine, buff, size);
+
+			printf("%8d | %12.2f %12.2f %7.1fx\n", size, library, engine, library / engine);
+		}
+
+		delete[] buff;
+
+		crc_backlog();
+
+		return RET_OK;
+	}
+} // Bench
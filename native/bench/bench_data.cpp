@@ -0,0 +1,142 @@
+#include "bench_data.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace BenchData
+{
+	const float SECONDS_IN_DAY = 86400;
+	const float PI_2 = 6.2831853f;
+
+	/******************************************************************************
+	 * Position in daily cycle, -1 to 1 (peaks mid-day)
+	 *****************************************************************************/
+	float daily(uint32_t tstamp)
+	{
+		return sinf(PI_2 * (tstamp % (uint32_t)SECONDS_IN_DAY) / SECONDS_IN_DAY - PI_2 / 4);
+	}
+
+	/******************************************************************************
+	 * Deterministic noise in range [-1, 1]
+	 *****************************************************************************/
+	float noise(int seq, int channel)
+	{
+		uint32_t x = seq * 2654435761u ^ channel * 40503u;
+		x ^= x >> 15;
+		x *= 2246822519u;
+		x ^= x >> 13;
+
+		return (float)(x % 2001) / 1000.0f - 1.0f;
+	}
+
+	/******************************************************************************
+	 * Round to resolution, as sensors report
+	 *****************************************************************************/
+	float res(float val, float resolution)
+	{
+		return roundf(val / resolution) * resolution;
+	}
+
+	void fill(WaterSensorData::Entry *entry, uint32_t tstamp, int seq)
+	{
+		memset(entry, 0, sizeof(*entry));
+
+		entry->timestamp = tstamp;
+		entry->temperature = res(18 + 3 * daily(tstamp) + 0.05f * noise(seq, 1), 0.01f);
+		entry->dissolved_oxygen = res(8 - 1.5f * daily(tstamp) + 0.1f * noise(seq, 2), 0.01f);
+		entry->conductivity = res(450 + 20 * daily(tstamp) + 2 * noise(seq, 3), 0.1f);
+		entry->ph = res(7.4f + 0.1f * daily(tstamp) + 0.02f * noise(seq, 4), 0.01f);
+		entry->orp = res(210 + 5 * noise(seq, 5), 0.1f);
+		entry->pressure = res(2.1f + 0.01f * noise(seq, 6), 0.01f);
+		entry->depth_cm = res(entry->pressure * 70.307f, 0.01f);
+		entry->depth_ft = res(entry->depth_cm / 30.48f, 0.01f);
+		entry->tss = res(12 + noise(seq, 7), 0.1f);
+		entry->presence = true;
+		entry->water_level = res(320 + 15 * daily(tstamp / 7) + noise(seq, 8), 1);
+	}
+
+	void fill(Atmos41Data::Entry *entry, uint32_t tstamp, int seq)
+	{
+		memset(entry, 0, sizeof(*entry));
+
+		float day = daily(tstamp);
+
+		entry->timestamp = tstamp;
+		entry->solar = day > 0 ? (int16_t)(900 * day + 30 * noise(seq, 1)) : 0;
+		entry->precipitation = seq % 97 < 5 ? res(0.017f * (seq % 7), 0.017f) : 0;
+		entry->strikes = seq % 211 == 0 ? 1 : 0;
+		entry->wind_speed = res(3 + 2 * noise(seq, 2), 0.01f);
+		entry->wind_dir = (int16_t)(200 + 40 * noise(seq, 3));
+		entry->wind_gust_speed = res(entry->wind_speed + 1.5f, 0.01f);
+		entry->air_temp = res(16 + 6 * day + 0.2f * noise(seq, 4), 0.1f);
+		entry->vapor_pressure = res(1.3f + 0.1f * day, 0.01f);
+		entry->atm_pressure = res(101.2f + 0.3f * noise(seq, 5), 0.01f);
+		entry->rel_humidity = res(65 - 15 * day, 0.1f);
+		entry->dew_point = res(entry->air_temp - (100 - entry->rel_humidity) / 5, 0.1f);
+	}
+
+	void fill(SoilMoistureData::Entry *entry, uint32_t tstamp, int seq)
+	{
+		memset(entry, 0, sizeof(*entry));
+
+		entry->timestamp = tstamp;
+		entry->vwc = res(0.28f - 0.02f * daily(tstamp) + 0.002f * noise(seq, 1), 0.001f);
+		entry->temperature = res(14 + 2 * daily(tstamp), 0.1f);
+		entry->conductivity = res(310 + 5 * noise(seq, 2), 1);
+	}
+
+	void fill(LightningData::Entry *entry, uint32_t tstamp, int seq)
+	{
+		memset(entry, 0, sizeof(*entry));
+
+		entry->timestamp = tstamp;
+		entry->distance = 1 + seq % 40;
+		entry->energy = 1000 + (uint32_t)(100000 * (noise(seq, 1) + 1));
+	}
+
+	void fill(FoData::StoreEntry *entry, uint32_t tstamp, int seq)
+	{
+		memset(entry, 0, sizeof(*entry));
+
+		float day = daily(tstamp);
+
+		entry->timestamp = tstamp;
+		entry->packets = 10;
+		entry->wakeups = 10;
+		entry->temp = res(16 + 6 * day + 0.2f * noise(seq, 1), 0.1f);
+		entry->hum = (uint8_t)(65 - 15 * day);
+		entry->rain = res(0.3f * (seq / 50), 0.3f);
+		entry->rain_hourly = seq % 50 == 0 ? 0.3f : 0;
+		entry->wind_dir = (uint16_t)(200 + 40 * noise(seq, 2));
+		entry->wind_speed = res(3 + 2 * noise(seq, 3), 0.1f);
+		entry->wind_gust = res(entry->wind_speed + 1.4f, 0.1f);
+		entry->uv = day > 0 ? (uint32_t)(3000 * day) : 0;
+		entry->uv_index = entry->uv / 1000;
+		entry->light = day > 0 ? (uint32_t)(80000 * day) : 0;
+		entry->solar_radiation = (uint32_t)(entry->light * 0.0079f);
+	}
+
+	void fill(SDI12Log::Entry *entry, uint32_t tstamp, int seq)
+	{
+		memset(entry, 0, sizeof(*entry));
+
+		entry->timestamp = tstamp * 1000LL;
+		snprintf(entry->response, sizeof(entry->response), "0+%.3f+%.1f+%d",
+			0.28f + 0.002f * noise(seq, 1), 14 + 2 * daily(tstamp), 310 + seq % 7);
+	}
+
+	void fill(Log::Entry *entry, uint32_t tstamp, int seq)
+	{
+		// Typical wake up cycle
+		const Log::Code codes[] = {
+			Log::WAKEUP, Log::BATTERY_MDDE, Log::CALCULATING_SLEEP, Log::SLEEP
+		};
+
+		memset(entry, 0, sizeof(*entry));
+
+		entry->timestamp = tstamp * 1000LL + seq % 4;
+		entry->code = codes[seq % (sizeof(codes) / sizeof(codes[0]))];
+		entry->meta1 = seq % 4 == 2 ? tstamp : 3 + seq % 3;
+		entry->meta2 = seq % 4 == 2 ? tstamp : 600;
+	}
+}
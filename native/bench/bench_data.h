@@ -0,0 +1,29 @@
+#ifndef BENCH_DATA_H
+#define BENCH_DATA_H
+#include <inttypes.h>
+#include "water_sensor_data.h"
+#include "atmos41_data.h"
+#include "soil_moisture_data.h"
+#include "lightning_data.h"
+#include "fo_data.h"
+#include "sdi12_log.h"
+#include "log.h"
+
+/******************************************************************************
+ * Synthetic telemetry for benchmarks
+ * Values drift slowly around plausible field readings with a daily cycle and
+ * some noise, so they look like a real backlog rather than random bytes.
+ * Output depends only on tstamp and seq (deterministic).
+ *****************************************************************************/
+namespace BenchData
+{
+	void fill(WaterSensorData::Entry *entry, uint32_t tstamp, int seq);
+	void fill(Atmos41Data::Entry *entry, uint32_t tstamp, int seq);
+	void fill(SoilMoistureData::Entry *entry, uint32_t tstamp, int seq);
+	void fill(LightningData::Entry *entry, uint32_t tstamp, int seq);
+	void fill(FoData::StoreEntry *entry, uint32_t tstamp, int seq);
+	void fill(SDI12Log::Entry *entry, uint32_t tstamp, int seq);
+	void fill(Log::Entry *entry, uint32_t tstamp, int seq);
+}
+
+#endif
@@ -0,0 +1,235 @@
+#include "bench.h"
+#include "bench_data.h"
+#include "bench_stores.h"
+#include "Arduino.h"
+#include "SPIFFS.h"
+#include "data_store.h"
+#include "data_store_reader.h"
+
+/******************************************************************************
+ * DataStore benchmark
+ * For every store type, fill a store with a backlog the way the firmware does
+ * (add + commit per measurement, fake clock advancing between measurements),
+ * then read it all back with a DataStoreReader.
+ ******************************************************************************/
+namespace Bench
+{
+	/** Backlog sizes, capped by max entries */
+	const int BACKLOG_SIZES[] = {10, 100, 1000, 10000, 100000};
+
+	/** Entries written per commit mode comparison */
+	const int COMMIT_BENCH_ENTRIES = 10000;
+
+	/** Partition size for benchmarks. Large enough for the largest backlog. */
+	const size_t BENCH_FS_CAPACITY = 1024 * 1024 * 1024;
+
+	/** Result of a single store/backlog run */
+	struct StoreResult
+	{
+		int entries;
+		int files;
+		uint64_t add_us;
+		uint64_t commit_us;
+		uint64_t read_us;
+		NativeFs::Stats write_stats;
+		NativeFs::Stats read_stats;
+		int read_entries;
+		int crc_failures;
+	};
+
+	/******************************************************************************
+	 * Fill and read back a single store
+	 * @param batch Entries add()ed between commits
+	 * @param mode Commit mode of the store
+	 ******************************************************************************/
+	template <typename TEntry>
+	RetResult bench_store(const char *path, int entries_per_file, int interval_sec, int count,
+		StoreResult *result, int batch = 1, DataStoreCommitMode mode = DATA_STORE_COMMIT_BULK)
+	{
+		memset(result, 0, sizeof(*result));
+		result->entries = count;
+
+		SPIFFS.format();
+		NativeFs::reset_stats();
+
+		DataStore<TEntry> store(path, entries_per_file);
+		store.set_commit_mode(mode);
+		TEntry entry;
+
+		//
+		// Write
+		//
+		for(int i = 0; i < count; i++)
+		{
+			NativeClock::advance_ms((uint64_t)interval_sec * 1000);
+			BenchData::fill(&entry, time(NULL), i);
+
+			uint64_t t_start = now_us();
+			store.add(&entry);
+			result->add_us += now_us() - t_start;
+
+			if((i + 1) % batch != 0 && i != count - 1)
+				continue;
+
+			t_start = now_us();
+			if(store.commit() != RET_OK)
+			{
+				printf("Commit failed at entry %d\n", i);
+				return RET_ERROR;
+			}
+			result->commit_us += now_us() - t_start;
+		}
+
+		result->write_stats = *NativeFs::get_stats();
+		result->files = NativeFs::get_file_count();
+
+		//
+		// Read back
+		//
+		NativeFs::reset_stats();
+
+		DataStoreReader<TEntry> reader(&store);
+		typename DataStore<TEntry>::Entry entries[DATA_STORE_READ_BLOCK_ENTRIES];
+		DataStoreSpan<TEntry> span(entries, DATA_STORE_READ_BLOCK_ENTRIES);
+		uint64_t t_start = now_us();
+
+		// Block reads, as call home does
+		while(reader.next_file())
+		{
+			while(reader.next_entries(&span, DATA_STORE_READ_BLOCK_ENTRIES))
+			{
+				result->read_entries += span.count + span.crc_failures;
+				result->crc_failures += span.crc_failures;
+			}
+		}
+
+		result->read_us = now_us() - t_start;
+		result->read_stats = *NativeFs::get_stats();
+
+		if(result->read_entries != count || result->crc_failures > 0)
+		{
+			printf("Read back %d/%d entries, %d CRC failures\n", result->read_entries, count, result->crc_failures);
+			return RET_ERROR;
+		}
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * Run all backlog sizes for a store type and print a table
+	 ******************************************************************************/
+	template <typename TEntry>
+	RetResult bench_store_type(const char *name, const char *path, int entries_per_file, int interval_sec)
+	{
+		printf("\n%s (%s) - entry: %d B, entries/file: %d\n", name, path,
+			(int)sizeof(typename DataStore<TEntry>::Entry), entries_per_file);
+		printf("%8s %6s | %10s %10s %10s %8s %8s %12s | %10s %8s %8s\n",
+			"entries", "files",
+			"add/s", "commit/s", "written", "writes", "opens", "dir scanned",
+			"read/s", "reads", "opens");
+
+		for(unsigned int i = 0; i < sizeof(BACKLOG_SIZES) / sizeof(BACKLOG_SIZES[0]); i++)
+		{
+			if(BACKLOG_SIZES[i] > get_max_entries())
+				break;
+
+			StoreResult res;
+			if(bench_store<TEntry>(path, entries_per_file, interval_sec, BACKLOG_SIZES[i], &res) != RET_OK)
+				return RET_ERROR;
+
+			printf("%8d %6d | %10.0f %10.0f %10llu %8u %8u %12llu | %10.0f %8u %8u\n",
+				res.entries, res.files,
+				rate(res.entries, res.add_us), rate(res.entries, res.commit_us),
+				(unsigned long long)res.write_stats.bytes_written, res.write_stats.write_calls,
+				res.write_stats.opens, (unsigned long long)res.write_stats.dir_entries_scanned,
+				rate(res.read_entries, res.read_us), res.read_stats.read_calls, res.read_stats.opens);
+		}
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * Compare commit modes for a store type, committing single entries (commit
+	 * on every add, like the firmware does) and full buffers
+	 ******************************************************************************/
+	template <typename TEntry>
+	RetResult bench_commit_type(const char *name, const char *path, int entries_per_file, int interval_sec)
+	{
+		const int batches[] = {1, DATA_STORE_BUFFER_ELEMENTS};
+		const DataStoreCommitMode modes[] = {DATA_STORE_COMMIT_PER_ENTRY, DATA_STORE_COMMIT_BULK};
+		const char *mode_names[] = {"per-entry", "bulk"};
+
+		// Geometry effects show up well before the largest backlogs
+		int count = get_max_entries() < COMMIT_BENCH_ENTRIES ? get_max_entries() : COMMIT_BENCH_ENTRIES;
+
+		printf("\n%s (%s) - entry: %d B, entries/file: %d, entries: %d\n", name, path,
+			(int)sizeof(typename DataStore<TEntry>::Entry), entries_per_file, count);
+		printf("%5s %10s | %10s %8s %10s %8s %12s %10s\n",
+			"batch", "mode", "commit us", "writes", "pages", "opens", "dir scanned", "written");
+
+		for(unsigned int b = 0; b < sizeof(batches) / sizeof(batches[0]); b++)
+		{
+			for(unsigned int m = 0; m < sizeof(modes) / sizeof(modes[0]); m++)
+			{
+				StoreResult res;
+				if(bench_store<TEntry>(path, entries_per_file, interval_sec, count, &res, batches[b], modes[m]) != RET_OK)
+					return RET_ERROR;
+
+				printf("%5d %10s | %10llu %8u %10llu %8u %12llu %10llu\n",
+					batches[b], mode_names[m],
+					(unsigned long long)res.commit_us, res.write_stats.write_calls,
+					(unsigned long long)res.write_stats.pages_programmed, res.write_stats.opens,
+					(unsigned long long)res.write_stats.dir_entries_scanned,
+					(unsigned long long)res.write_stats.bytes_written);
+			}
+		}
+
+		return RET_OK;
+	}
+
+	template <typename TEntry>
+	struct StoreTypeBench
+	{
+		static RetResult run(const char *name, const char *path, int entries_per_file, int interval_sec)
+		{
+			return bench_store_type<TEntry>(name, path, entries_per_file, interval_sec);
+		}
+	};
+
+	template <typename TEntry>
+	struct CommitBench
+	{
+		static RetResult run(const char *name, const char *path, int entries_per_file, int interval_sec)
+		{
+			return bench_commit_type<TEntry>(name, path, entries_per_file, interval_sec);
+		}
+	};
+
+	/******************************************************************************
+	 * Benchmark add/commit/read of all store types
+	 ******************************************************************************/
+	RetResult data_store()
+	{
+		NativeFs::set_capacity(BENCH_FS_CAPACITY);
+
+		RetResult ret = for_all_store_types<StoreTypeBench>();
+
+		SPIFFS.format();
+
+		return ret;
+	}
+
+	/******************************************************************************
+	 * Benchmark per-entry vs bulk commit of all store types
+	 ******************************************************************************/
+	RetResult data_store_commit()
+	{
+		NativeFs::set_capacity(BENCH_FS_CAPACITY);
+
+		RetResult ret = for_all_store_types<CommitBench>();
+
+		SPIFFS.format();
+
+		return ret;
+	}
+} // Bench
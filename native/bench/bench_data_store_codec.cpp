@@ -0,0 +1,352 @@
+#include "bench.h"
+#include "bench_data.h"
+#include "Arduino.h"
+#include "SPIFFS.h"
+#include "data_store.h"
+#include "data_store_reader.h"
+#include "water_sensor_data.h"
+#include "fo_data.h"
+
+/******************************************************************************
+ * DataStore encoding benchmark
+ * Stores using DataStoreCodec are filled the way the firmware does, raw and
+ * encoded in row and column blocks, and read back. Reports flash used, writes
+ * and read speed, and checks decoded entries are identical to the ones added.
+ * Then a time range of 1% of the backlog is queried.
+ * Layouts are the ones the firmware stores use.
+ ******************************************************************************/
+namespace Bench
+{
+	/** Entries written per run */
+	const int CODEC_BENCH_ENTRIES = 10000;
+
+	/** Partition size for benchmarks */
+	const size_t CODEC_BENCH_FS_CAPACITY = 64 * 1024 * 1024;
+
+	/** Entries per file for the large files run */
+	const int CODEC_BENCH_LARGE_FILE_ENTRIES = 200;
+
+	/** Entries appended to the current file after a torn block */
+	const int CODEC_TORN_ENTRIES = 20;
+
+	/** Result of a single run */
+	struct CodecResult
+	{
+		uint64_t commit_us;
+		uint64_t read_us;
+		NativeFs::Stats write_stats;
+		uint64_t data_bytes;
+		int read_entries;
+		int mismatches;
+		uint64_t query_us;
+		NativeFs::Stats query_stats;
+	};
+
+	/******************************************************************************
+	 * Total size of data files in a store dir (manifest excluded)
+	 ******************************************************************************/
+	uint64_t dir_size(const char *path)
+	{
+		uint64_t size = 0;
+		File dir = SPIFFS.open(path);
+		File file;
+
+		while((file = dir.openNextFile()))
+			size += file.size();
+
+		return size;
+	}
+
+	/******************************************************************************
+	 * Fill a store and read it back, comparing every entry, then query a time
+	 * range
+	 * @param layout Encoding layout, NULL for raw
+	 * @param block_layout Rows or columns
+	 * @param batch Entries add()ed between commits
+	 ******************************************************************************/
+	template <typename TEntry>
+	RetResult bench_codec_run(const char *path, int entries_per_file, int interval_sec, int count,
+		const DataStoreCodec::Field *layout, int layout_field_count, DataStoreCodec::BlockLayout block_layout,
+		int batch, CodecResult *result)
+	{
+		memset(result, 0, sizeof(*result));
+
+		SPIFFS.format();
+		NativeFs::reset_stats();
+
+		DataStore<TEntry> store(path, entries_per_file);
+		if(store.set_encoding(layout, layout_field_count, block_layout) != RET_OK)
+		{
+			printf("Invalid layout\n");
+			return RET_ERROR;
+		}
+
+		TEntry entry;
+
+		for(int i = 0; i < count; i++)
+		{
+			// Clock names files, entries get the same time on read back
+			NativeClock::advance_ms((uint64_t)interval_sec * 1000);
+			BenchData::fill(&entry, 1600000000 + i * interval_sec, i);
+
+			store.add(&entry);
+
+			if((i + 1) % batch != 0 && i != count - 1)
+				continue;
+
+			uint64_t t_start = now_us();
+			if(store.commit() != RET_OK)
+			{
+				printf("Commit failed at entry %d\n", i);
+				return RET_ERROR;
+			}
+			result->commit_us += now_us() - t_start;
+		}
+
+		result->write_stats = *NativeFs::get_stats();
+		result->data_bytes = dir_size(path);
+
+		//
+		// Read back, entries must be identical to the ones added
+		//
+		DataStoreReader<TEntry> reader(&store);
+		const TEntry *read_entry = NULL;
+		uint64_t t_start = now_us();
+
+		while(reader.next_file())
+		{
+			while((read_entry = reader.next_entry()))
+			{
+				BenchData::fill(&entry, 1600000000 + result->read_entries * interval_sec, result->read_entries);
+
+				if(!reader.entry_crc_valid() || memcmp(read_entry, &entry, sizeof(entry)) != 0)
+					result->mismatches++;
+
+				result->read_entries++;
+			}
+		}
+
+		result->read_us = now_us() - t_start;
+
+		if(result->read_entries != count || result->mismatches > 0)
+		{
+			printf("Read back %d/%d entries, %d mismatches\n", result->read_entries, count, result->mismatches);
+			return RET_ERROR;
+		}
+
+		//
+		// Query 1% of the backlog from the middle
+		//
+		int first = count / 2;
+		int query_count = count / 100 > 0 ? count / 100 : 1;
+		int query_read = 0;
+
+		reader.reset();
+		reader.set_time_range(1600000000 + (uint64_t)first * interval_sec,
+			1600000000 + (uint64_t)(first + query_count - 1) * interval_sec);
+
+		NativeFs::reset_stats();
+		t_start = now_us();
+
+		while(reader.next_file())
+		{
+			while((read_entry = reader.next_entry()))
+			{
+				BenchData::fill(&entry, 1600000000 + (first + query_read) * interval_sec, first + query_read);
+
+				if(memcmp(read_entry, &entry, sizeof(entry)) != 0)
+					result->mismatches++;
+
+				query_read++;
+			}
+		}
+
+		result->query_us = now_us() - t_start;
+		result->query_stats = *NativeFs::get_stats();
+
+		if(query_read != query_count || result->mismatches > 0)
+		{
+			printf("Query returned %d/%d entries, %d mismatches\n", query_read, query_count, result->mismatches);
+			return RET_ERROR;
+		}
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * Corrupt the end of the current file (as a reset during a write would) and
+	 * keep committing with a new store object (as after reboot). Entries before
+	 * the torn block and all new ones must read back.
+	 ******************************************************************************/
+	template <typename TEntry>
+	RetResult bench_codec_torn(const char *path, int entries_per_file,
+		const DataStoreCodec::Field *layout, int layout_field_count)
+	{
+		SPIFFS.format();
+
+		TEntry entry;
+		int seq = 0;
+
+		// Leave current file half full
+		int entries_before = entries_per_file + entries_per_file / 2;
+		{
+			DataStore<TEntry> store(path, entries_per_file, layout, layout_field_count);
+
+			for(; seq < entries_before; seq++)
+			{
+				NativeClock::advance_ms(600 * 1000);
+				BenchData::fill(&entry, 1600000000 + seq * 600, seq);
+				store.add(&entry);
+				store.commit();
+			}
+
+			DataStoreManifest::Record record;
+			char file_path[FILE_PATH_BUFFER_SIZE];
+			store.get_manifest()->get_record(store.get_manifest()->get_current_record(), &record);
+			store.get_manifest()->get_file_path(&record, file_path, sizeof(file_path));
+
+			// Header of a block that never got its payload
+			const uint8_t torn[] = {1, 0, 20, 0, 0xAA, 0xBB};
+			File f = SPIFFS.open(file_path, FILE_APPEND);
+			f.write(torn, sizeof(torn));
+			f.close();
+		}
+
+		DataStoreManifest::unload_all();
+
+		DataStore<TEntry> store(path, entries_per_file, layout, layout_field_count);
+		for(; seq < entries_before + CODEC_TORN_ENTRIES; seq++)
+		{
+			NativeClock::advance_ms(600 * 1000);
+			BenchData::fill(&entry, 1600000000 + seq * 600, seq);
+			store.add(&entry);
+
+			if(store.commit() != RET_OK)
+			{
+				printf("Commit after torn block failed\n");
+				return RET_ERROR;
+			}
+		}
+
+		DataStoreReader<TEntry> reader(&store);
+		const TEntry *read_entry = NULL;
+		int read = 0;
+
+		while(reader.next_file())
+		{
+			while((read_entry = reader.next_entry()))
+			{
+				BenchData::fill(&entry, 1600000000 + read * 600, read);
+
+				if(memcmp(read_entry, &entry, sizeof(entry)) != 0)
+				{
+					printf("Entry %d differs after torn block\n", read);
+					return RET_ERROR;
+				}
+
+				read++;
+			}
+		}
+
+		if(read != seq)
+		{
+			printf("Read %d/%d entries after torn block\n", read, seq);
+			return RET_ERROR;
+		}
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * Compare raw and encoded store of a type
+	 ******************************************************************************/
+	template <typename TEntry>
+	RetResult bench_codec_type(const char *name, const char *path, int entries_per_file, int interval_sec,
+		const DataStore<TEntry> *firmware_store)
+	{
+		// Commit per add and full buffers, then full buffers into large files
+		// (many blocks per file) to show block skipping
+		const int batches[] = {1, DATA_STORE_BUFFER_ELEMENTS, DATA_STORE_BUFFER_ELEMENTS};
+		const int files_entries[] = {entries_per_file, entries_per_file, CODEC_BENCH_LARGE_FILE_ENTRIES};
+
+		int layout_field_count = 0;
+		const DataStoreCodec::Field *layout = firmware_store->get_encoding(&layout_field_count);
+
+		int count = get_max_entries() < CODEC_BENCH_ENTRIES ? get_max_entries() : CODEC_BENCH_ENTRIES;
+
+		printf("\n%s (%s) - entry: %d B, fields: %d, entries/file: %d, entries: %d\n", name, path,
+			(int)sizeof(typename DataStore<TEntry>::Entry), layout_field_count, entries_per_file, count);
+		printf("%5s %5s %8s | %10s %8s %6s | %10s %10s %8s | %10s | %8s %6s %8s\n",
+			"batch", "file", "format", "data", "B/entry", "ratio", "written", "pages", "writes", "read/s",
+			"query us", "opens", "read B");
+
+		const int formats = 3;
+		const char *format_names[formats] = {"raw", "rows", "columns"};
+		const DataStoreCodec::BlockLayout block_layouts[formats] = {
+			DataStoreCodec::BLOCK_ROWS, DataStoreCodec::BLOCK_ROWS, DataStoreCodec::BLOCK_COLUMNS
+		};
+
+		for(unsigned int b = 0; b < sizeof(batches) / sizeof(batches[0]); b++)
+		{
+			CodecResult results[formats];
+
+			for(int i = 0; i < formats; i++)
+			{
+				if(bench_codec_run<TEntry>(path, files_entries[b], interval_sec, count,
+					i == 0 ? NULL : layout, i == 0 ? 0 : layout_field_count, block_layouts[i],
+					batches[b], &results[i]) != RET_OK)
+				{
+					return RET_ERROR;
+				}
+			}
+
+			for(int i = 0; i < formats; i++)
+			{
+				const NativeFs::Stats *stats = &results[i].write_stats;
+
+				printf("%5d %5d %8s | %10llu %8.1f %6.2f | %10llu %10llu %8u | %10.0f | %8llu %6u %8llu\n",
+					batches[b], files_entries[b], format_names[i],
+					(unsigned long long)results[i].data_bytes, (double)results[i].data_bytes / count,
+					(double)results[0].data_bytes / results[i].data_bytes,
+					(unsigned long long)stats->bytes_written,
+					(unsigned long long)stats->pages_programmed, stats->write_calls,
+					rate(results[i].read_entries, results[i].read_us),
+					(unsigned long long)results[i].query_us, results[i].query_stats.opens,
+					(unsigned long long)results[i].query_stats.bytes_read);
+			}
+		}
+
+		if(bench_codec_torn<TEntry>(path, entries_per_file, layout, layout_field_count) != RET_OK)
+			return RET_ERROR;
+
+		printf("Torn block at end of file: recovered\n");
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * Benchmark stores the firmware encodes
+	 ******************************************************************************/
+	RetResult data_store_codec()
+	{
+		RetResult ret = RET_OK;
+
+		NativeFs::set_capacity(CODEC_BENCH_FS_CAPACITY);
+
+		if(bench_codec_type<WaterSensorData::Entry>("WaterSensorData", WATER_SENSOR_DATA_PATH,
+			WATER_SENSOR_DATA_ENTRIES_PER_SUBMIT_REQ, 600, WaterSensorData::get_store()) != RET_OK)
+		{
+			ret = RET_ERROR;
+		}
+
+		if(bench_codec_type<FoData::StoreEntry>("FoData", FO_DATA_STORE_PATH,
+			FO_DATA_STORE_ENTRIES_PER_SUBMIT_REQ, 1800, FoData::get_store()) != RET_OK)
+		{
+			ret = RET_ERROR;
+		}
+
+		SPIFFS.format();
+
+		return ret;
+	}
+} // Bench
@@ -0,0 +1,167 @@
+#include "bench.h"
+#include "bench_data.h"
+#include "Arduino.h"
+#include "SPIFFS.h"
+#include "deep_sleep.h"
+#include "data_store.h"
+
+/******************************************************************************
+ * Deep sleep state benchmark
+ * Store buffers are filled, parked in RTC memory as before deep sleep and
+ * restored as on resume. Restored buffers must match what was parked, stores
+ * that didn't fit must have been committed to flash instead.
+ * Reports RTC memory used per store and park/restore times, for sizing
+ * DEEP_SLEEP_PARK_SIZE.
+ ******************************************************************************/
+namespace Bench
+{
+	/** Entries in each store buffer before sleeping */
+	const int DEEP_SLEEP_BENCH_FILLS[] = {1, 3, DATA_STORE_BUFFER_ELEMENTS / 2, DATA_STORE_BUFFER_ELEMENTS};
+
+	/** Largest store buffer in bytes */
+	const int DEEP_SLEEP_BENCH_SNAPSHOT_SIZE = 4096;
+
+	/** Buffer contents of a store before parking */
+	struct StoreSnapshot
+	{
+		uint8_t data[DEEP_SLEEP_BENCH_SNAPSHOT_SIZE];
+		size_t size;
+	};
+
+	/******************************************************************************
+	 * Add entries to a store buffer without committing and keep a copy of it
+	 ******************************************************************************/
+	template <typename TEntry>
+	void deep_sleep_fill(DataStore<TEntry> *store, int count, StoreSnapshot *snapshot)
+	{
+		TEntry entry;
+
+		store->clear_buffer();
+
+		for(int i = 0; i < count; i++)
+		{
+			BenchData::fill(&entry, 1600000000 + i * 600, i);
+			store->add(&entry);
+		}
+
+		snapshot->size = store->get_buffer_element_count() * sizeof(*store->get_buffer_element(0));
+		memcpy(snapshot->data, store->get_buffer_element(0), snapshot->size);
+	}
+
+	/******************************************************************************
+	 * Check a store after restoring
+	 * @param parked Set if the buffer was restored, cleared if it was committed
+	 ******************************************************************************/
+	template <typename TEntry>
+	RetResult deep_sleep_check(DataStore<TEntry> *store, const StoreSnapshot *snapshot, bool *parked)
+	{
+		size_t size = store->get_buffer_element_count() * sizeof(*store->get_buffer_element(0));
+
+		*parked = size > 0;
+
+		// Committed instead of parked
+		if(size == 0)
+			return RET_OK;
+
+		if(size != snapshot->size || memcmp(snapshot->data, store->get_buffer_element(0), size) != 0)
+		{
+			printf("Restored buffer of %s does not match\n", store->get_dir_path());
+			return RET_ERROR;
+		}
+
+		store->clear_buffer();
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * Print RTC memory needed for a full buffer of a store
+	 ******************************************************************************/
+	template <typename TEntry>
+	void deep_sleep_print_store(const char *name, DataStore<TEntry> *store)
+	{
+		int entry_size = sizeof(typename DataStore<TEntry>::Entry);
+
+		printf("%16s | %6d %10d\n", name, entry_size, entry_size * DATA_STORE_BUFFER_ELEMENTS);
+	}
+
+	/******************************************************************************
+	 * Benchmark parking and restoring of store buffers
+	 ******************************************************************************/
+	RetResult deep_sleep()
+	{
+		RetResult ret = RET_OK;
+
+		printf("Park size: %d B, store buffer: %d entries\n\n", DEEP_SLEEP_PARK_SIZE, DATA_STORE_BUFFER_ELEMENTS);
+		printf("%16s | %6s %10s\n", "store", "entry", "full buff");
+
+		deep_sleep_print_store("WaterSensorData", WaterSensorData::get_store());
+		deep_sleep_print_store("Atmos41Data", Atmos41Data::get_store());
+		deep_sleep_print_store("SoilMoistureData", SoilMoistureData::get_store());
+		deep_sleep_print_store("LightningData", LightningData::get_store());
+		deep_sleep_print_store("FoData", FoData::get_store());
+		deep_sleep_print_store("SDI12Log", SDI12Log::get_store());
+		deep_sleep_print_store("Log", Log::get_store());
+
+		printf("\n%6s | %7s %9s %8s | %7s %10s\n", "fill", "parked", "committed", "writes", "park us", "restore us");
+
+		StoreSnapshot *snapshots = new StoreSnapshot[7];
+
+		for(unsigned int i = 0; i < sizeof(DEEP_SLEEP_BENCH_FILLS) / sizeof(DEEP_SLEEP_BENCH_FILLS[0]); i++)
+		{
+			int fill = DEEP_SLEEP_BENCH_FILLS[i];
+
+			SPIFFS.format();
+			DataStoreManifest::unload_all();
+
+			deep_sleep_fill(WaterSensorData::get_store(), fill, &snapshots[0]);
+			deep_sleep_fill(Atmos41Data::get_store(), fill, &snapshots[1]);
+			deep_sleep_fill(SoilMoistureData::get_store(), fill, &snapshots[2]);
+			deep_sleep_fill(LightningData::get_store(), fill, &snapshots[3]);
+			deep_sleep_fill(FoData::get_store(), fill, &snapshots[4]);
+			deep_sleep_fill(SDI12Log::get_store(), fill, &snapshots[5]);
+			deep_sleep_fill(Log::get_store(), fill, &snapshots[6]);
+
+			NativeFs::reset_stats();
+
+			uint64_t t_start = now_us();
+			DeepSleep::park_state();
+			uint64_t park_us = now_us() - t_start;
+
+			size_t parked_bytes = DeepSleep::get_parked_bytes();
+
+			t_start = now_us();
+			DeepSleep::restore_state();
+			uint64_t restore_us = now_us() - t_start;
+
+			bool parked[7];
+			if(deep_sleep_check(WaterSensorData::get_store(), &snapshots[0], &parked[0]) != RET_OK ||
+				deep_sleep_check(Atmos41Data::get_store(), &snapshots[1], &parked[1]) != RET_OK ||
+				deep_sleep_check(SoilMoistureData::get_store(), &snapshots[2], &parked[2]) != RET_OK ||
+				deep_sleep_check(LightningData::get_store(), &snapshots[3], &parked[3]) != RET_OK ||
+				deep_sleep_check(FoData::get_store(), &snapshots[4], &parked[4]) != RET_OK ||
+				deep_sleep_check(SDI12Log::get_store(), &snapshots[5], &parked[5]) != RET_OK ||
+				deep_sleep_check(Log::get_store(), &snapshots[6], &parked[6]) != RET_OK)
+			{
+				ret = RET_ERROR;
+				break;
+			}
+
+			int committed = 0;
+			for(int s = 0; s < 7; s++)
+			{
+				if(!parked[s])
+					committed++;
+			}
+
+			printf("%6d | %7d %9d %8u | %7llu %10llu\n", fill, (int)parked_bytes, committed,
+				NativeFs::get_stats()->write_calls, (unsigned long long)park_us, (unsigned long long)restore_us);
+		}
+
+		delete[] snapshots;
+
+		SPIFFS.format();
+
+		return ret;
+	}
+} // Bench
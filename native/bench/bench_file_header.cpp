@@ -0,0 +1,350 @@
+#include "bench.h"
+#include "bench_data.h"
+#include "Arduino.h"
+#include "SPIFFS.h"
+#include "utils.h"
+#include "entry_schema.h"
+#include "data_store.h"
+#include "data_store_reader.h"
+#include <algorithm>
+#include <vector>
+
+/******************************************************************************
+ * Store file headers
+ * Upgrade: a backlog of legacy files (no header, as written by firmware
+ * before headers) is rewritten with headers, as at first boot after an OTA.
+ * Entries read back after must be exactly the ones before.
+ * Mismatch: the store's dir holds a backlog of another entry struct, left by
+ * the firmware before an OTA, and new entries are written after it. Without
+ * headers every old entry is read and fails CRC, and new entries appended to
+ * the old current file are misaligned. With headers old files are skipped
+ * by their header once and by their manifest flag after, and only the new
+ * entries are read.
+ * Reports upgrade time, flash written and the read cost of each case: first
+ * read, second read and read after new entries (opens, CRC failures, new
+ * entries read and old ones returned as entries).
+ ******************************************************************************/
+namespace Bench
+{
+	/** Backlog sizes, in entries. Upgrading needs room for a copy of a file,
+	 * larger backlogs of small files fill the emulated flash. */
+	const int FILE_HEADER_BENCH_BACKLOGS[] = {1000, 5000};
+
+	/** Entries written after the backlog of another struct */
+	const int FILE_HEADER_BENCH_NEW_ENTRIES = 50;
+
+	/** Seconds between entries */
+	const int FILE_HEADER_BENCH_INTERVAL_SEC = 600;
+
+	/** First entry timestamp */
+	const uint32_t FILE_HEADER_BENCH_TSTAMP = 1600000000;
+
+	/** Cost of reading a store back like call home does */
+	struct FileHeaderBenchRead
+	{
+		int files;
+		int crc_failures;
+		uint64_t us;
+		NativeFs::Stats stats;
+	};
+
+	/******************************************************************************
+	 * Read all entries of a store, with block reads
+	 * @param tstamps Timestamps of entries read, sorted
+	 ******************************************************************************/
+	template <typename TEntry>
+	void file_header_bench_read(DataStore<TEntry> *store, std::vector<uint32_t> *tstamps, FileHeaderBenchRead *result)
+	{
+		DataStoreReader<TEntry> reader(store);
+		typename DataStore<TEntry>::Entry entries[DATA_STORE_READ_BLOCK_ENTRIES];
+		DataStoreSpan<TEntry> span(entries, DATA_STORE_READ_BLOCK_ENTRIES);
+
+		tstamps->clear();
+		result->files = 0;
+		result->crc_failures = 0;
+
+		NativeFs::reset_stats();
+		uint64_t t_start = now_us();
+
+		while(reader.next_file())
+		{
+			result->files++;
+
+			while(reader.next_entries(&span, DATA_STORE_READ_BLOCK_ENTRIES))
+			{
+				result->crc_failures += span.crc_failures;
+
+				for(int i = 0; i < span.count; i++)
+					tstamps->push_back(span.get(i)->timestamp);
+			}
+		}
+
+		result->us = now_us() - t_start;
+		result->stats = *NativeFs::get_stats();
+
+		std::sort(tstamps->begin(), tstamps->end());
+	}
+
+	/******************************************************************************
+	 * Write a backlog as legacy files, without headers or manifest, as firmware
+	 * before headers did. Files are named after their first entry.
+	 ******************************************************************************/
+	template <typename TEntry>
+	RetResult file_header_bench_write_legacy(const char *path, int entries_per_file, int count)
+	{
+		typename DataStore<TEntry>::Entry entry;
+
+		for(int i = 0; i < count; i += entries_per_file)
+		{
+			uint32_t tstamp = FILE_HEADER_BENCH_TSTAMP + i * FILE_HEADER_BENCH_INTERVAL_SEC;
+
+			char file_path[FILE_PATH_BUFFER_SIZE] = {0};
+			snprintf(file_path, sizeof(file_path), "%s/%u_0", path, tstamp);
+
+			File f = SPIFFS.open(file_path, FILE_WRITE);
+			if(!f)
+				return RET_ERROR;
+
+			for(int j = i; j < i + entries_per_file && j < count; j++)
+			{
+				BenchData::fill(&entry.data, FILE_HEADER_BENCH_TSTAMP + j * FILE_HEADER_BENCH_INTERVAL_SEC, j);
+				entry.crc32 = Utils::crc32((uint8_t*)&entry.data, sizeof(entry.data));
+
+				if(f.write((uint8_t*)&entry, sizeof(entry)) != sizeof(entry))
+					return RET_ERROR;
+			}
+		}
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * Upgrade a legacy backlog and read it back
+	 ******************************************************************************/
+	template <typename TEntry>
+	RetResult file_header_bench_upgrade(const char *path, int entries_per_file, uint32_t schema_id, int count)
+	{
+		SPIFFS.format();
+		DataStoreManifest::unload_all();
+
+		if(file_header_bench_write_legacy<TEntry>(path, entries_per_file, count) != RET_OK)
+		{
+			printf("Could not write legacy backlog\n");
+			return RET_ERROR;
+		}
+
+		// Manifest is rebuilt from the legacy files, not timed
+		DataStore<TEntry> store(path, entries_per_file, schema_id);
+		store.load_manifest();
+
+		std::vector<uint32_t> tstamps_before, tstamps_after;
+		FileHeaderBenchRead before, after;
+
+		file_header_bench_read(&store, &tstamps_before, &before);
+
+		NativeFs::reset_stats();
+		int files_upgraded = 0, files_dropped = 0;
+
+		uint64_t t_start = now_us();
+		RetResult ret = store.upgrade_files(&files_upgraded, &files_dropped);
+		uint64_t upgrade_us = now_us() - t_start;
+
+		NativeFs::Stats upgrade_stats = *NativeFs::get_stats();
+
+		file_header_bench_read(&store, &tstamps_after, &after);
+
+		// Every file left must have a header
+		DataStoreManifest *manifest = store.get_manifest();
+		File records = manifest->open_records();
+		DataStoreManifest::Record record;
+		int index = 0, legacy_files = 0;
+
+		while(manifest->read_next_record(records, &record, &index))
+		{
+			if(!(record.flags & DataStoreManifest::RECORD_HEADER))
+				legacy_files++;
+		}
+
+		printf("%6d | %6d %7d %8.1f %7u | %9.0f %9.0f\n", count, files_upgraded, files_dropped,
+			upgrade_us / 1000.0, (unsigned int)(upgrade_stats.bytes_written / 1024),
+			rate(tstamps_before.size(), before.us), rate(tstamps_after.size(), after.us));
+
+		if(ret != RET_OK || legacy_files > 0 || tstamps_after != tstamps_before ||
+			(int)tstamps_before.size() != count)
+		{
+			printf("Upgrade failed: %d, legacy files left: %d, entries read after: %d, before: %d\n",
+				ret != RET_OK, legacy_files, (int)tstamps_after.size(), (int)tstamps_before.size());
+			return RET_ERROR;
+		}
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * Read a backlog of another struct, then add new entries and read again
+	 * @param headers Old backlog written with headers, else as legacy files
+	 ******************************************************************************/
+	RetResult file_header_bench_mismatch(int count, bool headers)
+	{
+		int entries_per_file = WATER_SENSOR_DATA_ENTRIES_PER_SUBMIT_REQ;
+
+		SPIFFS.format();
+		DataStoreManifest::unload_all();
+
+		int field_count = 0;
+		const EntrySchema::Field *fields = NULL;
+
+		//
+		// Backlog of the struct before the OTA
+		//
+		if(headers)
+		{
+			fields = Atmos41Data::get_schema(&field_count);
+			DataStore<Atmos41Data::Entry> old_store(WATER_SENSOR_DATA_PATH, entries_per_file,
+				EntrySchema::schema_id(fields, field_count));
+			Atmos41Data::Entry entry;
+
+			for(int i = 0; i < count; i++)
+			{
+				NativeClock::advance_ms((uint64_t)FILE_HEADER_BENCH_INTERVAL_SEC * 1000);
+				BenchData::fill(&entry, time(NULL), i);
+				old_store.add(&entry);
+
+				if(old_store.commit() != RET_OK)
+				{
+					printf("Could not write backlog\n");
+					return RET_ERROR;
+				}
+			}
+
+			DataStoreManifest::unload_all();
+		}
+		else if(file_header_bench_write_legacy<Atmos41Data::Entry>(WATER_SENSOR_DATA_PATH, entries_per_file,
+			count) != RET_OK)
+		{
+			printf("Could not write backlog\n");
+			return RET_ERROR;
+		}
+
+		//
+		// Store after the OTA
+		//
+		fields = WaterSensorData::get_schema(&field_count);
+		DataStore<WaterSensorData::Entry> store(WATER_SENSOR_DATA_PATH, entries_per_file,
+			EntrySchema::schema_id(fields, field_count));
+
+		std::vector<uint32_t> tstamps;
+		FileHeaderBenchRead first, second, after_new;
+
+		file_header_bench_read(&store, &tstamps, &first);
+		int old_read = tstamps.size();
+
+		file_header_bench_read(&store, &tstamps, &second);
+
+		WaterSensorData::Entry entry;
+		std::vector<uint32_t> tstamps_new;
+
+		for(int i = 0; i < FILE_HEADER_BENCH_NEW_ENTRIES; i++)
+		{
+			NativeClock::advance_ms((uint64_t)FILE_HEADER_BENCH_INTERVAL_SEC * 1000);
+			BenchData::fill(&entry, time(NULL), i);
+			tstamps_new.push_back(entry.timestamp);
+			store.add(&entry);
+			store.commit();
+		}
+
+		file_header_bench_read(&store, &tstamps, &after_new);
+
+		int new_read = 0;
+		for(unsigned int i = 0; i < tstamps.size(); i++)
+		{
+			if(std::binary_search(tstamps_new.begin(), tstamps_new.end(), tstamps[i]))
+				new_read++;
+		}
+
+		printf("%6d %7s | %5u %6d %8.2f | %5u %8.2f | %5u %6d %5d/%-5d %5d\n", count, headers ? "header" : "legacy",
+			first.stats.opens, first.crc_failures, first.us / 1000.0, second.stats.opens, second.us / 1000.0,
+			after_new.stats.opens, after_new.crc_failures, new_read, FILE_HEADER_BENCH_NEW_ENTRIES,
+			(int)tstamps.size() - new_read + old_read);
+
+		if(headers && (old_read > 0 || first.crc_failures > 0 || after_new.crc_failures > 0 ||
+			new_read != FILE_HEADER_BENCH_NEW_ENTRIES || (int)tstamps.size() != new_read))
+		{
+			printf("Entries of another struct read: %d, CRC failures: %d, new entries read: %d\n",
+				old_read + (int)tstamps.size() - new_read, first.crc_failures + after_new.crc_failures, new_read);
+			return RET_ERROR;
+		}
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * Benchmark store file headers
+	 ******************************************************************************/
+	RetResult file_header()
+	{
+		RetResult ret = RET_OK;
+		int field_count = 0;
+		const EntrySchema::Field *fields = NULL;
+
+		printf("Upgrade of legacy files at first boot after OTA\n");
+
+		fields = WaterSensorData::get_schema(&field_count);
+		printf("\nWaterSensorData (%s) - entries/file: %d\n", WATER_SENSOR_DATA_PATH,
+			WATER_SENSOR_DATA_ENTRIES_PER_SUBMIT_REQ);
+		printf("%6s | %6s %7s %8s %7s | %9s %9s\n", "entries", "files", "dropped", "ms", "KB wr",
+			"read/s", "after");
+
+		for(unsigned int i = 0; i < sizeof(FILE_HEADER_BENCH_BACKLOGS) / sizeof(FILE_HEADER_BENCH_BACKLOGS[0]); i++)
+		{
+			if(FILE_HEADER_BENCH_BACKLOGS[i] > get_max_entries())
+				break;
+
+			if(file_header_bench_upgrade<WaterSensorData::Entry>(WATER_SENSOR_DATA_PATH,
+				WATER_SENSOR_DATA_ENTRIES_PER_SUBMIT_REQ, EntrySchema::schema_id(fields, field_count),
+				FILE_HEADER_BENCH_BACKLOGS[i]) != RET_OK)
+			{
+				ret = RET_ERROR;
+			}
+		}
+
+		fields = Atmos41Data::get_schema(&field_count);
+		printf("\nAtmos41Data (%s) - entries/file: %d\n", ATMOS41_DATA_PATH, ATMOS41_DATA_ENTRIES_PER_SUBMIT_REQ);
+		printf("%6s | %6s %7s %8s %7s | %9s %9s\n", "entries", "files", "dropped", "ms", "KB wr",
+			"read/s", "after");
+
+		for(unsigned int i = 0; i < sizeof(FILE_HEADER_BENCH_BACKLOGS) / sizeof(FILE_HEADER_BENCH_BACKLOGS[0]); i++)
+		{
+			if(FILE_HEADER_BENCH_BACKLOGS[i] > get_max_entries())
+				break;
+
+			if(file_header_bench_upgrade<Atmos41Data::Entry>(ATMOS41_DATA_PATH, ATMOS41_DATA_ENTRIES_PER_SUBMIT_REQ,
+				EntrySchema::schema_id(fields, field_count), FILE_HEADER_BENCH_BACKLOGS[i]) != RET_OK)
+			{
+				ret = RET_ERROR;
+			}
+		}
+
+		printf("\nAtmos41Data backlog in WaterSensorData store (%s), %d new entries after it\n",
+			WATER_SENSOR_DATA_PATH, FILE_HEADER_BENCH_NEW_ENTRIES);
+		printf("%6s %7s | %5s %6s %8s | %5s %8s | %5s %6s %11s %5s\n", "entries", "format", "opens", "crc",
+			"ms", "opens", "ms", "opens", "crc", "new read", "old");
+
+		for(unsigned int i = 0; i < sizeof(FILE_HEADER_BENCH_BACKLOGS) / sizeof(FILE_HEADER_BENCH_BACKLOGS[0]); i++)
+		{
+			if(FILE_HEADER_BENCH_BACKLOGS[i] > get_max_entries())
+				break;
+
+			if(file_header_bench_mismatch(FILE_HEADER_BENCH_BACKLOGS[i], false) != RET_OK)
+				ret = RET_ERROR;
+
+			if(file_header_bench_mismatch(FILE_HEADER_BENCH_BACKLOGS[i], true) != RET_OK)
+				ret = RET_ERROR;
+		}
+
+		SPIFFS.format();
+		DataStoreManifest::unload_all();
+
+		return ret;
+	}
+} // Bench
@@ -0,0 +1,145 @@
+#include "bench.h"
+#include "bench_data.h"
+#include "Arduino.h"
+#include "SPIFFS.h"
+#include "flash.h"
+#include "storage.h"
+#include "data_store.h"
+#include "data_store_reader.h"
+#include "log.h"
+
+/******************************************************************************
+ * Flash wear counters
+ * A day of firmware activity (a water sensor entry and a few logs every wake
+ * up, a call home that submits and deletes everything every few hours) is
+ * run with the water store in rows and delta encoded. Flash counters must
+ * agree with what the native FS measured (writes, bytes, pages), so no
+ * write path is left uncounted, and a single mount must be counted however
+ * often stores mount. Reports wear per day as exported to TB.
+ ******************************************************************************/
+namespace Bench
+{
+	/** Wake ups per simulated day */
+	const int FLASH_BENCH_CYCLES = 144;
+
+	/** Seconds between wake ups */
+	const int FLASH_BENCH_CYCLE_SEC = 600;
+
+	/** Logs per wake up */
+	const int FLASH_BENCH_LOGS_PER_CYCLE = 4;
+
+	/** Wake ups between call homes */
+	const int FLASH_BENCH_CALL_HOME_CYCLES = 36;
+
+	/******************************************************************************
+	 * Read and delete every file of a store, as a successful call home does
+	 ******************************************************************************/
+	template <typename TEntry>
+	void flash_bench_submit(DataStore<TEntry> *store)
+	{
+		DataStoreReader<TEntry> reader(store);
+
+		while(reader.next_file())
+		{
+			while(reader.next_entry())
+				;
+
+			reader.delete_file();
+		}
+	}
+
+	/******************************************************************************
+	 * Run a day and compare counters with FS stats
+	 ******************************************************************************/
+	RetResult flash_bench_run(const char *name, bool encoded)
+	{
+		SPIFFS.format();
+		DataStoreManifest::unload_all();
+		NativeFs::reset_stats();
+		Flash::reset_stats();
+
+		// A single real mount, every flash access mounts again
+		Storage::end();
+		Flash::mount();
+
+		int layout_field_count = 0;
+		const DataStoreCodec::Field *layout = WaterSensorData::get_store()->get_encoding(&layout_field_count);
+
+		DataStore<WaterSensorData::Entry> store(WATER_SENSOR_DATA_PATH, WATER_SENSOR_DATA_ENTRIES_PER_SUBMIT_REQ,
+			encoded ? layout : NULL, encoded ? layout_field_count : 0);
+		WaterSensorData::Entry entry;
+
+		Log::begin();
+
+		for(int cycle = 0; cycle < FLASH_BENCH_CYCLES; cycle++)
+		{
+			NativeClock::advance_ms((uint64_t)FLASH_BENCH_CYCLE_SEC * 1000);
+
+			BenchData::fill(&entry, time(NULL), cycle);
+			store.add(&entry);
+			store.commit();
+
+			for(int i = 0; i < FLASH_BENCH_LOGS_PER_CYCLE; i++)
+				Log::log(Log::BATTERY, cycle, i);
+
+			if((cycle + 1) % FLASH_BENCH_CALL_HOME_CYCLES == 0)
+			{
+				Log::commit();
+				flash_bench_submit(&store);
+				flash_bench_submit(Log::get_store());
+			}
+		}
+
+		const Flash::Stats *stats = Flash::get_stats();
+		const NativeFs::Stats *fs_stats = NativeFs::get_stats();
+
+		printf("%8s | %6u %8u %6u %6u | %7u %7u | %6u %6u\n", name, stats->writes, stats->bytes_written,
+			stats->pages_programmed, Flash::get_est_erases(), stats->files_created, stats->files_deleted,
+			fs_stats->creates, fs_stats->removes);
+
+		for(int i = 0; i < stats->store_count; i++)
+		{
+			printf("%8s   %-6s data %6u B, manifest %6u B, writes %4u\n", "", stats->stores[i].dir_path,
+				stats->stores[i].data_bytes, stats->stores[i].manifest_bytes, stats->stores[i].writes);
+		}
+
+		if(stats->mounts != 1)
+		{
+			printf("Mounts counted: %u, expected 1\n", stats->mounts);
+			return RET_ERROR;
+		}
+
+		if(stats->writes != fs_stats->write_calls || stats->bytes_written != fs_stats->bytes_written ||
+			stats->pages_programmed != fs_stats->pages_programmed)
+		{
+			printf("Counters don't match FS - writes: %u, bytes: %llu, pages: %llu\n", fs_stats->write_calls,
+				(unsigned long long)fs_stats->bytes_written, (unsigned long long)fs_stats->pages_programmed);
+			return RET_ERROR;
+		}
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * Benchmark flash wear counters
+	 ******************************************************************************/
+	RetResult flash()
+	{
+		printf("Day: %d wake ups, %d logs each, call home every %d wake ups\n\n", FLASH_BENCH_CYCLES,
+			FLASH_BENCH_LOGS_PER_CYCLE, FLASH_BENCH_CALL_HOME_CYCLES);
+		printf("%8s | %6s %8s %6s %6s | %7s %7s | %6s %6s\n", "water", "writes", "bytes", "pages", "erases",
+			"created", "deleted", "fs cr", "fs rm");
+
+		RetResult ret = RET_OK;
+
+		if(flash_bench_run("rows", false) != RET_OK)
+			ret = RET_ERROR;
+
+		if(flash_bench_run("encoded", true) != RET_OK)
+			ret = RET_ERROR;
+
+		SPIFFS.format();
+
+		return ret;
+	}
+} // Bench
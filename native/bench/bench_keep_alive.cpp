@@ -0,0 +1,286 @@
+#include "bench.h"
+#include "bench_data.h"
+#include "Arduino.h"
+#include "SPIFFS.h"
+#include "data_store.h"
+#include "data_store_reader.h"
+#include "http_body.h"
+#include "telemetry_json_body.h"
+#include "tb_water_sensor_data_json_builder.h"
+#include "tb_atmos41_data_json_builder.h"
+#include "tb_soil_moisture_data_json_builder.h"
+#include "tb_lightning_data_json_builder.h"
+#include "tb_fo_data_json_builder.h"
+#include "tb_log_json_builder.h"
+#include <vector>
+
+/******************************************************************************
+ * HTTP keep-alive
+ * The requests of a call home (remote control, client attributes and the
+ * streamed telemetry of a backlog of every store) are timed over a GPRS link
+ * model:
+ * - close: a connection per request, opened and closed around it, as
+ *   HttpRequest did
+ * - keep-alive: a connection for the whole call home (HttpSession), reopened
+ *   after a request fails. Kept connections may have been dropped (NAT or
+ *   server idle timeout), the request on them fails and is resent on a new
+ *   connection.
+ * Reports connections, failed requests, call home duration and requests/s.
+ ******************************************************************************/
+namespace Bench
+{
+	/** Hours of data in backlog (call home interval) */
+	const int KEEP_ALIVE_BENCH_HOURS = 6;
+
+	/** AT+CIPSTART and TCP handshake */
+	const double KEEP_ALIVE_BENCH_CONNECT_MS = 2500;
+
+	/** AT+CIPCLOSE */
+	const double KEEP_ALIVE_BENCH_CLOSE_MS = 300;
+
+	/** Round trip incl. server time */
+	const double KEEP_ALIVE_BENCH_RTT_MS = 800;
+
+	/** GPRS up/downlink and modem UART, bytes per ms */
+	const double KEEP_ALIVE_BENCH_UPLINK_BPMS = 20000 / 8 / 1000.0;
+	const double KEEP_ALIVE_BENCH_DOWNLINK_BPMS = 40000 / 8 / 1000.0;
+	const double KEEP_ALIVE_BENCH_UART_BPMS = 115200 / 10 / 1000.0;
+
+	/** AT+CIPSEND round per write to the modem */
+	const double KEEP_ALIVE_BENCH_SEND_CMD_MS = 40;
+
+	/** Request and response headers */
+	const int KEEP_ALIVE_BENCH_REQ_HEADERS = 180;
+	const int KEEP_ALIVE_BENCH_RESP_HEADERS = 150;
+
+	/** Remote control response and client attributes request bodies */
+	const int KEEP_ALIVE_BENCH_RC_RESP = 600;
+	const int KEEP_ALIVE_BENCH_ATTR_REQ = 250;
+
+	/** Chance a kept connection was dropped before a request */
+	const double KEEP_ALIVE_BENCH_DROP[] = {0, 0.1, 0.3};
+
+	/** A request of the call home */
+	struct KeepAliveBenchRequest
+	{
+		int req_bytes;
+		int resp_bytes;
+	};
+
+	/** Result of a call home */
+	struct KeepAliveBenchRun
+	{
+		int requests;
+		int connects;
+		int failed;
+		double ms;
+	};
+
+	/******************************************************************************
+	 * GPRS link through the modem, times a call home's requests
+	 ******************************************************************************/
+	class KeepAliveBenchLink
+	{
+	public:
+		KeepAliveBenchLink(double drop) : _drop(drop)
+		{}
+
+		void run(const std::vector<KeepAliveBenchRequest> &requests, bool keep_alive, KeepAliveBenchRun *result)
+		{
+			bool connected = false;
+
+			memset(result, 0, sizeof(*result));
+
+			for(size_t i = 0; i < requests.size(); i++)
+			{
+				const KeepAliveBenchRequest *req = &requests[i];
+
+				result->requests++;
+
+				// Kept connection gone, request is lost and resent on a new one
+				if(connected && next_rand() < _drop * 4294967296.0)
+				{
+					result->ms += send_ms(req->req_bytes) + KEEP_ALIVE_BENCH_RTT_MS;
+					result->failed++;
+					connected = false;
+				}
+
+				if(!connected)
+				{
+					result->ms += KEEP_ALIVE_BENCH_CONNECT_MS;
+					result->connects++;
+					connected = true;
+				}
+
+				result->ms += send_ms(req->req_bytes) + KEEP_ALIVE_BENCH_RTT_MS +
+					(KEEP_ALIVE_BENCH_RESP_HEADERS + req->resp_bytes) / KEEP_ALIVE_BENCH_DOWNLINK_BPMS;
+
+				if(!keep_alive)
+				{
+					result->ms += KEEP_ALIVE_BENCH_CLOSE_MS;
+					connected = false;
+				}
+			}
+
+			if(connected)
+				result->ms += KEEP_ALIVE_BENCH_CLOSE_MS;
+		}
+
+	private:
+		/** Request sent in HTTP_BODY_CHUNK_SIZE writes to the modem */
+		double send_ms(int body_bytes)
+		{
+			int bytes = KEEP_ALIVE_BENCH_REQ_HEADERS + body_bytes;
+			int writes = 1 + (body_bytes + HTTP_BODY_CHUNK_SIZE - 1) / HTTP_BODY_CHUNK_SIZE;
+
+			return writes * KEEP_ALIVE_BENCH_SEND_CMD_MS + bytes / KEEP_ALIVE_BENCH_UART_BPMS +
+				bytes / KEEP_ALIVE_BENCH_UPLINK_BPMS;
+		}
+
+		uint32_t next_rand()
+		{
+			_state = _state * 1664525 + 1013904223;
+			return _state;
+		}
+
+		double _drop;
+		uint32_t _state = 12345;
+	};
+
+	/******************************************************************************
+	 * Sink counting bytes, as sent to the modem
+	 ******************************************************************************/
+	class KeepAliveBenchCounter : public HttpBodySink
+	{
+	public:
+		using HttpBodySink::write;
+
+		RetResult write(const uint8_t *data, int size)
+		{
+			bytes += size;
+			return RET_OK;
+		}
+
+		int bytes = 0;
+	};
+
+	/******************************************************************************
+	 * Add telemetry requests of a store's backlog, a file per request as
+	 * CallHome::submit_stored_telemetry sends them
+	 ******************************************************************************/
+	template <typename TEntry, typename TBuilder>
+	RetResult keep_alive_bench_store(const char *path, int entries_per_file, int interval_sec,
+		std::vector<KeepAliveBenchRequest> *requests)
+	{
+		SPIFFS.format();
+		DataStoreManifest::unload_all();
+
+		DataStore<TEntry> store(path, entries_per_file);
+		TEntry entry;
+		int count = KEEP_ALIVE_BENCH_HOURS * 3600 / interval_sec;
+
+		for(int i = 0; i < count; i++)
+		{
+			NativeClock::advance_ms((uint64_t)interval_sec * 1000);
+			BenchData::fill(&entry, 1600000000 + i * interval_sec, i);
+			store.add(&entry);
+
+			if(store.commit() != RET_OK)
+			{
+				printf("Could not write backlog\n");
+				return RET_ERROR;
+			}
+		}
+
+		DataStoreReader<TEntry> reader(&store);
+		typename DataStore<TEntry>::Entry entries[DATA_STORE_READ_BLOCK_ENTRIES];
+		DataStoreSpan<TEntry> span(entries, DATA_STORE_READ_BLOCK_ENTRIES);
+		TelemetryJsonBody<TEntry, TBuilder> *body = new TelemetryJsonBody<TEntry, TBuilder>(&reader, &span);
+		RetResult ret = RET_OK;
+
+		while(reader.next_file())
+		{
+			while(body->begin(entries_per_file))
+			{
+				KeepAliveBenchCounter counter;
+				HttpBodyStream stream(&counter, true);
+
+				if(body->write(&stream) != RET_OK || stream.finish() != RET_OK)
+					ret = RET_ERROR;
+
+				KeepAliveBenchRequest req = {counter.bytes, 0};
+				requests->push_back(req);
+			}
+		}
+
+		delete body;
+
+		return ret;
+	}
+
+	/******************************************************************************
+	 * Benchmark keep-alive sessions
+	 ******************************************************************************/
+	RetResult keep_alive()
+	{
+		std::vector<KeepAliveBenchRequest> requests;
+		RetResult ret = RET_OK;
+
+		// Remote control and client attributes
+		KeepAliveBenchRequest rc = {0, KEEP_ALIVE_BENCH_RC_RESP};
+		KeepAliveBenchRequest attr = {KEEP_ALIVE_BENCH_ATTR_REQ, 0};
+		requests.push_back(rc);
+		requests.push_back(attr);
+
+		if(keep_alive_bench_store<WaterSensorData::Entry, TbWaterSensorDataJsonBuilder>(WATER_SENSOR_DATA_PATH,
+				WATER_SENSOR_DATA_ENTRIES_PER_SUBMIT_REQ, 600, &requests) != RET_OK ||
+			keep_alive_bench_store<Atmos41Data::Entry, TbAtmos41DataJsonBuilder>(ATMOS41_DATA_PATH,
+				ATMOS41_DATA_ENTRIES_PER_SUBMIT_REQ, 600, &requests) != RET_OK ||
+			keep_alive_bench_store<SoilMoistureData::Entry, TbSoilMoistureDataJsonBuilder>(SOIL_MOISTURE_DATA_PATH,
+				SOIL_MOISTURE_DATA_ENTRIES_PER_SUBMIT_REQ, 600, &requests) != RET_OK ||
+			keep_alive_bench_store<FoData::StoreEntry, TbFoDataJsonBuilder>(FO_DATA_STORE_PATH,
+				FO_DATA_STORE_ENTRIES_PER_SUBMIT_REQ, 1800, &requests) != RET_OK ||
+			keep_alive_bench_store<LightningData::Entry, TbLightningDataJsonBuilder>(LIGHTNING_DATA_PATH,
+				LIGHTNING_DATA_ENTRIES_PER_SUBMIT_REQ, 3600, &requests) != RET_OK ||
+			keep_alive_bench_store<Log::Entry, TbLogJsonBuilder>(LOG_DATA_PATH,
+				LOG_ENTRIES_PER_SUBMIT_REQ, 60, &requests) != RET_OK)
+		{
+			ret = RET_ERROR;
+		}
+
+		SPIFFS.format();
+
+		uint64_t body_bytes = 0;
+		for(size_t i = 0; i < requests.size(); i++)
+			body_bytes += requests[i].req_bytes;
+
+		printf("%d h backlog: %d requests, %.1f KiB of bodies. Connect %.0f ms, RTT %.0f ms\n\n",
+			KEEP_ALIVE_BENCH_HOURS, (int)requests.size(), body_bytes / 1024.0, KEEP_ALIVE_BENCH_CONNECT_MS,
+			KEEP_ALIVE_BENCH_RTT_MS);
+		printf("%-10s %5s | %8s %8s %6s | %9s %6s %7s\n", "mode", "drop", "requests", "connects", "failed",
+			"call home", "req/s", "speedup");
+
+		for(unsigned int i = 0; i < sizeof(KEEP_ALIVE_BENCH_DROP) / sizeof(KEEP_ALIVE_BENCH_DROP[0]); i++)
+		{
+			KeepAliveBenchRun runs[2];
+
+			for(int mode = 0; mode < 2; mode++)
+			{
+				KeepAliveBenchLink link(KEEP_ALIVE_BENCH_DROP[i]);
+				KeepAliveBenchRun *run = &runs[mode];
+
+				link.run(requests, mode == 1, run);
+
+				printf("%-10s %4.0f%% | %8d %8d %6d | %8.1fs %6.2f %6.2fx\n", mode == 1 ? "keep-alive" : "close",
+					KEEP_ALIVE_BENCH_DROP[i] * 100, run->requests, run->connects, run->failed, run->ms / 1000,
+					run->requests * 1000 / run->ms, runs[0].ms / run->ms);
+			}
+
+			// A session must never be slower than a connection per request
+			if(runs[1].ms > runs[0].ms || runs[0].connects != (int)requests.size())
+				ret = RET_ERROR;
+		}
+
+		return ret;
+	}
+} // Bench
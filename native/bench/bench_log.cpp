@@ -0,0 +1,168 @@
+#include "bench.h"
+#include "Arduino.h"
+#include "SPIFFS.h"
+#include "data_store.h"
+#include "data_store_reader.h"
+#include "log.h"
+#include "rom/rtc.h"
+
+/******************************************************************************
+ * Log write coalescing benchmark
+ * Wake cycles log a few entries each, with a call home every few cycles.
+ * Compared:
+ * - direct: an add + commit per log (as Log::log did before staging)
+ * - staged: Log::log, entries staged and written in batches
+ * A software reset is simulated halfway, staged entries must survive it.
+ * All logged entries must be in the store at the end.
+ ******************************************************************************/
+namespace Bench
+{
+	/** Wake cycles per run */
+	const int LOG_BENCH_CYCLES = 1000;
+
+	/** Logs per wake cycle (wake up, battery, env sensor, sleep...) */
+	const int LOG_BENCH_LOGS_PER_CYCLE = 6;
+
+	/** Seconds between wake cycles */
+	const int LOG_BENCH_CYCLE_SEC = 600;
+
+	/** Cycles between call homes */
+	const int LOG_BENCH_CALL_HOME_CYCLES = 36;
+
+	/** Path of store for direct writes, Log uses its own */
+	const char *LOG_BENCH_DIRECT_PATH = "/logd";
+
+	/** Result of a single run */
+	struct LogResult
+	{
+		uint64_t log_us;
+		NativeFs::Stats write_stats;
+		int stored;
+	};
+
+	/******************************************************************************
+	 * Count entries in a store
+	 ******************************************************************************/
+	int count_log_entries(DataStore<Log::Entry> *store)
+	{
+		DataStoreReader<Log::Entry> reader(store);
+		int count = 0;
+
+		while(reader.next_file())
+		{
+			while(reader.next_entry())
+				count++;
+		}
+
+		return count;
+	}
+
+	/******************************************************************************
+	 * Run wake cycles, logging directly to a store or through Log
+	 ******************************************************************************/
+	RetResult bench_log_run(bool staged, int cycles, LogResult *result)
+	{
+		memset(result, 0, sizeof(*result));
+
+		SPIFFS.format();
+		DataStoreManifest::unload_all();
+		NativeFs::reset_stats();
+
+		DataStore<Log::Entry> direct_store(LOG_BENCH_DIRECT_PATH, LOG_ENTRIES_PER_SUBMIT_REQ);
+		Log::Entry entry = {0};
+
+		if(staged)
+			Log::begin();
+
+		for(int cycle = 0; cycle < cycles; cycle++)
+		{
+			NativeClock::advance_ms((uint64_t)LOG_BENCH_CYCLE_SEC * 1000);
+
+			// Reset, stage must be kept
+			if(staged && cycle == cycles / 2)
+			{
+				native_set_reset_reason(SW_CPU_RESET);
+				Log::begin();
+			}
+
+			uint64_t t_start = now_us();
+
+			for(int i = 0; i < LOG_BENCH_LOGS_PER_CYCLE; i++)
+			{
+				if(staged)
+				{
+					Log::log(Log::BATTERY, cycle, i);
+				}
+				else
+				{
+					entry.timestamp = time(NULL) * 1000LL + i;
+					entry.code = Log::BATTERY;
+					entry.meta1 = cycle;
+					entry.meta2 = i;
+
+					direct_store.add(&entry);
+					direct_store.commit();
+				}
+			}
+
+			// Staged logs are written before submitting
+			if(staged && (cycle + 1) % LOG_BENCH_CALL_HOME_CYCLES == 0)
+				Log::commit();
+
+			result->log_us += now_us() - t_start;
+		}
+
+		result->write_stats = *NativeFs::get_stats();
+
+		if(staged)
+		{
+			Log::commit();
+			result->stored = count_log_entries(Log::get_store());
+		}
+		else
+		{
+			result->stored = count_log_entries(&direct_store);
+		}
+
+		native_set_reset_reason(POWERON_RESET);
+
+		if(result->stored != cycles * LOG_BENCH_LOGS_PER_CYCLE)
+		{
+			printf("Stored %d/%d log entries\n", result->stored, cycles * LOG_BENCH_LOGS_PER_CYCLE);
+			return RET_ERROR;
+		}
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * Compare direct and staged logging
+	 ******************************************************************************/
+	RetResult log_stage()
+	{
+		int cycles = get_max_entries() / LOG_BENCH_LOGS_PER_CYCLE;
+		if(cycles > LOG_BENCH_CYCLES)
+			cycles = LOG_BENCH_CYCLES;
+
+		printf("Cycles: %d, logs/cycle: %d, call home every %d cycles, stage: %d entries, flush at %d\n",
+			cycles, LOG_BENCH_LOGS_PER_CYCLE, LOG_BENCH_CALL_HOME_CYCLES, LOG_STAGE_CAPACITY,
+			LOG_STAGE_FLUSH_ENTRIES);
+		printf("%7s | %8s %10s %10s %12s | %10s\n", "mode", "writes", "written", "pages", "writes/cycle", "log us");
+
+		for(int mode = 0; mode < 2; mode++)
+		{
+			LogResult res;
+			if(bench_log_run(mode == 1, cycles, &res) != RET_OK)
+				return RET_ERROR;
+
+			printf("%7s | %8u %10llu %10llu %12.2f | %10llu\n", mode == 1 ? "staged" : "direct",
+				res.write_stats.write_calls, (unsigned long long)res.write_stats.bytes_written,
+				(unsigned long long)res.write_stats.pages_programmed,
+				(double)res.write_stats.write_calls / cycles, (unsigned long long)res.log_us);
+		}
+
+		SPIFFS.format();
+
+		return RET_OK;
+	}
+} // Bench
@@ -0,0 +1,386 @@
+#include "bench.h"
+#include "bench_data.h"
+#include "Arduino.h"
+#include "SPIFFS.h"
+#include "data_store.h"
+#include "data_store_reader.h"
+#include "http_body.h"
+#include "upload_pipeline.h"
+#include "telemetry_upload.h"
+#include "merged_telemetry_body.h"
+#include "store_telemetry_stream.h"
+#include "tb_water_sensor_data_json_builder.h"
+#include "tb_atmos41_data_json_builder.h"
+#include "tb_soil_moisture_data_json_builder.h"
+#include "tb_lightning_data_json_builder.h"
+#include "tb_fo_data_json_builder.h"
+#include "tb_sdi12_log_json_builder.h"
+#include <set>
+#include <string>
+#include <string.h>
+#include <zlib.h>
+
+/******************************************************************************
+ * Merged multi-store requests
+ * A mixed backlog of a station is submitted. Water, Atmos41 and soil
+ * moisture are measured every 10 min, FO data every 30 min and there is a
+ * lightning event now and then, SDI12 debug logs are off (empty store):
+ * - stores: a store at a time, TelemetryUpload::submit_store each
+ * - merged: TelemetryUpload::submit_merged, every store in the same requests
+ *   in time order, values of a timestamp joined in an object
+ * - merged gzip: the same, bodies gzip compressed
+ * Stores measured on the same wake share timestamps (aligned), or are a few
+ * seconds apart (skewed), when nothing can be joined.
+ * Every entry must have been received once and the stores left empty,
+ * compressed bodies are inflated with zlib to check them.
+ * Reports requests, ts objects, body bytes and bytes on air incl. request
+ * and response headers.
+ ******************************************************************************/
+namespace Bench
+{
+	/** 10 min slots in backlog, 2 days */
+	const int MERGED_BENCH_SLOTS = 288;
+
+	/** Request and response headers */
+	const int MERGED_BENCH_REQ_HEADERS = 180;
+	const int MERGED_BENCH_RESP_HEADERS = 150;
+
+	/** Key prefixes of stores, an entry of a store is found by its keys */
+	const char *MERGED_BENCH_PREFIXES[] = {"\"s_", "\"ws_", "\"sm_", "\"fo_", "\"li_"};
+	const int MERGED_BENCH_PREFIX_COUNT = sizeof(MERGED_BENCH_PREFIXES) / sizeof(MERGED_BENCH_PREFIXES[0]);
+
+	/******************************************************************************
+	 * Decompress a gzip body with zlib
+	 * @return False if not valid gzip
+	 ******************************************************************************/
+	bool merged_bench_gunzip(const std::string &gzip, std::string *plain)
+	{
+		uint8_t out[4096];
+		z_stream stream;
+		memset(&stream, 0, sizeof(stream));
+
+		if(inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK)
+			return false;
+
+		stream.next_in = (Bytef*)gzip.data();
+		stream.avail_in = gzip.size();
+
+		plain->clear();
+		int ret = Z_OK;
+
+		while(ret == Z_OK)
+		{
+			stream.next_out = out;
+			stream.avail_out = sizeof(out);
+
+			ret = inflate(&stream, Z_NO_FLUSH);
+			plain->append((const char*)out, sizeof(out) - stream.avail_out);
+		}
+
+		inflateEnd(&stream);
+
+		return ret == Z_STREAM_END && stream.avail_in == 0;
+	}
+
+	/******************************************************************************
+	 * Socket acting as the server, keeps the store and timestamp of every entry
+	 * received. Compressed bodies are inflated first, those that can't be are
+	 * counted as invalid.
+	 ******************************************************************************/
+	class MergedBenchSocket : public UploadSocket, public HttpBodySink
+	{
+	public:
+		RetResult send(const char *path, HttpBodyWriter *body, const char *content_type)
+		{
+			_body.clear();
+
+			if(body->write(this) != RET_OK)
+				return RET_ERROR;
+
+			requests++;
+			body_bytes += _body.size();
+			_pending = true;
+
+			return RET_OK;
+		}
+
+		using HttpBodySink::write;
+
+		RetResult write(const uint8_t *data, int size)
+		{
+			_body.append((const char*)data, size);
+			return RET_OK;
+		}
+
+		int read_response()
+		{
+			if(!_pending)
+				return 0;
+
+			_pending = false;
+
+			std::string plain;
+
+			if(body->get_content_encoding() == NULL)
+			{
+				plain = _body;
+			}
+			else if(!merged_bench_gunzip(_body, &plain))
+			{
+				invalid_bodies++;
+				return 200;
+			}
+
+			size_t pos = plain.find("{\"ts\":");
+
+			while(pos != std::string::npos)
+			{
+				size_t next = plain.find("{\"ts\":", pos + 1);
+				std::string object = plain.substr(pos, next == std::string::npos ? std::string::npos : next - pos);
+				std::string tstamp = object.substr(6, object.find(',') - 6);
+
+				objects++;
+
+				for(int i = 0; i < MERGED_BENCH_PREFIX_COUNT; i++)
+				{
+					if(object.find(MERGED_BENCH_PREFIXES[i]) == std::string::npos)
+						continue;
+
+					if(!received.insert(std::to_string(i) + "@" + tstamp).second)
+						duplicates++;
+				}
+
+				pos = next;
+			}
+
+			return 200;
+		}
+
+		/** Body of last request */
+		HttpBodyWriter *body = NULL;
+
+		int requests = 0;
+		int objects = 0;
+		uint64_t body_bytes = 0;
+		int duplicates = 0;
+		std::set<std::string> received;
+
+		/** Compressed bodies that couldn't be inflated */
+		int invalid_bodies = 0;
+
+	private:
+		bool _pending = false;
+		std::string _body;
+	};
+
+	/******************************************************************************
+	 * Socket keeping the body it is sent, to tell compressed ones
+	 ******************************************************************************/
+	class MergedBenchBodySocket : public UploadSocket
+	{
+	public:
+		MergedBenchBodySocket(MergedBenchSocket *socket) : _socket(socket)
+		{}
+
+		RetResult send(const char *path, HttpBodyWriter *body, const char *content_type)
+		{
+			_socket->body = body;
+			return _socket->send(path, body, content_type);
+		}
+
+		int read_response()
+		{
+			return _socket->read_response();
+		}
+
+	private:
+		MergedBenchSocket *_socket;
+	};
+
+	/******************************************************************************
+	 * Add an entry to a store, committed as after a measurement
+	 ******************************************************************************/
+	template <typename TEntry>
+	void merged_bench_add(DataStore<TEntry> *store, uint32_t tstamp, int seq)
+	{
+		TEntry entry;
+		BenchData::fill(&entry, tstamp, seq);
+		store->add(&entry);
+		store->commit();
+	}
+
+	/******************************************************************************
+	 * Check if a store has entries left to submit
+	 ******************************************************************************/
+	template <typename TEntry>
+	bool merged_bench_has_entries(DataStore<TEntry> *store)
+	{
+		DataStoreReader<TEntry> reader(store);
+
+		while(reader.next_file())
+		{
+			if(reader.next_entry() != NULL)
+				return true;
+		}
+
+		return false;
+	}
+
+	/******************************************************************************
+	 * Build the backlog and submit it in a mode
+	 * @param mode 0: a store at a time, 1: merged, 2: merged gzip
+	 * @param skew Seconds Atmos41 and soil moisture are measured after water
+	 * @param entries Entries in backlog (output var)
+	 ******************************************************************************/
+	RetResult merged_bench_run(const char *scenario, int mode, int skew, int slots, int *entries)
+	{
+		SPIFFS.format();
+		DataStoreManifest::unload_all();
+
+		DataStore<WaterSensorData::Entry> water(WATER_SENSOR_DATA_PATH, WATER_SENSOR_DATA_ENTRIES_PER_SUBMIT_REQ);
+		DataStore<Atmos41Data::Entry> atmos41(ATMOS41_DATA_PATH, ATMOS41_DATA_ENTRIES_PER_SUBMIT_REQ);
+		DataStore<SoilMoistureData::Entry> soil(SOIL_MOISTURE_DATA_PATH, SOIL_MOISTURE_DATA_ENTRIES_PER_SUBMIT_REQ);
+		DataStore<FoData::StoreEntry> fo(FO_DATA_STORE_PATH, FO_DATA_STORE_ENTRIES_PER_SUBMIT_REQ);
+		DataStore<LightningData::Entry> lightning(LIGHTNING_DATA_PATH, LIGHTNING_DATA_ENTRIES_PER_SUBMIT_REQ);
+		DataStore<SDI12Log::Entry> sdi12(SDI12_LOG_DATA_PATH, 8);
+
+		*entries = 0;
+
+		for(int i = 0; i < slots; i++)
+		{
+			uint32_t tstamp = 1600000000 + i * 600;
+
+			// File names come from the clock
+			NativeClock::advance_ms(600 * 1000);
+
+			merged_bench_add(&water, tstamp, i);
+			merged_bench_add(&atmos41, tstamp + skew, i);
+			merged_bench_add(&soil, tstamp + skew * 2, i);
+			*entries += 3;
+
+			if(i % 3 == 0)
+			{
+				merged_bench_add(&fo, tstamp, i);
+				(*entries)++;
+			}
+
+			if(i % 37 == 5)
+			{
+				merged_bench_add(&lightning, tstamp + 123, i);
+				(*entries)++;
+			}
+		}
+
+		MergedBenchSocket socket;
+		MergedBenchBodySocket body_socket(&socket);
+		UploadSocket *sockets[] = {&body_socket};
+		UploadPipeline pipeline(sockets, 1);
+		const char *path = "/api/v1/token/telemetry";
+		RetResult ret = RET_OK;
+
+		if(mode == 0)
+		{
+			if(TelemetryUpload::submit_store<WaterSensorData::Entry, TbWaterSensorDataJsonBuilder>(&water, &pipeline,
+					path, 0, false, NULL) != RET_OK ||
+				TelemetryUpload::submit_store<Atmos41Data::Entry, TbAtmos41DataJsonBuilder>(&atmos41, &pipeline,
+					path, 0, false, NULL) != RET_OK ||
+				TelemetryUpload::submit_store<SoilMoistureData::Entry, TbSoilMoistureDataJsonBuilder>(&soil, &pipeline,
+					path, 0, false, NULL) != RET_OK ||
+				TelemetryUpload::submit_store<FoData::StoreEntry, TbFoDataJsonBuilder>(&fo, &pipeline,
+					path, 0, false, NULL) != RET_OK ||
+				TelemetryUpload::submit_store<LightningData::Entry, TbLightningDataJsonBuilder>(&lightning, &pipeline,
+					path, 0, false, NULL) != RET_OK ||
+				TelemetryUpload::submit_store<SDI12Log::Entry, TbSDI12LogJsonBuilder>(&sdi12, &pipeline,
+					path, 0, false, NULL) != RET_OK)
+			{
+				ret = RET_ERROR;
+			}
+		}
+		else
+		{
+			TelemetryStream *streams[] = {
+				new StoreTelemetryStream<WaterSensorData::Entry, TbWaterSensorDataJsonBuilder>(&water),
+				new StoreTelemetryStream<Atmos41Data::Entry, TbAtmos41DataJsonBuilder>(&atmos41),
+				new StoreTelemetryStream<SoilMoistureData::Entry, TbSoilMoistureDataJsonBuilder>(&soil),
+				new StoreTelemetryStream<FoData::StoreEntry, TbFoDataJsonBuilder>(&fo),
+				new StoreTelemetryStream<LightningData::Entry, TbLightningDataJsonBuilder>(&lightning),
+				new StoreTelemetryStream<SDI12Log::Entry, TbSDI12LogJsonBuilder>(&sdi12)
+			};
+			int stream_count = sizeof(streams) / sizeof(streams[0]);
+
+			if(TelemetryUpload::submit_merged(streams, stream_count, &pipeline, path, mode == 2, NULL) != RET_OK)
+				ret = RET_ERROR;
+
+			for(int i = 0; i < stream_count; i++)
+				delete streams[i];
+		}
+
+		const char *modes[] = {"stores", "merged", "merged gzip"};
+		uint64_t on_air = socket.body_bytes + (uint64_t)socket.requests *
+			(MERGED_BENCH_REQ_HEADERS + MERGED_BENCH_RESP_HEADERS);
+
+		// Objects aren't known when a body couldn't be inflated
+		char objects[16] = "-";
+		if(socket.invalid_bodies == 0)
+			snprintf(objects, sizeof(objects), "%d", socket.objects);
+
+		printf("%8s | %-11s | %8d %8s | %9llu %9llu %7.1f\n", scenario, modes[mode], socket.requests,
+			objects, (unsigned long long)socket.body_bytes, (unsigned long long)on_air,
+			(double)on_air / *entries);
+
+		if(merged_bench_has_entries(&water) || merged_bench_has_entries(&atmos41) ||
+			merged_bench_has_entries(&soil) || merged_bench_has_entries(&fo) ||
+			merged_bench_has_entries(&lightning))
+		{
+			printf("Entries left in stores\n");
+			ret = RET_ERROR;
+		}
+
+		if(socket.invalid_bodies > 0)
+		{
+			printf("%d compressed bodies not valid gzip\n", socket.invalid_bodies);
+			ret = RET_ERROR;
+		}
+
+		if((int)socket.received.size() != *entries || socket.duplicates > 0)
+		{
+			printf("Received %d/%d entries, %d twice\n", (int)socket.received.size(), *entries, socket.duplicates);
+			ret = RET_ERROR;
+		}
+
+		return ret;
+	}
+
+	/******************************************************************************
+	 * Benchmark merged multi-store requests
+	 ******************************************************************************/
+	RetResult merged()
+	{
+		int slots = get_max_entries() / 3 < MERGED_BENCH_SLOTS ? get_max_entries() / 3 : MERGED_BENCH_SLOTS;
+		int entries = 0;
+		RetResult ret = RET_OK;
+
+		printf("%d slots of 10 min, budget %d B/request, headers %d B/request\n\n", slots, TELEMETRY_REQ_BODY_BUDGET,
+			MERGED_BENCH_REQ_HEADERS + MERGED_BENCH_RESP_HEADERS);
+		printf("%8s | %-11s | %8s %8s | %9s %9s %7s\n", "backlog", "mode", "requests", "objects", "body B",
+			"on air B", "B/entry");
+
+		const char *scenarios[] = {"aligned", "skewed"};
+		int skews[] = {0, 3};
+
+		for(int i = 0; i < 2; i++)
+		{
+			for(int mode = 0; mode < 3; mode++)
+			{
+				if(merged_bench_run(scenarios[i], mode, skews[i], slots, &entries) != RET_OK)
+					ret = RET_ERROR;
+			}
+		}
+
+		printf("\n%d entries per backlog\n", entries);
+
+		SPIFFS.format();
+
+		return ret;
+	}
+} // Bench
@@ -0,0 +1,252 @@
+#include "bench.h"
+#include "bench_data.h"
+#include "Arduino.h"
+#include "SPIFFS.h"
+#include "data_store.h"
+#include "data_store_reader.h"
+#include "http_body.h"
+#include "telemetry_json_body.h"
+#include "upload_pipeline.h"
+#include "telemetry_upload.h"
+#include "tb_water_sensor_data_json_builder.h"
+#include "tb_atmos41_data_json_builder.h"
+#include "tb_fo_data_json_builder.h"
+#include "tb_log_json_builder.h"
+#include <set>
+#include <string>
+
+/******************************************************************************
+ * Packed requests
+ * A backlog of small files (as left by commits on every entry and reboots)
+ * and of files of the firmware's size is submitted:
+ * - file: a request per file, as call home did
+ * - packed: TelemetryUpload::submit_store, entries of several files packed in
+ *   a request up to TELEMETRY_REQ_BODY_BUDGET bytes
+ * Every entry must have been received once and the store must be left empty
+ * (every covered file deleted).
+ * Reports requests, body bytes per request, bytes on air incl. request and
+ * response headers and the drop in requests.
+ ******************************************************************************/
+namespace Bench
+{
+	/** Backlog per run */
+	const int PACKING_BENCH_ENTRIES = 1000;
+
+	/** Request and response headers */
+	const int PACKING_BENCH_REQ_HEADERS = 180;
+	const int PACKING_BENCH_RESP_HEADERS = 150;
+
+	/******************************************************************************
+	 * Socket acting as the server, keeps timestamps of entries received
+	 ******************************************************************************/
+	class PackingBenchSocket : public UploadSocket, public HttpBodySink
+	{
+	public:
+		RetResult send(const char *path, HttpBodyWriter *body, const char *content_type)
+		{
+			_body.clear();
+
+			if(body->write(this) != RET_OK)
+				return RET_ERROR;
+
+			requests++;
+			body_bytes += _body.size();
+			_pending = true;
+
+			return RET_OK;
+		}
+
+		using HttpBodySink::write;
+
+		RetResult write(const uint8_t *data, int size)
+		{
+			_body.append((const char*)data, size);
+			return RET_OK;
+		}
+
+		int read_response()
+		{
+			if(!_pending)
+				return 0;
+
+			_pending = false;
+
+			size_t pos = 0;
+			while((pos = _body.find("\"ts\":", pos)) != std::string::npos)
+			{
+				pos += 5;
+
+				if(!received.insert(_body.substr(pos, _body.find_first_of(",}", pos) - pos)).second)
+					duplicates++;
+			}
+
+			return 200;
+		}
+
+		int requests = 0;
+		uint64_t body_bytes = 0;
+		int duplicates = 0;
+		std::set<std::string> received;
+
+	private:
+		bool _pending = false;
+		std::string _body;
+	};
+
+	/******************************************************************************
+	 * Check if a store has entries left to submit
+	 ******************************************************************************/
+	template <typename TEntry>
+	bool packing_bench_has_entries(DataStore<TEntry> *store)
+	{
+		DataStoreReader<TEntry> reader(store);
+
+		while(reader.next_file())
+		{
+			if(reader.next_entry() != NULL)
+				return true;
+		}
+
+		return false;
+	}
+
+	/******************************************************************************
+	 * Print a run
+	 ******************************************************************************/
+	void packing_bench_print(const char *name, int entries_per_file, const char *mode, PackingBenchSocket *socket,
+		int file_requests)
+	{
+		uint64_t on_air = socket->body_bytes + (uint64_t)socket->requests *
+			(PACKING_BENCH_REQ_HEADERS + PACKING_BENCH_RESP_HEADERS);
+
+		printf("%16s %4d | %-6s | %8d %8.1f | %9llu %7.1f | %6.2fx\n", name, entries_per_file, mode, socket->requests,
+			(double)socket->body_bytes / socket->requests, (unsigned long long)on_air,
+			(double)on_air / socket->received.size(), (double)file_requests / socket->requests);
+	}
+
+	/******************************************************************************
+	 * Run a type with a file size
+	 ******************************************************************************/
+	template <typename TEntry, typename TBuilder>
+	RetResult packing_bench_run(const char *name, const char *path, int entries_per_file, int interval_sec, int count)
+	{
+		SPIFFS.format();
+		DataStoreManifest::unload_all();
+
+		DataStore<TEntry> store(path, entries_per_file);
+		TEntry entry;
+
+		for(int i = 0; i < count; i++)
+		{
+			// File names come from the clock
+			NativeClock::advance_ms((uint64_t)interval_sec * 1000);
+
+			BenchData::fill(&entry, 1600000000 + i * interval_sec, i);
+			store.add(&entry);
+
+			if(store.commit() != RET_OK)
+			{
+				printf("Could not write backlog\n");
+				return RET_ERROR;
+			}
+		}
+
+		RetResult ret = RET_OK;
+
+		// A request per file, nothing deleted
+		PackingBenchSocket file_socket;
+		{
+			DataStoreReader<TEntry> reader(&store);
+			typename DataStore<TEntry>::Entry entries[DATA_STORE_READ_BLOCK_ENTRIES];
+			DataStoreSpan<TEntry> span(entries, DATA_STORE_READ_BLOCK_ENTRIES);
+			TelemetryJsonBody<TEntry, TBuilder> *body = new TelemetryJsonBody<TEntry, TBuilder>(&reader, &span);
+
+			while(reader.next_file())
+			{
+				if(!body->begin(store.get_max_entries_per_file()))
+					continue;
+
+				file_socket.send(path, body, "application/json");
+				file_socket.read_response();
+			}
+
+			delete body;
+		}
+
+		// Packed, a call home
+		PackingBenchSocket packed_socket;
+		UploadSocket *sockets[] = {&packed_socket};
+		UploadPipeline pipeline(sockets, 1);
+
+		if(TelemetryUpload::submit_store<TEntry, TBuilder>(&store, &pipeline, "/api/v1/token/telemetry", 0, false,
+			NULL) != RET_OK)
+		{
+			ret = RET_ERROR;
+		}
+
+		packing_bench_print(name, entries_per_file, "file", &file_socket, file_socket.requests);
+		packing_bench_print(name, entries_per_file, "packed", &packed_socket, file_socket.requests);
+
+		if((int)file_socket.received.size() != count || (int)packed_socket.received.size() != count ||
+			packed_socket.duplicates > 0 || packing_bench_has_entries(&store))
+		{
+			printf("Received %d/%d entries, %d twice\n", (int)packed_socket.received.size(), count,
+				packed_socket.duplicates);
+			ret = RET_ERROR;
+		}
+
+		return ret;
+	}
+
+	/******************************************************************************
+	 * Benchmark packed requests
+	 ******************************************************************************/
+	RetResult packing()
+	{
+		int count = get_max_entries() < PACKING_BENCH_ENTRIES ? get_max_entries() : PACKING_BENCH_ENTRIES;
+		RetResult ret = RET_OK;
+
+		printf("%d entries per run, budget %d B/request, headers %d B/request\n\n", count, TELEMETRY_REQ_BODY_BUDGET,
+			PACKING_BENCH_REQ_HEADERS + PACKING_BENCH_RESP_HEADERS);
+		printf("%16s %4s | %-6s | %8s %8s | %9s %7s | %7s\n", "type", "file", "mode", "requests", "B/req",
+			"on air B", "B/entry", "drop");
+
+		int file_sizes[][4] = {
+			{1, 1, 1, 1},
+			{3, 3, 3, 3},
+			{WATER_SENSOR_DATA_ENTRIES_PER_SUBMIT_REQ, ATMOS41_DATA_ENTRIES_PER_SUBMIT_REQ,
+				FO_DATA_STORE_ENTRIES_PER_SUBMIT_REQ, LOG_ENTRIES_PER_SUBMIT_REQ}
+		};
+
+		for(int i = 0; i < 3; i++)
+		{
+			if(packing_bench_run<WaterSensorData::Entry, TbWaterSensorDataJsonBuilder>("WaterSensorData",
+				WATER_SENSOR_DATA_PATH, file_sizes[i][0], 600, count) != RET_OK)
+			{
+				ret = RET_ERROR;
+			}
+
+			if(packing_bench_run<Atmos41Data::Entry, TbAtmos41DataJsonBuilder>("Atmos41Data",
+				ATMOS41_DATA_PATH, file_sizes[i][1], 600, count) != RET_OK)
+			{
+				ret = RET_ERROR;
+			}
+
+			if(packing_bench_run<FoData::StoreEntry, TbFoDataJsonBuilder>("FoData",
+				FO_DATA_STORE_PATH, file_sizes[i][2], 1800, count) != RET_OK)
+			{
+				ret = RET_ERROR;
+			}
+
+			if(packing_bench_run<Log::Entry, TbLogJsonBuilder>("Log",
+				LOG_DATA_PATH, file_sizes[i][3], 60, count) != RET_OK)
+			{
+				ret = RET_ERROR;
+			}
+		}
+
+		SPIFFS.format();
+
+		return ret;
+	}
+} // Bench
@@ -0,0 +1,346 @@
+#include "bench.h"
+#include "bench_data.h"
+#include "Arduino.h"
+#include "SPIFFS.h"
+#include "data_store.h"
+#include "data_store_reader.h"
+#include "http_body.h"
+#include "upload_pipeline.h"
+#include "telemetry_upload.h"
+#include "tb_water_sensor_data_json_builder.h"
+#include "tb_fo_data_json_builder.h"
+#include <set>
+#include <string>
+
+/******************************************************************************
+ * Pipelined uploads
+ * A backlog is submitted with TelemetryUpload::submit_store over an upload
+ * pipeline of 1 (a request at a time) to UPLOAD_PIPELINE_MAX_SOCKETS sockets
+ * of a modem emulator. The emulator times AT send commands over the UART, a
+ * shared GPRS uplink behind the modem's TX buffer, server round trips and
+ * response reads, and fails responses at random (connection dropped). Call
+ * homes run until the backlog is empty, every entry must have been received
+ * in a successful request and nothing must be left in the store.
+ * Reports requests, failed ones, connections, time and requests/s.
+ ******************************************************************************/
+namespace Bench
+{
+	/** Backlog per run */
+	const int PIPELINE_BENCH_ENTRIES = 1000;
+
+	/** Call homes before giving up on emptying the backlog */
+	const int PIPELINE_BENCH_MAX_SESSIONS = 100;
+
+	/** AT+CIPSTART and TCP handshake */
+	const double PIPELINE_BENCH_CONNECT_MS = 2500;
+
+	/** Round trip incl. server time */
+	const double PIPELINE_BENCH_RTT_MS = 800;
+
+	/** GPRS up/downlink and modem UART, bytes per ms */
+	const double PIPELINE_BENCH_UPLINK_BPMS = 20000 / 8 / 1000.0;
+	const double PIPELINE_BENCH_DOWNLINK_BPMS = 40000 / 8 / 1000.0;
+	const double PIPELINE_BENCH_UART_BPMS = 115200 / 10 / 1000.0;
+
+	/** AT command round per send or read */
+	const double PIPELINE_BENCH_CMD_MS = 40;
+
+	/** Bytes the modem buffers for the uplink before send commands block */
+	const double PIPELINE_BENCH_MODEM_TX_BUFFER = 4096;
+
+	/** Request and response headers */
+	const int PIPELINE_BENCH_REQ_HEADERS = 180;
+	const int PIPELINE_BENCH_RESP_HEADERS = 150;
+
+	/** Chance a response is lost */
+	const double PIPELINE_BENCH_FAIL[] = {0, 0.05};
+
+	/******************************************************************************
+	 * Modem state shared by its sockets: clock, uplink and what the server got
+	 ******************************************************************************/
+	class PipelineBenchModem
+	{
+	public:
+		PipelineBenchModem(double fail) : _fail(fail)
+		{}
+
+		/******************************************************************************
+		 * Write bytes to the modem with a send command, they are queued for the
+		 * uplink. Blocks while its TX buffer is full.
+		 ******************************************************************************/
+		void send(int bytes)
+		{
+			double buffered_ms = PIPELINE_BENCH_MODEM_TX_BUFFER / PIPELINE_BENCH_UPLINK_BPMS;
+
+			if(uplink_free - buffered_ms > now)
+				now = uplink_free - buffered_ms;
+
+			now += PIPELINE_BENCH_CMD_MS + bytes / PIPELINE_BENCH_UART_BPMS;
+
+			if(uplink_free < now)
+				uplink_free = now;
+
+			uplink_free += bytes / PIPELINE_BENCH_UPLINK_BPMS;
+		}
+
+		bool next_fails()
+		{
+			_state = _state * 1664525 + 1013904223;
+			return _state < _fail * 4294967296.0;
+		}
+
+		/** Clock and time uplink is done with what's queued, ms */
+		double now = 0;
+		double uplink_free = 0;
+
+		int requests = 0;
+		int failed = 0;
+		int connects = 0;
+
+		/** Timestamps of entries received in successful requests */
+		std::set<std::string> received;
+
+	private:
+		double _fail;
+		uint32_t _state = 12345;
+	};
+
+	/******************************************************************************
+	 * Socket of the modem emulator
+	 ******************************************************************************/
+	class PipelineBenchSocket : public UploadSocket, public HttpBodySink
+	{
+	public:
+		PipelineBenchSocket(PipelineBenchModem *modem) : _modem(modem)
+		{}
+
+		RetResult send(const char *path, HttpBodyWriter *body, const char *content_type)
+		{
+			if(!_connected)
+			{
+				_modem->now += PIPELINE_BENCH_CONNECT_MS;
+				_modem->connects++;
+				_connected = true;
+			}
+
+			_modem->requests++;
+			_modem->send(PIPELINE_BENCH_REQ_HEADERS);
+
+			// Sent unframed so the server can read it as is, chunk framing adds ~2%
+			_body.clear();
+			HttpBodyStream stream(this, false);
+
+			if(body->write(&stream) != RET_OK || stream.finish() != RET_OK)
+				return RET_ERROR;
+
+			_response_at = _modem->uplink_free + PIPELINE_BENCH_RTT_MS +
+				PIPELINE_BENCH_RESP_HEADERS / PIPELINE_BENCH_DOWNLINK_BPMS;
+			_pending = true;
+
+			return RET_OK;
+		}
+
+		using HttpBodySink::write;
+
+		RetResult write(const uint8_t *data, int size)
+		{
+			_body.append((const char*)data, size);
+			_modem->send(size);
+			return RET_OK;
+		}
+
+		int read_response()
+		{
+			if(!_pending)
+				return 0;
+
+			_pending = false;
+
+			if(_modem->now < _response_at)
+				_modem->now = _response_at;
+
+			if(_modem->next_fails())
+			{
+				_modem->failed++;
+				_connected = false;
+				return 0;
+			}
+
+			_modem->now += PIPELINE_BENCH_CMD_MS + PIPELINE_BENCH_RESP_HEADERS / PIPELINE_BENCH_UART_BPMS;
+
+			// Server got the request, only timestamps are looked at
+			size_t pos = 0;
+			while((pos = _body.find("\"ts\":", pos)) != std::string::npos)
+			{
+				pos += 5;
+				_modem->received.insert(_body.substr(pos, _body.find_first_of(",}", pos) - pos));
+			}
+
+			return 200;
+		}
+
+	private:
+		PipelineBenchModem *_modem;
+		bool _connected = false;
+		bool _pending = false;
+		double _response_at = 0;
+		std::string _body;
+	};
+
+	/******************************************************************************
+	 * Check if a store has entries left to submit
+	 ******************************************************************************/
+	template <typename TEntry>
+	bool pipeline_bench_has_entries(DataStore<TEntry> *store)
+	{
+		DataStoreReader<TEntry> reader(store);
+
+		while(reader.next_file())
+		{
+			if(reader.next_entry() != NULL)
+				return true;
+		}
+
+		return false;
+	}
+
+	/** Result of a run */
+	struct PipelineBenchRun
+	{
+		int sessions;
+		int requests;
+		int failed;
+		int connects;
+		double ms;
+	};
+
+	/******************************************************************************
+	 * Submit a whole backlog in call homes over a pipeline of some sockets
+	 * @return RET_ERROR if backlog not emptied or entries missing on server
+	 ******************************************************************************/
+	template <typename TEntry, typename TBuilder>
+	RetResult pipeline_bench_run(const char *path, int entries_per_file, int interval_sec,
+		const DataStore<TEntry> *firmware_store, int socket_count, double fail, int count, PipelineBenchRun *result)
+	{
+		SPIFFS.format();
+		DataStoreManifest::unload_all();
+
+		int layout_field_count = 0;
+		const DataStoreCodec::Field *layout = firmware_store->get_encoding(&layout_field_count);
+
+		DataStore<TEntry> store(path, entries_per_file, layout, layout_field_count);
+		TEntry entry;
+
+		for(int i = 0; i < count; i++)
+		{
+			NativeClock::advance_ms((uint64_t)interval_sec * 1000);
+			BenchData::fill(&entry, 1600000000 + i * interval_sec, i);
+			store.add(&entry);
+			store.commit();
+		}
+
+		PipelineBenchModem modem(fail);
+
+		for(result->sessions = 0; result->sessions < PIPELINE_BENCH_MAX_SESSIONS &&
+			pipeline_bench_has_entries(&store); result->sessions++)
+		{
+			// New connections every call home
+			PipelineBenchSocket *sockets[UPLOAD_PIPELINE_MAX_SOCKETS];
+			UploadSocket *upload_sockets[UPLOAD_PIPELINE_MAX_SOCKETS];
+
+			for(int i = 0; i < socket_count; i++)
+			{
+				sockets[i] = new PipelineBenchSocket(&modem);
+				upload_sockets[i] = sockets[i];
+			}
+
+			UploadPipeline pipeline(upload_sockets, socket_count);
+
+			TelemetryUpload::submit_store<TEntry, TBuilder>(&store, &pipeline, "/api/v1/token/telemetry", 0, false, NULL);
+
+			for(int i = 0; i < socket_count; i++)
+				delete sockets[i];
+		}
+
+		result->requests = modem.requests;
+		result->failed = modem.failed;
+		result->connects = modem.connects;
+		result->ms = modem.now;
+
+		// Store emptied only once server has every entry
+		if((int)modem.received.size() != count || pipeline_bench_has_entries(&store))
+		{
+			printf("Received %d/%d entries in %d call homes\n", (int)modem.received.size(), count, result->sessions);
+			return RET_ERROR;
+		}
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * Compare pipeline sizes for a store type
+	 ******************************************************************************/
+	template <typename TEntry, typename TBuilder>
+	RetResult pipeline_bench_type(const char *name, const char *path, int entries_per_file, int interval_sec,
+		const DataStore<TEntry> *firmware_store)
+	{
+		int count = get_max_entries() < PIPELINE_BENCH_ENTRIES ? get_max_entries() : PIPELINE_BENCH_ENTRIES;
+		RetResult ret = RET_OK;
+
+		printf("\n%s - entries: %d, entries/file: %d\n", name, count, entries_per_file);
+		printf("%7s %5s | %8s %8s %6s %8s | %8s %6s %7s\n", "sockets", "fail", "sessions", "requests", "failed",
+			"connects", "time", "req/s", "speedup");
+
+		for(unsigned int i = 0; i < sizeof(PIPELINE_BENCH_FAIL) / sizeof(PIPELINE_BENCH_FAIL[0]); i++)
+		{
+			double sequential_ms = 0;
+
+			for(int sockets = 1; sockets <= UPLOAD_PIPELINE_MAX_SOCKETS; sockets++)
+			{
+				PipelineBenchRun run = {0};
+
+				if(pipeline_bench_run<TEntry, TBuilder>(path, entries_per_file, interval_sec, firmware_store,
+					sockets, PIPELINE_BENCH_FAIL[i], count, &run) != RET_OK)
+				{
+					ret = RET_ERROR;
+				}
+
+				if(sockets == 1)
+					sequential_ms = run.ms;
+
+				printf("%7d %4.0f%% | %8d %8d %6d %8d | %7.1fs %6.2f %6.2fx\n", sockets, PIPELINE_BENCH_FAIL[i] * 100,
+					run.sessions, run.requests, run.failed, run.connects, run.ms / 1000, run.requests * 1000 / run.ms,
+					sequential_ms / run.ms);
+			}
+		}
+
+		return ret;
+	}
+
+	/******************************************************************************
+	 * Benchmark pipelined uploads
+	 ******************************************************************************/
+	RetResult pipeline()
+	{
+		RetResult ret = RET_OK;
+
+		printf("Connect %.0f ms, RTT %.0f ms, uplink %.1f B/ms, modem TX buffer %.0f B\n", PIPELINE_BENCH_CONNECT_MS,
+			PIPELINE_BENCH_RTT_MS, PIPELINE_BENCH_UPLINK_BPMS, PIPELINE_BENCH_MODEM_TX_BUFFER);
+
+		if(pipeline_bench_type<WaterSensorData::Entry, TbWaterSensorDataJsonBuilder>("WaterSensorData",
+			WATER_SENSOR_DATA_PATH, WATER_SENSOR_DATA_ENTRIES_PER_SUBMIT_REQ, 600, WaterSensorData::get_store()) != RET_OK)
+		{
+			ret = RET_ERROR;
+		}
+
+		if(pipeline_bench_type<FoData::StoreEntry, TbFoDataJsonBuilder>("FoData",
+			FO_DATA_STORE_PATH, FO_DATA_STORE_ENTRIES_PER_SUBMIT_REQ, 1800, FoData::get_store()) != RET_OK)
+		{
+			ret = RET_ERROR;
+		}
+
+		SPIFFS.format();
+
+		return ret;
+	}
+} // Bench
@@ -0,0 +1,234 @@
+#include "bench.h"
+#include "bench_data.h"
+#include "Arduino.h"
+#include "SPIFFS.h"
+#include "flash.h"
+#include "data_store.h"
+
+/******************************************************************************
+ * Store quotas and eviction
+ * A long outage on a small partition: every wake up adds a water sensor
+ * entry, an FO entry, a few logs and an SDI12 log, nothing is ever submitted.
+ * Once flash is full, lower priority stores must give up their oldest files
+ * so that every water sensor commit succeeds and the newest water data is
+ * always on flash. Reports how much of each store survives and commit times.
+ ******************************************************************************/
+namespace Bench
+{
+	/** Partition size, fills up after a few hundred wake ups */
+	const size_t QUOTA_BENCH_FS_CAPACITY = 128 * 1024;
+
+	/** Partition size restored when done (esp32 default) */
+	const size_t QUOTA_BENCH_FS_CAPACITY_DEFAULT = 1374476;
+
+	/** Seconds between wake ups */
+	const int QUOTA_BENCH_CYCLE_SEC = 600;
+
+	/** Logs per wake up */
+	const int QUOTA_BENCH_LOGS_PER_CYCLE = 4;
+
+	/** Wake ups after which results are printed, last one ends the run */
+	const int QUOTA_BENCH_CHECKPOINTS[] = {250, 500, 1000, 2000, 4000};
+
+	/** Commit results of a store */
+	struct QuotaBenchStore
+	{
+		int commits;
+		int failed_commits;
+		uint64_t max_commit_us;
+	};
+
+	/******************************************************************************
+	 * Add an entry to a store and commit it
+	 ******************************************************************************/
+	template <typename TEntry>
+	void quota_bench_add(DataStore<TEntry> *store, uint32_t tstamp, int seq, QuotaBenchStore *result)
+	{
+		TEntry entry;
+		BenchData::fill(&entry, tstamp, seq);
+
+		store->add(&entry);
+
+		uint64_t t_start = now_us();
+		if(store->commit() != RET_OK)
+			result->failed_commits++;
+		uint64_t commit_us = now_us() - t_start;
+
+		result->commits++;
+		if(commit_us > result->max_commit_us)
+			result->max_commit_us = commit_us;
+	}
+
+	/******************************************************************************
+	 * Get files of a store from its manifest
+	 * @param oldest Creation time of oldest file (epoch)
+	 * @param newest Newest entry timestamp (units of the store's entries)
+	 ******************************************************************************/
+	template <typename TEntry>
+	void quota_bench_store_info(DataStore<TEntry> *store, int *files, uint32_t *oldest, uint64_t *newest)
+	{
+		DataStoreManifest *manifest = store->get_manifest();
+
+		*files = 0;
+		*oldest = 0;
+		*newest = 0;
+
+		if(store->load_manifest() != RET_OK)
+			return;
+
+		File f = manifest->open_records();
+		DataStoreManifest::Record record;
+		int index = 0;
+
+		while(manifest->read_next_record(f, &record, &index))
+		{
+			(*files)++;
+
+			if(*oldest == 0 || record.name_tstamp < *oldest)
+				*oldest = record.name_tstamp;
+			if(record.entries > 0 && record.max_tstamp > *newest)
+				*newest = record.max_tstamp;
+		}
+	}
+
+	/******************************************************************************
+	 * Get files evicted from a store
+	 ******************************************************************************/
+	uint32_t quota_bench_evicted(const char *dir_path)
+	{
+		const Flash::Stats *stats = Flash::get_stats();
+
+		for(int i = 0; i < stats->store_count; i++)
+		{
+			if(strcmp(stats->stores[i].dir_path, dir_path) == 0)
+				return stats->stores[i].files_evicted;
+		}
+
+		return 0;
+	}
+
+	/******************************************************************************
+	 * Print files, evicted files and hours of data kept of a store
+	 * @return Files of store
+	 ******************************************************************************/
+	template <typename TEntry>
+	int quota_bench_print_store(DataStore<TEntry> *store, uint32_t now)
+	{
+		int files = 0;
+		uint32_t oldest = 0;
+		uint64_t newest = 0;
+
+		quota_bench_store_info(store, &files, &oldest, &newest);
+
+		int hours = oldest > 0 ? (now - oldest) / 3600 : 0;
+
+		printf(" | %5d %5u %4d", files, quota_bench_evicted(store->get_dir_path()), hours);
+
+		return files;
+	}
+
+	/******************************************************************************
+	 * Benchmark eviction during a long outage
+	 ******************************************************************************/
+	RetResult quota()
+	{
+		RetResult ret = RET_OK;
+
+		NativeFs::set_capacity(QUOTA_BENCH_FS_CAPACITY);
+		SPIFFS.format();
+		DataStoreManifest::unload_all();
+		Flash::reset_stats();
+		Flash::mount();
+
+		DataStore<WaterSensorData::Entry> *water = WaterSensorData::get_store();
+		DataStore<FoData::StoreEntry> *fo = FoData::get_store();
+		DataStore<Log::Entry> *log_store = Log::get_store();
+		DataStore<SDI12Log::Entry> *sdi12 = SDI12Log::get_store();
+
+		water->clear_buffer();
+		fo->clear_buffer();
+		log_store->clear_buffer();
+		sdi12->clear_buffer();
+
+		printf("Partition: %d KB, wake up every %d sec, %d logs each, min free: %d B\n\n",
+			(int)(QUOTA_BENCH_FS_CAPACITY / 1024), QUOTA_BENCH_CYCLE_SEC, QUOTA_BENCH_LOGS_PER_CYCLE,
+			DATA_STORE_EVICT_MIN_FREE_BYTES);
+		printf("%6s %7s | %16s | %16s | %16s | %16s | %6s %9s\n", "", "", "water", "fo", "log", "sdi12", "",
+			"max");
+		printf("%6s %7s", "wakes", "free B");
+		for(int i = 0; i < 4; i++)
+			printf(" | %5s %5s %4s", "files", "evict", "hrs");
+		printf(" | %6s %9s\n", "fails", "commit us");
+
+		QuotaBenchStore results[4] = {0};
+		int checkpoint = 0;
+		int checkpoint_count = sizeof(QUOTA_BENCH_CHECKPOINTS) / sizeof(QUOTA_BENCH_CHECKPOINTS[0]);
+		uint32_t tstamp = 0;
+
+		for(int cycle = 1; checkpoint < checkpoint_count; cycle++)
+		{
+			NativeClock::advance_ms((uint64_t)QUOTA_BENCH_CYCLE_SEC * 1000);
+			tstamp = time(NULL);
+
+			quota_bench_add(water, tstamp, cycle, &results[0]);
+			quota_bench_add(fo, tstamp, cycle, &results[1]);
+
+			for(int i = 0; i < QUOTA_BENCH_LOGS_PER_CYCLE; i++)
+				quota_bench_add(log_store, tstamp, cycle * QUOTA_BENCH_LOGS_PER_CYCLE + i, &results[2]);
+
+			quota_bench_add(sdi12, tstamp, cycle, &results[3]);
+
+			if(cycle != QUOTA_BENCH_CHECKPOINTS[checkpoint])
+				continue;
+
+			checkpoint++;
+
+			int failed_commits = 0;
+			uint64_t max_commit_us = 0;
+			for(int i = 0; i < 4; i++)
+			{
+				failed_commits += results[i].failed_commits;
+				if(results[i].max_commit_us > max_commit_us)
+					max_commit_us = results[i].max_commit_us;
+			}
+
+			printf("%6d %7d", cycle, (int)Flash::get_free_bytes());
+			quota_bench_print_store(water, tstamp);
+			int lower_files = quota_bench_print_store(fo, tstamp);
+			lower_files += quota_bench_print_store(log_store, tstamp);
+			lower_files += quota_bench_print_store(sdi12, tstamp);
+			printf(" | %6d %9llu\n", failed_commits, (unsigned long long)max_commit_us);
+
+			// Water files go only once lower priority stores are down to the file they write to
+			if(quota_bench_evicted(WATER_SENSOR_DATA_PATH) > 0 && lower_files > 3)
+			{
+				printf("Water sensor data evicted while lower priority stores have %d files\n", lower_files);
+				ret = RET_ERROR;
+			}
+		}
+
+		// Every water commit succeeded and newest entry is on flash
+		int files = 0;
+		uint32_t oldest = 0;
+		uint64_t newest = 0;
+		quota_bench_store_info(water, &files, &oldest, &newest);
+
+		if(results[0].failed_commits > 0 || newest != tstamp)
+		{
+			printf("Water sensor data lost - failed commits: %d, newest entry: %llu (expected %u)\n",
+				results[0].failed_commits, (unsigned long long)newest, tstamp);
+			ret = RET_ERROR;
+		}
+
+		water->clear_buffer();
+		fo->clear_buffer();
+		log_store->clear_buffer();
+		sdi12->clear_buffer();
+
+		SPIFFS.format();
+		DataStoreManifest::unload_all();
+		NativeFs::set_capacity(QUOTA_BENCH_FS_CAPACITY_DEFAULT);
+
+		return ret;
+	}
+} // Bench
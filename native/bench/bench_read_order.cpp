@@ -0,0 +1,293 @@
+#include "bench.h"
+#include "bench_data.h"
+#include "Arduino.h"
+#include "SPIFFS.h"
+#include "data_store.h"
+#include "data_store_reader.h"
+#include <algorithm>
+#include <vector>
+
+/******************************************************************************
+ * Read order
+ * A backlog left by a long outage, with a stretch of entries stamped by a
+ * clock running ahead, so creation order is not time order. Read:
+ * - oldest: creation order, as call home did
+ * - newest: newest first by the manifest's file time bounds
+ * - window: newest first, only files of the last priority window
+ * - policy: the call home policy, window newest first then backfill oldest
+ *   first, deleting every file read
+ * Reports read cost (incl. manifest passes), how stale the newest data sent
+ * is once a tenth of the files are sent (a call home running out of air
+ * time) and checks that every entry is read exactly once and newest-first
+ * files come in order.
+ ******************************************************************************/
+namespace Bench
+{
+	/** Backlog sizes, in entries */
+	const int READ_ORDER_BENCH_BACKLOGS[] = {1000, 10000};
+
+	/** Seconds between entries */
+	const int READ_ORDER_BENCH_INTERVAL_SEC = 600;
+
+	/** First entry timestamp */
+	const uint32_t READ_ORDER_BENCH_TSTAMP = 1600000000;
+
+	/** Entries from this fraction of the backlog on are stamped ahead... */
+	const double READ_ORDER_BENCH_SKEW_AT = 0.5;
+
+	/** ...for this fraction of it, by this many seconds */
+	const double READ_ORDER_BENCH_SKEW_LEN = 0.05;
+	const uint32_t READ_ORDER_BENCH_SKEW_SEC = 7 * 24 * 3600;
+
+	/** Share of files a call home gets through, for staleness */
+	const int READ_ORDER_BENCH_BUDGET_DIV = 10;
+
+	/** Result of a read */
+	struct ReadOrderBenchRead
+	{
+		int files;
+		uint64_t us;
+		NativeFs::Stats stats;
+		/** Newest entry read once the budget of files was read */
+		uint32_t newest_in_budget;
+		/** Files came newest first */
+		bool ordered;
+	};
+
+	/******************************************************************************
+	 * Read files of a reader until done
+	 * @param budget_files Files after which newest_in_budget is taken
+	 * @param tstamps Timestamps of entries read are appended
+	 * @param delete_files Delete every file read, as call home does
+	 ******************************************************************************/
+	template <typename TEntry>
+	void read_order_bench_files(DataStoreReader<TEntry> *reader, int budget_files, bool delete_files,
+		std::vector<uint32_t> *tstamps, ReadOrderBenchRead *result)
+	{
+		typename DataStore<TEntry>::Entry entries[DATA_STORE_READ_BLOCK_ENTRIES];
+		DataStoreSpan<TEntry> span(entries, DATA_STORE_READ_BLOCK_ENTRIES);
+
+		uint32_t last_file_newest = UINT32_MAX;
+
+		while(reader->next_file())
+		{
+			uint32_t file_newest = 0;
+
+			while(reader->next_entries(&span, DATA_STORE_READ_BLOCK_ENTRIES))
+			{
+				for(int i = 0; i < span.count; i++)
+				{
+					uint32_t tstamp = span.get(i)->timestamp;
+
+					tstamps->push_back(tstamp);
+					if(tstamp > file_newest)
+						file_newest = tstamp;
+				}
+			}
+
+			if(file_newest > last_file_newest)
+				result->ordered = false;
+			last_file_newest = file_newest;
+
+			if(result->files < budget_files && file_newest > result->newest_in_budget)
+				result->newest_in_budget = file_newest;
+
+			result->files++;
+
+			if(delete_files)
+				reader->delete_file();
+		}
+	}
+
+	/******************************************************************************
+	 * Read whole store in an order, optionally only files in a range
+	 ******************************************************************************/
+	template <typename TEntry>
+	void read_order_bench_read(DataStore<TEntry> *store, DataStoreReadOrder order, bool window, uint32_t window_start,
+		int budget_files, std::vector<uint32_t> *tstamps, ReadOrderBenchRead *result)
+	{
+		DataStoreReader<TEntry> reader(store);
+		reader.set_order(order);
+		if(window)
+			reader.set_file_range(window_start, UINT64_MAX);
+
+		memset(result, 0, sizeof(*result));
+		result->ordered = true;
+		tstamps->clear();
+
+		NativeFs::reset_stats();
+		uint64_t t_start = now_us();
+
+		read_order_bench_files(&reader, budget_files, false, tstamps, result);
+
+		result->us = now_us() - t_start;
+		result->stats = *NativeFs::get_stats();
+
+		std::sort(tstamps->begin(), tstamps->end());
+	}
+
+	/******************************************************************************
+	 * Read store with the call home policy (see CallHome::next_submit_file()),
+	 * deleting files. Ordered is only checked for the window.
+	 ******************************************************************************/
+	template <typename TEntry>
+	void read_order_bench_policy(DataStore<TEntry> *store, uint32_t window_start, int budget_files,
+		std::vector<uint32_t> *tstamps, ReadOrderBenchRead *result)
+	{
+		DataStoreReader<TEntry> reader(store);
+
+		memset(result, 0, sizeof(*result));
+		result->ordered = true;
+		tstamps->clear();
+
+		NativeFs::reset_stats();
+		uint64_t t_start = now_us();
+
+		reader.set_order(DATA_STORE_READ_NEWEST_FIRST);
+		reader.set_file_range(window_start, UINT64_MAX);
+		read_order_bench_files(&reader, budget_files, true, tstamps, result);
+
+		bool ordered = result->ordered;
+
+		reader.reset();
+		reader.set_order(DATA_STORE_READ_OLDEST_FIRST);
+		reader.set_file_range(0, window_start - 1);
+		reader.set_ring_log_enabled(false);
+		read_order_bench_files(&reader, budget_files, true, tstamps, result);
+
+		result->ordered = ordered;
+		result->us = now_us() - t_start;
+		result->stats = *NativeFs::get_stats();
+
+		std::sort(tstamps->begin(), tstamps->end());
+	}
+
+	/******************************************************************************
+	 * Print a result row
+	 * @param newest Newest entry of backlog, staleness is relative to it
+	 ******************************************************************************/
+	void read_order_bench_print(int count, const char *name, const ReadOrderBenchRead *result, uint32_t newest,
+		int entries, bool entries_ok)
+	{
+		double stale_h = result->newest_in_budget > 0 ? (double)(newest - result->newest_in_budget) / 3600 : -1;
+
+		printf("%7d | %-6s | %5d %9.2f %9.1f | %8.1f | %7d %3s %3s\n", count, name, result->files, result->us / 1000.0,
+			result->stats.bytes_read / 1024.0, stale_h, entries, entries_ok ? "ok" : "BAD",
+			result->ordered ? "ok" : "BAD");
+	}
+
+	/******************************************************************************
+	 * Write a skewed backlog and read it in every order
+	 ******************************************************************************/
+	RetResult read_order_bench_run(int count)
+	{
+		SPIFFS.format();
+		DataStoreManifest::unload_all();
+
+		DataStore<WaterSensorData::Entry> store(WATER_SENSOR_DATA_PATH, WATER_SENSOR_DATA_ENTRIES_PER_SUBMIT_REQ);
+
+		int skew_from = count * READ_ORDER_BENCH_SKEW_AT;
+		int skew_to = skew_from + count * READ_ORDER_BENCH_SKEW_LEN;
+
+		std::vector<uint32_t> written;
+		WaterSensorData::Entry entry;
+
+		for(int i = 0; i < count; i++)
+		{
+			// File names come from the clock
+			NativeClock::advance_ms((uint64_t)READ_ORDER_BENCH_INTERVAL_SEC * 1000);
+
+			uint32_t tstamp = READ_ORDER_BENCH_TSTAMP + i * READ_ORDER_BENCH_INTERVAL_SEC;
+			if(i >= skew_from && i < skew_to)
+				tstamp += READ_ORDER_BENCH_SKEW_SEC;
+
+			BenchData::fill(&entry, tstamp, i);
+			store.add(&entry);
+			written.push_back(tstamp);
+
+			if(store.commit() != RET_OK)
+			{
+				printf("Could not write backlog\n");
+				return RET_ERROR;
+			}
+		}
+
+		std::sort(written.begin(), written.end());
+
+		// Window ends at the true clock, skewed entries are newer still
+		uint32_t now = READ_ORDER_BENCH_TSTAMP + count * READ_ORDER_BENCH_INTERVAL_SEC;
+		uint32_t window_start = now - TELEMETRY_PRIORITY_WINDOW_HOURS * 3600;
+		uint32_t newest = written.back();
+
+		int budget_files = (count / WATER_SENSOR_DATA_ENTRIES_PER_SUBMIT_REQ) / READ_ORDER_BENCH_BUDGET_DIV;
+
+		// Entries expected in window: files with their newest entry in it
+		int window_entries = 0;
+		DataStoreManifest *manifest = store.get_manifest();
+		File records = manifest->open_records();
+		DataStoreManifest::Record record;
+		int index = 0;
+
+		while(manifest->read_next_record(records, &record, &index))
+		{
+			if(record.max_tstamp >= window_start)
+				window_entries += record.entries;
+		}
+		records.close();
+
+		RetResult ret = RET_OK;
+		std::vector<uint32_t> tstamps;
+		ReadOrderBenchRead result;
+
+		read_order_bench_read(&store, DATA_STORE_READ_OLDEST_FIRST, false, 0, budget_files, &tstamps, &result);
+		// Creation order isn't time order here
+		result.ordered = true;
+		read_order_bench_print(count, "oldest", &result, newest, tstamps.size(), tstamps == written);
+		if(tstamps != written)
+			ret = RET_ERROR;
+
+		read_order_bench_read(&store, DATA_STORE_READ_NEWEST_FIRST, false, 0, budget_files, &tstamps, &result);
+		read_order_bench_print(count, "newest", &result, newest, tstamps.size(), tstamps == written);
+		if(tstamps != written || !result.ordered)
+			ret = RET_ERROR;
+
+		read_order_bench_read(&store, DATA_STORE_READ_NEWEST_FIRST, true, window_start, budget_files, &tstamps, &result);
+		read_order_bench_print(count, "window", &result, newest, tstamps.size(), (int)tstamps.size() == window_entries);
+		if((int)tstamps.size() != window_entries || !result.ordered)
+			ret = RET_ERROR;
+
+		read_order_bench_policy(&store, window_start, budget_files, &tstamps, &result);
+		bool policy_ok = tstamps == written && store.get_manifest()->get_live_files() == 0;
+		read_order_bench_print(count, "policy", &result, newest, tstamps.size(), policy_ok);
+		if(!policy_ok || !result.ordered)
+			ret = RET_ERROR;
+
+		return ret;
+	}
+
+	/******************************************************************************
+	 * Benchmark read orders
+	 ******************************************************************************/
+	RetResult read_order()
+	{
+		RetResult ret = RET_OK;
+
+		printf("WaterSensorData, %d h window, %.0f%% of entries %d days ahead, staleness after 1/%d of files\n\n",
+			TELEMETRY_PRIORITY_WINDOW_HOURS, READ_ORDER_BENCH_SKEW_LEN * 100, READ_ORDER_BENCH_SKEW_SEC / 86400,
+			READ_ORDER_BENCH_BUDGET_DIV);
+		printf("%7s | %-6s | %5s %9s %9s | %8s | %7s %3s %3s\n", "entries", "order", "files", "ms", "KiB read",
+			"stale h", "entries", "all", "ord");
+
+		for(unsigned int i = 0; i < sizeof(READ_ORDER_BENCH_BACKLOGS) / sizeof(READ_ORDER_BENCH_BACKLOGS[0]); i++)
+		{
+			int count = READ_ORDER_BENCH_BACKLOGS[i];
+			if(count > get_max_entries())
+				continue;
+
+			if(read_order_bench_run(count) != RET_OK)
+				ret = RET_ERROR;
+		}
+
+		return ret;
+	}
+} // Bench
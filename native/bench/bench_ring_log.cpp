@@ -0,0 +1,261 @@
+#include "bench.h"
+#include "bench_data.h"
+#include "bench_stores.h"
+#include "Arduino.h"
+#include "data_store.h"
+#include "data_store_reader.h"
+#include "ring_log.h"
+#include "emulated_flash.h"
+
+/******************************************************************************
+ * RingLog benchmark
+ * Same workload as the DataStore benchmark, but stores commit to a ring log
+ * on emulated NOR flash. After filling, the ring is recovered by a new
+ * RingLog (as after a reboot), read back oldest first and consumed.
+ * A power cut in the middle of an append is also simulated for every store.
+ ******************************************************************************/
+namespace Bench
+{
+	/** Backlog sizes, capped by max entries */
+	const int RING_BACKLOG_SIZES[] = {10, 100, 1000, 10000, 100000};
+
+	/** Region per store. Small enough for the largest backlogs to wrap. */
+	const uint32_t RING_BENCH_SECTORS = 64;
+	const uint32_t RING_BENCH_SECTOR_SIZE = 4096;
+
+	/** Result of a single store/backlog run */
+	struct RingResult
+	{
+		int entries;
+		uint32_t live;
+		uint32_t evicted;
+		uint64_t commit_us;
+		uint64_t recover_us;
+		uint64_t read_us;
+		EmulatedFlash::Stats write_stats;
+		uint32_t max_sector_erases;
+	};
+
+	/******************************************************************************
+	 * Read all records with a reader, checking CRC and that timestamps are in
+	 * order, then consume them all
+	 ******************************************************************************/
+	template <typename TEntry>
+	RetResult read_and_consume(DataStore<TEntry> *store, uint32_t expected, uint64_t *read_us)
+	{
+		DataStoreReader<TEntry> reader(store);
+		const TEntry *entry = NULL;
+		uint32_t read = 0;
+		uint64_t last_tstamp = 0;
+
+		uint64_t t_start = now_us();
+
+		while(reader.next_file())
+		{
+			while((entry = reader.next_entry()))
+			{
+				if(!reader.entry_crc_valid() || entry->timestamp < last_tstamp)
+				{
+					printf("Bad entry read back: %u\n", read);
+					return RET_ERROR;
+				}
+
+				last_tstamp = entry->timestamp;
+				read++;
+			}
+
+			reader.delete_file();
+		}
+
+		*read_us = now_us() - t_start;
+
+		if(read != expected || store->get_ring_log()->count() != 0)
+		{
+			printf("Read back %u/%u records, %u left after consuming\n", read, expected, store->get_ring_log()->count());
+			return RET_ERROR;
+		}
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * Fill, recover, read back and consume a ring log backed store
+	 ******************************************************************************/
+	template <typename TEntry>
+	RetResult bench_ring(const char *path, int entries_per_file, int interval_sec, int count, RingResult *result)
+	{
+		memset(result, 0, sizeof(*result));
+		result->entries = count;
+
+		uint32_t region_size = RING_BENCH_SECTORS * RING_BENCH_SECTOR_SIZE;
+		EmulatedFlash flash(region_size, RING_BENCH_SECTOR_SIZE);
+
+		RingLog ring;
+		if(ring.begin(&flash, 0, region_size, sizeof(typename DataStore<TEntry>::Entry)) != RET_OK)
+			return RET_ERROR;
+
+		DataStore<TEntry> store(path, entries_per_file);
+		store.set_ring_log(&ring);
+		TEntry entry;
+
+		//
+		// Write
+		//
+		for(int i = 0; i < count; i++)
+		{
+			NativeClock::advance_ms((uint64_t)interval_sec * 1000);
+			BenchData::fill(&entry, time(NULL), i);
+
+			store.add(&entry);
+
+			uint64_t t_start = now_us();
+			if(store.commit() != RET_OK)
+			{
+				printf("Commit failed at entry %d\n", i);
+				return RET_ERROR;
+			}
+			result->commit_us += now_us() - t_start;
+		}
+
+		result->write_stats = *flash.get_stats();
+		result->max_sector_erases = flash.get_max_sector_erases();
+		result->evicted = ring.get_stats()->evicted;
+
+		//
+		// Recover, as after reboot
+		//
+		RingLog recovered;
+		uint64_t t_start = now_us();
+		if(recovered.begin(&flash, 0, region_size, sizeof(typename DataStore<TEntry>::Entry)) != RET_OK)
+			return RET_ERROR;
+		result->recover_us = now_us() - t_start;
+
+		result->live = recovered.count();
+		if(result->live + result->evicted != (uint32_t)count)
+		{
+			printf("Recovered %u records, evicted %u, written %d\n", result->live, result->evicted, count);
+			return RET_ERROR;
+		}
+
+		store.set_ring_log(&recovered);
+
+		return read_and_consume<TEntry>(&store, result->live, &result->read_us);
+	}
+
+	/******************************************************************************
+	 * Cut power in the middle of an append. After recovery, records written
+	 * before must all be there, the torn one must be skipped and appending
+	 * must continue.
+	 ******************************************************************************/
+	template <typename TEntry>
+	RetResult bench_ring_power_cut(const char *path, int entries_per_file)
+	{
+		const int RECORDS_BEFORE = 25;
+
+		uint32_t region_size = RING_BENCH_SECTORS * RING_BENCH_SECTOR_SIZE;
+		EmulatedFlash flash(region_size, RING_BENCH_SECTOR_SIZE);
+		uint16_t record_size = sizeof(typename DataStore<TEntry>::Entry);
+
+		RingLog ring;
+		ring.begin(&flash, 0, region_size, record_size);
+
+		DataStore<TEntry> store(path, entries_per_file);
+		store.set_ring_log(&ring);
+		TEntry entry;
+
+		for(int i = 0; i < RECORDS_BEFORE + 1; i++)
+		{
+			BenchData::fill(&entry, 1600000000 + i, i);
+			store.add(&entry);
+
+			// Last one is cut halfway
+			if(i == RECORDS_BEFORE)
+				flash.set_write_budget(record_size / 2);
+
+			store.commit();
+		}
+
+		flash.set_write_budget(-1);
+
+		RingLog recovered;
+		if(recovered.begin(&flash, 0, region_size, record_size) != RET_OK)
+			return RET_ERROR;
+
+		DataStore<TEntry> store_after(path, entries_per_file);
+		store_after.set_ring_log(&recovered);
+
+		BenchData::fill(&entry, 1600000000 + RECORDS_BEFORE + 1, RECORDS_BEFORE + 1);
+		store_after.add(&entry);
+		if(store_after.commit() != RET_OK)
+			return RET_ERROR;
+
+		uint64_t read_us = 0;
+		if(read_and_consume<TEntry>(&store_after, RECORDS_BEFORE + 1, &read_us) != RET_OK)
+		{
+			printf("Power cut recovery failed\n");
+			return RET_ERROR;
+		}
+
+		if(flash.get_stats()->program_violations > 0)
+		{
+			printf("Flash programmed without erase: %u\n", flash.get_stats()->program_violations);
+			return RET_ERROR;
+		}
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * Run all backlog sizes for a store type and print a table
+	 ******************************************************************************/
+	template <typename TEntry>
+	RetResult bench_ring_type(const char *name, const char *path, int entries_per_file, int interval_sec)
+	{
+		printf("\n%s - record: %d B, region: %u sectors\n", name,
+			(int)sizeof(typename DataStore<TEntry>::Entry), RING_BENCH_SECTORS);
+		printf("%8s %7s %7s | %10s %8s %10s %7s %10s | %10s %10s\n",
+			"entries", "live", "evicted",
+			"commit/s", "writes", "written", "erases", "max erases",
+			"recover us", "read/s");
+
+		for(unsigned int i = 0; i < sizeof(RING_BACKLOG_SIZES) / sizeof(RING_BACKLOG_SIZES[0]); i++)
+		{
+			if(RING_BACKLOG_SIZES[i] > get_max_entries())
+				break;
+
+			RingResult res;
+			if(bench_ring<TEntry>(path, entries_per_file, interval_sec, RING_BACKLOG_SIZES[i], &res) != RET_OK)
+				return RET_ERROR;
+
+			printf("%8d %7u %7u | %10.0f %8u %10llu %7u %10u | %10llu %10.0f\n",
+				res.entries, res.live, res.evicted,
+				rate(res.entries, res.commit_us), res.write_stats.write_calls,
+				(unsigned long long)res.write_stats.bytes_written, res.write_stats.erases, res.max_sector_erases,
+				(unsigned long long)res.recover_us, rate(res.live, res.read_us));
+		}
+
+		if(bench_ring_power_cut<TEntry>(path, entries_per_file) != RET_OK)
+			return RET_ERROR;
+
+		printf("Power cut during append: recovered\n");
+
+		return RET_OK;
+	}
+
+	template <typename TEntry>
+	struct RingBench
+	{
+		static RetResult run(const char *name, const char *path, int entries_per_file, int interval_sec)
+		{
+			return bench_ring_type<TEntry>(name, path, entries_per_file, interval_sec);
+		}
+	};
+
+	/******************************************************************************
+	 * Benchmark ring log backed stores of all store types
+	 ******************************************************************************/
+	RetResult ring_log()
+	{
+		return for_all_store_types<RingBench>();
+	}
+} // Bench
@@ -0,0 +1,147 @@
+#include "bench.h"
+#include "bench_data.h"
+#include "Arduino.h"
+#include "entry_schema.h"
+#include "tb_water_sensor_data_json_builder.h"
+#include "tb_atmos41_data_json_builder.h"
+#include "tb_soil_moisture_data_json_builder.h"
+#include "tb_lightning_data_json_builder.h"
+#include "tb_fo_data_json_builder.h"
+
+/******************************************************************************
+ * Entry schemas
+ * Telemetry JSON and print() of every entry type are generated from its
+ * schema. Builds the JSON of a backlog a request at a time, as call home
+ * does, and copies every entry field by field through the schema, which must
+ * give back the same bytes (schema covers the whole struct).
+ * Reports JSON build rate and size, copy rate and entries that differ.
+ ******************************************************************************/
+namespace Bench
+{
+	/** Entries per type */
+	const int SCHEMA_BENCH_ENTRIES = 20000;
+
+	/** Seconds between entries */
+	const int SCHEMA_BENCH_INTERVAL_SEC = 600;
+
+	/******************************************************************************
+	 * Build JSON and copy entries of a type through its schema
+	 ******************************************************************************/
+	template <typename TEntry, typename TBuilder>
+	RetResult schema_bench_type(const char *name, const EntrySchema::Field* (*get_schema)(int*),
+		int entries_per_req, int count)
+	{
+		int field_count = 0;
+		const EntrySchema::Field *fields = get_schema(&field_count);
+
+		TEntry *entries = new TEntry[count];
+		for(int i = 0; i < count; i++)
+			BenchData::fill(&entries[i], 1600000000 + i * SCHEMA_BENCH_INTERVAL_SEC, i);
+
+		//
+		// JSON, a request at a time
+		//
+		TBuilder *json_builder = new TBuilder();
+		char json_buff[8192];
+		uint64_t json_bytes = 0;
+		int failed_adds = 0;
+
+		uint64_t t_start = now_us();
+
+		for(int i = 0; i < count; i += entries_per_req)
+		{
+			json_builder->reset();
+
+			for(int j = i; j < i + entries_per_req && j < count; j++)
+			{
+				if(json_builder->add(&entries[j]) != RET_OK)
+					failed_adds++;
+			}
+
+			json_builder->build(json_buff, sizeof(json_buff), false);
+			json_bytes += strlen(json_buff);
+		}
+
+		uint64_t json_us = now_us() - t_start;
+
+		//
+		// Field by field copy
+		//
+		TEntry copy;
+		int mismatches = 0;
+
+		t_start = now_us();
+
+		for(int i = 0; i < count; i++)
+		{
+			memset(&copy, 0, sizeof(copy));
+
+			for(int j = 0; j < field_count; j++)
+				EntrySchema::set_value(&fields[j], &copy, EntrySchema::get_value(&fields[j], &entries[i]));
+
+			if(memcmp(&copy, &entries[i], sizeof(copy)) != 0)
+				mismatches++;
+		}
+
+		uint64_t copy_us = now_us() - t_start;
+
+		printf("%16s | %6d %4d | %9.0f %9.1f | %9.0f %10d\n", name, field_count, (int)sizeof(TEntry),
+			rate(count, json_us), (double)json_bytes / count, rate(count, copy_us), mismatches);
+
+		delete json_builder;
+		delete[] entries;
+
+		if(failed_adds > 0 || mismatches > 0)
+		{
+			printf("Failed JSON adds: %d, entries changed by copy: %d\n", failed_adds, mismatches);
+			return RET_ERROR;
+		}
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * Benchmark entry schemas
+	 ******************************************************************************/
+	RetResult schema()
+	{
+		int count = get_max_entries() < SCHEMA_BENCH_ENTRIES ? get_max_entries() : SCHEMA_BENCH_ENTRIES;
+		RetResult ret = RET_OK;
+
+		printf("%d entries per type\n\n", count);
+		printf("%16s | %6s %4s | %9s %9s | %9s %10s\n", "type", "fields", "size", "json/s", "B/entry",
+			"copy/s", "mismatches");
+
+		if(schema_bench_type<WaterSensorData::Entry, TbWaterSensorDataJsonBuilder>("WaterSensorData",
+			WaterSensorData::get_schema, WATER_SENSOR_DATA_ENTRIES_PER_SUBMIT_REQ, count) != RET_OK)
+		{
+			ret = RET_ERROR;
+		}
+
+		if(schema_bench_type<Atmos41Data::Entry, TbAtmos41DataJsonBuilder>("Atmos41Data",
+			Atmos41Data::get_schema, ATMOS41_DATA_ENTRIES_PER_SUBMIT_REQ, count) != RET_OK)
+		{
+			ret = RET_ERROR;
+		}
+
+		if(schema_bench_type<SoilMoistureData::Entry, TbSoilMoistureDataJsonBuilder>("SoilMoistureData",
+			SoilMoistureData::get_schema, SOIL_MOISTURE_DATA_ENTRIES_PER_SUBMIT_REQ, count) != RET_OK)
+		{
+			ret = RET_ERROR;
+		}
+
+		if(schema_bench_type<LightningData::Entry, TbLightningDataJsonBuilder>("LightningData",
+			LightningData::get_schema, LIGHTNING_DATA_ENTRIES_PER_SUBMIT_REQ, count) != RET_OK)
+		{
+			ret = RET_ERROR;
+		}
+
+		if(schema_bench_type<FoData::StoreEntry, TbFoDataJsonBuilder>("FoData",
+			FoData::get_schema, FO_DATA_STORE_ENTRIES_PER_SUBMIT_REQ, count) != RET_OK)
+		{
+			ret = RET_ERROR;
+		}
+
+		return ret;
+	}
+} // Bench
@@ -0,0 +1,297 @@
+#include "bench.h"
+#include "bench_data.h"
+#include "Arduino.h"
+#include "storage.h"
+#include "flash.h"
+#include "data_store.h"
+#include "data_store_reader.h"
+#include <algorithm>
+#include <vector>
+
+/******************************************************************************
+ * Storage backends
+ * The same backlog (a water sensor entry and a few logs per wake up, commit
+ * on every add) is committed, read back and deleted on every backend, then
+ * a SPIFFS partition is migrated to LittleFS and read back. A backlog too big
+ * to migrate must stay on SPIFFS, one that fits must be migrated whole.
+ * Reports rates and what each file system does underneath: space used, flash
+ * pages programmed and dir entries visited to list the stores.
+ ******************************************************************************/
+namespace Bench
+{
+	/** Max wake ups per backend run */
+	const int STORAGE_BENCH_CYCLES = 2000;
+
+	/** Wake ups written before migrating, a backlog over the staging buffer and
+	 * one within it */
+	const int STORAGE_BENCH_MIGRATION_CYCLES[] = {1000, 100};
+
+	/** Seconds between wake ups */
+	const int STORAGE_BENCH_CYCLE_SEC = 600;
+
+	/** Logs per wake up */
+	const int STORAGE_BENCH_LOGS_PER_CYCLE = 4;
+
+	/** Backends compared */
+	const int STORAGE_BENCH_BACKENDS[] = {STORAGE_BACKEND_SPIFFS, STORAGE_BACKEND_LITTLEFS, STORAGE_BACKEND_RAM};
+
+	/******************************************************************************
+	 * Add a wake up's entries to the stores and commit them
+	 * @return Timestamp of water entry
+	 ******************************************************************************/
+	uint32_t storage_bench_cycle(DataStore<WaterSensorData::Entry> *water, DataStore<Log::Entry> *log_store,
+		int cycle, int *failed_commits)
+	{
+		WaterSensorData::Entry water_entry;
+		Log::Entry log_entry;
+
+		NativeClock::advance_ms((uint64_t)STORAGE_BENCH_CYCLE_SEC * 1000);
+		uint32_t tstamp = time(NULL);
+
+		BenchData::fill(&water_entry, tstamp, cycle);
+		water->add(&water_entry);
+		if(water->commit() != RET_OK)
+			(*failed_commits)++;
+
+		for(int i = 0; i < STORAGE_BENCH_LOGS_PER_CYCLE; i++)
+		{
+			BenchData::fill(&log_entry, tstamp, cycle * STORAGE_BENCH_LOGS_PER_CYCLE + i);
+			log_store->add(&log_entry);
+			if(log_store->commit() != RET_OK)
+				(*failed_commits)++;
+		}
+
+		return tstamp;
+	}
+
+	/******************************************************************************
+	 * Read every entry of a store
+	 * @return Entries read, -1 on CRC failure
+	 ******************************************************************************/
+	template <typename TEntry>
+	int storage_bench_read(DataStore<TEntry> *store, std::vector<uint32_t> *tstamps = NULL)
+	{
+		DataStoreReader<TEntry> reader(store);
+		TEntry *entry;
+		int entries = 0;
+
+		while(reader.next_file())
+		{
+			while((entry = reader.next_entry()) != NULL)
+			{
+				if(!reader.entry_crc_valid())
+					return -1;
+
+				if(tstamps != NULL)
+					tstamps->push_back(entry->timestamp);
+
+				entries++;
+			}
+		}
+
+		return entries;
+	}
+
+	/******************************************************************************
+	 * Delete every file of a store
+	 * @return Files deleted
+	 ******************************************************************************/
+	template <typename TEntry>
+	int storage_bench_delete(DataStore<TEntry> *store)
+	{
+		DataStoreReader<TEntry> reader(store);
+		int files = 0;
+
+		while(reader.next_file())
+		{
+			if(reader.delete_file() == RET_OK)
+				files++;
+		}
+
+		return files;
+	}
+
+	/******************************************************************************
+	 * Switch backend and start with an empty partition
+	 ******************************************************************************/
+	RetResult storage_bench_reset(int backend_id)
+	{
+		if(Storage::set_backend(backend_id) != RET_OK || !Storage::format())
+			return RET_ERROR;
+
+		DataStoreManifest::unload_all();
+		Flash::reset_stats();
+
+		return Flash::mount();
+	}
+
+	/******************************************************************************
+	 * Commit, read and delete a backlog on a backend
+	 ******************************************************************************/
+	RetResult storage_bench_backend(int backend_id, int cycles)
+	{
+		if(storage_bench_reset(backend_id) != RET_OK)
+		{
+			printf("Could not mount backend %d\n", backend_id);
+			return RET_ERROR;
+		}
+
+		DataStore<WaterSensorData::Entry> water(WATER_SENSOR_DATA_PATH, WATER_SENSOR_DATA_ENTRIES_PER_SUBMIT_REQ);
+		DataStore<Log::Entry> log_store(LOG_DATA_PATH, LOG_ENTRIES_PER_SUBMIT_REQ);
+		int failed_commits = 0;
+
+		NativeFs::reset_stats();
+		uint64_t t_start = now_us();
+
+		for(int cycle = 0; cycle < cycles; cycle++)
+			storage_bench_cycle(&water, &log_store, cycle, &failed_commits);
+
+		uint64_t commit_us = now_us() - t_start;
+		NativeFs::Stats commit_stats = *NativeFs::get_stats();
+		size_t used_bytes = Storage::used_bytes();
+
+		NativeFs::reset_stats();
+		t_start = now_us();
+
+		int water_read = storage_bench_read(&water);
+		int log_read = storage_bench_read(&log_store);
+
+		uint64_t read_us = now_us() - t_start;
+		NativeFs::Stats read_stats = *NativeFs::get_stats();
+
+		NativeFs::reset_stats();
+		t_start = now_us();
+
+		int files = storage_bench_delete(&water) + storage_bench_delete(&log_store);
+
+		uint64_t delete_us = now_us() - t_start;
+
+		int commits = cycles * (1 + STORAGE_BENCH_LOGS_PER_CYCLE);
+		int entries = water_read + log_read;
+
+		printf("%8s | %9.0f %8u %8llu %9llu | %9.0f %9llu | %7d %9.0f\n", Storage::get_name(),
+			rate(commits, commit_us), (unsigned)(used_bytes / 1024),
+			(unsigned long long)commit_stats.pages_programmed, (unsigned long long)commit_stats.dir_entries_scanned,
+			rate(entries, read_us), (unsigned long long)read_stats.dir_entries_scanned,
+			files, rate(files, delete_us));
+
+		if(failed_commits > 0 || water_read != cycles || log_read != cycles * STORAGE_BENCH_LOGS_PER_CYCLE)
+		{
+			printf("Failed commits: %d, read back water: %d/%d, logs: %d/%d\n", failed_commits, water_read, cycles,
+				log_read, cycles * STORAGE_BENCH_LOGS_PER_CYCLE);
+			return RET_ERROR;
+		}
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * Migrate a SPIFFS backlog to LittleFS, nothing must be lost whether it is
+	 * migrated or kept on SPIFFS
+	 ******************************************************************************/
+	RetResult storage_bench_migration(int cycles)
+	{
+		if(storage_bench_reset(STORAGE_BACKEND_SPIFFS) != RET_OK)
+			return RET_ERROR;
+
+		std::vector<uint32_t> written;
+		int failed_commits = 0;
+
+		{
+			DataStore<WaterSensorData::Entry> water(WATER_SENSOR_DATA_PATH, WATER_SENSOR_DATA_ENTRIES_PER_SUBMIT_REQ);
+			DataStore<Log::Entry> log_store(LOG_DATA_PATH, LOG_ENTRIES_PER_SUBMIT_REQ);
+
+			for(int cycle = 0; cycle < cycles; cycle++)
+				written.push_back(storage_bench_cycle(&water, &log_store, cycle, &failed_commits));
+		}
+
+		size_t spiffs_used = Storage::used_bytes();
+
+		Storage::set_backend(STORAGE_BACKEND_LITTLEFS);
+
+		int files_migrated = 0, files_dropped = 0;
+		uint64_t t_start = now_us();
+
+		RetResult ret = Storage::migrate(Storage::get_backend(STORAGE_BACKEND_SPIFFS), &files_migrated, &files_dropped);
+
+		uint64_t migrate_us = now_us() - t_start;
+
+		if(ret != RET_OK || Flash::mount() != RET_OK)
+		{
+			printf("Migration failed\n");
+			return RET_ERROR;
+		}
+
+		DataStore<WaterSensorData::Entry> water(WATER_SENSOR_DATA_PATH, WATER_SENSOR_DATA_ENTRIES_PER_SUBMIT_REQ);
+		DataStore<Log::Entry> log_store(LOG_DATA_PATH, LOG_ENTRIES_PER_SUBMIT_REQ);
+
+		std::vector<uint32_t> read;
+		int water_read = storage_bench_read(&water, &read);
+		int log_read = storage_bench_read(&log_store);
+
+		bool migrated = Storage::get_backend()->id == STORAGE_BACKEND_LITTLEFS;
+
+		printf("\nMigration SPIFFS -> LittleFS (%d KB staging): %d wake ups, %u KB -> %s %u KB, %d files migrated, "
+			"%d dropped, %.0f ms\n", STORAGE_MIGRATION_MAX_BYTES / 1024, cycles, (unsigned)(spiffs_used / 1024),
+			Storage::get_name(), (unsigned)(Storage::used_bytes() / 1024), files_migrated, files_dropped,
+			migrate_us / 1000.0);
+		printf("Read back: water %d/%d, logs %d/%d\n", water_read, cycles, log_read,
+			cycles * STORAGE_BENCH_LOGS_PER_CYCLE);
+
+		// Rebuilt manifests list files in dir order, not creation order
+		std::sort(read.begin(), read.end());
+
+		if(failed_commits > 0 || read != written || log_read != cycles * STORAGE_BENCH_LOGS_PER_CYCLE ||
+			files_dropped > 0)
+		{
+			printf("Store data lost in migration\n");
+			return RET_ERROR;
+		}
+
+		if(migrated != (spiffs_used <= STORAGE_MIGRATION_MAX_BYTES))
+		{
+			printf("Backlog %s\n", migrated ? "over staging buffer migrated" : "within staging buffer not migrated");
+			return RET_ERROR;
+		}
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * Benchmark storage backends
+	 ******************************************************************************/
+	RetResult storage()
+	{
+		int cycles = get_max_entries() < STORAGE_BENCH_CYCLES ? get_max_entries() : STORAGE_BENCH_CYCLES;
+		RetResult ret = RET_OK;
+
+		printf("Backlog: %d wake ups, a water entry and %d logs each, commit on every add\n\n", cycles,
+			STORAGE_BENCH_LOGS_PER_CYCLE);
+		printf("%8s | %9s %8s %8s %9s | %9s %9s | %7s %9s\n", "backend", "commit/s", "used KB", "pages",
+			"scanned", "read/s", "scanned", "deleted", "delete/s");
+
+		for(unsigned int i = 0; i < sizeof(STORAGE_BENCH_BACKENDS) / sizeof(STORAGE_BENCH_BACKENDS[0]); i++)
+		{
+			if(storage_bench_backend(STORAGE_BENCH_BACKENDS[i], cycles) != RET_OK)
+				ret = RET_ERROR;
+		}
+
+		for(unsigned int i = 0; i < sizeof(STORAGE_BENCH_MIGRATION_CYCLES) / sizeof(STORAGE_BENCH_MIGRATION_CYCLES[0]); i++)
+		{
+			int migration_cycles = get_max_entries() < STORAGE_BENCH_MIGRATION_CYCLES[i] ? get_max_entries() :
+				STORAGE_BENCH_MIGRATION_CYCLES[i];
+
+			if(storage_bench_migration(migration_cycles) != RET_OK)
+				ret = RET_ERROR;
+		}
+
+		// Leave SPIFFS empty and in use for the benchmarks that follow
+		Storage::set_backend(STORAGE_BACKEND_LITTLEFS);
+		Storage::format();
+		Storage::set_backend(STORAGE_BACKEND_SPIFFS);
+		Storage::format();
+		DataStoreManifest::unload_all();
+
+		return ret;
+	}
+} // Bench
@@ -0,0 +1,45 @@
+#ifndef BENCH_STORES_H
+#define BENCH_STORES_H
+#include "struct.h"
+#include "const.h"
+#include "water_sensor_data.h"
+#include "atmos41_data.h"
+#include "soil_moisture_data.h"
+#include "lightning_data.h"
+#include "fo_data.h"
+#include "sdi12_log.h"
+#include "log.h"
+
+namespace Bench
+{
+	/******************************************************************************
+	 * Run a per store type benchmark for all store types instantiated by the
+	 * firmware. Measurement intervals roughly match the default schedule.
+	 * TBench<TEntry>::run(name, path, entries_per_file, interval_sec) is called
+	 * for each store type.
+	 ******************************************************************************/
+	template <template <typename> class TBench>
+	RetResult for_all_store_types()
+	{
+		RetResult ret = RET_OK;
+
+		if(TBench<WaterSensorData::Entry>::run("WaterSensorData", WATER_SENSOR_DATA_PATH, WATER_SENSOR_DATA_ENTRIES_PER_SUBMIT_REQ, 600) != RET_OK)
+			ret = RET_ERROR;
+		if(TBench<Atmos41Data::Entry>::run("Atmos41Data", ATMOS41_DATA_PATH, ATMOS41_DATA_ENTRIES_PER_SUBMIT_REQ, 600) != RET_OK)
+			ret = RET_ERROR;
+		if(TBench<SoilMoistureData::Entry>::run("SoilMoistureData", SOIL_MOISTURE_DATA_PATH, SOIL_MOISTURE_DATA_ENTRIES_PER_SUBMIT_REQ, 600) != RET_OK)
+			ret = RET_ERROR;
+		if(TBench<Log::Entry>::run("Log", LOG_DATA_PATH, LOG_ENTRIES_PER_SUBMIT_REQ, 60) != RET_OK)
+			ret = RET_ERROR;
+		if(TBench<SDI12Log::Entry>::run("SDI12Log", "/sdi12", 8, 600) != RET_OK)
+			ret = RET_ERROR;
+		if(TBench<FoData::StoreEntry>::run("FoData", FO_DATA_STORE_PATH, FO_DATA_STORE_ENTRIES_PER_SUBMIT_REQ, 1800) != RET_OK)
+			ret = RET_ERROR;
+		if(TBench<LightningData::Entry>::run("LightningData", LIGHTNING_DATA_PATH, LIGHTNING_DATA_ENTRIES_PER_SUBMIT_REQ, 3600) != RET_OK)
+			ret = RET_ERROR;
+
+		return ret;
+	}
+} // Bench
+
+#endif
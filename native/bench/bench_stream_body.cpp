@@ -0,0 +1,288 @@
+#include "bench.h"
+#include "bench_data.h"
+#include "Arduino.h"
+#include "SPIFFS.h"
+#include "data_store.h"
+#include "data_store_reader.h"
+#include "http_body.h"
+#include "telemetry_json_body.h"
+#include "tb_water_sensor_data_json_builder.h"
+#include "tb_atmos41_data_json_builder.h"
+#include "tb_fo_data_json_builder.h"
+#include "tb_log_json_builder.h"
+#include <string>
+#include <vector>
+
+/******************************************************************************
+ * Streamed request bodies
+ * A backlog is turned into telemetry requests, a file per request, as call
+ * home does:
+ * - buffer: JSON built in a TELEMETRY_DATA_JSON_OUTPUT_BUFF_SIZE buffer,
+ *   requests that don't fit are cut (as call home did)
+ * - stream: JSON streamed entry by entry through a chunked HttpBodyStream
+ * Files of the firmware's size and of many more entries are compared.
+ * Streamed bodies are de-chunked and must match the buffered JSON of the
+ * requests that fit, and hold every entry.
+ * Reports requests, cut requests, body bytes, chunk framing overhead, rate
+ * and RAM held by the request builder.
+ ******************************************************************************/
+namespace Bench
+{
+	/** Backlog per run */
+	const int STREAM_BODY_BENCH_ENTRIES = 2000;
+
+	/** Entries per file of the large file run */
+	const int STREAM_BODY_BENCH_LARGE_FILE_ENTRIES = 64;
+
+	/******************************************************************************
+	 * Sink keeping everything written, as the socket would get it
+	 ******************************************************************************/
+	class StreamBodyBenchSink : public HttpBodySink
+	{
+	public:
+		using HttpBodySink::write;
+
+		RetResult write(const uint8_t *data, int size)
+		{
+			bytes.append((const char*)data, size);
+			writes++;
+			return RET_OK;
+		}
+
+		std::string bytes;
+		int writes = 0;
+	};
+
+	/******************************************************************************
+	 * Decode chunked transfer encoding
+	 * @return False if framing is invalid or last chunk is missing
+	 ******************************************************************************/
+	bool stream_body_bench_dechunk(const std::string &chunked, std::string *body)
+	{
+		size_t pos = 0;
+		body->clear();
+
+		while(true)
+		{
+			size_t line_end = chunked.find("\r\n", pos);
+			if(line_end == std::string::npos)
+				return false;
+
+			size_t size = strtoul(chunked.substr(pos, line_end - pos).c_str(), NULL, 16);
+			pos = line_end + 2;
+
+			if(size == 0)
+				return chunked.compare(pos, std::string::npos, "\r\n") == 0;
+
+			if(pos + size + 2 > chunked.size() || chunked.compare(pos + size, 2, "\r\n") != 0)
+				return false;
+
+			body->append(chunked, pos, size);
+			pos += size + 2;
+		}
+	}
+
+	/** Result of a run */
+	struct StreamBodyBenchRun
+	{
+		int requests;
+		int cut_requests;
+		int entries;
+		uint64_t body_bytes;
+		uint64_t sent_bytes;
+		uint64_t us;
+	};
+
+	/******************************************************************************
+	 * Build the requests of a store's files, deleting nothing
+	 * @param json Buffered JSON of every request, compared to streamed ones
+	 ******************************************************************************/
+	template <typename TEntry, typename TBuilder>
+	RetResult stream_body_bench_requests(DataStore<TEntry> *store, bool stream, std::vector<std::string> *json,
+		StreamBodyBenchRun *result)
+	{
+		DataStoreReader<TEntry> reader(store);
+		typename DataStore<TEntry>::Entry entries[DATA_STORE_READ_BLOCK_ENTRIES];
+		DataStoreSpan<TEntry> span(entries, DATA_STORE_READ_BLOCK_ENTRIES);
+
+		TBuilder *json_builder = new TBuilder();
+		TelemetryJsonBody<TEntry, TBuilder> *body = new TelemetryJsonBody<TEntry, TBuilder>(&reader, &span);
+		char json_buff[TELEMETRY_DATA_JSON_OUTPUT_BUFF_SIZE];
+		int max_entries = store->get_max_entries_per_file();
+		RetResult ret = RET_OK;
+		int req = 0;
+
+		memset(result, 0, sizeof(*result));
+		uint64_t t_start = now_us();
+
+		while(reader.next_file())
+		{
+			if(stream)
+			{
+				if(!body->begin(max_entries))
+					continue;
+
+				StreamBodyBenchSink sink;
+				HttpBodyStream body_stream(&sink, true);
+				std::string streamed;
+
+				if(body->write(&body_stream) != RET_OK || body_stream.finish() != RET_OK ||
+					!stream_body_bench_dechunk(sink.bytes, &streamed) ||
+					(int)streamed.size() != body_stream.get_body_size())
+				{
+					ret = RET_ERROR;
+				}
+
+				// Buffered JSON of requests that fit must match
+				if(req < (int)json->size() && (*json)[req].size() < sizeof(json_buff) - 1 && (*json)[req] != streamed)
+				{
+					if(ret == RET_OK)
+						printf("Request %d differs:\n  buffer: %s\n  stream: %s\n", req, (*json)[req].c_str(), streamed.c_str());
+					ret = RET_ERROR;
+				}
+
+				result->entries += body->get_entry_count();
+				result->body_bytes += streamed.size();
+				result->sent_bytes += sink.bytes.size();
+			}
+			else
+			{
+				json_builder->reset();
+
+				while(reader.next_entries(&span, DATA_STORE_READ_BLOCK_ENTRIES))
+				{
+					for(int i = 0; i < span.count; i++)
+						json_builder->add(span.get(i));
+
+					result->entries += span.count;
+				}
+
+				json_builder->build(json_buff, sizeof(json_buff), false);
+
+				int size = strlen(json_buff);
+				if(size >= (int)sizeof(json_buff) - 1)
+					result->cut_requests++;
+
+				json->push_back(json_buff);
+				result->body_bytes += size;
+				result->sent_bytes += size;
+			}
+
+			result->requests++;
+			req++;
+		}
+
+		result->us = now_us() - t_start;
+
+		delete json_builder;
+		delete body;
+
+		return ret;
+	}
+
+	/******************************************************************************
+	 * Run a type with a file size
+	 ******************************************************************************/
+	template <typename TEntry, typename TBuilder>
+	RetResult stream_body_bench_run(const char *name, const char *path, int entries_per_file, int count)
+	{
+		SPIFFS.format();
+		DataStoreManifest::unload_all();
+
+		DataStore<TEntry> store(path, entries_per_file);
+		TEntry entry;
+
+		for(int i = 0; i < count; i++)
+		{
+			// File names come from the clock
+			NativeClock::advance_ms(600 * 1000);
+
+			BenchData::fill(&entry, 1600000000 + i * 600, i);
+			store.add(&entry);
+
+			if(store.commit() != RET_OK)
+			{
+				printf("Could not write backlog\n");
+				return RET_ERROR;
+			}
+		}
+
+		RetResult ret = RET_OK;
+		std::vector<std::string> json;
+		StreamBodyBenchRun runs[2];
+		const char *modes[] = {"buffer", "stream"};
+		int ram[] = {(int)(sizeof(TBuilder) + TELEMETRY_DATA_JSON_OUTPUT_BUFF_SIZE),
+			(int)(sizeof(TelemetryJsonBody<TEntry, TBuilder>) + sizeof(HttpBodyStream))};
+
+		for(int mode = 0; mode < 2; mode++)
+		{
+			StreamBodyBenchRun *run = &runs[mode];
+
+			if(stream_body_bench_requests<TEntry, TBuilder>(&store, mode == 1, &json, run) != RET_OK)
+				ret = RET_ERROR;
+
+			printf("%16s %4d | %-6s | %6d %5d %7.1f | %9.0f %6.1f%% | %9.0f %6d\n", name, entries_per_file,
+				modes[mode], run->requests, run->cut_requests, (double)run->body_bytes / run->requests,
+				(double)run->sent_bytes / run->requests, 100.0 * (run->sent_bytes - run->body_bytes) / run->body_bytes,
+				rate(run->entries, run->us), ram[mode]);
+		}
+
+		if(runs[1].entries != count || runs[1].cut_requests > 0)
+		{
+			printf("Streamed entries: %d of %d\n", runs[1].entries, count);
+			ret = RET_ERROR;
+		}
+
+		return ret;
+	}
+
+	/******************************************************************************
+	 * Benchmark streamed request bodies
+	 ******************************************************************************/
+	RetResult stream_body()
+	{
+		int count = get_max_entries() < STREAM_BODY_BENCH_ENTRIES ? get_max_entries() : STREAM_BODY_BENCH_ENTRIES;
+		RetResult ret = RET_OK;
+
+		printf("%d entries per run, %d B JSON buffer, %d B chunks\n\n", count, TELEMETRY_DATA_JSON_OUTPUT_BUFF_SIZE,
+			HTTP_BODY_CHUNK_SIZE);
+		printf("%16s %4s | %-6s | %6s %5s %7s | %9s %7s | %9s %6s\n", "type", "file", "mode", "reqs", "cut",
+			"B/req", "sent B/req", "framing", "entries/s", "RAM B");
+
+		int file_sizes[][4] = {
+			{WATER_SENSOR_DATA_ENTRIES_PER_SUBMIT_REQ, ATMOS41_DATA_ENTRIES_PER_SUBMIT_REQ,
+				FO_DATA_STORE_ENTRIES_PER_SUBMIT_REQ, LOG_ENTRIES_PER_SUBMIT_REQ},
+			{STREAM_BODY_BENCH_LARGE_FILE_ENTRIES, STREAM_BODY_BENCH_LARGE_FILE_ENTRIES,
+				STREAM_BODY_BENCH_LARGE_FILE_ENTRIES, STREAM_BODY_BENCH_LARGE_FILE_ENTRIES}
+		};
+
+		for(int i = 0; i < 2; i++)
+		{
+			if(stream_body_bench_run<WaterSensorData::Entry, TbWaterSensorDataJsonBuilder>("WaterSensorData",
+				WATER_SENSOR_DATA_PATH, file_sizes[i][0], count) != RET_OK)
+			{
+				ret = RET_ERROR;
+			}
+
+			if(stream_body_bench_run<Atmos41Data::Entry, TbAtmos41DataJsonBuilder>("Atmos41Data",
+				ATMOS41_DATA_PATH, file_sizes[i][1], count) != RET_OK)
+			{
+				ret = RET_ERROR;
+			}
+
+			if(stream_body_bench_run<FoData::StoreEntry, TbFoDataJsonBuilder>("FoData",
+				FO_DATA_STORE_PATH, file_sizes[i][2], count) != RET_OK)
+			{
+				ret = RET_ERROR;
+			}
+
+			if(stream_body_bench_run<Log::Entry, TbLogJsonBuilder>("Log",
+				LOG_DATA_PATH, file_sizes[i][3], count) != RET_OK)
+			{
+				ret = RET_ERROR;
+			}
+		}
+
+		return ret;
+	}
+} // Bench
@@ -0,0 +1,374 @@
+#include "bench.h"
+#include "bench_data.h"
+#include "Arduino.h"
+#include "SPIFFS.h"
+#include <limits.h>
+#include "data_store.h"
+#include "data_store_reader.h"
+#include "flash.h"
+#include "tb_water_sensor_data_json_builder.h"
+#include "tb_fo_data_json_builder.h"
+
+/******************************************************************************
+ * Telemetry submission over a lossy link
+ * A backlog is submitted in call home sessions the way
+ * CallHome::submit_stored_telemetry does, over a link that drops requests
+ * with a probability growing with their size. Sessions run until the backlog
+ * is empty. Compared:
+ * - file: a file per request, deleted only when its request succeeds (as the
+ *   firmware did before reader acks)
+ * - ack: requests shrink after failures and grow back after successes, the
+ *   entries of every successful request are acked, so retries only resend
+ *   what wasn't acked
+ * Reports bytes on air, incl. bytes of requests cut by the link.
+ * Also checks that entries added to a file after all of it was acked are
+ * read after a reboot, when Flash::ls() loads the manifest before the store.
+ ******************************************************************************/
+namespace Bench
+{
+	/** Backlog per run */
+	const int SUBMIT_BENCH_ENTRIES = 2000;
+
+	/** HTTP headers and TCP setup, sent with every request */
+	const int SUBMIT_BENCH_REQ_OVERHEAD = 400;
+
+	/** Sessions before giving up on emptying the backlog */
+	const int SUBMIT_BENCH_MAX_SESSIONS = 2000;
+
+	/** Chance a 1 KiB request goes through, from good to poor coverage */
+	const double SUBMIT_BENCH_KB_SUCCESS[] = {0.99, 0.9, 0.7, 0.5, 0.3};
+
+	/** Partition size for benchmarks */
+	const size_t SUBMIT_BENCH_FS_CAPACITY = 64 * 1024 * 1024;
+
+	/** Entries acked, then added to the same file before the reboot */
+	const int SUBMIT_BENCH_REBOOT_ACKED = 4;
+	const int SUBMIT_BENCH_REBOOT_ADDED = 2;
+
+	/******************************************************************************
+	 * Link that cuts every byte with the same probability. A cut request has
+	 * still used air time up to the cut.
+	 ******************************************************************************/
+	class LossyLink
+	{
+	public:
+		LossyLink(double kb_success)
+		{
+			_loss_per_byte = 1.0 - pow(kb_success, 1.0 / 1024);
+		}
+
+		bool send(int size)
+		{
+			size += SUBMIT_BENCH_REQ_OVERHEAD;
+			requests++;
+
+			// Bytes until first lost one (geometric)
+			double u = (next_rand() + 1.0) / 4294967297.0;
+			double bytes_until_loss = log(u) / log(1.0 - _loss_per_byte);
+
+			if(bytes_until_loss < size)
+			{
+				bytes_on_air += (uint64_t)bytes_until_loss;
+				failed++;
+				return false;
+			}
+
+			bytes_on_air += size;
+			return true;
+		}
+
+		uint64_t bytes_on_air = 0;
+		int requests = 0;
+		int failed = 0;
+
+	private:
+		uint32_t next_rand()
+		{
+			_state = _state * 1664525 + 1013904223;
+			return _state;
+		}
+
+		double _loss_per_byte;
+		uint32_t _state = 12345;
+	};
+
+	/******************************************************************************
+	 * A call home session, mirrors CallHome::submit_stored_telemetry
+	 * @param ack Ack submitted entries and shrink requests after failures
+	 * @param delivered Incremented with entries that went through
+	 ******************************************************************************/
+	template <typename TEntry, typename TBuilder>
+	void submit_session(DataStore<TEntry> *store, LossyLink *link, bool ack, int *delivered)
+	{
+		TBuilder json_builder;
+		char json_buff[TELEMETRY_DATA_JSON_OUTPUT_BUFF_SIZE] = {0};
+		DataStoreReader<TEntry> reader(store);
+		typename DataStore<TEntry>::Entry entries[DATA_STORE_READ_BLOCK_ENTRIES];
+		DataStoreSpan<TEntry> span(entries, DATA_STORE_READ_BLOCK_ENTRIES);
+
+		int req_max_entries = ack ? store->get_max_entries_per_file() : INT_MAX;
+		int failed_requests = 0;
+
+		json_builder.reset();
+
+		while(reader.next_file())
+		{
+			int cur_req_entries = 0;
+			bool file_failed = false;
+			bool more_entries = true;
+
+			do
+			{
+				more_entries = reader.next_entries(&span, req_max_entries - cur_req_entries);
+
+				for(int i = 0; i < span.count; i++)
+					json_builder.add(span.get(i));
+
+				cur_req_entries += span.count;
+
+				if(more_entries && cur_req_entries < req_max_entries)
+					continue;
+
+				if(cur_req_entries == 0)
+					continue;
+
+				json_builder.build(json_buff, sizeof(json_buff), false);
+
+				if(link->send(strlen(json_buff)))
+				{
+					if(ack)
+					{
+						reader.ack();
+
+						req_max_entries *= 2;
+						if(req_max_entries > store->get_max_entries_per_file())
+							req_max_entries = store->get_max_entries_per_file();
+					}
+
+					*delivered += cur_req_entries;
+				}
+				else
+				{
+					if(ack)
+					{
+						req_max_entries /= 2;
+						if(req_max_entries < TELEMETRY_MIN_ENTRIES_PER_REQ)
+							req_max_entries = TELEMETRY_MIN_ENTRIES_PER_REQ;
+					}
+
+					failed_requests++;
+					file_failed = true;
+				}
+
+				json_builder.reset();
+				cur_req_entries = 0;
+			} while(more_entries && !file_failed);
+
+			if(!file_failed)
+				reader.delete_file();
+			else if(failed_requests >= FAILED_TELEMETRY_REQ_THRESHOLD)
+				break;
+		}
+	}
+
+	/******************************************************************************
+	 * Submit a whole backlog in sessions
+	 * @return RET_ERROR if backlog not emptied or entries delivered != added
+	 ******************************************************************************/
+	template <typename TEntry, typename TBuilder>
+	RetResult bench_submit_run(const char *path, int entries_per_file, int interval_sec,
+		const DataStore<TEntry> *firmware_store, bool ack, LossyLink *link, int *sessions)
+	{
+		SPIFFS.format();
+		DataStoreManifest::unload_all();
+
+		int layout_field_count = 0;
+		const DataStoreCodec::Field *layout = firmware_store->get_encoding(&layout_field_count);
+
+		DataStore<TEntry> store(path, entries_per_file, layout, layout_field_count);
+		TEntry entry;
+
+		int count = get_max_entries() < SUBMIT_BENCH_ENTRIES ? get_max_entries() : SUBMIT_BENCH_ENTRIES;
+
+		for(int i = 0; i < count; i++)
+		{
+			NativeClock::advance_ms((uint64_t)interval_sec * 1000);
+			BenchData::fill(&entry, 1600000000 + i * interval_sec, i);
+			store.add(&entry);
+			store.commit();
+		}
+
+		int delivered = 0;
+
+		for(*sessions = 0; *sessions < SUBMIT_BENCH_MAX_SESSIONS && delivered < count; (*sessions)++)
+			submit_session<TEntry, TBuilder>(&store, link, ack, &delivered);
+
+		if(delivered != count)
+		{
+			printf("Delivered %d/%d entries in %d sessions\n", delivered, count, *sessions);
+			return RET_ERROR;
+		}
+
+		// Nothing must be left to read
+		DataStoreReader<TEntry> reader(&store);
+		while(reader.next_file())
+		{
+			if(reader.next_entry() != NULL)
+			{
+				printf("Entries left in store after delivering all\n");
+				return RET_ERROR;
+			}
+		}
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * Compare strategies over links from good to poor for a store type
+	 ******************************************************************************/
+	template <typename TEntry, typename TBuilder>
+	RetResult bench_submit_type(const char *name, const char *path, int entries_per_file, int interval_sec,
+		const DataStore<TEntry> *firmware_store)
+	{
+		int count = get_max_entries() < SUBMIT_BENCH_ENTRIES ? get_max_entries() : SUBMIT_BENCH_ENTRIES;
+
+		printf("\n%s - entries: %d, entries/file: %d, request overhead: %d B\n", name, count,
+			entries_per_file, SUBMIT_BENCH_REQ_OVERHEAD);
+		printf("%7s %5s | %8s %8s %7s | %10s %8s %6s\n",
+			"1KiB ok", "mode", "sessions", "requests", "failed", "on air", "B/entry", "ratio");
+
+		for(unsigned int i = 0; i < sizeof(SUBMIT_BENCH_KB_SUCCESS) / sizeof(SUBMIT_BENCH_KB_SUCCESS[0]); i++)
+		{
+			uint64_t file_bytes = 0;
+
+			for(int mode = 0; mode < 2; mode++)
+			{
+				bool ack = mode == 1;
+				LossyLink link(SUBMIT_BENCH_KB_SUCCESS[i]);
+				int sessions = 0;
+
+				if(bench_submit_run<TEntry, TBuilder>(path, entries_per_file, interval_sec, firmware_store,
+					ack, &link, &sessions) != RET_OK)
+				{
+					return RET_ERROR;
+				}
+
+				if(!ack)
+					file_bytes = link.bytes_on_air;
+
+				printf("%7.2f %5s | %8d %8d %7d | %10llu %8.1f %6.2f\n",
+					SUBMIT_BENCH_KB_SUCCESS[i], ack ? "ack" : "file", sessions, link.requests, link.failed,
+					(unsigned long long)link.bytes_on_air, (double)link.bytes_on_air / count,
+					(double)link.bytes_on_air / file_bytes);
+			}
+		}
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * Ack a whole file, add entries to it and reboot (new store object, counts
+	 * kept in RAM lost). Flash::ls() loads the manifest first, as at boot. The
+	 * added entries must be read and nothing else.
+	 ******************************************************************************/
+	RetResult bench_submit_ack_reboot()
+	{
+		SPIFFS.format();
+		DataStoreManifest::unload_all();
+
+		WaterSensorData::Entry entry;
+		int seq = 0;
+
+		{
+			DataStore<WaterSensorData::Entry> store(WATER_SENSOR_DATA_PATH, WATER_SENSOR_DATA_ENTRIES_PER_SUBMIT_REQ);
+
+			for(; seq < SUBMIT_BENCH_REBOOT_ACKED; seq++)
+			{
+				NativeClock::advance_ms(600 * 1000);
+				BenchData::fill(&entry, 1600000000 + seq * 600, seq);
+				store.add(&entry);
+				store.commit();
+			}
+
+			DataStoreReader<WaterSensorData::Entry> reader(&store);
+			if(!reader.next_file())
+			{
+				printf("No file to ack\n");
+				return RET_ERROR;
+			}
+
+			while(reader.next_entry() != NULL)
+				;
+
+			reader.ack();
+
+			for(; seq < SUBMIT_BENCH_REBOOT_ACKED + SUBMIT_BENCH_REBOOT_ADDED; seq++)
+			{
+				NativeClock::advance_ms(600 * 1000);
+				BenchData::fill(&entry, 1600000000 + seq * 600, seq);
+				store.add(&entry);
+				store.commit();
+			}
+		}
+
+		DataStore<WaterSensorData::Entry> store(WATER_SENSOR_DATA_PATH, WATER_SENSOR_DATA_ENTRIES_PER_SUBMIT_REQ);
+
+		Flash::ls();
+
+		DataStoreReader<WaterSensorData::Entry> reader(&store);
+		const WaterSensorData::Entry *read_entry = NULL;
+		int read = 0;
+		bool order_ok = true;
+
+		while(reader.next_file())
+		{
+			while((read_entry = reader.next_entry()))
+			{
+				if(read_entry->timestamp != (uint32_t)(1600000000 + (SUBMIT_BENCH_REBOOT_ACKED + read) * 600))
+					order_ok = false;
+
+				read++;
+			}
+		}
+
+		printf("\nAck file, add %d entries, reboot, Flash::ls, read: %d entries read\n",
+			SUBMIT_BENCH_REBOOT_ADDED, read);
+
+		if(read != SUBMIT_BENCH_REBOOT_ADDED || !order_ok)
+		{
+			printf("Entries added after ack not read back after reboot\n");
+			return RET_ERROR;
+		}
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * Benchmark submission of the stores sent as telemetry
+	 ******************************************************************************/
+	RetResult submit()
+	{
+		RetResult ret = RET_OK;
+
+		NativeFs::set_capacity(SUBMIT_BENCH_FS_CAPACITY);
+
+		if(bench_submit_type<WaterSensorData::Entry, TbWaterSensorDataJsonBuilder>("WaterSensorData",
+			WATER_SENSOR_DATA_PATH, WATER_SENSOR_DATA_ENTRIES_PER_SUBMIT_REQ, 600, WaterSensorData::get_store()) != RET_OK)
+		{
+			ret = RET_ERROR;
+		}
+
+		if(bench_submit_type<FoData::StoreEntry, TbFoDataJsonBuilder>("FoData",
+			FO_DATA_STORE_PATH, FO_DATA_STORE_ENTRIES_PER_SUBMIT_REQ, 1800, FoData::get_store()) != RET_OK)
+		{
+			ret = RET_ERROR;
+		}
+
+		if(bench_submit_ack_reboot() != RET_OK)
+			ret = RET_ERROR;
+
+		SPIFFS.format();
+
+		return ret;
+	}
+} // Bench
@@ -0,0 +1,197 @@
+#include "bench.h"
+#include "bench_data.h"
+#include "Arduino.h"
+#include "entry_schema.h"
+#include "telemetry_decoder.h"
+#include "tb_water_sensor_data_json_builder.h"
+#include "tb_atmos41_data_json_builder.h"
+#include "tb_soil_moisture_data_json_builder.h"
+#include "tb_lightning_data_json_builder.h"
+#include "tb_fo_data_json_builder.h"
+#include "water_sensor_data_cbor_builder.h"
+#include "atmos41_data_cbor_builder.h"
+#include "soil_moisture_data_cbor_builder.h"
+#include "lightning_data_cbor_builder.h"
+#include "fo_data_cbor_builder.h"
+
+/******************************************************************************
+ * Binary telemetry encoding
+ * Builds the requests of a backlog, a request at a time as call home does,
+ * with the TB JSON builder and the CBOR builder of every entry type. Every
+ * CBOR request is decoded back by the host telemetry decoder, which must
+ * give the same JSON as the JSON builder.
+ * Reports build rate and bytes per entry of both and decode rate.
+ ******************************************************************************/
+namespace Bench
+{
+	/** Entries per type */
+	const int TELEMETRY_ENCODING_BENCH_ENTRIES = 20000;
+
+	/** Seconds between entries */
+	const int TELEMETRY_ENCODING_BENCH_INTERVAL_SEC = 600;
+
+	/******************************************************************************
+	 * Build JSON and CBOR requests of a type and decode CBOR ones
+	 ******************************************************************************/
+	template <typename TEntry, typename TJsonBuilder, typename TCborBuilder>
+	RetResult telemetry_encoding_bench_type(const char *name, int entries_per_req, int count)
+	{
+		TEntry *entries = new TEntry[count];
+		for(int i = 0; i < count; i++)
+			BenchData::fill(&entries[i], 1600000000 + i * TELEMETRY_ENCODING_BENCH_INTERVAL_SEC, i);
+
+		int requests = (count + entries_per_req - 1) / entries_per_req;
+
+		//
+		// JSON
+		//
+		TJsonBuilder *json_builder = new TJsonBuilder();
+		char *json = new char[requests * TELEMETRY_DATA_JSON_OUTPUT_BUFF_SIZE];
+		uint64_t json_bytes = 0;
+		int failed_adds = 0;
+
+		uint64_t t_start = now_us();
+
+		for(int req = 0; req < requests; req++)
+		{
+			json_builder->reset();
+
+			for(int i = req * entries_per_req; i < (req + 1) * entries_per_req && i < count; i++)
+			{
+				if(json_builder->add(&entries[i]) != RET_OK)
+					failed_adds++;
+			}
+
+			char *req_json = json + req * TELEMETRY_DATA_JSON_OUTPUT_BUFF_SIZE;
+			json_builder->build(req_json, TELEMETRY_DATA_JSON_OUTPUT_BUFF_SIZE, false);
+			json_bytes += strlen(req_json);
+		}
+
+		uint64_t json_us = now_us() - t_start;
+
+		//
+		// CBOR
+		//
+		TCborBuilder *cbor_builder = new TCborBuilder();
+		const int cbor_buff_size = TELEMETRY_CBOR_BUFF_SIZE + 32;
+		uint8_t *cbor = new uint8_t[requests * cbor_buff_size];
+		int *cbor_sizes = new int[requests];
+		uint64_t cbor_bytes = 0;
+
+		t_start = now_us();
+
+		for(int req = 0; req < requests; req++)
+		{
+			cbor_builder->reset();
+
+			for(int i = req * entries_per_req; i < (req + 1) * entries_per_req && i < count; i++)
+			{
+				if(cbor_builder->add(&entries[i]) != RET_OK)
+					failed_adds++;
+			}
+
+			cbor_builder->build(cbor + req * cbor_buff_size, cbor_buff_size, &cbor_sizes[req]);
+			cbor_bytes += cbor_sizes[req];
+		}
+
+		uint64_t cbor_us = now_us() - t_start;
+
+		//
+		// Decode, JSON must match
+		//
+		char decoded[TELEMETRY_DATA_JSON_OUTPUT_BUFF_SIZE];
+		int mismatches = 0;
+		int decoded_entries = 0;
+
+		t_start = now_us();
+
+		for(int req = 0; req < requests; req++)
+		{
+			int entry_count = 0;
+
+			if(TelemetryDecoder::to_tb_json(cbor + req * cbor_buff_size, cbor_sizes[req], decoded,
+				sizeof(decoded), &entry_count) != RET_OK ||
+				strcmp(decoded, json + req * TELEMETRY_DATA_JSON_OUTPUT_BUFF_SIZE) != 0)
+			{
+				if(mismatches == 0)
+				{
+					printf("First mismatch, request %d:\n  json:    %s\n  decoded: %s\n", req,
+						json + req * TELEMETRY_DATA_JSON_OUTPUT_BUFF_SIZE, decoded);
+				}
+
+				mismatches++;
+			}
+
+			decoded_entries += entry_count;
+		}
+
+		uint64_t decode_us = now_us() - t_start;
+
+		printf("%16s | %9.0f %9.1f | %9.0f %9.1f %6.1f%% | %9.0f %10d\n", name,
+			rate(count, json_us), (double)json_bytes / count,
+			rate(count, cbor_us), (double)cbor_bytes / count, 100.0 * cbor_bytes / json_bytes,
+			rate(decoded_entries, decode_us), mismatches);
+
+		delete json_builder;
+		delete cbor_builder;
+		delete[] json;
+		delete[] cbor;
+		delete[] cbor_sizes;
+		delete[] entries;
+
+		if(failed_adds > 0 || mismatches > 0 || decoded_entries != count)
+		{
+			printf("Failed adds: %d, mismatched requests: %d, decoded entries: %d\n", failed_adds, mismatches,
+				decoded_entries);
+			return RET_ERROR;
+		}
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * Benchmark binary telemetry encoding against JSON
+	 ******************************************************************************/
+	RetResult telemetry_encoding()
+	{
+		int count = get_max_entries() < TELEMETRY_ENCODING_BENCH_ENTRIES ?
+			get_max_entries() : TELEMETRY_ENCODING_BENCH_ENTRIES;
+		RetResult ret = RET_OK;
+
+		printf("%d entries per type\n\n", count);
+		printf("%16s | %9s %9s | %9s %9s %7s | %9s %10s\n", "type", "json/s", "B/entry",
+			"cbor/s", "B/entry", "of json", "decode/s", "mismatches");
+
+		if(telemetry_encoding_bench_type<WaterSensorData::Entry, TbWaterSensorDataJsonBuilder,
+			WaterSensorDataCborBuilder>("WaterSensorData", WATER_SENSOR_DATA_ENTRIES_PER_SUBMIT_REQ, count) != RET_OK)
+		{
+			ret = RET_ERROR;
+		}
+
+		if(telemetry_encoding_bench_type<Atmos41Data::Entry, TbAtmos41DataJsonBuilder,
+			Atmos41DataCborBuilder>("Atmos41Data", ATMOS41_DATA_ENTRIES_PER_SUBMIT_REQ, count) != RET_OK)
+		{
+			ret = RET_ERROR;
+		}
+
+		if(telemetry_encoding_bench_type<SoilMoistureData::Entry, TbSoilMoistureDataJsonBuilder,
+			SoilMoistureDataCborBuilder>("SoilMoistureData", SOIL_MOISTURE_DATA_ENTRIES_PER_SUBMIT_REQ, count) != RET_OK)
+		{
+			ret = RET_ERROR;
+		}
+
+		if(telemetry_encoding_bench_type<LightningData::Entry, TbLightningDataJsonBuilder,
+			LightningDataCborBuilder>("LightningData", LIGHTNING_DATA_ENTRIES_PER_SUBMIT_REQ, count) != RET_OK)
+		{
+			ret = RET_ERROR;
+		}
+
+		if(telemetry_encoding_bench_type<FoData::StoreEntry, TbFoDataJsonBuilder,
+			FoDataCborBuilder>("FoData", FO_DATA_STORE_ENTRIES_PER_SUBMIT_REQ, count) != RET_OK)
+		{
+			ret = RET_ERROR;
+		}
+
+		return ret;
+	}
+} // Bench
@@ -0,0 +1,26 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench.h"
+
+/******************************************************************************
+ * Native benchmark entry point
+ * Usage: program [max_entries]
+ * FS contents are kept in $NATIVE_FS_ROOT (default /tmp/native_spiffs) which
+ * is formatted by the benchmarks.
+ *****************************************************************************/
+int main(int argc, char *argv[])
+{
+	if(argc > 1)
+	{
+		int max_entries = atoi(argv[1]);
+		if(max_entries < 1)
+		{
+			fprintf(stderr, "Invalid max entries: %s\n", argv[1]);
+			return 1;
+		}
+
+		Bench::set_max_entries(max_entries);
+	}
+
+	return Bench::run_all() == RET_OK ? 0 : 1;
+}
@@ -0,0 +1,382 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <zlib.h>
+#include "const.h"
+#include "telemetry_decoder.h"
+
+/******************************************************************************
+ * Local stand-in for the TB HTTP API that accepts binary (CBOR) telemetry
+ * Usage: program [port] [tb_host tb_port]
+ * POSTs to /api/v1/<token>/telemetry with Content-Type application/cbor are
+ * decoded to TB JSON, other bodies are passed as they are. Bodies may be sent
+ * chunked and gzip compressed (Content-Encoding: gzip). The JSON is
+ * printed and, if a TB host is given, posted to the same path on it, whose
+ * response status is returned to the node. Without a TB host every valid
+ * request gets 200.
+ * One connection is served at a time, one request per connection.
+ *****************************************************************************/
+namespace Gateway
+{
+	const int DEFAULT_PORT = 8080;
+
+	/** Longest request head (request line + headers) */
+	const int MAX_HEAD_SIZE = 4096;
+
+	/** Longest request body, and once decompressed */
+	const int MAX_BODY_SIZE = 64 * 1024;
+	const int MAX_PLAIN_BODY_SIZE = 1024 * 1024;
+
+	/** Longest TB JSON a body is decoded to */
+	const int MAX_JSON_SIZE = 256 * 1024;
+
+	const char TELEMETRY_PATH_PREFIX[] = "/api/v1/";
+	const char TELEMETRY_PATH_POSTFIX[] = "/telemetry";
+
+	struct Request
+	{
+		char method[8];
+		char path[256];
+		char content_type[64];
+		int content_length;
+		bool chunked;
+		bool gzip;
+		int body_size;
+		uint8_t body[MAX_BODY_SIZE];
+	};
+
+	const char *tb_host = NULL;
+	const char *tb_port = NULL;
+
+	char json[MAX_JSON_SIZE];
+
+	uint8_t plain_body[MAX_PLAIN_BODY_SIZE];
+
+	/******************************************************************************
+	 * Read bytes until a delimiter, which is not kept
+	 * @return Bytes read, -1 on error or if buffer is full
+	 *****************************************************************************/
+	int read_until(int sock, char *buff, int buff_size, const char *delimiter)
+	{
+		int size = 0;
+		int delimiter_len = strlen(delimiter);
+
+		while(size < buff_size - 1)
+		{
+			if(recv(sock, buff + size, 1, 0) != 1)
+				return -1;
+
+			size++;
+			buff[size] = '\0';
+
+			if(size >= delimiter_len && strcmp(buff + size - delimiter_len, delimiter) == 0)
+			{
+				size -= delimiter_len;
+				buff[size] = '\0';
+				return size;
+			}
+		}
+
+		return -1;
+	}
+
+	bool read_body(int sock, uint8_t *body, int size)
+	{
+		int received = 0;
+
+		while(received < size)
+		{
+			int ret = recv(sock, body + received, size - received, 0);
+			if(ret <= 0)
+				return false;
+
+			received += ret;
+		}
+
+		return true;
+	}
+
+	/******************************************************************************
+	 * Read a body sent with chunked transfer encoding
+	 * @return Body size, -1 on error or if too long
+	 *****************************************************************************/
+	int read_chunked_body(int sock, uint8_t *body, int max_size)
+	{
+		int size = 0;
+		char line[32];
+
+		while(true)
+		{
+			if(read_until(sock, line, sizeof(line), "\r\n") < 0)
+				return -1;
+
+			int chunk_size = strtol(line, NULL, 16);
+			if(chunk_size < 0 || chunk_size > max_size - size)
+				return -1;
+
+			// Last chunk, no trailers are sent
+			if(chunk_size == 0)
+				return read_until(sock, line, sizeof(line), "\r\n") == 0 ? size : -1;
+
+			if(!read_body(sock, body + size, chunk_size) || read_until(sock, line, sizeof(line), "\r\n") != 0)
+				return -1;
+
+			size += chunk_size;
+		}
+	}
+
+	/******************************************************************************
+	 * Decompress a gzip body
+	 * @return Decompressed size, -1 if not valid gzip or too long
+	 *****************************************************************************/
+	int gunzip(const uint8_t *data, int size, uint8_t *out, int out_size)
+	{
+		z_stream stream;
+		memset(&stream, 0, sizeof(stream));
+
+		// gzip wrapper only
+		if(inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK)
+			return -1;
+
+		stream.next_in = (Bytef*)data;
+		stream.avail_in = size;
+		stream.next_out = out;
+		stream.avail_out = out_size;
+
+		int ret = inflate(&stream, Z_FINISH);
+		int out_len = stream.total_out;
+
+		inflateEnd(&stream);
+
+		return ret == Z_STREAM_END ? out_len : -1;
+	}
+
+	/******************************************************************************
+	 * Read a request, headers other than content type, length, transfer and
+	 * content encoding are dropped
+	 *****************************************************************************/
+	bool read_request(int sock, Request *req)
+	{
+		char head[MAX_HEAD_SIZE];
+		memset(req, 0, sizeof(Request) - sizeof(req->body));
+
+		if(read_until(sock, head, sizeof(head), "\r\n\r\n") < 0)
+			return false;
+
+		char *save = NULL;
+		char *line = strtok_r(head, "\r\n", &save);
+
+		if(line == NULL || sscanf(line, "%7s %255s", req->method, req->path) != 2)
+			return false;
+
+		while((line = strtok_r(NULL, "\r\n", &save)) != NULL)
+		{
+			if(strncasecmp(line, "Content-Length:", 15) == 0)
+				req->content_length = atoi(line + 15);
+			else if(strncasecmp(line, "Content-Type:", 13) == 0)
+				sscanf(line + 13, " %63[^;\r\n]", req->content_type);
+			else if(strncasecmp(line, "Transfer-Encoding:", 18) == 0)
+				req->chunked = strcasestr(line + 18, "chunked") != NULL;
+			else if(strncasecmp(line, "Content-Encoding:", 17) == 0)
+				req->gzip = strcasestr(line + 17, "gzip") != NULL;
+		}
+
+		if(req->chunked)
+		{
+			req->body_size = read_chunked_body(sock, req->body, MAX_BODY_SIZE);
+			return req->body_size >= 0;
+		}
+
+		if(req->content_length < 0 || req->content_length > MAX_BODY_SIZE)
+			return false;
+
+		req->body_size = req->content_length;
+
+		return read_body(sock, req->body, req->content_length);
+	}
+
+	void send_response(int sock, int status, const char *reason)
+	{
+		char resp[128];
+		int size = snprintf(resp, sizeof(resp), "HTTP/1.1 %d %s\r\nContent-Length: 0\r\nConnection: close\r\n\r\n",
+			status, reason);
+
+		send(sock, resp, size, 0);
+	}
+
+	bool is_telemetry_path(const char *path)
+	{
+		int path_len = strlen(path);
+		int prefix_len = strlen(TELEMETRY_PATH_PREFIX);
+		int postfix_len = strlen(TELEMETRY_PATH_POSTFIX);
+
+		return path_len > prefix_len + postfix_len &&
+			strncmp(path, TELEMETRY_PATH_PREFIX, prefix_len) == 0 &&
+			strcmp(path + path_len - postfix_len, TELEMETRY_PATH_POSTFIX) == 0;
+	}
+
+	/******************************************************************************
+	 * Post JSON to TB
+	 * @return HTTP status of response, -1 if TB couldn't be reached
+	 *****************************************************************************/
+	int forward(const char *path, const char *body, int body_size)
+	{
+		struct addrinfo hints, *addr = NULL;
+		memset(&hints, 0, sizeof(hints));
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+
+		if(getaddrinfo(tb_host, tb_port, &hints, &addr) != 0)
+			return -1;
+
+		int sock = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+		if(sock < 0 || connect(sock, addr->ai_addr, addr->ai_addrlen) != 0)
+		{
+			if(sock >= 0)
+				close(sock);
+			freeaddrinfo(addr);
+			return -1;
+		}
+		freeaddrinfo(addr);
+
+		char head[512];
+		int head_size = snprintf(head, sizeof(head),
+			"POST %s HTTP/1.1\r\nHost: %s\r\nContent-Type: application/json\r\n"
+			"Content-Length: %d\r\nConnection: close\r\n\r\n", path, tb_host, body_size);
+
+		int status = -1;
+		char status_line[128];
+
+		if(send(sock, head, head_size, 0) == head_size && send(sock, body, body_size, 0) == body_size &&
+			read_until(sock, status_line, sizeof(status_line), "\r\n") > 0)
+		{
+			sscanf(status_line, "HTTP/%*s %d", &status);
+		}
+
+		close(sock);
+		return status;
+	}
+
+	/******************************************************************************
+	 * Serve a connection
+	 *****************************************************************************/
+	void serve(int sock)
+	{
+		static Request req;
+
+		if(!read_request(sock, &req))
+		{
+			send_response(sock, 400, "Bad Request");
+			return;
+		}
+
+		if(strcmp(req.method, "POST") != 0 || !is_telemetry_path(req.path))
+		{
+			send_response(sock, 404, "Not Found");
+			return;
+		}
+
+		const uint8_t *data = req.body;
+		int data_size = req.body_size;
+
+		if(req.gzip)
+		{
+			data_size = gunzip(req.body, req.body_size, plain_body, sizeof(plain_body));
+
+			if(data_size < 0)
+			{
+				printf("Could not decompress %d byte gzip request.\n", req.body_size);
+				send_response(sock, 400, "Bad Request");
+				return;
+			}
+
+			printf("gzip: %d bytes -> %d bytes (%.2fx)\n", req.body_size, data_size,
+				(double)data_size / req.body_size);
+
+			data = plain_body;
+		}
+
+		const char *body = (const char*)data;
+		int body_size = data_size;
+
+		if(strcmp(req.content_type, TELEMETRY_CBOR_CONTENT_TYPE) == 0)
+		{
+			int entries = 0;
+
+			if(TelemetryDecoder::to_tb_json(data, data_size, json, sizeof(json), &entries) != RET_OK)
+			{
+				printf("Could not decode %d byte CBOR request.\n", data_size);
+				send_response(sock, 400, "Bad Request");
+				return;
+			}
+
+			printf("%s: %d entries, %d bytes CBOR -> %d bytes JSON\n",
+				TelemetryDecoder::get_type_name(data, data_size),
+				entries, data_size, (int)strlen(json));
+
+			body = json;
+			body_size = strlen(json);
+		}
+
+		printf("%.*s\n", body_size, body);
+
+		if(tb_host == NULL)
+		{
+			send_response(sock, 200, "OK");
+			return;
+		}
+
+		int status = forward(req.path, body, body_size);
+		if(status < 0)
+			send_response(sock, 502, "Bad Gateway");
+		else
+			send_response(sock, status, status == 200 ? "OK" : "TB Error");
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	int port = argc > 1 ? atoi(argv[1]) : Gateway::DEFAULT_PORT;
+
+	if(argc > 3)
+	{
+		Gateway::tb_host = argv[2];
+		Gateway::tb_port = argv[3];
+	}
+
+	int server = socket(AF_INET, SOCK_STREAM, 0);
+	int reuse = 1;
+	setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	addr.sin_port = htons(port);
+
+	if(server < 0 || bind(server, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(server, 4) != 0)
+	{
+		fprintf(stderr, "Could not listen on port %d\n", port);
+		return 1;
+	}
+
+	printf("Listening on port %d\n", port);
+
+	while(true)
+	{
+		int sock = accept(server, NULL, NULL);
+		if(sock < 0)
+			continue;
+
+		Gateway::serve(sock);
+		close(sock);
+		fflush(stdout);
+	}
+
+	return 0;
+}
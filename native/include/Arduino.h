@@ -0,0 +1,125 @@
+#ifndef NATIVE_ARDUINO_H
+#define NATIVE_ARDUINO_H
+
+/******************************************************************************
+ * Minimal Arduino core stand-in for the native (host) build.
+ * Provides only what the modules built in [env:native] use. Time is driven by
+ * a fake clock (NativeClock) so code that sleeps or timestamps entries can be
+ * exercised deterministically on the host.
+ *****************************************************************************/
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <string>
+
+#define PROGMEM
+#define PSTR(s) (s)
+
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(string_literal))
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+/** Only used as a type by headers pulled in through app_config.h */
+enum gpio_num_t
+{
+	GPIO_NUM_NC = -1
+};
+
+/******************************************************************************
+ * String
+ *****************************************************************************/
+class String
+{
+public:
+	String() {}
+	String(const char *str) : _str(str ? str : "") {}
+	String(const std::string &str) : _str(str) {}
+
+	const char* c_str() const { return _str.c_str(); }
+	unsigned int length() const { return _str.length(); }
+
+	String& operator+=(const String &rhs) { _str += rhs._str; return *this; }
+	String& operator+=(const char *rhs) { _str += rhs; return *this; }
+	bool operator==(const String &rhs) const { return _str == rhs._str; }
+private:
+	std::string _str;
+};
+
+/******************************************************************************
+ * Serial
+ * Writes to stdout. Output can be redirected or muted (NULL) with set_output(),
+ * eg. to keep debug output from skewing benchmark timings.
+ *****************************************************************************/
+class HardwareSerial
+{
+public:
+	HardwareSerial(int uart_nr = 0);
+
+	void begin(unsigned long baud, uint32_t config = 0, int8_t rx_pin = -1, int8_t tx_pin = -1);
+	void flush();
+
+	size_t print(const char *str);
+	size_t print(const String &str);
+	size_t print(const __FlashStringHelper *str);
+	size_t print(char c);
+	size_t print(int val, int base = DEC);
+	size_t print(unsigned int val, int base = DEC);
+	size_t print(long val, int base = DEC);
+	size_t print(unsigned long val, int base = DEC);
+	size_t print(long long val, int base = DEC);
+	size_t print(unsigned long long val, int base = DEC);
+	size_t print(double val, int digits = 2);
+
+	size_t println();
+	template <typename T>
+	size_t println(T val) { size_t n = print(val); return n + println(); }
+	template <typename T>
+	size_t println(T val, int base) { size_t n = print(val, base); return n + println(); }
+
+	int printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+	void set_output(FILE *out);
+private:
+	size_t print_number(unsigned long long val, int base, bool negative);
+
+	FILE *_out;
+};
+
+extern HardwareSerial Serial;
+
+/******************************************************************************
+ * Time
+ *****************************************************************************/
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+
+namespace NativeClock
+{
+	void advance_ms(uint64_t ms);
+
+	void set_epoch(uint32_t epoch);
+
+	uint32_t get_epoch();
+}
+
+/******************************************************************************
+ * Misc
+ *****************************************************************************/
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+
+#endif
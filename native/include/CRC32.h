@@ -0,0 +1,35 @@
+#ifndef NATIVE_CRC32_H
+#define NATIVE_CRC32_H
+
+#include <inttypes.h>
+#include <stddef.h>
+
+/******************************************************************************
+ * Host stand-in for the CRC32 Arduino library (same nibble table algorithm,
+ * bit-compatible with data written by the firmware)
+ *****************************************************************************/
+class CRC32
+{
+public:
+	static uint32_t calculate(const uint8_t *data, size_t size)
+	{
+		static const uint32_t table[16] = {
+			0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac,
+			0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+			0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c,
+			0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c
+		};
+
+		uint32_t state = ~0L;
+
+		for(size_t i = 0; i < size; i++)
+		{
+			state = table[(state ^ data[i]) & 0x0f] ^ (state >> 4);
+			state = table[(state ^ (data[i] >> 4)) & 0x0f] ^ (state >> 4);
+		}
+
+		return ~state;
+	}
+};
+
+#endif
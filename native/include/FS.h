@@ -0,0 +1,139 @@
+#ifndef NATIVE_FS_H
+#define NATIVE_FS_H
+
+/******************************************************************************
+ * Host stand-in for the arduino-esp32 FS API (fs::FS / fs::File).
+ * Every file system object (SPIFFS, LITTLEFS, RAMFS) is an fs::FS backed by
+ * its own FSImpl, which models how that file system lays files out and lists
+ * dirs. Host backed ones keep files in a single flat host directory:
+ * "/was/1577836800_0" is stored as one escaped file name. On SPIFFS "dirs"
+ * are path prefixes matched by scanning every file, on LittleFS they are
+ * real and must be created.
+ *****************************************************************************/
+
+#include "Arduino.h"
+#include <memory>
+
+#define FILE_READ       "r"
+#define FILE_WRITE      "w"
+#define FILE_APPEND     "a"
+
+namespace fs
+{
+	enum SeekMode
+	{
+		SeekSet = 0,
+		SeekCur = 1,
+		SeekEnd = 2
+	};
+
+	class FileImpl;
+	class FSImpl;
+
+	class File
+	{
+	public:
+		File() {}
+		File(std::shared_ptr<FileImpl> impl) : _impl(impl) {}
+
+		operator bool() const;
+
+		size_t write(uint8_t c);
+		size_t write(const uint8_t *buf, size_t size);
+
+		int available();
+		int read();
+		size_t read(uint8_t *buf, size_t size);
+		size_t readBytes(char *buffer, size_t length);
+
+		bool seek(uint32_t pos, SeekMode mode = SeekSet);
+		size_t position() const;
+		size_t size() const;
+		void flush();
+		void close();
+
+		const char* name() const;
+
+		bool isDirectory();
+		File openNextFile(const char *mode = FILE_READ);
+		void rewindDirectory();
+	private:
+		std::shared_ptr<FileImpl> _impl;
+	};
+
+	class FS
+	{
+	public:
+		FS(FSImpl *impl) : _impl(impl) {}
+
+		File open(const char *path, const char *mode = FILE_READ);
+		File open(const String &path, const char *mode = FILE_READ) { return open(path.c_str(), mode); }
+
+		bool exists(const char *path);
+		bool remove(const char *path);
+		bool rename(const char *path_from, const char *path_to);
+		bool mkdir(const char *path);
+		bool rmdir(const char *path);
+
+		FSImpl* get_impl() const { return _impl; }
+	protected:
+		FSImpl *_impl;
+	};
+}
+
+using fs::File;
+using fs::FS;
+using fs::SeekMode;
+using fs::SeekSet;
+using fs::SeekCur;
+using fs::SeekEnd;
+
+/******************************************************************************
+ * Native FS control and instrumentation
+ * Counters follow what the firmware asks of the file system, not what the host
+ * does to implement it (eg. every file handed out by openNextFile() counts as
+ * an open, as it does on SPIFFS, even though the host opens it lazily).
+ * Functions apply to the file system selected with select(), SPIFFS unless
+ * changed.
+ *****************************************************************************/
+namespace NativeFs
+{
+	struct Stats
+	{
+		/** Regular files opened (incl. openNextFile()) */
+		uint32_t opens;
+		/** Files created */
+		uint32_t creates;
+		/** Files removed */
+		uint32_t removes;
+		/** Dirs opened for iteration */
+		uint32_t dir_opens;
+		/** Entries visited for dir iteration (every file on the partition for SPIFFS) */
+		uint64_t dir_entries_scanned;
+		/** write() calls reaching the FS */
+		uint32_t write_calls;
+		/** Bytes written */
+		uint64_t bytes_written;
+		/** Flash pages (256 B) programmed by writes. SPIFFS: data pages touched +
+		 * index page. LittleFS: inline data or copied last block + metadata. */
+		uint64_t pages_programmed;
+		/** read() calls reaching the FS */
+		uint32_t read_calls;
+		/** Bytes read */
+		uint64_t bytes_read;
+	};
+
+	void select(fs::FS *fs);
+
+	void set_root(const char *host_dir);
+
+	void set_capacity(size_t bytes);
+
+	const Stats* get_stats();
+
+	void reset_stats();
+
+	uint32_t get_file_count();
+}
+
+#endif
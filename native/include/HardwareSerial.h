@@ -0,0 +1,6 @@
+#ifndef NATIVE_HARDWARE_SERIAL_H
+#define NATIVE_HARDWARE_SERIAL_H
+
+#include "Arduino.h"
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef NATIVE_LITTLEFS_H
+#define NATIVE_LITTLEFS_H
+
+#include "FS.h"
+
+/******************************************************************************
+ * Stand-in for LITTLEFS of the LittleFS_esp32 library
+ *****************************************************************************/
+class LITTLEFSFS : public fs::FS
+{
+public:
+	LITTLEFSFS();
+
+	bool begin(bool format_on_fail = false, const char *base_path = "/littlefs", uint8_t max_open_files = 10,
+		const char *partition_label = "spiffs");
+	bool format();
+	size_t totalBytes();
+	size_t usedBytes();
+	void end();
+};
+
+extern LITTLEFSFS LITTLEFS;
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef NATIVE_LORALIB_H
+#define NATIVE_LORALIB_H
+
+// FO sniffer radio is not available on host, header only satisfies includes
+
+#endif
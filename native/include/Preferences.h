@@ -0,0 +1,12 @@
+#ifndef NATIVE_PREFERENCES_H
+#define NATIVE_PREFERENCES_H
+
+/******************************************************************************
+ * NVS is not available on host. DeviceConfig is replaced by a stub in the
+ * native build, this only satisfies includes.
+ *****************************************************************************/
+class Preferences
+{
+};
+
+#endif
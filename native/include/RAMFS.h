@@ -0,0 +1,24 @@
+#ifndef NATIVE_RAMFS_H
+#define NATIVE_RAMFS_H
+
+#include "FS.h"
+
+/******************************************************************************
+ * File system kept in host RAM, native only. Contents survive end() but not
+ * the process. Has dirs, no flash wear.
+ *****************************************************************************/
+class RAMFSFS : public fs::FS
+{
+public:
+	RAMFSFS();
+
+	bool begin(bool format_on_fail = false);
+	bool format();
+	size_t totalBytes();
+	size_t usedBytes();
+	void end();
+};
+
+extern RAMFSFS RAMFS;
+
+#endif
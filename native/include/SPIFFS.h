@@ -0,0 +1,20 @@
+#ifndef NATIVE_SPIFFS_H
+#define NATIVE_SPIFFS_H
+
+#include "FS.h"
+
+class SPIFFSFS : public fs::FS
+{
+public:
+	SPIFFSFS();
+
+	bool begin(bool format_on_fail = false, const char *base_path = "/spiffs", uint8_t max_open_files = 10);
+	bool format();
+	size_t totalBytes();
+	size_t usedBytes();
+	void end();
+};
+
+extern SPIFFSFS SPIFFS;
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef NATIVE_CREDENTIALS_H
+#define NATIVE_CREDENTIALS_H
+
+// Used only when include/credentials.h has not been created. The native build
+// never talks to a server so the empty template values are enough.
+#include "../../include/credentials.h.template"
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef EMULATED_FLASH_H
+#define EMULATED_FLASH_H
+
+#include <vector>
+#include "raw_flash.h"
+
+/******************************************************************************
+ * RAM backed NOR flash for running flash engines on the host
+ * Enforces NOR semantics (writes can only clear bits, erase is per sector) and
+ * counts operations and per-sector wear. Contents can be saved to/loaded from
+ * a file to emulate a reboot with a different process.
+ ******************************************************************************/
+class EmulatedFlash : public RawFlash
+{
+public:
+    /** Operation counters */
+    struct Stats
+    {
+        uint32_t read_calls;
+        uint64_t bytes_read;
+        uint32_t write_calls;
+        uint64_t bytes_written;
+        uint32_t erases;
+        /** Writes that tried to set a cleared bit (would corrupt real flash) */
+        uint32_t program_violations;
+    };
+
+    EmulatedFlash(uint32_t size, uint32_t sector_size = 4096);
+
+    RetResult read(uint32_t addr, void *dest, size_t size);
+
+    RetResult write(uint32_t addr, const void *src, size_t size);
+
+    RetResult erase_sector(uint32_t addr);
+
+    uint32_t get_size() const;
+
+    uint32_t get_sector_size() const;
+
+    void set_write_budget(int64_t bytes);
+
+    RetResult save(const char *path) const;
+
+    RetResult load(const char *path);
+
+    const Stats* get_stats() const;
+
+    void reset_stats();
+
+    uint32_t get_max_sector_erases() const;
+
+private:
+    std::vector<uint8_t> _data;
+    std::vector<uint32_t> _sector_erases;
+    uint32_t _sector_size;
+    Stats _stats;
+
+    /** Bytes that can still be written before a simulated power cut, < 0 for no limit */
+    int64_t _write_budget = -1;
+};
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef NATIVE_ESP_ATTR_H
+#define NATIVE_ESP_ATTR_H
+
+/******************************************************************************
+ * Section attributes stand-ins. RTC memory is plain RAM on host.
+ *****************************************************************************/
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
+
+#endif
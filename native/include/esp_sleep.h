@@ -0,0 +1,29 @@
+#ifndef NATIVE_ESP_SLEEP_H
+#define NATIVE_ESP_SLEEP_H
+
+#include <inttypes.h>
+
+/******************************************************************************
+ * Sleep stand-ins. Sleeping advances the fake clock by the timer wake up
+ * duration and returns immediately.
+ *****************************************************************************/
+typedef int esp_err_t;
+
+typedef enum
+{
+	ESP_SLEEP_WAKEUP_UNDEFINED,
+	ESP_SLEEP_WAKEUP_ALL,
+	ESP_SLEEP_WAKEUP_EXT0,
+	ESP_SLEEP_WAKEUP_EXT1,
+	ESP_SLEEP_WAKEUP_TIMER
+} esp_sleep_wakeup_cause_t;
+
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t time_in_us);
+
+esp_err_t esp_light_sleep_start();
+
+void esp_deep_sleep_start();
+
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause();
+
+#endif
@@ -0,0 +1,7 @@
+#ifndef NATIVE_IPFS_CLIENT_H
+#define NATIVE_IPFS_CLIENT_H
+
+// IPFS client is not available on host, header only satisfies includes
+#include "Arduino.h"
+
+#endif
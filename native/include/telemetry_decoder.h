@@ -0,0 +1,22 @@
+#ifndef TELEMETRY_DECODER_H
+#define TELEMETRY_DECODER_H
+
+#include <inttypes.h>
+#include "struct.h"
+
+/******************************************************************************
+ * Host side decoder of binary (CBOR) telemetry
+ * Turns a request built by a CborBuilderBase builder back into the TB JSON
+ * the firmware's JSON builders would have sent for the same entries: entries
+ * are rebuilt through their schema and passed to the JSON builder of their
+ * type. The entry type is found by the request's telemetry id, so the
+ * decoder must be built from the same schemas as the firmware.
+ ******************************************************************************/
+namespace TelemetryDecoder
+{
+    RetResult to_tb_json(const uint8_t *payload, int size, char *json_out, int json_size, int *entry_count);
+
+    const char* get_type_name(const uint8_t *payload, int size);
+}
+
+#endif
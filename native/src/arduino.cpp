@@ -0,0 +1,265 @@
+#include "Arduino.h"
+#include "esp_sleep.h"
+#include <stdarg.h>
+#include <chrono>
+#include <random>
+
+/******************************************************************************
+ * Native Arduino core stand-in
+ *****************************************************************************/
+
+HardwareSerial Serial(0);
+
+namespace
+{
+	/** Real time reference millis() is measured from */
+	const std::chrono::steady_clock::time_point _t_start = std::chrono::steady_clock::now();
+
+	/** Time added to the real elapsed time by fake sleeps/advances */
+	uint64_t _advanced_ms = 0;
+
+	/** Epoch at millis() == 0. Any valid timestamp will do, RTC::tstamp_valid() must pass */
+	uint32_t _epoch_base = 1600000000;
+
+	/** Duration of next (fake) sleep */
+	uint64_t _sleep_timer_us = 0;
+
+	std::mt19937 _rng(1);
+
+	uint64_t elapsed_us()
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now() - _t_start).count() + _advanced_ms * 1000;
+	}
+}
+
+/******************************************************************************
+ * Fake system time. Overrides libc time() so everything using the system clock
+ * (eg. DataStore file names) follows the fake RTC, as on the device where
+ * system time is set from the RTC.
+ *****************************************************************************/
+#ifndef __THROW
+#define __THROW
+#endif
+
+extern "C" time_t time(time_t *t) __THROW
+{
+	time_t now = NativeClock::get_epoch();
+
+	if(t != NULL)
+		*t = now;
+
+	return now;
+}
+
+unsigned long millis()
+{
+	return elapsed_us() / 1000;
+}
+
+unsigned long micros()
+{
+	return elapsed_us();
+}
+
+void delay(unsigned long ms)
+{
+	NativeClock::advance_ms(ms);
+}
+
+namespace NativeClock
+{
+	/******************************************************************************
+	 * Move fake time forward without waiting
+	 *****************************************************************************/
+	void advance_ms(uint64_t ms)
+	{
+		_advanced_ms += ms;
+	}
+
+	/******************************************************************************
+	 * Set current epoch
+	 *****************************************************************************/
+	void set_epoch(uint32_t epoch)
+	{
+		_epoch_base = epoch - millis() / 1000;
+	}
+
+	/******************************************************************************
+	 * Get current epoch
+	 *****************************************************************************/
+	uint32_t get_epoch()
+	{
+		return _epoch_base + millis() / 1000;
+	}
+}
+
+long random(long max)
+{
+	return random(0, max);
+}
+
+long random(long min, long max)
+{
+	if(max <= min)
+		return min;
+
+	return min + (long)(_rng() % (unsigned long)(max - min));
+}
+
+void randomSeed(unsigned long seed)
+{
+	_rng.seed(seed);
+}
+
+/******************************************************************************
+ * Sleep
+ *****************************************************************************/
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t time_in_us)
+{
+	_sleep_timer_us = time_in_us;
+	return 0;
+}
+
+esp_err_t esp_light_sleep_start()
+{
+	NativeClock::advance_ms(_sleep_timer_us / 1000);
+	return 0;
+}
+
+void esp_deep_sleep_start()
+{
+	NativeClock::advance_ms(_sleep_timer_us / 1000);
+}
+
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause()
+{
+	return _sleep_timer_us > 0 ? ESP_SLEEP_WAKEUP_TIMER : ESP_SLEEP_WAKEUP_UNDEFINED;
+}
+
+/******************************************************************************
+ * Serial
+ *****************************************************************************/
+HardwareSerial::HardwareSerial(int uart_nr)
+{
+	_out = stdout;
+}
+
+void HardwareSerial::begin(unsigned long baud, uint32_t config, int8_t rx_pin, int8_t tx_pin)
+{}
+
+void HardwareSerial::flush()
+{
+	if(_out != NULL)
+		fflush(_out);
+}
+
+void HardwareSerial::set_output(FILE *out)
+{
+	_out = out;
+}
+
+size_t HardwareSerial::print(const char *str)
+{
+	if(_out == NULL || str == NULL)
+		return 0;
+
+	return fputs(str, _out) < 0 ? 0 : strlen(str);
+}
+
+size_t HardwareSerial::print(const String &str)
+{
+	return print(str.c_str());
+}
+
+size_t HardwareSerial::print(const __FlashStringHelper *str)
+{
+	return print(reinterpret_cast<const char*>(str));
+}
+
+size_t HardwareSerial::print(char c)
+{
+	char str[2] = {c, '\0'};
+	return print(str);
+}
+
+size_t HardwareSerial::print(int val, int base)
+{
+	return print((long long)val, base);
+}
+
+size_t HardwareSerial::print(unsigned int val, int base)
+{
+	return print((unsigned long long)val, base);
+}
+
+size_t HardwareSerial::print(long val, int base)
+{
+	return print((long long)val, base);
+}
+
+size_t HardwareSerial::print(unsigned long val, int base)
+{
+	return print((unsigned long long)val, base);
+}
+
+size_t HardwareSerial::print(long long val, int base)
+{
+	// Negative numbers printed with sign only in decimal, as Arduino Print does
+	if(base == DEC && val < 0)
+		return print_number(-(unsigned long long)val, base, true);
+
+	return print_number((unsigned long long)val, base, false);
+}
+
+size_t HardwareSerial::print(unsigned long long val, int base)
+{
+	return print_number(val, base, false);
+}
+
+size_t HardwareSerial::print(double val, int digits)
+{
+	char buff[64] = "";
+	snprintf(buff, sizeof(buff), "%.*f", digits, val);
+	return print(buff);
+}
+
+size_t HardwareSerial::println()
+{
+	return print("\r\n");
+}
+
+int HardwareSerial::printf(const char *format, ...)
+{
+	if(_out == NULL)
+		return 0;
+
+	va_list args;
+	va_start(args, format);
+	int ret = vfprintf(_out, format, args);
+	va_end(args);
+
+	return ret;
+}
+
+size_t HardwareSerial::print_number(unsigned long long val, int base, bool negative)
+{
+	if(base < 2)
+		base = DEC;
+
+	// Max 64 binary digits, sign and terminator
+	char buff[66] = "";
+	char *p = &buff[sizeof(buff) - 1];
+
+	do
+	{
+		int digit = val % base;
+		*--p = digit < 10 ? '0' + digit : 'A' + digit - 10;
+		val /= base;
+	} while(val);
+
+	if(negative)
+		*--p = '-';
+
+	return print(p);
+}
@@ -0,0 +1,142 @@
+#include "emulated_flash.h"
+#include <stdio.h>
+#include <string.h>
+
+/******************************************************************************
+ * Constructor
+ * Flash starts erased.
+ ******************************************************************************/
+EmulatedFlash::EmulatedFlash(uint32_t size, uint32_t sector_size)
+	: _data(size, 0xFF), _sector_erases(size / sector_size, 0), _sector_size(sector_size)
+{
+	reset_stats();
+}
+
+RetResult EmulatedFlash::read(uint32_t addr, void *dest, size_t size)
+{
+	if(addr + size > _data.size())
+		return RET_ERROR;
+
+	memcpy(dest, &_data[addr], size);
+
+	_stats.read_calls++;
+	_stats.bytes_read += size;
+
+	return RET_OK;
+}
+
+/******************************************************************************
+ * Program bytes. Bits can only go from 1 to 0, like NOR flash.
+ * When a write budget is set and runs out, the write stops midway and fails,
+ * like a reset in the middle of programming.
+ ******************************************************************************/
+RetResult EmulatedFlash::write(uint32_t addr, const void *src, size_t size)
+{
+	if(addr + size > _data.size())
+		return RET_ERROR;
+
+	size_t to_write = size;
+	if(_write_budget >= 0 && (int64_t)size > _write_budget)
+		to_write = _write_budget;
+
+	const uint8_t *bytes = (const uint8_t*)src;
+	for(size_t i = 0; i < to_write; i++)
+	{
+		if(bytes[i] & ~_data[addr + i])
+			_stats.program_violations++;
+
+		_data[addr + i] &= bytes[i];
+	}
+
+	_stats.write_calls++;
+	_stats.bytes_written += to_write;
+
+	if(_write_budget >= 0)
+		_write_budget -= to_write;
+
+	return to_write == size ? RET_OK : RET_ERROR;
+}
+
+RetResult EmulatedFlash::erase_sector(uint32_t addr)
+{
+	if(addr % _sector_size != 0 || addr >= _data.size())
+		return RET_ERROR;
+
+	if(_write_budget == 0)
+		return RET_ERROR;
+
+	memset(&_data[addr], 0xFF, _sector_size);
+
+	_sector_erases[addr / _sector_size]++;
+	_stats.erases++;
+
+	return RET_OK;
+}
+
+uint32_t EmulatedFlash::get_size() const
+{
+	return _data.size();
+}
+
+uint32_t EmulatedFlash::get_sector_size() const
+{
+	return _sector_size;
+}
+
+/******************************************************************************
+ * Limit bytes written from now on, to simulate a power cut
+ * @param bytes Bytes to allow, < 0 to remove limit
+ ******************************************************************************/
+void EmulatedFlash::set_write_budget(int64_t bytes)
+{
+	_write_budget = bytes;
+}
+
+RetResult EmulatedFlash::save(const char *path) const
+{
+	FILE *f = fopen(path, "wb");
+	if(f == NULL)
+		return RET_ERROR;
+
+	size_t written = fwrite(&_data[0], 1, _data.size(), f);
+	fclose(f);
+
+	return written == _data.size() ? RET_OK : RET_ERROR;
+}
+
+RetResult EmulatedFlash::load(const char *path)
+{
+	FILE *f = fopen(path, "rb");
+	if(f == NULL)
+		return RET_ERROR;
+
+	size_t read = fread(&_data[0], 1, _data.size(), f);
+	fclose(f);
+
+	return read == _data.size() ? RET_OK : RET_ERROR;
+}
+
+const EmulatedFlash::Stats* EmulatedFlash::get_stats() const
+{
+	return &_stats;
+}
+
+void EmulatedFlash::reset_stats()
+{
+	memset(&_stats, 0, sizeof(_stats));
+}
+
+/******************************************************************************
+ * Erase count of most worn sector
+ ******************************************************************************/
+uint32_t EmulatedFlash::get_max_sector_erases() const
+{
+	uint32_t max = 0;
+	for(size_t i = 0; i < _sector_erases.size(); i++)
+	{
+		if(_sector_erases[i] > max)
+			max = _sector_erases[i];
+	}
+
+	return max;
+}
@@ -0,0 +1,1030 @@
+#include "native_fs.h"
+#include "SPIFFS.h"
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+/******************************************************************************
+ * Native file system engine
+ * fs::File and fs::FS on top of an FSImpl, which holds the state of a single
+ * file system and models its layout (see native_fs.h).
+ *****************************************************************************/
+
+namespace
+{
+	/** SPIFFS logical page size */
+	const size_t SPIFFS_PAGE_SIZE = 256;
+
+	/** SPIFFS data bytes per page (page header excluded) */
+	const size_t SPIFFS_PAGE_DATA_SIZE = SPIFFS_PAGE_SIZE - 5;
+
+	/** LittleFS block size */
+	const size_t LFS_BLOCK_SIZE = 4096;
+
+	/** LittleFS files up to this size are kept inline in their dir's metadata */
+	const size_t LFS_INLINE_MAX = 512;
+
+	/** LittleFS metadata per dir entry (tags, struct), excl. name */
+	const size_t LFS_ENTRY_OVERHEAD = 16;
+
+	/** Unit of pages_programmed for models without pages */
+	const size_t PROG_UNIT = 256;
+
+	/** Host file marking a host backed file system as formatted */
+	const char FORMATTED_MARKER[] = ".formatted";
+
+	/** File system NativeFs functions apply to, NULL for SPIFFS */
+	fs::FSImpl *_selected = NULL;
+
+	fs::FSImpl* selected()
+	{
+		return _selected != NULL ? _selected : SPIFFS.get_impl();
+	}
+
+	/******************************************************************************
+	 * Path to flat host file name. '/' is escaped since files are kept flat.
+	 *****************************************************************************/
+	std::string escape(const std::string &path)
+	{
+		std::string escaped;
+
+		for(char c : path)
+		{
+			if(c == '/')
+				escaped += "%2F";
+			else if(c == '%')
+				escaped += "%25";
+			else
+				escaped += c;
+		}
+
+		return escaped;
+	}
+
+	std::string unescape(const std::string &name)
+	{
+		std::string path;
+
+		for(size_t i = 0; i < name.size(); i++)
+		{
+			if(name[i] == '%' && i + 2 < name.size())
+			{
+				path += (char)strtol(name.substr(i + 1, 2).c_str(), NULL, 16);
+				i += 2;
+			}
+			else
+			{
+				path += name[i];
+			}
+		}
+
+		return path;
+	}
+
+	/******************************************************************************
+	 * Strip trailing '/' (except for root)
+	 *****************************************************************************/
+	std::string normalize(const std::string &path)
+	{
+		std::string normalized = path;
+
+		while(normalized.size() > 1 && normalized[normalized.size() - 1] == '/')
+			normalized.erase(normalized.size() - 1);
+
+		return normalized;
+	}
+
+	size_t div_up(size_t a, size_t b)
+	{
+		return (a + b - 1) / b;
+	}
+}
+
+namespace fs
+{
+	/******************************************************************************
+	 * FSImpl
+	 *****************************************************************************/
+	FSImpl::FSImpl(Model model, const char *default_root, const char *root_env, size_t default_capacity)
+		: model(model), default_root(default_root), root_env(root_env), capacity(default_capacity)
+	{
+		// Nothing to persist, SPIFFS always mounts (partition is formatted on flashing)
+		formatted = model == MODEL_SPIFFS;
+	}
+
+	/******************************************************************************
+	 * Mount. Loads index from host dir, does nothing if already mounted.
+	 *****************************************************************************/
+	bool FSImpl::begin(bool format_on_fail)
+	{
+		if(mounted)
+			return true;
+
+		if(model == MODEL_RAM)
+		{
+			if(!formatted && !format_on_fail)
+				return false;
+
+			if(!formatted)
+				return format();
+
+			mounted = true;
+			return true;
+		}
+
+		if(root.empty())
+		{
+			const char *env_root = root_env != NULL ? getenv(root_env) : NULL;
+			root = env_root != NULL ? env_root : default_root;
+		}
+
+		::mkdir(root.c_str(), 0755);
+
+		DIR *dir = opendir(root.c_str());
+		if(dir == NULL)
+			return false;
+
+		index.clear();
+		dirs.clear();
+		data_bytes = 0;
+
+		if(has_dirs())
+		{
+			dirs["/"] = 0;
+			formatted = false;
+		}
+
+		std::vector<std::string> dir_paths;
+		std::vector<std::pair<std::string, size_t>> files;
+
+		struct dirent *ent;
+		while((ent = readdir(dir)) != NULL)
+		{
+			std::string name(ent->d_name);
+
+			if(name == FORMATTED_MARKER)
+			{
+				formatted = true;
+				continue;
+			}
+
+			// Dirs are kept as ".<escaped path>" host files
+			if(name[0] == '.')
+			{
+				if(has_dirs() && name.size() > 1)
+					dir_paths.push_back(unescape(name.substr(1)));
+
+				continue;
+			}
+
+			struct stat st;
+			if(stat((root + "/" + name).c_str(), &st) == 0 && S_ISREG(st.st_mode))
+				files.push_back(std::make_pair(unescape(name), (size_t)st.st_size));
+		}
+		closedir(dir);
+
+		// Parents first
+		std::sort(dir_paths.begin(), dir_paths.end());
+		for(const std::string &path : dir_paths)
+			make_dir(path);
+
+		for(auto &file : files)
+			set_size(file.first, file.second);
+
+		mounted = true;
+
+		// Whatever is in the host dir is not a file system, wipe it
+		if(!formatted)
+		{
+			if(!format_on_fail)
+			{
+				mounted = false;
+				return false;
+			}
+
+			return format();
+		}
+
+		return true;
+	}
+
+	/******************************************************************************
+	 * Remove everything and mark as formatted
+	 *****************************************************************************/
+	bool FSImpl::format()
+	{
+		if(model != MODEL_RAM)
+		{
+			// Mount whatever is there to know what to remove
+			if(!mounted && !begin(true))
+				return false;
+
+			for(auto &file : index)
+				unlink(host_path(file.first).c_str());
+
+			for(auto &dir : dirs)
+				unlink((root + "/." + escape(dir.first)).c_str());
+
+			int fd = ::open((root + "/" + FORMATTED_MARKER).c_str(), O_WRONLY | O_CREAT, 0644);
+			if(fd >= 0)
+				::close(fd);
+		}
+
+		index.clear();
+		contents.clear();
+		dirs.clear();
+		data_bytes = 0;
+
+		if(has_dirs())
+			dirs["/"] = 0;
+
+		formatted = true;
+		mounted = true;
+
+		return true;
+	}
+
+	void FSImpl::end()
+	{
+		mounted = false;
+	}
+
+	bool FSImpl::has_dirs() const
+	{
+		return model != MODEL_SPIFFS;
+	}
+
+	bool FSImpl::is_dir(const std::string &path) const
+	{
+		return dirs.count(path) > 0;
+	}
+
+	/******************************************************************************
+	 * Dir a path is in, "/" for top level
+	 *****************************************************************************/
+	std::string FSImpl::parent(const std::string &path) const
+	{
+		size_t pos = path.find_last_of('/');
+
+		if(pos == std::string::npos || pos == 0)
+			return "/";
+
+		return path.substr(0, pos);
+	}
+
+	std::string FSImpl::host_path(const std::string &path) const
+	{
+		return root + "/" + escape(path);
+	}
+
+	/******************************************************************************
+	 * Space taken by a file's data
+	 *****************************************************************************/
+	size_t FSImpl::file_data_bytes(size_t size) const
+	{
+		switch(model)
+		{
+			case MODEL_SPIFFS:
+				// Index page plus data pages
+				return (1 + div_up(size, SPIFFS_PAGE_DATA_SIZE)) * SPIFFS_PAGE_SIZE;
+			case MODEL_LITTLEFS:
+				return size <= LFS_INLINE_MAX ? 0 : div_up(size, LFS_BLOCK_SIZE) * LFS_BLOCK_SIZE;
+			default:
+				return size;
+		}
+	}
+
+	/******************************************************************************
+	 * Metadata a file takes in its dir (MODEL_LITTLEFS), incl. inline data
+	 *****************************************************************************/
+	size_t FSImpl::file_meta_bytes(const std::string &path, size_t size) const
+	{
+		if(model != MODEL_LITTLEFS)
+			return 0;
+
+		size_t name_len = path.size() - path.find_last_of('/') - 1;
+
+		return LFS_ENTRY_OVERHEAD + name_len + (size <= LFS_INLINE_MAX ? size : 0);
+	}
+
+	/******************************************************************************
+	 * Blocks taken by a dir's metadata (MODEL_LITTLEFS). Metadata lives in block
+	 * pairs, a pair is split once its compacted contents exceed half a block.
+	 *****************************************************************************/
+	size_t FSImpl::dir_bytes(size_t meta_bytes) const
+	{
+		if(model != MODEL_LITTLEFS)
+			return 0;
+
+		size_t pairs = meta_bytes > 0 ? div_up(meta_bytes, LFS_BLOCK_SIZE / 2) : 1;
+
+		return pairs * 2 * LFS_BLOCK_SIZE;
+	}
+
+	/******************************************************************************
+	 * Add or resize file in index
+	 *****************************************************************************/
+	void FSImpl::set_size(const std::string &path, size_t size)
+	{
+		auto it = index.find(path);
+		std::string dir = parent(path);
+
+		if(it != index.end())
+		{
+			data_bytes -= file_data_bytes(it->second);
+			if(has_dirs())
+				dirs[dir] -= file_meta_bytes(path, it->second);
+
+			it->second = size;
+		}
+		else
+		{
+			index[path] = size;
+		}
+
+		data_bytes += file_data_bytes(size);
+		if(has_dirs())
+			dirs[dir] += file_meta_bytes(path, size);
+	}
+
+	void FSImpl::drop(const std::string &path)
+	{
+		auto it = index.find(path);
+		if(it == index.end())
+			return;
+
+		data_bytes -= file_data_bytes(it->second);
+		if(has_dirs())
+			dirs[parent(path)] -= file_meta_bytes(path, it->second);
+
+		index.erase(it);
+		contents.erase(path);
+	}
+
+	/******************************************************************************
+	 * Create dir, parent must exist
+	 *****************************************************************************/
+	bool FSImpl::make_dir(const std::string &path)
+	{
+		if(!has_dirs() || is_dir(path) || index.count(path) || !is_dir(parent(path)))
+			return false;
+
+		// Dir also takes an entry in its parent's metadata
+		dirs[path] = 0;
+		dirs[parent(path)] += file_meta_bytes(path, 0);
+
+		save_dir(path, true);
+
+		return true;
+	}
+
+	/******************************************************************************
+	 * Remove dir, must be empty
+	 *****************************************************************************/
+	bool FSImpl::remove_dir(const std::string &path)
+	{
+		if(!has_dirs() || path == "/" || !is_dir(path))
+			return false;
+
+		std::string prefix = path + "/";
+
+		for(auto &file : index)
+		{
+			if(file.first.compare(0, prefix.size(), prefix) == 0)
+				return false;
+		}
+
+		for(auto &dir : dirs)
+		{
+			if(dir.first.compare(0, prefix.size(), prefix) == 0)
+				return false;
+		}
+
+		dirs.erase(path);
+		dirs[parent(path)] -= file_meta_bytes(path, 0);
+
+		save_dir(path, false);
+
+		return true;
+	}
+
+	/******************************************************************************
+	 * Persist dir of a host backed file system
+	 *****************************************************************************/
+	void FSImpl::save_dir(const std::string &path, bool exists)
+	{
+		if(model == MODEL_RAM || root.empty())
+			return;
+
+		std::string marker = root + "/." + escape(path);
+
+		if(exists)
+		{
+			int fd = ::open(marker.c_str(), O_WRONLY | O_CREAT, 0644);
+			if(fd >= 0)
+				::close(fd);
+		}
+		else
+		{
+			unlink(marker.c_str());
+		}
+	}
+
+	/******************************************************************************
+	 * Bytes used on partition
+	 *****************************************************************************/
+	size_t FSImpl::used_bytes() const
+	{
+		size_t used = data_bytes;
+
+		for(auto &dir : dirs)
+			used += dir_bytes(dir.second);
+
+		return used;
+	}
+
+	/******************************************************************************
+	 * Bytes that would be used if a file had size
+	 *****************************************************************************/
+	size_t FSImpl::used_with(const std::string &path, size_t size) const
+	{
+		auto it = index.find(path);
+		size_t used = used_bytes();
+
+		if(it != index.end())
+			used -= file_data_bytes(it->second);
+		used += file_data_bytes(size);
+
+		if(model == MODEL_LITTLEFS)
+		{
+			auto dir = dirs.find(parent(path));
+			size_t meta = dir != dirs.end() ? dir->second : 0;
+			size_t new_meta = meta + file_meta_bytes(path, size) -
+				(it != index.end() ? file_meta_bytes(path, it->second) : 0);
+
+			used = used - dir_bytes(meta) + dir_bytes(new_meta);
+		}
+
+		return used;
+	}
+
+	/******************************************************************************
+	 * Bytes that can be appended to a file of cur_size before the partition fills
+	 *****************************************************************************/
+	size_t FSImpl::writable_bytes(const std::string &path, size_t cur_size, size_t wanted) const
+	{
+		if(used_with(path, cur_size + wanted) <= capacity)
+			return wanted;
+
+		// Space only grows with size, find the largest size that fits
+		size_t low = 0, high = wanted;
+
+		while(low < high)
+		{
+			size_t mid = low + (high - low + 1) / 2;
+
+			if(used_with(path, cur_size + mid) <= capacity)
+				low = mid;
+			else
+				high = mid - 1;
+		}
+
+		return low;
+	}
+
+	/******************************************************************************
+	 * Flash pages programmed by a write
+	 * SPIFFS: every data page touched is rewritten (partial pages are
+	 * read-modify-write) plus the object index page that tracks the file's size.
+	 * LittleFS: inline data is rewritten whole with the metadata commit. Block
+	 * files are copy on write, appending copies the partial last block.
+	 *****************************************************************************/
+	uint32_t FSImpl::pages_for_write(size_t pos, size_t written, size_t old_size, size_t new_size) const
+	{
+		switch(model)
+		{
+			case MODEL_SPIFFS:
+				return (pos + written - 1) / SPIFFS_PAGE_DATA_SIZE - pos / SPIFFS_PAGE_DATA_SIZE + 1 + 1;
+			case MODEL_LITTLEFS:
+				if(new_size <= LFS_INLINE_MAX)
+					return div_up(LFS_ENTRY_OVERHEAD + new_size, PROG_UNIT);
+
+				// Leaving inline, whole file goes to blocks
+				if(old_size <= LFS_INLINE_MAX)
+					return div_up(new_size, PROG_UNIT) + 1;
+
+				return div_up(pos % LFS_BLOCK_SIZE + written, PROG_UNIT) + 1;
+			default:
+				return 0;
+		}
+	}
+
+	/******************************************************************************
+	 * Open file or dir
+	 *****************************************************************************/
+	class FileImpl
+	{
+	public:
+		FileImpl(FSImpl *fs, const std::string &path, bool is_dir, int open_flags)
+			: fs(fs), path(path), is_dir(is_dir), flags(open_flags)
+		{}
+
+		~FileImpl()
+		{
+			close();
+		}
+
+		void close()
+		{
+			if(fd >= 0)
+				::close(fd);
+
+			fd = -1;
+			closed = true;
+		}
+
+		/** Open host file on first access. Listing files does not need it. */
+		bool ensure_open()
+		{
+			if(closed || is_dir)
+				return false;
+
+			if(fs->model == FSImpl::MODEL_RAM)
+				return true;
+
+			if(fd < 0)
+				fd = ::open(fs->host_path(path).c_str(), flags, 0644);
+
+			return fd >= 0;
+		}
+
+		FSImpl *fs;
+		std::string path;
+		bool is_dir;
+		int flags;
+		int fd = -1;
+		bool closed = false;
+
+		/** Position (MODEL_RAM) */
+		size_t ram_pos = 0;
+
+		/** Dir iteration: matching paths and their position in the partition scan */
+		std::vector<std::pair<std::string, size_t>> dir_entries;
+		size_t dir_pos = 0;
+		size_t dir_scan_pos = 0;
+	};
+
+	File::operator bool() const
+	{
+		return _impl && !_impl->closed;
+	}
+
+	size_t File::write(uint8_t c)
+	{
+		return write(&c, 1);
+	}
+
+	size_t File::write(const uint8_t *buf, size_t size)
+	{
+		if(!*this || !_impl->ensure_open() || (_impl->flags & O_ACCMODE) == O_RDONLY)
+			return 0;
+
+		FSImpl *fs = _impl->fs;
+
+		fs->stats.write_calls++;
+
+		size_t cur_size = fs->index.count(_impl->path) ? fs->index[_impl->path] : 0;
+		size_t pos = (_impl->flags & O_APPEND) ? cur_size : position();
+		size_t grow = pos + size > cur_size ? pos + size - cur_size : 0;
+
+		// Partition full, write only what fits
+		size_t to_write = size;
+		if(grow > 0)
+		{
+			size_t allowed = fs->writable_bytes(_impl->path, cur_size, grow);
+			to_write = size - (grow - allowed);
+		}
+
+		size_t written = 0;
+
+		if(fs->model == FSImpl::MODEL_RAM)
+		{
+			std::vector<uint8_t> &data = fs->contents[_impl->path];
+
+			if(pos + to_write > data.size())
+				data.resize(pos + to_write);
+
+			memcpy(data.data() + pos, buf, to_write);
+			_impl->ram_pos = pos + to_write;
+			written = to_write;
+		}
+		else
+		{
+			ssize_t host_written = to_write > 0 ? ::write(_impl->fd, buf, to_write) : 0;
+			written = host_written > 0 ? host_written : 0;
+		}
+
+		if(written == 0)
+			return 0;
+
+		size_t new_size = pos + written > cur_size ? pos + written : cur_size;
+
+		fs->stats.bytes_written += written;
+		fs->stats.pages_programmed += fs->pages_for_write(pos, written, cur_size, new_size);
+
+		if(new_size != cur_size)
+			fs->set_size(_impl->path, new_size);
+
+		return written;
+	}
+
+	int File::available()
+	{
+		if(!*this)
+			return 0;
+
+		return size() - position();
+	}
+
+	int File::read()
+	{
+		uint8_t c = 0;
+		return read(&c, 1) == 1 ? c : -1;
+	}
+
+	size_t File::read(uint8_t *buf, size_t size)
+	{
+		if(!*this || !_impl->ensure_open())
+			return 0;
+
+		FSImpl *fs = _impl->fs;
+
+		fs->stats.read_calls++;
+
+		size_t bytes_read = 0;
+
+		if(fs->model == FSImpl::MODEL_RAM)
+		{
+			const std::vector<uint8_t> &data = fs->contents[_impl->path];
+
+			if(_impl->ram_pos < data.size())
+			{
+				bytes_read = data.size() - _impl->ram_pos < size ? data.size() - _impl->ram_pos : size;
+				memcpy(buf, data.data() + _impl->ram_pos, bytes_read);
+				_impl->ram_pos += bytes_read;
+			}
+		}
+		else
+		{
+			ssize_t host_read = ::read(_impl->fd, buf, size);
+			bytes_read = host_read > 0 ? host_read : 0;
+		}
+
+		if(bytes_read == 0)
+			return 0;
+
+		fs->stats.bytes_read += bytes_read;
+
+		return bytes_read;
+	}
+
+	size_t File::readBytes(char *buffer, size_t length)
+	{
+		return read((uint8_t*)buffer, length);
+	}
+
+	bool File::seek(uint32_t pos, SeekMode mode)
+	{
+		if(!*this || !_impl->ensure_open())
+			return false;
+
+		if(_impl->fs->model == FSImpl::MODEL_RAM)
+		{
+			size_t base = mode == SeekSet ? 0 : (mode == SeekCur ? _impl->ram_pos : size());
+			_impl->ram_pos = base + pos;
+			return true;
+		}
+
+		int whence = mode == SeekSet ? SEEK_SET : (mode == SeekCur ? SEEK_CUR : SEEK_END);
+
+		return lseek(_impl->fd, pos, whence) >= 0;
+	}
+
+	size_t File::position() const
+	{
+		if(!*this)
+			return 0;
+
+		if(_impl->fs->model == FSImpl::MODEL_RAM)
+			return _impl->ram_pos;
+
+		if(_impl->fd < 0)
+			return 0;
+
+		return lseek(_impl->fd, 0, SEEK_CUR);
+	}
+
+	size_t File::size() const
+	{
+		if(!*this || _impl->is_dir)
+			return 0;
+
+		auto it = _impl->fs->index.find(_impl->path);
+
+		return it == _impl->fs->index.end() ? 0 : it->second;
+	}
+
+	void File::flush()
+	{}
+
+	void File::close()
+	{
+		if(_impl)
+			_impl->close();
+
+		_impl.reset();
+	}
+
+	const char* File::name() const
+	{
+		if(!_impl)
+			return NULL;
+
+		return _impl->path.c_str();
+	}
+
+	bool File::isDirectory()
+	{
+		return *this && _impl->is_dir;
+	}
+
+	/******************************************************************************
+	 * Next file in dir
+	 * On SPIFFS finding the files of a dir means scanning every object on the
+	 * partition, which is what dir_entries_scanned counts. Real dirs only visit
+	 * their own entries (files and dirs).
+	 *****************************************************************************/
+	File File::openNextFile(const char *mode)
+	{
+		if(!isDirectory())
+			return File();
+
+		FSImpl *fs = _impl->fs;
+
+		if(_impl->dir_pos >= _impl->dir_entries.size())
+		{
+			// Rest of partition scanned without finding another match
+			if(!fs->has_dirs() && _impl->dir_scan_pos < fs->index.size())
+			{
+				fs->stats.dir_entries_scanned += fs->index.size() - _impl->dir_scan_pos;
+				_impl->dir_scan_pos = fs->index.size();
+			}
+
+			return File();
+		}
+
+		const std::pair<std::string, size_t> &entry = _impl->dir_entries[_impl->dir_pos++];
+
+		fs->stats.dir_entries_scanned += entry.second + 1 - _impl->dir_scan_pos;
+		_impl->dir_scan_pos = entry.second + 1;
+
+		if(fs->is_dir(entry.first))
+			return File(std::make_shared<FileImpl>(fs, entry.first, true, O_RDONLY));
+
+		// File may have been removed since the dir was opened
+		if(!fs->index.count(entry.first))
+			return openNextFile(mode);
+
+		fs->stats.opens++;
+
+		return File(std::make_shared<FileImpl>(fs, entry.first, false, O_RDONLY));
+	}
+
+	void File::rewindDirectory()
+	{
+		if(!isDirectory())
+			return;
+
+		_impl->dir_pos = 0;
+		_impl->dir_scan_pos = 0;
+	}
+
+	/******************************************************************************
+	 * Open file. On SPIFFS opening a path that is not a file for reading returns
+	 * a dir, like on esp32 where any path can be opened as a dir. With real dirs
+	 * only existing dirs open and files can only be created in one.
+	 *****************************************************************************/
+	File FS::open(const char *path, const char *mode)
+	{
+		if(!_impl->mounted || path == NULL || mode == NULL)
+			return File();
+
+		std::string str_path = normalize(path);
+		if(str_path.empty())
+			return File();
+
+		bool exists = _impl->index.count(str_path) > 0;
+		bool plus = strchr(mode, '+') != NULL;
+
+		if(mode[0] == 'r')
+		{
+			if(!exists)
+			{
+				if(_impl->has_dirs() && !_impl->is_dir(str_path))
+					return File();
+
+				_impl->stats.dir_opens++;
+
+				std::shared_ptr<FileImpl> dir = std::make_shared<FileImpl>(_impl, str_path, true, O_RDONLY);
+
+				std::string prefix = str_path;
+				if(prefix[prefix.size() - 1] != '/')
+					prefix += '/';
+
+				size_t scan_pos = 0;
+
+				if(_impl->has_dirs())
+				{
+					for(auto &sub_dir : _impl->dirs)
+					{
+						if(sub_dir.first != "/" && _impl->parent(sub_dir.first) == str_path)
+							dir->dir_entries.push_back(std::make_pair(sub_dir.first, scan_pos++));
+					}
+				}
+
+				for(auto &file : _impl->index)
+				{
+					if(_impl->has_dirs())
+					{
+						if(_impl->parent(file.first) == str_path)
+							dir->dir_entries.push_back(std::make_pair(file.first, scan_pos++));
+					}
+					else
+					{
+						if(prefix == "/" || file.first.compare(0, prefix.size(), prefix) == 0)
+							dir->dir_entries.push_back(std::make_pair(file.first, scan_pos));
+
+						scan_pos++;
+					}
+				}
+
+				return File(dir);
+			}
+
+			_impl->stats.opens++;
+
+			return File(std::make_shared<FileImpl>(_impl, str_path, false, plus ? O_RDWR : O_RDONLY));
+		}
+
+		int flags = plus ? O_RDWR : O_WRONLY;
+		if(mode[0] == 'w')
+			flags |= O_CREAT | O_TRUNC;
+		else if(mode[0] == 'a')
+			flags |= O_CREAT | O_APPEND;
+		else
+			return File();
+
+		if(_impl->has_dirs() && (_impl->is_dir(str_path) || !_impl->is_dir(_impl->parent(str_path))))
+			return File();
+
+		// Creating a file takes space (a page on SPIFFS)
+		if(!exists && _impl->used_with(str_path, 0) > _impl->capacity)
+			return File();
+
+		std::shared_ptr<FileImpl> file = std::make_shared<FileImpl>(_impl, str_path, false, flags);
+		if(!file->ensure_open())
+			return File();
+
+		_impl->stats.opens++;
+
+		if(!exists)
+		{
+			_impl->stats.creates++;
+			_impl->set_size(str_path, 0);
+		}
+		else if(mode[0] == 'w')
+		{
+			_impl->set_size(str_path, 0);
+			_impl->contents.erase(str_path);
+		}
+
+		return File(file);
+	}
+
+	bool FS::exists(const char *path)
+	{
+		if(!_impl->mounted)
+			return false;
+
+		std::string str_path = normalize(path);
+
+		return _impl->index.count(str_path) > 0 || _impl->is_dir(str_path);
+	}
+
+	bool FS::remove(const char *path)
+	{
+		if(!_impl->mounted || !_impl->index.count(path))
+			return false;
+
+		if(_impl->model != FSImpl::MODEL_RAM && unlink(_impl->host_path(path).c_str()) != 0)
+			return false;
+
+		_impl->drop(path);
+		_impl->stats.removes++;
+
+		return true;
+	}
+
+	bool FS::rename(const char *path_from, const char *path_to)
+	{
+		if(!_impl->mounted || !_impl->index.count(path_from) || exists(path_to))
+			return false;
+
+		if(_impl->has_dirs() && !_impl->is_dir(_impl->parent(path_to)))
+			return false;
+
+		if(_impl->model == FSImpl::MODEL_RAM)
+		{
+			std::vector<uint8_t> data = _impl->contents[path_from];
+			_impl->contents[path_to] = data;
+		}
+		else if(::rename(_impl->host_path(path_from).c_str(), _impl->host_path(path_to).c_str()) != 0)
+		{
+			return false;
+		}
+
+		size_t size = _impl->index[path_from];
+		_impl->drop(path_from);
+		_impl->set_size(path_to, size);
+
+		return true;
+	}
+
+	bool FS::mkdir(const char *path)
+	{
+		if(!_impl->mounted)
+			return false;
+
+		// Dirs are virtual on SPIFFS
+		if(!_impl->has_dirs())
+			return true;
+
+		return _impl->make_dir(normalize(path));
+	}
+
+	bool FS::rmdir(const char *path)
+	{
+		if(!_impl->mounted)
+			return false;
+
+		if(!_impl->has_dirs())
+			return true;
+
+		return _impl->remove_dir(normalize(path));
+	}
+}
+
+namespace NativeFs
+{
+	/******************************************************************************
+	 * Select file system the functions below apply to, NULL for SPIFFS
+	 *****************************************************************************/
+	void select(fs::FS *fs)
+	{
+		_selected = fs != NULL ? fs->get_impl() : NULL;
+	}
+
+	/******************************************************************************
+	 * Set host dir backing the partition. Remounts on next begin().
+	 *****************************************************************************/
+	void set_root(const char *host_dir)
+	{
+		selected()->root = host_dir;
+		selected()->mounted = false;
+	}
+
+	/******************************************************************************
+	 * Set partition size in bytes
+	 *****************************************************************************/
+	void set_capacity(size_t bytes)
+	{
+		selected()->capacity = bytes;
+	}
+
+	const Stats* get_stats()
+	{
+		return &selected()->stats;
+	}
+
+	void reset_stats()
+	{
+		memset(&selected()->stats, 0, sizeof(Stats));
+	}
+
+	uint32_t get_file_count()
+	{
+		return selected()->index.size();
+	}
+}
@@ -0,0 +1,51 @@
+#include "LITTLEFS.h"
+#include "native_fs.h"
+
+/******************************************************************************
+ * LittleFS stand-in backed by a host directory
+ * Space is accounted for in 4 KB blocks: small files are inlined in their
+ * dir's metadata pair, larger ones take whole blocks. Dirs are real and the
+ * volume must be formatted before it mounts, as on flash.
+ *****************************************************************************/
+
+namespace
+{
+	/** Usable bytes of a 1.5MB partition (368 blocks) */
+	const size_t DEFAULT_CAPACITY = 1507328;
+
+	/** Default host dir, can be overriden with NATIVE_LITTLEFS_ROOT env var */
+	const char DEFAULT_ROOT[] = "/tmp/native_littlefs";
+
+	fs::FSImpl _fs(fs::FSImpl::MODEL_LITTLEFS, DEFAULT_ROOT, "NATIVE_LITTLEFS_ROOT", DEFAULT_CAPACITY);
+}
+
+LITTLEFSFS LITTLEFS;
+
+LITTLEFSFS::LITTLEFSFS() : fs::FS(&_fs)
+{}
+
+bool LITTLEFSFS::begin(bool format_on_fail, const char *base_path, uint8_t max_open_files,
+	const char *partition_label)
+{
+	return _impl->begin(format_on_fail);
+}
+
+bool LITTLEFSFS::format()
+{
+	return _impl->format();
+}
+
+size_t LITTLEFSFS::totalBytes()
+{
+	return _impl->capacity;
+}
+
+size_t LITTLEFSFS::usedBytes()
+{
+	return _impl->used_bytes();
+}
+
+void LITTLEFSFS::end()
+{
+	_impl->end();
+}
@@ -0,0 +1,103 @@
+#ifndef NATIVE_FS_IMPL_H
+#define NATIVE_FS_IMPL_H
+
+#include "FS.h"
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+/******************************************************************************
+ * File system model behind a native fs::FS
+ * File metadata (names, sizes, dirs) is kept in an in-memory index so that
+ * listing does not touch the host. Host backed models load the index from
+ * their host dir on begin(), so contents persist between runs like a real
+ * partition. Space is accounted for the way the modelled file system lays
+ * files out, so usedBytes() fills up like it does on flash.
+ *****************************************************************************/
+namespace fs
+{
+	class FSImpl
+	{
+	public:
+		enum Model
+		{
+			// Flat, 256 B pages with an index page per file, dirs are name prefixes
+			MODEL_SPIFFS,
+			// 4 KB blocks, small files inline in dir metadata, real dirs
+			MODEL_LITTLEFS,
+			// Contents in RAM, real dirs, no flash underneath
+			MODEL_RAM
+		};
+
+		FSImpl(Model model, const char *default_root, const char *root_env, size_t default_capacity);
+
+		bool begin(bool format_on_fail);
+
+		bool format();
+
+		void end();
+
+		bool has_dirs() const;
+
+		bool is_dir(const std::string &path) const;
+
+		std::string parent(const std::string &path) const;
+
+		std::string host_path(const std::string &path) const;
+
+		void set_size(const std::string &path, size_t size);
+
+		void drop(const std::string &path);
+
+		bool make_dir(const std::string &path);
+
+		bool remove_dir(const std::string &path);
+
+		size_t used_bytes() const;
+
+		size_t used_with(const std::string &path, size_t size) const;
+
+		size_t writable_bytes(const std::string &path, size_t cur_size, size_t wanted) const;
+
+		uint32_t pages_for_write(size_t pos, size_t written, size_t old_size, size_t new_size) const;
+
+		Model model;
+
+		/** Host dir (not used by MODEL_RAM), default can be overriden with env var root_env */
+		std::string root;
+		const char *default_root;
+		const char *root_env;
+
+		size_t capacity;
+		bool mounted = false;
+
+		/** Has a file system on it, begin() fails otherwise unless formatting */
+		bool formatted = false;
+
+		/** Path -> file size */
+		std::map<std::string, size_t> index;
+
+		/** File contents (MODEL_RAM) */
+		std::map<std::string, std::vector<uint8_t>> contents;
+
+		/** Dir -> metadata bytes of its entries. "/" always exists. (not MODEL_SPIFFS) */
+		std::map<std::string, size_t> dirs;
+
+		/** Space used by file data (pages/blocks), dir metadata excluded */
+		size_t data_bytes = 0;
+
+		NativeFs::Stats stats = {0};
+
+	private:
+		size_t file_data_bytes(size_t size) const;
+
+		size_t file_meta_bytes(const std::string &path, size_t size) const;
+
+		size_t dir_bytes(size_t meta_bytes) const;
+
+		void save_dir(const std::string &path, bool exists);
+	};
+}
+
+#endif
@@ -0,0 +1,40 @@
+#include "RAMFS.h"
+#include "native_fs.h"
+
+namespace
+{
+	/** Same size as the flash partition so stores fill up alike */
+	const size_t DEFAULT_CAPACITY = 1374476;
+
+	fs::FSImpl _fs(fs::FSImpl::MODEL_RAM, "", NULL, DEFAULT_CAPACITY);
+}
+
+RAMFSFS RAMFS;
+
+RAMFSFS::RAMFSFS() : fs::FS(&_fs)
+{}
+
+bool RAMFSFS::begin(bool format_on_fail)
+{
+	return _impl->begin(format_on_fail);
+}
+
+bool RAMFSFS::format()
+{
+	return _impl->format();
+}
+
+size_t RAMFSFS::totalBytes()
+{
+	return _impl->capacity;
+}
+
+size_t RAMFSFS::usedBytes()
+{
+	return _impl->used_bytes();
+}
+
+void RAMFSFS::end()
+{
+	_impl->end();
+}
@@ -0,0 +1,49 @@
+#include "SPIFFS.h"
+#include "native_fs.h"
+
+/******************************************************************************
+ * SPIFFS stand-in backed by a host directory
+ * Space is accounted for in SPIFFS pages (one index page per file plus data
+ * pages with a small header) so usedBytes() fills up like it does on flash.
+ *****************************************************************************/
+
+namespace
+{
+	/** Usable bytes reported by a default 1.5MB esp32 SPIFFS partition */
+	const size_t DEFAULT_CAPACITY = 1374476;
+
+	/** Default host dir, can be overriden with NATIVE_FS_ROOT env var or NativeFs::set_root() */
+	const char DEFAULT_ROOT[] = "/tmp/native_spiffs";
+
+	fs::FSImpl _fs(fs::FSImpl::MODEL_SPIFFS, DEFAULT_ROOT, "NATIVE_FS_ROOT", DEFAULT_CAPACITY);
+}
+
+SPIFFSFS SPIFFS;
+
+SPIFFSFS::SPIFFSFS() : fs::FS(&_fs)
+{}
+
+bool SPIFFSFS::begin(bool format_on_fail, const char *base_path, uint8_t max_open_files)
+{
+	return _impl->begin(format_on_fail);
+}
+
+bool SPIFFSFS::format()
+{
+	return _impl->format();
+}
+
+size_t SPIFFSFS::totalBytes()
+{
+	return _impl->capacity;
+}
+
+size_t SPIFFSFS::usedBytes()
+{
+	return _impl->used_bytes();
+}
+
+void SPIFFSFS::end()
+{
+	_impl->end();
+}
@@ -0,0 +1,173 @@
+#include "Arduino.h"
+#include "crc.h"
+#include "utils.h"
+#include "rtc.h"
+#include "battery.h"
+#include "device_config.h"
+#include "fo_sniffer.h"
+#include "fo_uart.h"
+#include "rom/rtc.h"
+
+/******************************************************************************
+ * Stand-ins for firmware modules that talk to hardware and are not built for
+ * the native target. Only what the natively built modules call is provided.
+ *****************************************************************************/
+
+namespace Utils
+{
+	void print_separator(const __FlashStringHelper *title)
+	{
+		Serial.print(F("\x18\x18\x18\x18 "));
+		if(title != NULL)
+			Serial.print(title);
+		Serial.println();
+	}
+
+	void print_block(const __FlashStringHelper *title)
+	{
+		Serial.println(F("======================================================="));
+		Serial.println(title != NULL ? title : F(""));
+		Serial.println(F("======================================================="));
+	}
+
+	void print_buff_hex(uint8_t *buff, int len, int break_pos)
+	{
+		for(int i = 0; i < len; i++)
+		{
+			Serial.printf("%02x ", buff[i]);
+
+			if((i + 1) % break_pos == 0)
+				Serial.println();
+		}
+		Serial.println();
+	}
+
+	void serial_style(SerialStyle style)
+	{
+		Serial.printf("\033[%dm", style);
+	}
+
+	uint32_t crc32(uint8_t *buff, uint32_t buff_size)
+	{
+		return Crc::crc32(buff, buff_size);
+	}
+
+	template<typename T>
+	int in_array(T val, const T arr[], int size)
+	{
+		for(int i = 0; i < size; i++)
+		{
+			if(arr[i] == val)
+				return i;
+		}
+
+		return -1;
+	}
+	template int in_array<int>(int val, const int arr[], int size);
+}
+
+/******************************************************************************
+ * RTC follows the fake clock
+ *****************************************************************************/
+namespace RTC
+{
+	uint32_t get_timestamp()
+	{
+		return time(NULL);
+	}
+
+	uint32_t get_external_rtc_timestamp()
+	{
+		return time(NULL);
+	}
+
+	uint32_t get_last_sync_tick()
+	{
+		return 0;
+	}
+
+	bool tstamp_valid(uint32_t tstamp)
+	{
+		return tstamp >= FAIL_CHECK_TIMESTAMP_START && tstamp <= FAIL_CHECK_TIMESTAMP_END;
+	}
+
+	RetResult sync_time_from_ext_rtc()
+	{
+		return RET_OK;
+	}
+
+	void print_time()
+	{}
+}
+
+/******************************************************************************
+ * Reset reason, set by benchmarks simulating reboots
+ *****************************************************************************/
+RESET_REASON _native_reset_reason = POWERON_RESET;
+
+RESET_REASON rtc_get_reset_reason(int cpu_no)
+{
+	return _native_reset_reason;
+}
+
+void native_set_reset_reason(RESET_REASON reason)
+{
+	_native_reset_reason = reason;
+}
+
+namespace Battery
+{
+	BATTERY_MODE get_current_mode()
+	{
+		return BATTERY_MODE_NORMAL;
+	}
+
+	BATTERY_MODE get_last_mode()
+	{
+		return BATTERY_MODE_NORMAL;
+	}
+
+	void print_mode()
+	{}
+}
+
+/******************************************************************************
+ * Default config, never persisted
+ *****************************************************************************/
+namespace DeviceConfig
+{
+	const Data* get()
+	{
+		static Data config = {0};
+		static bool inited = false;
+
+		if(!inited)
+		{
+			memcpy(config.wakeup_schedule, WAKEUP_SCHEDULE_DEFAULT, sizeof(WAKEUP_SCHEDULE_DEFAULT));
+			inited = true;
+		}
+
+		return &config;
+	}
+
+	const bool get_fo_enabled()
+	{
+		return false;
+	}
+}
+
+namespace FoSniffer
+{
+	int calc_secs_to_next_sniff()
+	{
+		return 0;
+	}
+}
+
+namespace FoUart
+{
+	int calc_secs_to_next_packet()
+	{
+		return 0;
+	}
+}
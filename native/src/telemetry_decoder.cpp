@@ -0,0 +1,334 @@
+#include "telemetry_decoder.h"
+#include "const.h"
+#include "entry_schema.h"
+#include "cbor_writer.h"
+#include "tb_water_sensor_data_json_builder.h"
+#include "tb_atmos41_data_json_builder.h"
+#include "tb_soil_moisture_data_json_builder.h"
+#include "tb_lightning_data_json_builder.h"
+#include "tb_fo_data_json_builder.h"
+#include <math.h>
+#include <string.h>
+
+namespace TelemetryDecoder
+{
+	/******************************************************************************
+	 * Reads the CBOR items written by CborWriter. Any other item, or reading
+	 * past the end, fails the reader.
+	 ******************************************************************************/
+	class CborReader
+	{
+	public:
+		CborReader(const uint8_t *data, int size) : _data(data), _size(size)
+		{}
+
+		/** Read an array head, count is -1 for indefinite arrays */
+		bool read_array(int *count)
+		{
+			uint8_t major = 0, info = 0;
+			uint64_t value = 0;
+
+			if(!read_head(&major, &info, &value) || major != CborWriter::MAJOR_ARRAY)
+				return fail();
+
+			*count = info == CborWriter::INDEFINITE ? -1 : (int)value;
+			return true;
+		}
+
+		/** Check for and consume the break ending an indefinite array */
+		bool read_break()
+		{
+			if(_pos < _size && _data[_pos] == CborWriter::BREAK)
+			{
+				_pos++;
+				return true;
+			}
+
+			return false;
+		}
+
+		/** Read an int or float, null sets is_null */
+		bool read_number(double *value, bool *is_null)
+		{
+			uint8_t major = 0, info = 0;
+			uint64_t arg = 0;
+
+			*is_null = false;
+
+			if(!read_head(&major, &info, &arg))
+				return fail();
+
+			if(major == CborWriter::MAJOR_UNSIGNED)
+			{
+				*value = (double)arg;
+			}
+			else if(major == CborWriter::MAJOR_NEGATIVE)
+			{
+				*value = -1.0 - (double)arg;
+			}
+			else if(major == CborWriter::MAJOR_SIMPLE && info == CborWriter::SIMPLE_NULL)
+			{
+				*is_null = true;
+			}
+			else if(major == CborWriter::MAJOR_SIMPLE && info == CborWriter::SIMPLE_HALF)
+			{
+				*value = half_to_double(arg);
+			}
+			else if(major == CborWriter::MAJOR_SIMPLE && info == CborWriter::SIMPLE_SINGLE)
+			{
+				uint32_t bits = arg;
+				float single = 0;
+				memcpy(&single, &bits, sizeof(single));
+				*value = single;
+			}
+			else if(major == CborWriter::MAJOR_SIMPLE && info == CborWriter::SIMPLE_DOUBLE)
+			{
+				memcpy(value, &arg, sizeof(*value));
+			}
+			else
+			{
+				return fail();
+			}
+
+			return true;
+		}
+
+		bool read_int(int64_t *value)
+		{
+			double number = 0;
+			bool is_null = false;
+
+			if(!read_number(&number, &is_null) || is_null || number != floor(number))
+				return fail();
+
+			*value = (int64_t)number;
+			return true;
+		}
+
+		bool failed() const
+		{
+			return _failed;
+		}
+
+	private:
+		/** Read first byte and argument of an item. Simple values and floats
+		 * have their bits as argument. */
+		bool read_head(uint8_t *major, uint8_t *info, uint64_t *value)
+		{
+			if(_failed || _pos >= _size)
+				return false;
+
+			uint8_t first = _data[_pos++];
+			*major = first >> 5;
+			*info = first & 0x1F;
+
+			int bytes = 0;
+
+			if(*info < 24 || *info == CborWriter::INDEFINITE)
+			{
+				*value = *info < 24 ? *info : 0;
+				return true;
+			}
+			else if(*info <= 27)
+			{
+				bytes = 1 << (*info - 24);
+			}
+			else
+			{
+				return false;
+			}
+
+			if(_pos + bytes > _size)
+				return false;
+
+			*value = 0;
+			for(int i = 0; i < bytes; i++)
+				*value = (*value << 8) | _data[_pos++];
+
+			return true;
+		}
+
+		static double half_to_double(uint64_t half)
+		{
+			int exp = (half >> 10) & 0x1F;
+			int mantissa = half & 0x3FF;
+			double value = 0;
+
+			if(exp == 0)
+				value = ldexp(mantissa, -24);
+			else if(exp == 31)
+				value = mantissa == 0 ? INFINITY : NAN;
+			else
+				value = ldexp(mantissa + 1024, exp - 25);
+
+			return (half & 0x8000) ? -value : value;
+		}
+
+		bool fail()
+		{
+			_failed = true;
+			return false;
+		}
+
+		const uint8_t *_data = NULL;
+		int _size = 0;
+		int _pos = 0;
+		bool _failed = false;
+	};
+
+	/** Entry type binary telemetry can be sent for */
+	struct EntryType
+	{
+		const char *name;
+		const EntrySchema::Field* (*get_schema)(int *field_count);
+		RetResult (*decode)(CborReader *reader, const EntrySchema::Field *fields, int field_count,
+			uint32_t first_tstamp, char *json_out, int json_size, int *entry_count);
+	};
+
+	template <typename TEntry, typename TBuilder>
+	RetResult decode_entries(CborReader *reader, const EntrySchema::Field *fields, int field_count,
+		uint32_t first_tstamp, char *json_out, int json_size, int *entry_count);
+
+	/** Types with a CBOR builder */
+	const EntryType ENTRY_TYPES[] = {
+		{"WaterSensorData", WaterSensorData::get_schema, decode_entries<WaterSensorData::Entry, TbWaterSensorDataJsonBuilder>},
+		{"Atmos41Data", Atmos41Data::get_schema, decode_entries<Atmos41Data::Entry, TbAtmos41DataJsonBuilder>},
+		{"SoilMoistureData", SoilMoistureData::get_schema, decode_entries<SoilMoistureData::Entry, TbSoilMoistureDataJsonBuilder>},
+		{"LightningData", LightningData::get_schema, decode_entries<LightningData::Entry, TbLightningDataJsonBuilder>},
+		{"FoData", FoData::get_schema, decode_entries<FoData::StoreEntry, TbFoDataJsonBuilder>}
+	};
+
+	/******************************************************************************
+	 * Read request header and find its entry type
+	 * @return NULL if payload is not a request of a known type and version
+	 ******************************************************************************/
+	const EntryType* read_header(CborReader *reader, uint32_t *first_tstamp)
+	{
+		int count = 0;
+		int64_t version = 0, telemetry_id = 0, tstamp = 0;
+
+		if(!reader->read_array(&count) || count != 4 || !reader->read_int(&version) ||
+			version != TELEMETRY_CBOR_VERSION || !reader->read_int(&telemetry_id) || !reader->read_int(&tstamp))
+		{
+			return NULL;
+		}
+
+		*first_tstamp = tstamp;
+
+		for(unsigned int i = 0; i < sizeof(ENTRY_TYPES) / sizeof(ENTRY_TYPES[0]); i++)
+		{
+			int field_count = 0;
+			const EntrySchema::Field *fields = ENTRY_TYPES[i].get_schema(&field_count);
+
+			if(EntrySchema::telemetry_id(fields, field_count) == (uint32_t)telemetry_id)
+				return &ENTRY_TYPES[i];
+		}
+
+		return NULL;
+	}
+
+	/******************************************************************************
+	 * Decode a request to TB JSON
+	 * @param entry_count Entries decoded
+	 * @return RET_ERROR if payload is invalid, of an unknown type/version or
+	 *		   the JSON doesn't fit
+	 ******************************************************************************/
+	RetResult to_tb_json(const uint8_t *payload, int size, char *json_out, int json_size, int *entry_count)
+	{
+		CborReader reader(payload, size);
+		uint32_t first_tstamp = 0;
+
+		*entry_count = 0;
+
+		const EntryType *type = read_header(&reader, &first_tstamp);
+		if(type == NULL)
+			return RET_ERROR;
+
+		int field_count = 0;
+		const EntrySchema::Field *fields = type->get_schema(&field_count);
+
+		return type->decode(&reader, fields, field_count, first_tstamp, json_out, json_size, entry_count);
+	}
+
+	/******************************************************************************
+	 * Name of the entry type of a request, NULL if unknown
+	 ******************************************************************************/
+	const char* get_type_name(const uint8_t *payload, int size)
+	{
+		CborReader reader(payload, size);
+		uint32_t first_tstamp = 0;
+
+		const EntryType *type = read_header(&reader, &first_tstamp);
+
+		return type != NULL ? type->name : NULL;
+	}
+
+	/******************************************************************************
+	 * Rebuild the entries of a request through their schema and build their JSON
+	 * Fields not sent (no key, zero group) are left 0, as the JSON builder
+	 * leaves out the same ones.
+	 ******************************************************************************/
+	template <typename TEntry, typename TBuilder>
+	RetResult decode_entries(CborReader *reader, const EntrySchema::Field *fields, int field_count,
+		uint32_t first_tstamp, char *json_out, int json_size, int *entry_count)
+	{
+		TBuilder builder;
+		uint32_t tstamp = first_tstamp;
+		int count = 0;
+
+		int items = 1;
+		for(int i = 1; i < field_count; i++)
+		{
+			if(fields[i].key != NULL)
+				items++;
+		}
+
+		if(!reader->read_array(&count) || count != -1)
+			return RET_ERROR;
+
+		while(!reader->read_break())
+		{
+			TEntry entry;
+			int64_t delta = 0;
+
+			memset(&entry, 0, sizeof(entry));
+
+			if(!reader->read_array(&count) || count != items || !reader->read_int(&delta))
+				return RET_ERROR;
+
+			tstamp += delta;
+			EntrySchema::set_value(&fields[0], &entry, tstamp);
+
+			for(int i = 1; i < field_count; i++)
+			{
+				const EntrySchema::Field *field = &fields[i];
+				double value = 0;
+				bool is_null = false;
+
+				if(field->key == NULL)
+					continue;
+
+				if(!reader->read_number(&value, &is_null))
+					return RET_ERROR;
+
+				if(is_null)
+					continue;
+
+				if(field->type == EntrySchema::TYPE_FLOAT && field->decimals != EntrySchema::DECIMALS_ALL)
+					value /= EntrySchema::decimals_scale(field);
+
+				EntrySchema::set_value(field, &entry, value);
+			}
+
+			if(builder.add(&entry) != RET_OK)
+				return RET_ERROR;
+
+			(*entry_count)++;
+		}
+
+		if(reader->failed())
+			return RET_ERROR;
+
+		return builder.build(json_out, json_size, false);
+	}
+}
@@ -7,13 +7,45 @@
 
 namespace Atmos41Data
 {
+	/**
+	 * Schema of entries. Temperatures, pressures and humidity are sent with one
+	 * decimal, the sensor resolution.
+	 */
+	constexpr EntrySchema::Field SCHEMA[] = {
+		ENTRY_SCHEMA_FIELD(Entry, timestamp, NULL, "Timestamp", 0, FIELD_DELTA2, EntrySchema::FLAG_NONE),
+		ENTRY_SCHEMA_FIELD(Entry, solar, ATMOS41_DATA_KEY_SOLAR, "Solar",
+			0, FIELD_DELTA, EntrySchema::FLAG_NONE),
+		ENTRY_SCHEMA_FIELD(Entry, precipitation, ATMOS41_DATA_KEY_PRECIPITATION, "Precipitation",
+			EntrySchema::DECIMALS_ALL, FIELD_DELTA, EntrySchema::FLAG_NONE),
+		ENTRY_SCHEMA_FIELD(Entry, strikes, ATMOS41_DATA_KEY_STRIKES, "Strikes",
+			0, FIELD_DELTA, EntrySchema::FLAG_NONE),
+		ENTRY_SCHEMA_FIELD(Entry, wind_speed, ATMOS41_DATA_KEY_WIND_SPEED, "Wind speed",
+			EntrySchema::DECIMALS_ALL, FIELD_DELTA, EntrySchema::FLAG_NONE),
+		ENTRY_SCHEMA_FIELD(Entry, wind_dir, ATMOS41_DATA_KEY_WIND_DIR, "Wind dir",
+			0, FIELD_DELTA, EntrySchema::FLAG_NONE),
+		ENTRY_SCHEMA_FIELD(Entry, wind_gust_speed, ATMOS41_DATA_KEY_WIND_GUST, "Wind gust speed",
+			EntrySchema::DECIMALS_ALL, FIELD_DELTA, EntrySchema::FLAG_NONE),
+		ENTRY_SCHEMA_FIELD(Entry, air_temp, ATMOS41_DATA_KEY_AIR_TEMP, "Air temp",
+			1, FIELD_DELTA, EntrySchema::FLAG_NONE),
+		ENTRY_SCHEMA_FIELD(Entry, vapor_pressure, ATMOS41_DATA_KEY_VAPOR_PRESSURE, "Vapor press",
+			EntrySchema::DECIMALS_ALL, FIELD_DELTA, EntrySchema::FLAG_NONE),
+		ENTRY_SCHEMA_FIELD(Entry, atm_pressure, ATMOS41_DATA_KEY_ATM_PRESSURE, "Atm press",
+			1, FIELD_DELTA, EntrySchema::FLAG_NONE),
+		ENTRY_SCHEMA_FIELD(Entry, rel_humidity, ATMOS41_DATA_KEY_REL_HUMIDITY, "Relative humidity",
+			1, FIELD_DELTA, EntrySchema::FLAG_NONE),
+		ENTRY_SCHEMA_FIELD(Entry, dew_point, ATMOS41_DATA_KEY_DEW_POINT, "Dew point",
+			1, FIELD_DELTA, EntrySchema::FLAG_NONE)
+	};
+	ENTRY_SCHEMA_CHECK(Entry, SCHEMA);
+
 	/** 
 	 * Store for weather data
 	 * Number of entries per file is the same as the number of entries in a request packet.
 	 * This way if a request succeeds, a whole file can be deleted, if not the file remains
 	 * to be resent at a later time
 	 */
-    DataStore<Atmos41Data::Entry> store(ATMOS41_DATA_PATH, ATMOS41_DATA_ENTRIES_PER_SUBMIT_REQ);
+    DataStore<Atmos41Data::Entry> store(ATMOS41_DATA_PATH, ATMOS41_DATA_ENTRIES_PER_SUBMIT_REQ,
+        EntrySchema::schema_id(SCHEMA, ENTRY_SCHEMA_FIELD_COUNT(SCHEMA)));
 
     /******************************************************************************
     * Add water weather data to storage
@@ -37,6 +69,15 @@ namespace Atmos41Data
         return &store;
     }
 
+    /******************************************************************************
+    * Get entry schema
+    ******************************************************************************/
+    const EntrySchema::Field* get_schema(int *field_count)
+    {
+        *field_count = ENTRY_SCHEMA_FIELD_COUNT(SCHEMA);
+        return SCHEMA;
+    }
+
     /********************************************************************************
 	 * Print all data from a struct
 	 * @param data Data structure
@@ -45,41 +86,7 @@ namespace Atmos41Data
 	{
 		Utils::print_separator(F("Atmos41 Data"));
 
-		debug_print(F("Timestamp: "));
-		debug_println(data->timestamp);
-
-		debug_print(F("Solar: "));
-		debug_println(data->solar);
-
-		debug_print(F("Precipitation: "));
-		debug_println(data->precipitation);
-
-		debug_print(F("Strikes: "));
-		debug_println(data->strikes);
-
-		debug_print(F("Wind speed: "));
-		debug_println(data->wind_speed);
-
-		debug_print(F("Wind dir: "));
-		debug_println(data->wind_dir, DEC);
-
-		debug_print(F("Wind gust speed: "));
-		debug_println(data->wind_gust_speed, DEC);
-
-		debug_print(F("Air temp: "));
-		debug_println(data->air_temp, DEC);
-
-		debug_print(F("Vapor press: "));
-		debug_println(data->vapor_pressure, DEC);
-
-		debug_print(F("Atm press: "));
-		debug_println(data->atm_pressure, DEC);
-
-		debug_print(F("Relative humidity: "));
-		debug_println(data->rel_humidity, DEC);
-
-		debug_print(F("Dew point: "));
-		debug_println(data->dew_point, DEC);
+		EntrySchema::print(SCHEMA, ENTRY_SCHEMA_FIELD_COUNT(SCHEMA), data);
 
 		Utils::print_separator(NULL);
 	}
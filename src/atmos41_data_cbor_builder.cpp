@@ -0,0 +1,14 @@
+#include "atmos41_data_cbor_builder.h"
+#include "common.h"
+
+/******************************************************************************
+ * Add packet to request
+ * Values are generated from the entry schema, see Atmos41Data::get_schema()
+ *****************************************************************************/
+RetResult Atmos41DataCborBuilder::add(const Atmos41Data::Entry *entry)
+{
+	int field_count = 0;
+	const EntrySchema::Field *fields = Atmos41Data::get_schema(&field_count);
+
+	return add_schema_entry(entry, fields, field_count);
+}
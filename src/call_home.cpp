@@ -4,6 +4,8 @@
 #include "common.h"
 #include "log.h"
 #include "data_store_reader.h"
+#include "telemetry_upload.h"
+#include "store_telemetry_stream.h"
 #include "water_sensor_data.h"
 #include "soil_moisture_data.h"
 #include "sdi12_log.h"
@@ -24,6 +26,7 @@
 #include "battery.h"
 #include "int_env_sensor.h"
 #include "http_request.h"
+#include "http_session.h"
 #include "log.h"
 #include "globals.h"
 #include "atmos41_data.h"
@@ -37,6 +40,37 @@
 #include <HTTPClient.h>
 #include "ipfs_client.h"
 
+/******************************************************************************
+* Upload socket sending each request over a connection of its own, as a
+* whole request/response exchange
+******************************************************************************/
+class RequestUploadSocket : public UploadSocket
+{
+public:
+	RetResult send(const char *path, HttpBodyWriter *body, const char *content_type)
+	{
+		HttpRequest http_req(GSM::get_modem(), TB_SERVER);
+		http_req.set_port(TB_PORT);
+
+		_response_code = 0;
+
+		if(http_req.post(path, body, content_type, NULL, 0) != RET_OK)
+			return RET_ERROR;
+
+		_response_code = http_req.get_response_code();
+
+		return RET_OK;
+	}
+
+	int read_response()
+	{
+		return _response_code;
+	}
+
+private:
+	int _response_code = 0;
+};
+
 namespace CallHome
 {
 	//
@@ -44,10 +78,19 @@ namespace CallHome
 	//
 	template <typename TStore, typename TBuilder, typename TEntry>
 	RetResult submit_stored_telemetry(TStore *store, DataStoreSubmitStats *stats);
+	RetResult submit_merged_telemetry(DataStoreSubmitStats *stats);
+	template <typename TEntry>
+	uint64_t priority_window_start();
 	RetResult submit_tb_telemetry(const char *data, int data_size);
 	uint32_t build_flags_bitmask();
 	RetResult end();
 
+	//
+	// Private vars
+	//
+	/** Tick call home started */
+	uint32_t _start_millis = 0;
+
 	/******************************************************************************
 	* Handle waking up from sleep to call home
 	******************************************************************************/
@@ -65,6 +108,8 @@ namespace CallHome
 
 		Log::log(Log::Code::CALLING_HOME);
 
+		_start_millis = millis();
+
 		// TEMP Log current schedule
 		Log::log(Log::SCHEDULE_CALL_HOME_INT, DeviceConfig::get_wakeup_schedule_reason_int(SleepScheduler::WakeupReason::REASON_CALL_HOME));
 		Log::log(Log::SCHEDULE_WATER_SENSORS_INT, DeviceConfig::get_wakeup_schedule_reason_int(SleepScheduler::WakeupReason::REASON_READ_WATER_SENSORS));
@@ -77,7 +122,7 @@ namespace CallHome
 		Battery::log_solar_adc();
 		Log::log(Log::BATTERY_MDDE, Battery::get_last_mode());
 
-		Log::log(Log::Code::FS_SPACE, SPIFFS.usedBytes(), SPIFFS.totalBytes() - SPIFFS.usedBytes());
+		Log::log(Log::Code::FS_SPACE, Storage::used_bytes(), Storage::total_bytes() - Storage::used_bytes());
 
 		GSM::on();
 		if(GSM::connect_persist() != RET_OK)
@@ -91,12 +136,16 @@ namespace CallHome
 		// Log RSSI
 		Log::log(Log::GSM_RSSI, GSM::get_rssi());
 
+		// All TB requests of call home share a connection
+		HttpSession::open(TB_SERVER, TB_PORT);
+
 		if(FLAGS.RTC_AUTO_SYNC)
 		{
-			uint32_t last_sync_tick = RTC::get_last_sync_tick();
-			uint32_t mins_since_last_tick = ((millis() - last_sync_tick) / 1000 / 60);
+			// Timestamp instead of ticks, ticks restart after deep sleep
+			uint32_t last_sync_tstamp = RTC::get_last_sync_tstamp();
+			uint32_t mins_since_last_sync = (RTC::get_timestamp() - last_sync_tstamp) / 60;
 			
-			if(mins_since_last_tick >= RTC_AUTOSYNC_INTERVAL_MIN)
+			if(mins_since_last_sync >= RTC_AUTOSYNC_INTERVAL_MIN)
 			{
 				debug_println_i(F("RTC auto sync"));
 				RTC::sync();
@@ -185,6 +234,8 @@ namespace CallHome
 	 *****************************************************************************/
 	RetResult end()
 	{
+		HttpSession::close();
+
 		GSM::off();
 		
 		Utils::serial_style(STYLE_BLUE);
@@ -192,8 +243,8 @@ namespace CallHome
 		Utils::serial_style(STYLE_RESET);
 		debug_println();
 
-		Log::log(Log::CALLING_HOME_END);
-		Log::log(Log::Code::FS_SPACE, SPIFFS.usedBytes(), SPIFFS.totalBytes() - SPIFFS.usedBytes());
+		Log::log(Log::CALLING_HOME_END, (millis() - _start_millis) / 1000);
+		Log::log(Log::Code::FS_SPACE, Storage::used_bytes(), Storage::total_bytes() - Storage::used_bytes());
 
 		BatteryGauge::log();
 
@@ -331,15 +382,26 @@ namespace CallHome
 		// Keep track of time elapsed
 		uint32_t telemetry_start_millis = millis();
 
-		for(int i = 0; i < sizeof(tasks) / sizeof(tasks[0]); i++)
+		if(FLAGS.TELEMETRY_MERGED)
 		{
-			tasks[i](&telemetry_stats);
-
-			if(telemetry_stats.failed_requests >= FAILED_TELEMETRY_REQ_THRESHOLD)
+			if(submit_merged_telemetry(&telemetry_stats) != RET_OK)
 			{
 				debug_println_e(F("Request error threshold reached, aborting telemetry submission"));
 				submission_aborted = true;
-				break;
+			}
+		}
+		else
+		{
+			for(int i = 0; i < sizeof(tasks) / sizeof(tasks[0]); i++)
+			{
+				tasks[i](&telemetry_stats);
+
+				if(telemetry_stats.failed_requests >= FAILED_TELEMETRY_REQ_THRESHOLD)
+				{
+					debug_println_e(F("Request error threshold reached, aborting telemetry submission"));
+					submission_aborted = true;
+					break;
+				}
 			}
 		}
 
@@ -384,6 +446,23 @@ namespace CallHome
 		debug_println(logs_elapsed_sec, DEC);
 		debug_println();
 
+		if(telemetry_stats.body_bytes > 0)
+		{
+			debug_print(F("Compressed bodies (bytes): "));
+			debug_print(telemetry_stats.body_bytes, DEC);
+			debug_print(F(" -> "));
+			debug_print(telemetry_stats.compressed_bytes, DEC);
+			debug_print(F(" - Saved: "));
+			debug_print((int)telemetry_stats.body_bytes - (int)telemetry_stats.compressed_bytes, DEC);
+			debug_print(F(" - Ratio: "));
+			debug_print((float)telemetry_stats.body_bytes / telemetry_stats.compressed_bytes, 2);
+			debug_print(F(" - CPU (ms): "));
+			debug_println(telemetry_stats.compress_us / 1000, DEC);
+			debug_println();
+
+			Log::log(Log::TELEMETRY_COMPRESSED, telemetry_stats.body_bytes, telemetry_stats.compressed_bytes);
+		}
+
 		Log::log(Log::SENSOR_DATA_SUBMITTED, telemetry_stats.submitted_entries, telemetry_stats.crc_failed_entries);
 
 		Log::log(Log::DATA_SUBMISSION_ELAPSED, telemetry_elapsed_sec, logs_elapsed_sec);
@@ -401,137 +480,108 @@ namespace CallHome
 	}
 
 	/******************************************************************************
-	 * Read all data from a DataStore, build JSON and submit as telemetry
+	 * Submit all data of a DataStore as telemetry, see TelemetryUpload
+	 * Requests are pipelined over the sockets of the HTTP session, sent one at a
+	 * time over connections of their own if no session is open.
 	 *****************************************************************************/
 	template <typename TStore, typename TBuilder, typename TEntry>
 	RetResult submit_stored_telemetry(TStore *store, DataStoreSubmitStats *stats)
 	{
+		char url[URL_BUFFER_SIZE] = "";
 
-		// Entries in current request packet
-		int cur_req_entries = 0;
-		// Keep count of failed CRCs for log
-		int crc_failures = 0;
-		// Total sensor data entries
-		int total_entries = 0;
-		// Total entries submitted (valid entries)
-		int submitted_entries = 0;
-		// Total successfull entries
-		int successfull_entries = 0;
-		// Total number of requests 
-		int total_requests = 0;
-		// Number of successfull requests
-		int successfull_requests = 0;
-
-		TBuilder json_builder;
-
-		// Output buffer for resulting JSON
-		char json_buff[TELEMETRY_DATA_JSON_OUTPUT_BUFF_SIZE] = {0};
-		
-		DataStoreReader<TEntry> reader(store);
-		const TEntry *entry = NULL;
+		snprintf(url, sizeof(url), TB_TELEMETRY_URL_FORMAT, DeviceConfig::get_tb_device_token());
 
-		json_builder.reset();
+		UploadSocket *sockets[UPLOAD_PIPELINE_MAX_SOCKETS];
+		int socket_count = HttpSession::get_upload_sockets(sockets, UPLOAD_PIPELINE_SOCKETS);
 
-		//
-		// Iterate all data and submit. Each file in flash will fit in a single request.
-		// If request succeeds, file is deleted, if not it is left to be retried next time.
-		//
-		
-		// Submission errors occurred
-		bool submission_failed = false;
-
-		while(reader.next_file())
+		RequestUploadSocket request_socket;
+		if(socket_count == 0)
 		{
-			cur_req_entries = 0;
-
-			// Iterate all file entries in file, check CRC and add to JSON
-			while((entry = reader.next_entry()))
-			{
-				total_entries++;
-				if(!reader.entry_crc_valid())
-				{
-					crc_failures++;
-					continue;
-				}
-				
-				cur_req_entries++;
-				submitted_entries++;
-
-				json_builder.add(entry);
-			}
+			sockets[0] = &request_socket;
+			socket_count = 1;
+		}
 
-			// Send only if there are valid entries to be sent
-			if(cur_req_entries > 0)
-			{
-				json_builder.build(json_buff, sizeof(json_buff), false);
+		UploadPipeline pipeline(sockets, socket_count);
 
-				total_requests++;
+		return TelemetryUpload::submit_store<TEntry, TBuilder>(store, &pipeline, url, priority_window_start<TEntry>(),
+			FLAGS.TELEMETRY_GZIP, stats);
+	}
 
-				if(submit_tb_telemetry(json_buff, strlen(json_buff)) == RET_OK)
-				{
-					// Request success, file can be deleted
-					reader.delete_file();
+	/******************************************************************************
+	 * Submit the telemetry of all stores in merged requests, in time order with
+	 * values that share a timestamp joined. Requests go over the first
+	 * connection of the session, or one of their own if no session is open.
+	 *****************************************************************************/
+	RetResult submit_merged_telemetry(DataStoreSubmitStats *stats)
+	{
+		char url[URL_BUFFER_SIZE] = "";
 
-					Utils::serial_style(STYLE_BLUE);
-					debug_println(F("Deleting file, all complete"));
-					Utils::serial_style(STYLE_RESET);
+		snprintf(url, sizeof(url), TB_TELEMETRY_URL_FORMAT, DeviceConfig::get_tb_device_token());
 
-					successfull_entries += cur_req_entries;
-					successfull_requests++;
-				}
-				else
-				{
-					Utils::serial_style(STYLE_RED);
-					debug_println(F("Sending telemetry data failed. File remains to be retried next time."));
-					Utils::serial_style(STYLE_RESET);
+		Utils::serial_style(STYLE_BLUE);
+		Utils::print_separator(F("Submitting merged telemetry."));
+		Utils::serial_style(STYLE_RESET);
 
-					// Max error threshold reached, abort
-					if(total_requests - successfull_entries >= FAILED_TELEMETRY_REQ_THRESHOLD)
-					{
-						submission_failed = true;
-						break;
-					}
-				}
-			}
-			else
-			{
-				// All entries failed CRC in this file so it is useless, delete it
-				reader.delete_file();
+		UploadSocket *sockets[1];
+		RequestUploadSocket request_socket;
+
+		if(HttpSession::get_upload_sockets(sockets, 1) == 0)
+			sockets[0] = &request_socket;
+
+		UploadPipeline pipeline(sockets, 1);
+
+		// Streams hold an entry buffer and builder each, kept off the stack.
+		// submit_merged() resets them for every submission.
+		static StoreTelemetryStream<WaterSensorData::Entry, TbWaterSensorDataJsonBuilder> water_sensor_stream(
+			WaterSensorData::get_store());
+		static StoreTelemetryStream<Atmos41Data::Entry, TbAtmos41DataJsonBuilder> atmos41_stream(
+			Atmos41Data::get_store());
+		static StoreTelemetryStream<SoilMoistureData::Entry, TbSoilMoistureDataJsonBuilder> soil_moisture_stream(
+			SoilMoistureData::get_store());
+		static StoreTelemetryStream<FoData::StoreEntry, TbFoDataJsonBuilder> fo_stream(
+			FoData::get_store());
+		static StoreTelemetryStream<LightningData::Entry, TbLightningDataJsonBuilder> lightning_stream(
+			LightningData::get_store());
+		static StoreTelemetryStream<SDI12Log::Entry, TbSDI12LogJsonBuilder> sdi12_log_stream(
+			SDI12Log::get_store());
+
+		TelemetryStream *streams[] = {
+			&water_sensor_stream,
+			&atmos41_stream,
+			&soil_moisture_stream,
+			&fo_stream,
+			&lightning_stream,
+			&sdi12_log_stream
+		};
+		int stream_count = sizeof(streams) / sizeof(streams[0]);
+
+		RetResult ret = TelemetryUpload::submit_merged(streams, stream_count, &pipeline, url, FLAGS.TELEMETRY_GZIP,
+			stats);
 
-				Utils::serial_style(STYLE_BLUE);
-				debug_println(F("Deleting file, BAD CRC"));
-				Utils::serial_style(STYLE_RESET);
-			}
+		Utils::serial_style(STYLE_BLUE);
+		Utils::print_separator(F("Merged telemetry submission complete"));
+		Utils::serial_style(STYLE_RESET);
 
-			// Empty packet and prepare for next
-			json_builder.reset();
-		}
+		return ret;
+	}
 
-		// Print report
-		int failed_requests = total_requests - successfull_requests;
+	/******************************************************************************
+	 * Start of the priority window in units of a store's entry timestamps:
+	 * seconds, or ms for 64 bit timestamps (logs). 0 (whole store) if the clock
+	 * is not past the window.
+	 *****************************************************************************/
+	template <typename TEntry>
+	uint64_t priority_window_start()
+	{
+		uint64_t window_sec = (uint64_t)TELEMETRY_PRIORITY_WINDOW_HOURS * 3600;
+		uint64_t now = RTC::get_timestamp();
 
-		debug_print(F("Total entries: "));
-		debug_println(total_entries, DEC);
-		debug_print(F("Submitted entries: "));
-		debug_println(submitted_entries, DEC);
-		debug_print(F("Successful entries: "));
-		debug_println(successfull_entries, DEC);
-		debug_print(F("Entries failed CRC32: "));
-		debug_println(crc_failures, DEC);
-		debug_println();
+		if(now <= window_sec)
+			return 0;
 
-		// Output operation stats (add to provided)
-		if(stats != nullptr)
-		{
-			stats->total_entries += total_entries;
-			stats->submitted_entries += submitted_entries;
-			stats->successful_entries += successfull_entries;
-			stats->crc_failed_entries += crc_failures;
-			stats->total_requests += total_requests;
-			stats->failed_requests += failed_requests;
-		}
+		uint64_t start = now - window_sec;
 
-		return submission_failed ? RET_ERROR : RET_OK;
+		return sizeof(((TEntry*)0)->timestamp) > sizeof(uint32_t) ? start * 1000 : start;
 	}
 
 	/******************************************************************************
@@ -547,11 +597,14 @@ namespace CallHome
 		Utils::print_separator(F("Submitting logs."));
 		Utils::serial_style(STYLE_RESET);
 
+		// Write staged logs so they are submitted too
+		Log::commit();
+
 		// Disable logs to avoid getting stuck in loop in case an error occurrs while
 		// accessing the file system to read the logs
 		Log::set_enabled(false);
 
-		DataStoreSubmitStats log_stats;
+		DataStoreSubmitStats log_stats = {0};
 		ret = submit_stored_telemetry<DataStore<Log::Entry>, TbLogJsonBuilder, Log::Entry>(Log::get_store(), &log_stats);
 
 		// Reenable logging
@@ -646,79 +699,79 @@ namespace CallHome
 		client.set_node_address(IPFS_NODE_ADDR, IPFS_NODE_PORT);
 
 		DataStoreReader<FoData::StoreEntry> reader(FoData::get_store());
-		const FoData::StoreEntry *entry = NULL;
+		DataStore<FoData::StoreEntry>::Entry entries[DATA_STORE_READ_BLOCK_ENTRIES];
+		DataStoreSpan<FoData::StoreEntry> span(entries, DATA_STORE_READ_BLOCK_ENTRIES);
 
 		while(reader.next_file())
 		{
-			while((entry = reader.next_entry()))
+			// Entries that failed CRC are already dropped from span
+			while(reader.next_entries(&span, DATA_STORE_READ_BLOCK_ENTRIES))
 			{
-				if(!reader.entry_crc_valid())
+				for(int i = 0; i < span.count; i++)
 				{
-					continue;
-				}
-
-				json_builder.add(entry);
+					json_builder.add(span.get(i));
 
-				// Add geohash to JSON
-				JsonDocument *json_doc = json_builder.get_json_doc();
+					// Add geohash to JSON
+					JsonDocument *json_doc = json_builder.get_json_doc();
 				
-				json_doc->getElement(0)["values"]["geohash"] = DEVICE_GEOHASH;
+					json_doc->getElement(0)["values"]["geohash"] = DEVICE_GEOHASH;
 
-				// Get timestamp of record
-				uint32_t tstamp = (uint64_t)json_doc->getElement(0)["ts"] / 1000;
+					// Get timestamp of record
+					uint32_t tstamp = (uint64_t)json_doc->getElement(0)["ts"] / 1000;
 				
-				json_builder.build(data_buff, sizeof(data_buff), true);
+					json_builder.build(data_buff, sizeof(data_buff), true);
 
-				// Serial.println(F("Submitting --------------------"));
-				// Serial.println(data_buff);
-				// Serial.println(F("------------------------------------------------------------------------"));
+					// Serial.println(F("Submitting --------------------"));
+					// Serial.println(data_buff);
+					// Serial.println(F("------------------------------------------------------------------------"));
 
-				IPFSClient::IPFSFile ipfs_file = {0};
-				if(client.add(&ipfs_file, "ws", data_buff) == IPFSClient::IPFS_CLIENT_OK)
-				{
-					Serial.println(F("Hash: "));
-					Serial.println(ipfs_file.hash);
+					IPFSClient::IPFSFile ipfs_file = {0};
+					if(client.add(&ipfs_file, "ws", data_buff) == IPFSClient::IPFS_CLIENT_OK)
+					{
+						Serial.println(F("Hash: "));
+						Serial.println(ipfs_file.hash);
 
-					//
-					// Submit hash
-					//
-					const char cid_submit_url_format[] = "/ipfs/%s";
-					data_buff[0] = '\0';
+						//
+						// Submit hash
+						//
+						const char cid_submit_url_format[] = "/ipfs/%s";
+						data_buff[0] = '\0';
 
-					snprintf(data_buff, sizeof(data_buff), cid_submit_url_format, ipfs_file.hash);
+						snprintf(data_buff, sizeof(data_buff), cid_submit_url_format, ipfs_file.hash);
 
-					HttpRequest http_req(GSM::get_modem(), IPFS_MIDDLEWARE_URL);
-					http_req.set_port(IPFS_MIDDLEWARE_PORT);
+						HttpRequest http_req(GSM::get_modem(), IPFS_MIDDLEWARE_URL);
+						http_req.set_port(IPFS_MIDDLEWARE_PORT);
 
-					debug_print(F("Submitting CID to Middleware: "));
-					debug_println(data_buff);
+						debug_print(F("Submitting CID to Middleware: "));
+						debug_println(data_buff);
 					
-					RetResult ret = http_req.post(data_buff, NULL, 0, "application/json", NULL, 0);
-					Serial.flush();
-
-					if(ret != RET_OK || http_req.get_response_code() != 200)
+						RetResult ret = http_req.post(data_buff, NULL, 0, "application/json", NULL, 0);
+						Serial.flush();
+
+						if(ret != RET_OK || http_req.get_response_code() != 200)
+						{
+							debug_println_e(F("CID submission failed."));
+						}				
+						data_buff[0] = '\0';
+
+						//
+						// Submit hash to thingsboard
+						//
+						Utils::build_ipfs_file_json(ipfs_file.hash, tstamp, data_buff, sizeof(data_buff));
+						Serial.println(F("TB JSON: "));
+						Serial.println(data_buff);
+						submit_tb_telemetry(data_buff, strlen(data_buff));
+
+						data_buff[0] = '\0';
+					}
+					else
 					{
-						debug_println_e(F("CID submission failed."));
-					}				
-					data_buff[0] = '\0';
-
-					//
-					// Submit hash to thingsboard
-					//
-					Utils::build_ipfs_file_json(ipfs_file.hash, tstamp, data_buff, sizeof(data_buff));
-					Serial.println(F("TB JSON: "));
-					Serial.println(data_buff);
-					submit_tb_telemetry(data_buff, strlen(data_buff));
-
-					data_buff[0] = '\0';
-				}
-				else
-				{
-					debug_println_e(F("Could not submit data to IPFS."));
-				}
+						debug_println_e(F("Could not submit data to IPFS."));
+					}
 				
-				json_builder.reset();
+					json_builder.reset();
 
+				}
 			}
 		}
 		//////////////////////
@@ -763,6 +816,31 @@ namespace CallHome
 		json_doc[TB_ATTR_UPTIME] = millis() / 1000;
 		json_doc[TB_ATTR_FLAGS] = build_flags_bitmask();
 
+		// Flash wear counters since power on
+		const Flash::Stats *flash_stats = Flash::get_stats();
+
+		JsonArray flash_wear = json_doc.createNestedArray(TB_ATTR_FLASH_WEAR);
+		flash_wear.add(flash_stats->since_tstamp);
+		flash_wear.add(flash_stats->writes);
+		flash_wear.add(flash_stats->bytes_written);
+		flash_wear.add(flash_stats->pages_programmed);
+		flash_wear.add(Flash::get_est_erases());
+		flash_wear.add(flash_stats->raw_bytes_written);
+		flash_wear.add(flash_stats->raw_erases);
+		flash_wear.add(flash_stats->files_created);
+		flash_wear.add(flash_stats->files_deleted);
+		flash_wear.add(flash_stats->mount_ms);
+		flash_wear.add(flash_stats->files_evicted);
+
+		JsonObject flash_stores = json_doc.createNestedObject(TB_ATTR_FLASH_STORES);
+		for(int i = 0; i < flash_stats->store_count; i++)
+		{
+			JsonArray store = flash_stores.createNestedArray(flash_stats->stores[i].dir_path);
+			store.add(flash_stats->stores[i].data_bytes);
+			store.add(flash_stats->stores[i].manifest_bytes);
+			store.add(flash_stats->stores[i].files_evicted);
+		}
+
 		// FO Enabled
 		json_doc[TB_ATTR_CUR_FO_EN] = DeviceConfig::get_fo_enabled();
 
@@ -0,0 +1,194 @@
+#include "cbor_builder_base.h"
+#include "water_sensor_data.h"
+#include "atmos41_data.h"
+#include "soil_moisture_data.h"
+#include "lightning_data.h"
+#include "fo_data.h"
+#include "common.h"
+#include <math.h>
+#include <string.h>
+
+/******************************************************************************
+ * Default constructor
+ *****************************************************************************/
+template <typename TStruct, int TBuffSize>
+CborBuilderBase<TStruct, TBuffSize>::CborBuilderBase() : _writer(_buff, TBuffSize)
+{
+	reset();
+}
+
+/******************************************************************************
+ * Add an entry described by a schema (see CborBuilderBase)
+ * @return RET_ERROR if entry doesn't fit, request is left as it was
+ *****************************************************************************/
+template <typename TStruct, int TBuffSize>
+RetResult CborBuilderBase<TStruct, TBuffSize>::add_schema_entry(const TStruct *entry,
+	const EntrySchema::Field *fields, int field_count)
+{
+	uint32_t tstamp = (uint32_t)EntrySchema::get_value(&fields[0], entry);
+
+	if(_entry_count == 0)
+	{
+		_telemetry_id = EntrySchema::telemetry_id(fields, field_count);
+		_first_tstamp = tstamp;
+		_last_tstamp = tstamp;
+	}
+
+	int items = 1;
+	for(int i = 1; i < field_count; i++)
+	{
+		if(fields[i].key != NULL)
+			items++;
+	}
+
+	int start_size = _writer.get_size();
+	bool skip_zero_group = EntrySchema::is_zero_group_empty(fields, field_count, entry);
+
+	_writer.begin_array(items);
+	_writer.write_int((int64_t)tstamp - _last_tstamp);
+
+	for(int i = 1; i < field_count; i++)
+	{
+		const EntrySchema::Field *field = &fields[i];
+
+		if(field->key == NULL)
+			continue;
+
+		if(skip_zero_group && (field->flags & EntrySchema::FLAG_ZERO_GROUP))
+		{
+			_writer.write_null();
+			continue;
+		}
+
+		double value = EntrySchema::get_value(field, entry);
+
+		switch(field->type)
+		{
+		case EntrySchema::TYPE_FLOAT:
+			if(field->decimals != EntrySchema::DECIMALS_ALL)
+			{
+				_writer.write_int((int64_t)round(value * EntrySchema::decimals_scale(field)));
+			}
+			else if(value == floor(value) && fabs(value) < 4294967296.0)
+			{
+				_writer.write_int((int64_t)value);
+			}
+			else
+			{
+				_writer.write_double(value);
+			}
+			break;
+
+		case EntrySchema::TYPE_BOOL:
+			_writer.write_uint(value != 0);
+			break;
+
+		case EntrySchema::TYPE_SIGNED:
+			_writer.write_int((int64_t)value);
+			break;
+
+		default:
+			_writer.write_uint((uint64_t)value);
+			break;
+		}
+	}
+
+	if(_writer.is_full())
+	{
+		debug_println_e(F("Could not add entry to CBOR."));
+		_writer.set_size(start_size);
+		return RET_ERROR;
+	}
+
+	_last_tstamp = tstamp;
+	_entry_count++;
+
+	return RET_OK;
+}
+
+/******************************************************************************
+ * Write request to buffer
+ * @param size_out Bytes written
+ * @return RET_ERROR if buffer is too small
+ *****************************************************************************/
+template <typename TStruct, int TBuffSize>
+RetResult CborBuilderBase<TStruct, TBuffSize>::build(uint8_t *buff_out, int buff_size, int *size_out)
+{
+	CborWriter writer(buff_out, buff_size);
+
+	writer.begin_array(4);
+	writer.write_uint(TELEMETRY_CBOR_VERSION);
+	writer.write_uint(_telemetry_id);
+	writer.write_uint(_first_tstamp);
+	writer.begin_array();
+
+	int header_size = writer.get_size();
+	int entries_size = _writer.get_size();
+
+	if(writer.is_full() || header_size + entries_size + 1 > buff_size)
+	{
+		*size_out = 0;
+		return RET_ERROR;
+	}
+
+	memcpy(buff_out + header_size, _buff, entries_size);
+	writer.set_size(header_size + entries_size);
+	writer.end_array();
+
+	*size_out = writer.get_size();
+
+	return RET_OK;
+}
+
+/******************************************************************************
+ * Reset object for reuse
+ *****************************************************************************/
+template <typename TStruct, int TBuffSize>
+RetResult CborBuilderBase<TStruct, TBuffSize>::reset()
+{
+	_writer.set_size(0);
+	_entry_count = 0;
+	_telemetry_id = 0;
+	_first_tstamp = 0;
+	_last_tstamp = 0;
+
+	return RET_OK;
+}
+
+template <typename TStruct, int TBuffSize>
+bool CborBuilderBase<TStruct, TBuffSize>::is_empty()
+{
+	return _entry_count < 1;
+}
+
+/******************************************************************************
+ * Print request as hex
+ * Used for debugging
+ *****************************************************************************/
+template <typename TStruct, int TBuffSize>
+void CborBuilderBase<TStruct, TBuffSize>::print()
+{
+	uint8_t buff[TBuffSize + 32];
+	int size = 0;
+
+	build(buff, sizeof(buff), &size);
+
+	for(int i = 0; i < size; i++)
+	{
+		if(buff[i] < 0x10)
+			debug_print('0');
+		debug_print(buff[i], HEX);
+	}
+
+	debug_println();
+	debug_print(F("Length: "));
+	debug_println(size, DEC);
+}
+
+
+// Forward declarations
+template class CborBuilderBase<WaterSensorData::Entry, TELEMETRY_CBOR_BUFF_SIZE>;
+template class CborBuilderBase<Atmos41Data::Entry, TELEMETRY_CBOR_BUFF_SIZE>;
+template class CborBuilderBase<SoilMoistureData::Entry, TELEMETRY_CBOR_BUFF_SIZE>;
+template class CborBuilderBase<LightningData::Entry, TELEMETRY_CBOR_BUFF_SIZE>;
+template class CborBuilderBase<FoData::StoreEntry, TELEMETRY_CBOR_BUFF_SIZE>;
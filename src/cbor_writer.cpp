@@ -0,0 +1,219 @@
+#include "cbor_writer.h"
+#include <string.h>
+
+/******************************************************************************
+ * Constructor
+ * @param buff Buffer items are written to, from its start
+ ******************************************************************************/
+CborWriter::CborWriter(uint8_t *buff, int buff_size)
+{
+	_buff = buff;
+	_buff_size = buff_size;
+}
+
+/******************************************************************************
+ * Default constructor (private)
+ ******************************************************************************/
+CborWriter::CborWriter()
+{}
+
+void CborWriter::write_uint(uint64_t value)
+{
+	write_head(MAJOR_UNSIGNED, value);
+}
+
+void CborWriter::write_int(int64_t value)
+{
+	if(value >= 0)
+		write_head(MAJOR_UNSIGNED, value);
+	else
+		write_head(MAJOR_NEGATIVE, (uint64_t)(-1 - value));
+}
+
+/******************************************************************************
+ * Write a float in the shortest form that keeps its value
+ ******************************************************************************/
+void CborWriter::write_double(double value)
+{
+	float single = (float)value;
+	uint16_t half = 0;
+
+	// Needs double. NaN != NaN, it is written as half.
+	if((double)single != value && value == value)
+	{
+		uint64_t bits = 0;
+		memcpy(&bits, &value, sizeof(bits));
+
+		write_byte((MAJOR_SIMPLE << 5) | SIMPLE_DOUBLE);
+		write_be(bits, sizeof(bits));
+	}
+	else if(to_half(single, &half))
+	{
+		write_byte((MAJOR_SIMPLE << 5) | SIMPLE_HALF);
+		write_be(half, sizeof(half));
+	}
+	else
+	{
+		uint32_t bits = 0;
+		memcpy(&bits, &single, sizeof(bits));
+
+		write_byte((MAJOR_SIMPLE << 5) | SIMPLE_SINGLE);
+		write_be(bits, sizeof(bits));
+	}
+}
+
+void CborWriter::write_null()
+{
+	write_byte((MAJOR_SIMPLE << 5) | SIMPLE_NULL);
+}
+
+/******************************************************************************
+ * Start an array of count items
+ ******************************************************************************/
+void CborWriter::begin_array(int count)
+{
+	write_head(MAJOR_ARRAY, count);
+}
+
+/******************************************************************************
+ * Start an array of items not known yet, closed by end_array()
+ ******************************************************************************/
+void CborWriter::begin_array()
+{
+	write_byte((MAJOR_ARRAY << 5) | INDEFINITE);
+}
+
+void CborWriter::end_array()
+{
+	write_byte(BREAK);
+}
+
+/******************************************************************************
+ * Bytes written
+ ******************************************************************************/
+int CborWriter::get_size() const
+{
+	return _size;
+}
+
+/******************************************************************************
+ * Check if a write didn't fit in buffer
+ ******************************************************************************/
+bool CborWriter::is_full() const
+{
+	return _full;
+}
+
+/******************************************************************************
+ * Drop everything written after size (eg. an item that didn't fit) and clear
+ * full flag
+ ******************************************************************************/
+void CborWriter::set_size(int size)
+{
+	_size = size;
+	_full = false;
+}
+
+/******************************************************************************
+ * Write major type and its argument, in the fewest bytes
+ ******************************************************************************/
+void CborWriter::write_head(uint8_t major_type, uint64_t value)
+{
+	if(value < 24)
+	{
+		write_byte((major_type << 5) | value);
+	}
+	else if(value <= 0xFF)
+	{
+		write_byte((major_type << 5) | 24);
+		write_be(value, 1);
+	}
+	else if(value <= 0xFFFF)
+	{
+		write_byte((major_type << 5) | 25);
+		write_be(value, 2);
+	}
+	else if(value <= 0xFFFFFFFF)
+	{
+		write_byte((major_type << 5) | 26);
+		write_be(value, 4);
+	}
+	else
+	{
+		write_byte((major_type << 5) | 27);
+		write_be(value, 8);
+	}
+}
+
+void CborWriter::write_byte(uint8_t byte)
+{
+	if(_size >= _buff_size)
+	{
+		_full = true;
+		return;
+	}
+
+	_buff[_size++] = byte;
+}
+
+/******************************************************************************
+ * Write the low bytes of a value, big endian
+ ******************************************************************************/
+void CborWriter::write_be(uint64_t value, int bytes)
+{
+	for(int i = bytes - 1; i >= 0; i--)
+		write_byte((value >> (i * 8)) & 0xFF);
+}
+
+/******************************************************************************
+ * Convert a float to half precision if that keeps its value
+ * @return False if value needs more precision or range
+ ******************************************************************************/
+bool CborWriter::to_half(float value, uint16_t *half)
+{
+	uint32_t bits = 0;
+	memcpy(&bits, &value, sizeof(bits));
+
+	uint16_t sign = (bits >> 16) & 0x8000;
+	int exp = (int)((bits >> 23) & 0xFF) - 127;
+	uint32_t mantissa = bits & 0x7FFFFF;
+
+	// Zero
+	if((bits & 0x7FFFFFFF) == 0)
+	{
+		*half = sign;
+		return true;
+	}
+
+	// Inf/NaN
+	if(exp == 128)
+	{
+		*half = sign | 0x7C00 | (mantissa ? 0x200 : 0);
+		return true;
+	}
+
+	// Normal half, low 13 bits of mantissa are dropped
+	if(exp >= -14 && exp <= 15)
+	{
+		if(mantissa & 0x1FFF)
+			return false;
+
+		*half = sign | ((exp + 15) << 10) | (mantissa >> 13);
+		return true;
+	}
+
+	// Subnormal half (units of 2^-24), float subnormals are out of range
+	if(exp >= -24 && exp < -14)
+	{
+		uint32_t significand = mantissa | 0x800000;
+		int shift = -(exp + 1);
+
+		if(significand & ((1u << shift) - 1))
+			return false;
+
+		*half = sign | (significand >> shift);
+		return true;
+	}
+
+	return false;
+}
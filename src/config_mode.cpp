@@ -4,7 +4,8 @@
 #include "config_mode.h"
 #include "app_config.h"
 #include "device_config.h"
-#include <SPIFFS.h>
+#include "storage.h"
+#include "data_store_manifest.h"
 
 namespace ConfigMode
 {
@@ -385,7 +386,8 @@ RetResult cmd_spiffs_format(char *val, bool read)
 {
 	Serial.println(F("Formatting..."));
 	
-	if(SPIFFS.format())
+	DataStoreManifest::unload_all();
+	if(Storage::format())
 	{
 		print_ok();
 	}
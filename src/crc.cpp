@@ -0,0 +1,105 @@
+#include "crc.h"
+
+#ifndef NATIVE
+#include "rom/crc.h"
+#endif
+
+namespace Crc
+{
+	/******************************************************************************
+	 * Privates
+	 ******************************************************************************/
+#ifdef NATIVE
+	/** Reflected polynomial */
+	const uint32_t POLY = 0xEDB88320;
+
+	/** table[0] is the classic byte table, table[k] advances a byte k more
+	 * positions. Built on first use. */
+	uint32_t _table[8][256];
+	bool _table_ready = false;
+
+	void build_table();
+#endif
+
+	/******************************************************************************
+	 * CRC32 of a buffer
+	 ******************************************************************************/
+	uint32_t crc32(const void *data, size_t size)
+	{
+		return crc32_update(0, data, size);
+	}
+
+	/******************************************************************************
+	 * Continue a CRC32 with more data
+	 * @param crc Result of previous call, 0 to start
+	 ******************************************************************************/
+	uint32_t crc32_update(uint32_t crc, const void *data, size_t size)
+	{
+#ifndef NATIVE
+		// ROM takes care of init/xorout
+		return crc32_le(crc, (const uint8_t*)data, size);
+#else
+		if(!_table_ready)
+			build_table();
+
+		const uint8_t *p = (const uint8_t*)data;
+		uint32_t state = ~crc;
+
+		while(size >= 8)
+		{
+			uint32_t lo = state ^ ((uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24);
+			uint32_t hi = (uint32_t)p[4] | (uint32_t)p[5] << 8 | (uint32_t)p[6] << 16 | (uint32_t)p[7] << 24;
+
+			state = _table[7][lo & 0xFF] ^ _table[6][(lo >> 8) & 0xFF] ^
+				_table[5][(lo >> 16) & 0xFF] ^ _table[4][lo >> 24] ^
+				_table[3][hi & 0xFF] ^ _table[2][(hi >> 8) & 0xFF] ^
+				_table[1][(hi >> 16) & 0xFF] ^ _table[0][hi >> 24];
+
+			p += 8;
+			size -= 8;
+		}
+
+		while(size--)
+			state = _table[0][(state ^ *p++) & 0xFF] ^ (state >> 8);
+
+		return ~state;
+#endif
+	}
+
+	/******************************************************************************
+	 * Name of engine in use, for logs and benchmarks
+	 ******************************************************************************/
+	const char* get_engine_name()
+	{
+#ifndef NATIVE
+		return "ROM crc32_le";
+#else
+		return "slicing-by-8";
+#endif
+	}
+
+#ifdef NATIVE
+	/******************************************************************************
+	 * Build slicing tables
+	 ******************************************************************************/
+	void build_table()
+	{
+		for(uint32_t i = 0; i < 256; i++)
+		{
+			uint32_t c = i;
+			for(int bit = 0; bit < 8; bit++)
+				c = (c & 1) ? (c >> 1) ^ POLY : c >> 1;
+
+			_table[0][i] = c;
+		}
+
+		for(uint32_t i = 0; i < 256; i++)
+		{
+			for(int k = 1; k < 8; k++)
+				_table[k][i] = (_table[k - 1][i] >> 8) ^ _table[0][_table[k - 1][i] & 0xFF];
+		}
+
+		_table_ready = true;
+	}
+#endif
+} // Crc
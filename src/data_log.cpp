@@ -0,0 +1,135 @@
+#include "data_log.h"
+#include "esp_partition_flash.h"
+#include "ring_log.h"
+#include "data_store.h"
+#include "water_sensor_data.h"
+#include "atmos41_data.h"
+#include "soil_moisture_data.h"
+#include "fo_data.h"
+#include "lightning_data.h"
+#include "sdi12_log.h"
+#include "log.h"
+#include "const.h"
+#include "common.h"
+
+namespace DataLog
+{
+	/******************************************************************************
+	 * Privates
+	 ******************************************************************************/
+	/** Data log partition */
+	EspPartitionFlash _flash;
+
+	/** One ring per store, in the order of STORE_SHARES */
+	RingLog _rings[7];
+
+	/** Share of the partition each store gets. Partition is split in
+	 * sum(shares) parts and each store gets share parts. */
+	const int STORE_SHARES[] = {
+		4,	// Water sensor data
+		4,	// Atmos41 data
+		2,	// Soil moisture data
+		2,	// FineOffset data
+		1,	// Lightning data
+		2,	// Log
+		1	// SDI12 log
+	};
+
+	/** Partition found and all rings ready */
+	bool _enabled = false;
+
+	template <typename TEntry>
+	RetResult attach(DataStore<TEntry> *store, int index, uint32_t sectors_per_share, uint32_t *offset);
+
+	/******************************************************************************
+	 * Find data log partition and attach a ring log to every store.
+	 * Without the partition, stores stay on SPIFFS.
+	 ******************************************************************************/
+	RetResult init()
+	{
+		_enabled = false;
+
+		if(_flash.begin(DATA_LOG_PARTITION_LABEL) != RET_OK)
+		{
+			debug_println(F("No data log partition, stores use SPIFFS."));
+			return RET_ERROR;
+		}
+
+		int total_shares = 0;
+		for(unsigned int i = 0; i < sizeof(STORE_SHARES) / sizeof(STORE_SHARES[0]); i++)
+		{
+			total_shares += STORE_SHARES[i];
+		}
+
+		uint32_t sectors_per_share = _flash.get_size() / _flash.get_sector_size() / total_shares;
+		uint32_t offset = 0;
+
+		if(attach(WaterSensorData::get_store(), 0, sectors_per_share, &offset) != RET_OK ||
+			attach(Atmos41Data::get_store(), 1, sectors_per_share, &offset) != RET_OK ||
+			attach(SoilMoistureData::get_store(), 2, sectors_per_share, &offset) != RET_OK ||
+			attach(FoData::get_store(), 3, sectors_per_share, &offset) != RET_OK ||
+			attach(LightningData::get_store(), 4, sectors_per_share, &offset) != RET_OK ||
+			attach(Log::get_store(), 5, sectors_per_share, &offset) != RET_OK ||
+			attach(SDI12Log::get_store(), 6, sectors_per_share, &offset) != RET_OK)
+		{
+			debug_println_e(F("Could not init data log, stores use SPIFFS."));
+			return RET_ERROR;
+		}
+
+		_enabled = true;
+
+		print_info();
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * Check if stores use the data log
+	 ******************************************************************************/
+	bool is_enabled()
+	{
+		return _enabled;
+	}
+
+	/******************************************************************************
+	 * Print info of all rings
+	 ******************************************************************************/
+	void print_info()
+	{
+		if(!_enabled)
+		{
+			debug_println(F("Data log disabled."));
+			return;
+		}
+
+		for(unsigned int i = 0; i < sizeof(_rings) / sizeof(_rings[0]); i++)
+		{
+			_rings[i].print_info();
+		}
+	}
+
+	/******************************************************************************
+	 * Begin a store's ring at offset and attach it to the store
+	 * @param store Store to attach to
+	 * @param index Index of ring/share
+	 * @param sectors_per_share Sectors in a single share
+	 * @param offset Ring offset in partition, advanced by ring size
+	 ******************************************************************************/
+	template <typename TEntry>
+	RetResult attach(DataStore<TEntry> *store, int index, uint32_t sectors_per_share, uint32_t *offset)
+	{
+		uint32_t size = STORE_SHARES[index] * sectors_per_share * _flash.get_sector_size();
+
+		if(_rings[index].begin(&_flash, *offset, size, sizeof(typename DataStore<TEntry>::Entry)) != RET_OK)
+		{
+			debug_print(F("Could not begin ring log of store: "));
+			debug_println(store->get_dir_path());
+			return RET_ERROR;
+		}
+
+		store->set_ring_log(&_rings[index]);
+		*offset += size;
+
+		return RET_OK;
+	}
+}
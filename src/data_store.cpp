@@ -9,12 +9,13 @@
 #include "utils.h"
 #include "flash.h"
 #include "common.h"
+#include "deep_sleep.h"
 
 /******************************************************************************
  * DataStore
- * Represents a store of data structures in SPIFFS.
+ * Represents a store of data structures in flash.
  * Data can be add()ed which is then stored in a buffer until the buffer is full
- * or commit() is called, in which cases it is appended to a file in SPIFFS.
+ * or commit() is called, in which cases it is appended to a file in flash.
  * A file has a max size. When max size is reached, a new file is created and 
  * subsequent structures are written there.
  * Data in a DataStore can be traversed with a DataStoreReader class.
@@ -26,10 +27,42 @@
  * @param elements_per_file Max entries to store in a file before creating a new one
  ******************************************************************************/
 template <class TStruct>
-DataStore<TStruct>::DataStore(const char *dir_path, int max_entries_per_file)
+DataStore<TStruct>::DataStore(const char *dir_path, int max_entries_per_file) : _manifest(dir_path)
 {
 	_dir_path = dir_path;
 	_max_entries_per_file = max_entries_per_file;
+	_manifest.set_restore_callback(restore_manifest_record, this);
+}
+
+/******************************************************************************
+ * Constructor, for raw stores with a known schema
+ * @param schema_id Id of TStruct's schema (see EntrySchema::schema_id()),
+ *		  written to file headers. Files of another schema are not read.
+ ******************************************************************************/
+template <class TStruct>
+DataStore<TStruct>::DataStore(const char *dir_path, int max_entries_per_file, uint32_t schema_id) : _manifest(dir_path)
+{
+	_dir_path = dir_path;
+	_max_entries_per_file = max_entries_per_file;
+	_manifest.set_restore_callback(restore_manifest_record, this);
+	_schema_id = schema_id;
+}
+
+/******************************************************************************
+ * Constructor, for stores writing encoded files
+ * @param layout Field layout of TStruct, see set_encoding()
+ * @param block_layout Rows or columns, see set_encoding()
+ ******************************************************************************/
+template <class TStruct>
+DataStore<TStruct>::DataStore(const char *dir_path, int max_entries_per_file,
+	const DataStoreCodec::Field *layout, int layout_field_count,
+	DataStoreCodec::BlockLayout block_layout) : _manifest(dir_path)
+{
+	_dir_path = dir_path;
+	_max_entries_per_file = max_entries_per_file;
+	_manifest.set_restore_callback(restore_manifest_record, this);
+
+	set_encoding(layout, layout_field_count, block_layout);
 }
 
 /******************************************************************************
@@ -87,23 +120,89 @@ RetResult DataStore<TStruct>::add(TStruct *data)
  * Data is appended to a file until max file size is reached. In that case a new
  * file is created and writing continues to that file. File names are 
  * 
+ * Entries that could not be written remain in the buffer.
+ * When flash is (nearly) full, old files of stores over their quota or of
+ * lower priority stores are evicted to make room, up to
+ * DATA_STORE_EVICT_MAX_FILES per commit (see DataStoreManifest::evict()).
  ******************************************************************************/
 template <class TStruct>
 RetResult DataStore<TStruct>::commit()
 {
+	if(_ring_log != NULL && _ring_log->is_ready())
+		return commit_ring_log();
+
 	if (Flash::mount() != RET_OK)
 		return RET_ERROR;
 
-	// If current data file not set yet, get one
-	if(strlen(_current_data_file_path) < 1)
+	if(load_manifest() != RET_OK)
+	{
+		debug_println(F("Could not load store manifest."));
+		return RET_ERROR;
+	}
+
+	int evicted = 0;
+
+	// Keep free space for SPIFFS before writing
+	while(evicted < DATA_STORE_EVICT_MAX_FILES && Flash::get_free_bytes() < DATA_STORE_EVICT_MIN_FREE_BYTES)
+	{
+		if(DataStoreManifest::evict(&_manifest) != RET_OK)
+			break;
+
+		evicted++;
+	}
+
+	RetResult ret = commit_files();
+
+	// Commit failed for lack of space, evict and retry with what is left in buffer
+	while(ret != RET_OK && evicted < DATA_STORE_EVICT_MAX_FILES && Flash::get_free_bytes() < DATA_STORE_EVICT_MIN_FREE_BYTES)
+	{
+		if(DataStoreManifest::evict(&_manifest) != RET_OK)
+			break;
+
+		evicted++;
+		ret = commit_files();
+	}
+
+	return ret;
+}
+
+/******************************************************************************
+ * Write buffer to the store's data files
+ ******************************************************************************/
+template <class TStruct>
+RetResult DataStore<TStruct>::commit_files()
+{
+	if(load_manifest() != RET_OK)
+	{
+		debug_println(F("Could not load store manifest."));
+		return RET_ERROR;
+	}
+
+	// If current data file not set yet (or was deleted by a reader), get one
+	if(strlen(_current_data_file_path) < 1 || _manifest.get_current_record() != _current_record_index)
 	{
-		if(update_current_data_file_path() != RET_OK)
+		if(update_current_data_file_path(_buffer_element_count > 0 ? _buffer[0].data.timestamp : 0) != RET_OK)
 		{
 			debug_println(F("Could not get data file to write to."));
 			return RET_ERROR;
 		}
 	}
-	
+
+	if(_layout != NULL)
+		return commit_encoded();
+	else if(_commit_mode == DATA_STORE_COMMIT_PER_ENTRY)
+		return commit_per_entry();
+	else
+		return commit_bulk();
+}
+
+/******************************************************************************
+ * Commit buffer one entry per write, starting from the end of the buffer.
+ * Each written entry is removed from the buffer immediately.
+ ******************************************************************************/
+template <class TStruct>
+RetResult DataStore<TStruct>::commit_per_entry()
+{
 	// debug_print(F("File: "));
 	// debug_println(_current_data_file_path)
 	File f;
@@ -115,7 +214,7 @@ RetResult DataStore<TStruct>::commit()
 	while(entries_left)
 	{
 		// Try to open current data file.
-		f = SPIFFS.open(_current_data_file_path, "a");
+		f = Storage::fs().open(_current_data_file_path, "a");
 
 		if(!f)
 		{
@@ -124,7 +223,11 @@ RetResult DataStore<TStruct>::commit()
 		}
 
 		// Entries to write is how many space we have left in this file / size of an entry
-		int entries_for_current_file = (_max_entries_per_file * sizeof(Entry) - f.size()) / sizeof(Entry);
+		size_t data_size = f.size() - data_offset(&_current_record);
+		int entries_for_current_file = (_max_entries_per_file * sizeof(Entry) - data_size) / sizeof(Entry);
+
+		// File size is the truth, manifest may lag behind after a reset
+		_current_record.entries = data_size / sizeof(Entry);
 
 		if(entries_for_current_file > 0)
 		{
@@ -134,26 +237,31 @@ RetResult DataStore<TStruct>::commit()
 			// If writing fails this will be false
 			bool write_success = true;
 
+			// Entries written are the ones right after entries_left in buffer
+			int entries_left_before = entries_left;
+
 			// Write entries one by one from end of buffer. If correct number of bytes is written,
 			// last buffer element is removed. In the case of full disk, data corruption is minimized
 			for(int i = 0; i < entries_for_current_file; i++)
 			{
 				// Get buffer entry to write
 				const Entry *buff_entry = NULL;
-				buff_entry = get_buffer_element(entries_left - i - 1);
+				buff_entry = get_buffer_element(entries_left - 1);
 
 				// Reading out of bounds check (redundant)
 				if(buff_entry == NULL)
 				{
 					debug_print(F("Element index doesn't exist in buffer: "));
-					debug_println(entries_left - i - 1, DEC);
+					debug_println(entries_left - 1, DEC);
 
 					write_success = false;
 					break;
 				}
 
 				// Write a single netry
+				size_t pos = f.size();
 				int written_bytes = f.write((uint8_t*)buff_entry, sizeof(Entry));
+				Flash::count_write(_dir_path, pos, written_bytes);
 				if(written_bytes != sizeof(Entry))
 				{
 					debug_println(F("Could not write entry."));
@@ -173,6 +281,8 @@ RetResult DataStore<TStruct>::commit()
 				entries_left--;
 			}
 
+			update_current_record(&_buffer[entries_left], entries_left_before - entries_left);
+
 			// Writing failed, abort
 			if(!write_success)
 			{
@@ -187,8 +297,9 @@ RetResult DataStore<TStruct>::commit()
 		// it is time to get a new data file
 		if(entries_for_current_file < 1 || entries_left > 0)
 		{
-			// File has reached max size, get new file
-			if(update_current_data_file_path() != RET_OK)
+			// File has reached max size, get new file. A file with no room left
+			// but less entries (partly written one at its end) is left too.
+			if(update_current_data_file_path(_buffer[entries_left - 1].data.timestamp, entries_for_current_file < 1) != RET_OK)
 			{
 				debug_printf("Could not get data file to write to.");
 				
@@ -202,190 +313,1663 @@ RetResult DataStore<TStruct>::commit()
 }
 
 /******************************************************************************
- * Clear buffer data
+ * Commit buffer with a single write per data file
+ * The run of entries that fits in the current file is written in one go, in
+ * chronological order (start of buffer first), then writing continues to the
+ * next file. On a short write only whole entries count as written; written
+ * entries are removed from the buffer and the rest remain, same as with the
+ * per-entry path.
  ******************************************************************************/
 template <class TStruct>
-RetResult DataStore<TStruct>::clear_buffer()
+RetResult DataStore<TStruct>::commit_bulk()
 {
-	_buffer_element_count = 0;
+	// Entries from the start of the buffer that made it to flash
+	unsigned int entries_written = 0;
+	unsigned int entries_total = get_buffer_element_count();
+
+	while(entries_written < entries_total)
+	{
+		File f = Storage::fs().open(_current_data_file_path, "a");
+
+		if(!f)
+		{
+			debug_println(F("Could not open data file for append."));
+			remove_buffer_head(entries_written);
+			return RET_ERROR;
+		}
+
+		// Space left in this file, in entries
+		size_t data_size = f.size() - data_offset(&_current_record);
+		int entries_for_current_file = (_max_entries_per_file * sizeof(Entry) - data_size) / sizeof(Entry);
+
+		// File size is the truth, manifest may lag behind after a reset
+		_current_record.entries = data_size / sizeof(Entry);
+
+		if(entries_for_current_file > 0)
+		{
+			if(entries_total - entries_written < (unsigned int)entries_for_current_file)
+				entries_for_current_file = entries_total - entries_written;
+
+			size_t bytes_to_write = entries_for_current_file * sizeof(Entry);
+			size_t pos = f.size();
+			size_t written_bytes = f.write((uint8_t*)&_buffer[entries_written], bytes_to_write);
+			f.close();
+
+			Flash::count_write(_dir_path, pos, written_bytes);
+
+			// Partially written trailing entry is not counted
+			update_current_record(&_buffer[entries_written], written_bytes / sizeof(Entry));
+			entries_written += written_bytes / sizeof(Entry);
+
+			if(written_bytes != bytes_to_write)
+			{
+				debug_println(F("Could not write entries."));
+				debug_print(F("Bytes: "));
+				debug_println(bytes_to_write, DEC);
+				debug_print(F("Written: "));
+				debug_println(written_bytes, DEC);
+
+				remove_buffer_head(entries_written);
+
+				debug_print(F("Writing failed, aborting. Entries left in buffer: "));
+				debug_println(get_buffer_element_count());
+				return RET_ERROR;
+			}
+		}
+		else
+		{
+			f.close();
+		}
+
+		// Current file full or entries still left, get a new data file. A file
+		// with no room left but less entries (partly written one at its end) is
+		// left too.
+		if(entries_for_current_file < 1 || entries_written < entries_total)
+		{
+			if(update_current_data_file_path(_buffer[entries_written].data.timestamp, entries_for_current_file < 1) != RET_OK)
+			{
+				debug_printf("Could not get data file to write to.");
+
+				remove_buffer_head(entries_written);
+				return RET_ERROR;
+			}
+		}
+	}
+
+	clear_buffer();
 
 	return RET_OK;
 }
 
 /******************************************************************************
- * Clear all saved data from flash storage
+ * Commit buffer to ring log, oldest entry first
+ * Entries appended are removed from the buffer, the rest remain.
  ******************************************************************************/
 template <class TStruct>
-RetResult DataStore<TStruct>::clear_all()
+RetResult DataStore<TStruct>::commit_ring_log()
 {
-	// Clear buffer
-	clear_buffer();
-
-	// Clear flash
-	// Rmdir doesnt't work since SPIFFS is flat and dirs are only somewhat
-	// emulated, so delete one by one
-	File dir = SPIFFS.open(get_dir_path());
-	File file;
+	unsigned int entries_written = 0;
 
-	while(file = dir.openNextFile())
+	while(entries_written < get_buffer_element_count())
 	{
-		SPIFFS.remove(file.name());
+		if(_ring_log->append(&_buffer[entries_written]) != RET_OK)
+		{
+			debug_print(F("Ring log append failed. Entries left in buffer: "));
+			debug_println(get_buffer_element_count() - entries_written);
+
+			remove_buffer_head(entries_written);
+			return RET_ERROR;
+		}
+
+		entries_written++;
 	}
 
+	clear_buffer();
+
 	return RET_OK;
 }
 
 /******************************************************************************
- * Get number of items in buffer
+ * Commit buffer as encoded blocks, oldest entry first
+ * Entries are encoded against the last ones of the current file, so a file is
+ * a chain of blocks that can only be decoded from its start. If the end of the
+ * current file is unknown (eg. after reset) it is decoded first. A file that
+ * doesn't decode to its end (torn write) is not appended to.
+ * Columnar blocks hold the entries of a single commit and don't depend on
+ * previous ones.
+ * Commit mode doesn't apply, each block is a single write.
  ******************************************************************************/
 template <class TStruct>
-unsigned int DataStore<TStruct>::get_buffer_element_count() const
+RetResult DataStore<TStruct>::commit_encoded()
 {
-	return _buffer_element_count;
-}
+	unsigned int entries_written = 0;
+	unsigned int entries_total = get_buffer_element_count();
 
-/******************************************************************************
- * Get pointer to buffer
- * Used by reader.
- ******************************************************************************/
-template <class TStruct>
-const typename DataStore<TStruct>::Entry* DataStore<TStruct>::get_buffer_element(unsigned int index) const
-{
-	if(_buffer_element_count == 0 || index > _buffer_element_count - 1)
-		return NULL;
+	while(entries_written < entries_total)
+	{
+		if(!_codec_history_valid && restore_codec_history() != RET_OK)
+		{
+			debug_println(F("Current data file not appendable, starting new one."));
 
-	return &(_buffer[index]);
+			if(update_current_data_file_path(_buffer[entries_written].data.timestamp, true) != RET_OK)
+			{
+				remove_buffer_head(entries_written);
+				return RET_ERROR;
+			}
+		}
+
+		// Current file full, get a new one
+		if(_current_record.entries >= _max_entries_per_file)
+		{
+			if(update_current_data_file_path(_buffer[entries_written].data.timestamp) != RET_OK)
+			{
+				debug_printf("Could not get data file to write to.");
+
+				remove_buffer_head(entries_written);
+				return RET_ERROR;
+			}
+
+			continue;
+		}
+
+		int entries_for_current_file = _max_entries_per_file - _current_record.entries;
+		if(entries_total - entries_written < (unsigned int)entries_for_current_file)
+			entries_for_current_file = entries_total - entries_written;
+
+		// History is only advanced once the block is on flash
+		uint8_t block[DATA_STORE_CODEC_BLOCK_SIZE];
+		DataStoreCodec::History history = _codec_history;
+		int entries_encoded = 0;
+
+		int block_size = 0;
+
+		if(_block_layout == DataStoreCodec::BLOCK_COLUMNS)
+		{
+			block_size = DataStoreCodec::encode_columnar_block(_layout, _layout_field_count, sizeof(TStruct),
+				(const uint8_t*)&_buffer[entries_written].data, sizeof(Entry), entries_for_current_file,
+				block, sizeof(block), &entries_encoded);
+
+			// A row block after this one starts with a keyframe
+			DataStoreCodec::reset_history(&history);
+		}
+		else
+		{
+			block_size = DataStoreCodec::encode_block(_layout, _layout_field_count, sizeof(TStruct), &history,
+				(const uint8_t*)&_buffer[entries_written].data, sizeof(Entry), entries_for_current_file,
+				block, sizeof(block), &entries_encoded);
+		}
+
+		if(block_size < 0)
+		{
+			debug_println(F("Could not encode entries."));
+			remove_buffer_head(entries_written);
+			return RET_ERROR;
+		}
+
+		File f = Storage::fs().open(_current_data_file_path, "a");
+		if(!f)
+		{
+			debug_println(F("Could not open data file for append."));
+			remove_buffer_head(entries_written);
+			return RET_ERROR;
+		}
+
+		size_t pos = f.size();
+		size_t written_bytes = f.write(block, block_size);
+		f.close();
+
+		Flash::count_write(_dir_path, pos, written_bytes);
+
+		if(written_bytes != (size_t)block_size)
+		{
+			debug_println(F("Could not write block."));
+			debug_print(F("Bytes: "));
+			debug_println(block_size, DEC);
+			debug_print(F("Written: "));
+			debug_println(written_bytes, DEC);
+
+			// Whatever made it to flash is checked on next commit
+			_codec_history_valid = false;
+
+			remove_buffer_head(entries_written);
+			return RET_ERROR;
+		}
+
+		_codec_history = history;
+		update_current_record(&_buffer[entries_written], entries_encoded);
+		entries_written += entries_encoded;
+	}
+
+	clear_buffer();
+
+	return RET_OK;
 }
 
 /******************************************************************************
- * Get store dir path
+ * Decode current data file to get the entries new ones are encoded against
+ * @return RET_ERROR if file is not encoded or doesn't decode to its end
  ******************************************************************************/
 template <class TStruct>
-const char* DataStore<TStruct>::get_dir_path() const
+RetResult DataStore<TStruct>::restore_codec_history()
 {
-	return _dir_path;
+	DataStoreCodec::reset_history(&_codec_history);
+
+	if(!(_current_record.flags & DataStoreManifest::RECORD_ENCODED))
+		return RET_ERROR;
+
+	File f = Storage::fs().open(_current_data_file_path, FILE_READ);
+	if(!f)
+		return RET_ERROR;
+
+	// File is the truth, manifest may lag behind after a reset
+	DataStoreManifest::Record record = _current_record;
+	record.entries = 0;
+
+	size_t valid_size = 0;
+	RetResult ret = scan_encoded_file(f, &record, &_codec_history, &valid_size);
+	f.close();
+
+	_current_record.entries = record.entries;
+	_current_record.min_tstamp = record.min_tstamp;
+	_current_record.max_tstamp = record.max_tstamp;
+
+	if(ret != RET_OK)
+		return RET_ERROR;
+
+	_codec_history_valid = true;
+
+	return RET_OK;
 }
 
 /******************************************************************************
- * Update path of file where the next write operation will take
- * First try to find a  file that has still space left (didn't reach max 
- * element per file limit). If failed, create a new file.
+ * Decode all blocks of an encoded file
+ * Record entry count/timestamps are updated with the entries decoded.
+ * @param f File open for reading, at start
+ * @param record Record to update
+ * @param history Set to the last entries of the file
+ * @param valid_size Set to bytes of file holding its header and valid blocks
+ * @return RET_OK if whole file decoded
  ******************************************************************************/
 template <class TStruct>
-RetResult DataStore<TStruct>::update_current_data_file_path()
+RetResult DataStore<TStruct>::scan_encoded_file(File &f, DataStoreManifest::Record *record,
+	DataStoreCodec::History *history, size_t *valid_size)
 {
-	File dir = SPIFFS.open(_dir_path);
-	if(!dir)
-	{
-		debug_print(F("Could not open store dir: "));
-		debug_println(_dir_path);
+	uint8_t block[DATA_STORE_CODEC_BLOCK_SIZE];
+	DataStoreCodec::BlockHeader header;
+	DataStoreCodec::ColumnCursor cursor;
+	TStruct entry;
+	FileHeader file_header;
+
+	DataStoreCodec::reset_history(history);
+	*valid_size = 0;
+
+	if(read_file_header(f, &file_header) == DATA_STORE_FILE_MISMATCH)
 		return RET_ERROR;
-	}
 
-	// Find smallest file
-	int smallest_size = -1;
-	char smallest_file_path[FILE_PATH_BUFFER_SIZE] = {0};
-	File cur_file;
+	*valid_size = f.position();
 
-	while(cur_file = dir.openNextFile())
+	size_t file_size = f.size();
+
+	while(*valid_size < file_size)
 	{
-		if(cur_file.size() < smallest_size || smallest_size < 0)
+		if(f.read(block, sizeof(header)) != sizeof(header) ||
+			DataStoreCodec::read_block_header(block, sizeof(header), &header) != RET_OK ||
+			f.read(block, header.payload_size) != header.payload_size ||
+			!DataStoreCodec::block_crc_valid(&header, block))
 		{
-			smallest_size = cur_file.size();
-			strncpy(smallest_file_path, cur_file.name(), sizeof(smallest_file_path));
+			return RET_ERROR;
 		}
-	}
-	cur_file.close();
-	dir.close();
-
-	// debug_print(F("Smallest size: ")); // del
-	// debug_println(smallest_size, DEC);
 
-	// Smallest file found, check if there is space in it for at least one entry
-	// else create a new file
-	if(smallest_size >= 0 && smallest_size + sizeof(Entry) <= _max_entries_per_file * sizeof(Entry))
-	{
-		// debug_print(F("Use existing: "));
-		// debug_println(smallest_file_path);
-
-		// Update current file path
-		strncpy(_current_data_file_path, smallest_file_path, sizeof(_current_data_file_path));
-		return RET_OK;
-	}
-	else
-	{
-		// debug_println(F("No file found or all files at max limit, creating new."));
+		bool columnar = header.flags & DataStoreCodec::BLOCK_COLUMNAR;
 
-		// Smallest file not found (no files exist) or all files full, decide a new filename
-		// and create
-		// Filename is current epoch time. In the unlikely event that the filename is taken
-		// (eg. problems with RTC) append a number and see if it is taken, until an unused
-		// name is found. Do this a limited number of times before failing else this could
-		// lead into endless loops under certain circumstances.
-		char new_file_path[FILE_PATH_BUFFER_SIZE] = {0};
-		int tries = 100;
-		bool success = false;
+		if(columnar && DataStoreCodec::begin_columnar_block(_layout, _layout_field_count, &header, block, &cursor) != RET_OK)
+			return RET_ERROR;
 
-		do
+		int pos = 0;
+		for(int i = 0; i < header.entries; i++)
 		{
-			snprintf(new_file_path, sizeof(new_file_path), "%s/%d_%d", _dir_path, (int)time(NULL), FILENAME_POSTFIX_MAX - tries);
-			
-			if (!SPIFFS.exists(new_file_path))
+			if(columnar)
 			{
-				success = true;
-				break;
+				if(DataStoreCodec::decode_columnar_entry(_layout, _layout_field_count, sizeof(TStruct), history,
+					&header, block, &cursor, (uint8_t*)&entry) != RET_OK)
+				{
+					return RET_ERROR;
+				}
 			}
+			else
+			{
+				bool keyframe = i == 0 && (header.flags & DataStoreCodec::BLOCK_KEYFRAME);
 
-		} while (--tries);
+				int size = DataStoreCodec::decode_entry(_layout, _layout_field_count, sizeof(TStruct), history,
+					keyframe, block + pos, header.payload_size - pos, (uint8_t*)&entry);
+				if(size < 0)
+					return RET_ERROR;
 
-		if (!success) 
-		{
-			debug_println(F("Could not decide new file name."));
-			return RET_ERROR;
-		}
+				pos += size;
+			}
 
-		// Create file
-		debug_print(F("Creating new file: "));
-		debug_println(new_file_path);
+			uint64_t tstamp = entry.timestamp;
+			if(record->entries == 0 || tstamp < record->min_tstamp)
+				record->min_tstamp = tstamp;
+			if(record->entries == 0 || tstamp > record->max_tstamp)
+				record->max_tstamp = tstamp;
 
-		File f = SPIFFS.open(new_file_path, FILE_WRITE);
-		if(!f)
-		{
-			debug_print(F("Could not create new data file: "));
-			debug_println(new_file_path);
-			return RET_ERROR;
+			record->entries++;
 		}
 
-		f.close();
-
-		// Update current file path
-		strncpy(_current_data_file_path, new_file_path, sizeof(_current_data_file_path));
+		*valid_size += sizeof(header) + header.payload_size;
 
-		return RET_OK;
+		// Encoder starts row blocks after a columnar one with a keyframe
+		if(columnar)
+			DataStoreCodec::reset_history(history);
 	}
+
+	return RET_OK;
 }
 
-template <typename TStruct>
-File DataStore<TStruct>::open_file()
+/******************************************************************************
+ * Remove entries from the start of the buffer, moving the rest to the front
+ ******************************************************************************/
+template <class TStruct>
+void DataStore<TStruct>::remove_buffer_head(unsigned int count)
 {
-	// TODO: Not implemented
+	if(count >= _buffer_element_count)
+	{
+		_buffer_element_count = 0;
+		return;
+	}
+
+	memmove(&_buffer[0], &_buffer[count], (_buffer_element_count - count) * sizeof(Entry));
+	_buffer_element_count -= count;
 }
 
-template <typename TStruct>
-RetResult DataStore<TStruct>::cleanup_store()
+/******************************************************************************
+ * Set how the buffer is written to flash on commit
+ ******************************************************************************/
+template <class TStruct>
+void DataStore<TStruct>::set_commit_mode(DataStoreCommitMode mode)
 {
-	debug_print_i(F("Cleaning up store: "));
-	debug_println(_dir_path);
+	_commit_mode = mode;
+}
 
-	File dir = SPIFFS.open(_dir_path);
-	if(!dir)
-	{
-		debug_println_e(F("Could not open store dir."));
-		return RET_ERROR;
-	}
+/******************************************************************************
+ * Get commit mode
+ ******************************************************************************/
+template <class TStruct>
+DataStoreCommitMode DataStore<TStruct>::get_commit_mode() const
+{
+	return _commit_mode;
+}
 
-	// TODO: Not implemented
+/******************************************************************************
+ * Clear buffer data
+ ******************************************************************************/
+template <class TStruct>
+RetResult DataStore<TStruct>::clear_buffer()
+{
+	_buffer_element_count = 0;
+
+	return RET_OK;
+}
+
+/******************************************************************************
+ * Keep uncommitted entries in RTC memory over deep sleep, buffer is emptied
+ * @return RET_ERROR if they don't fit, buffer is kept
+ ******************************************************************************/
+template <class TStruct>
+RetResult DataStore<TStruct>::park_buffer()
+{
+	if(_buffer_element_count == 0)
+		return RET_OK;
+
+	if(DeepSleep::park(_dir_path, _buffer, _buffer_element_count * sizeof(Entry)) != RET_OK)
+		return RET_ERROR;
+
+	clear_buffer();
+
+	return RET_OK;
+}
+
+/******************************************************************************
+ * Put entries parked before deep sleep back in the buffer
+ ******************************************************************************/
+template <class TStruct>
+RetResult DataStore<TStruct>::restore_buffer()
+{
+	size_t size = 0;
+
+	if(DeepSleep::unpark(_dir_path, &_buffer[_buffer_element_count],
+		(DATA_STORE_BUFFER_ELEMENTS - _buffer_element_count) * sizeof(Entry), &size) != RET_OK)
+	{
+		return RET_ERROR;
+	}
+
+	_buffer_element_count += size / sizeof(Entry);
+
+	return RET_OK;
+}
+
+/******************************************************************************
+ * Clear all saved data from flash storage
+ ******************************************************************************/
+template <class TStruct>
+RetResult DataStore<TStruct>::clear_all()
+{
+	// Clear buffer
+	clear_buffer();
+
+	// Clear flash
+	// Rmdir doesnt't work since SPIFFS is flat and dirs are only somewhat
+	// emulated, so delete one by one. Dir may not exist on LittleFS.
+	File dir = Storage::fs().open(get_dir_path());
+	File file;
+
+	while(dir && (file = dir.openNextFile()))
+	{
+		if(Storage::fs().remove(file.name()))
+			Flash::count_delete();
+	}
+
+	// Start with an empty manifest
+	_current_record_index = -1;
+	_current_data_file_path[0] = '\0';
+
+	return _manifest.create();
+}
+
+/******************************************************************************
+ * Get number of items in buffer
+ ******************************************************************************/
+template <class TStruct>
+unsigned int DataStore<TStruct>::get_buffer_element_count() const
+{
+	return _buffer_element_count;
+}
+
+/******************************************************************************
+ * Get pointer to buffer
+ * Used by reader.
+ ******************************************************************************/
+template <class TStruct>
+const typename DataStore<TStruct>::Entry* DataStore<TStruct>::get_buffer_element(unsigned int index) const
+{
+	if(_buffer_element_count == 0 || index > _buffer_element_count - 1)
+		return NULL;
+
+	return &(_buffer[index]);
+}
+
+/******************************************************************************
+ * Get store dir path
+ ******************************************************************************/
+template <class TStruct>
+const char* DataStore<TStruct>::get_dir_path() const
+{
+	return _dir_path;
+}
+
+/******************************************************************************
+ * Update path of file where the next write operation will take
+ * Keep writing to the current file of the manifest if there is still space in
+ * it (didn't reach max element per file limit). If not, create a new file and
+ * add it to the manifest.
+ * New files start with a header. A current file of another format (eg. left
+ * by the firmware before an OTA) is not appended to.
+ * @param first_tstamp Timestamp of first entry to be written, for header
+ * @param new_file Create a new file even if current one has space
+ ******************************************************************************/
+template <class TStruct>
+RetResult DataStore<TStruct>::update_current_data_file_path(uint64_t first_tstamp, bool new_file)
+{
+	int index = _manifest.get_current_record();
+
+	// Record in RAM is up to date when it is the current one, else load it
+	if(index >= 0 && index != _current_record_index)
+	{
+		if(_manifest.get_record(index, &_current_record) != RET_OK)
+		{
+			debug_println(F("Could not read current manifest record."));
+			index = -1;
+		}
+		else if(!current_file_usable())
+		{
+			index = -1;
+		}
+	}
+
+	if(index >= 0 && !new_file && _current_record.entries < _max_entries_per_file)
+	{
+		// Update current file path
+		if(index != _current_record_index)
+			_codec_history_valid = false;
+
+		_current_record_index = index;
+		_manifest.get_file_path(&_current_record, _current_data_file_path, sizeof(_current_data_file_path));
+		return RET_OK;
+	}
+	else
+	{
+		// debug_println(F("No file found or all files at max limit, creating new."));
+
+		// No current file or it is full, decide a new filename and create
+		// Filename is current epoch time
+		char new_file_path[FILE_PATH_BUFFER_SIZE] = {0};
+
+		DataStoreManifest::Record new_record = {0};
+		new_record.name_tstamp = time(NULL);
+		new_record.flags = DataStoreManifest::RECORD_HEADER;
+
+		if(_layout != NULL)
+			new_record.flags |= DataStoreManifest::RECORD_ENCODED;
+
+		if(decide_new_file_path(&new_record, new_file_path, sizeof(new_file_path)) != RET_OK)
+			return RET_ERROR;
+
+		// Add to manifest before creating so that the file can't be orphaned
+		if(_manifest.append_record(&new_record, &index) != RET_OK)
+		{
+			debug_println(F("Could not add file to manifest."));
+			return RET_ERROR;
+		}
+
+		// Create file
+		debug_print(F("Creating new file: "));
+		debug_println(new_file_path);
+
+		Storage::make_dirs(new_file_path);
+
+		File f = Storage::fs().open(new_file_path, FILE_WRITE);
+		if(!f)
+		{
+			debug_print(F("Could not create new data file: "));
+			debug_println(new_file_path);
+			_manifest.delete_record(index);
+			return RET_ERROR;
+		}
+
+		Flash::count_create();
+
+		RetResult ret = write_file_header(f, first_tstamp, _layout != NULL);
+		f.close();
+
+		if(ret != RET_OK)
+		{
+			remove_file(index, &new_record);
+			return RET_ERROR;
+		}
+
+		// Empty file, first block will be a keyframe
+		DataStoreCodec::reset_history(&_codec_history);
+		_codec_history_valid = true;
+
+		// Update current file path
+		memcpy(&_current_record, &new_record, sizeof(_current_record));
+		_current_record_index = index;
+		strncpy(_current_data_file_path, new_file_path, sizeof(_current_data_file_path));
+
+		return RET_OK;
+	}
+}
+
+/******************************************************************************
+ * Check that the current record's file can be appended to: its header (if
+ * any) matches the store. A file that doesn't is flagged in the manifest, so
+ * it is only checked once.
+ ******************************************************************************/
+template <class TStruct>
+bool DataStore<TStruct>::current_file_usable()
+{
+	if(_current_record.flags & DataStoreManifest::RECORD_MISMATCH)
+		return false;
+
+	// Legacy file, appended to as it is
+	if(!(_current_record.flags & DataStoreManifest::RECORD_HEADER))
+		return true;
+
+	File f = open_file(&_current_record, FILE_READ);
+
+	// Missing (eg. reset before it was created), start a new one
+	if(!f)
+		return false;
+
+	FileHeader header;
+	DataStoreFileFormat format = read_file_header(f, &header);
+	f.close();
+
+	if(format == DATA_STORE_FILE_CURRENT)
+		return true;
+
+	debug_print(F("Current data file of another format, not appending: "));
+	debug_println(_dir_path);
+
+	_current_record.flags |= DataStoreManifest::RECORD_MISMATCH;
+	_manifest.update_record(_manifest.get_current_record(), &_current_record);
+
+	return false;
+}
+
+/******************************************************************************
+ * Write header of a new data file
+ * @param f File open for writing, empty
+ * @param first_tstamp Timestamp of first entry to be written
+ * @param encoded File will hold encoded blocks
+ ******************************************************************************/
+template <class TStruct>
+RetResult DataStore<TStruct>::write_file_header(File &f, uint64_t first_tstamp, bool encoded)
+{
+	FileHeader header = {0};
+	header.magic = DATA_STORE_FILE_MAGIC;
+	header.version = DATA_STORE_FILE_VERSION;
+	header.flags = encoded ? FILE_ENCODED : 0;
+	header.entry_size = sizeof(Entry);
+	header.schema_id = _schema_id;
+	header.first_tstamp = first_tstamp;
+	header.crc32 = Utils::crc32((uint8_t*)&header, sizeof(header) - sizeof(header.crc32));
+
+	size_t written = f.write((uint8_t*)&header, sizeof(header));
+	Flash::count_write(_dir_path, 0, written);
+
+	if(written != sizeof(header))
+	{
+		debug_println(F("Could not write data file header."));
+		return RET_ERROR;
+	}
+
+	return RET_OK;
+}
+
+/******************************************************************************
+ * Read header of a data file and check it against the store
+ * Only the header is read, so a file is told apart in O(1) whatever its size.
+ * The schema id is compared when both the store and the file have one.
+ * @param f File open for reading, at start. Left at the first entry/block.
+ * @param header Header read (output var), valid unless legacy
+ * @return DATA_STORE_FILE_LEGACY if file has no header,
+ *		   DATA_STORE_FILE_MISMATCH if its entries can't be read by this store
+ ******************************************************************************/
+template <class TStruct>
+DataStoreFileFormat DataStore<TStruct>::read_file_header(File &f, FileHeader *header)
+{
+	// First bytes of a legacy file are an entry CRC or a block header
+	if(f.read((uint8_t*)header, sizeof(*header)) != sizeof(*header) || header->magic != DATA_STORE_FILE_MAGIC)
+	{
+		f.seek(0);
+		return DATA_STORE_FILE_LEGACY;
+	}
+
+	if(header->crc32 != Utils::crc32((uint8_t*)header, sizeof(*header) - sizeof(header->crc32)) ||
+		header->version != DATA_STORE_FILE_VERSION ||
+		header->entry_size != sizeof(Entry) ||
+		(header->schema_id != 0 && _schema_id != 0 && header->schema_id != _schema_id) ||
+		((header->flags & FILE_ENCODED) && _layout == NULL))
+	{
+		return DATA_STORE_FILE_MISMATCH;
+	}
+
+	return DATA_STORE_FILE_CURRENT;
+}
+
+/******************************************************************************
+ * Bytes before the first entry/block of a record's file
+ ******************************************************************************/
+template <class TStruct>
+size_t DataStore<TStruct>::data_offset(const DataStoreManifest::Record *record) const
+{
+	return (record->flags & DataStoreManifest::RECORD_HEADER) ? sizeof(FileHeader) : 0;
+}
+
+/******************************************************************************
+ * Decide name of a new data file
+ * In the unlikely event that the filename is taken (eg. problems with RTC)
+ * append a number and see if it is taken, until an unused name is found. Do
+ * this a limited number of times before failing else this could lead into
+ * endless loops under certain circumstances.
+ * @param record Record of new file, name_tstamp set. name_postfix is set.
+ * @param path Path of new file (output var)
+ ******************************************************************************/
+template <class TStruct>
+RetResult DataStore<TStruct>::decide_new_file_path(DataStoreManifest::Record *record, char *path, int path_size)
+{
+	int tries = FILENAME_POSTFIX_MAX;
+
+	do
+	{
+		record->name_postfix = FILENAME_POSTFIX_MAX - tries;
+		_manifest.get_file_path(record, path, path_size);
+
+		if (!Storage::fs().exists(path))
+			return RET_OK;
+
+	} while (--tries);
+
+	debug_println(F("Could not decide new file name."));
+	return RET_ERROR;
+}
+
+/******************************************************************************
+ * Update current manifest record after entries were appended to its file
+ * Kept in RAM by the manifest, not written on every commit.
+ * @param entries First entry written
+ * @param count Number of entries written (contiguous in buffer)
+ ******************************************************************************/
+template <class TStruct>
+RetResult DataStore<TStruct>::update_current_record(const Entry *entries, int count)
+{
+	if(count < 1)
+		return RET_OK;
+
+	for(int i = 0; i < count; i++)
+	{
+		uint64_t tstamp = entries[i].data.timestamp;
+
+		if(_current_record.entries == 0 || tstamp < _current_record.min_tstamp)
+			_current_record.min_tstamp = tstamp;
+		if(_current_record.entries == 0 || tstamp > _current_record.max_tstamp)
+			_current_record.max_tstamp = tstamp;
+
+		_current_record.entries++;
+	}
+
+	if(_current_record_index != _manifest.get_current_record())
+		return _manifest.update_record(_current_record_index, &_current_record);
+
+	return _manifest.cache_current_record(&_current_record);
+}
+
+/******************************************************************************
+ * Restore callback of the store's manifest, called on every load of it
+ ******************************************************************************/
+template <class TStruct>
+void DataStore<TStruct>::restore_manifest_record(void *store)
+{
+	((DataStore<TStruct>*)store)->restore_current_record();
+}
+
+/******************************************************************************
+ * Bring entry count and timestamps of the current record up to date with its
+ * file. The manifest only has them as of the last time the record was written
+ * (see DataStoreManifest::cache_current_record()). Raw entries after that are
+ * read, an encoded file is decoded.
+ ******************************************************************************/
+template <class TStruct>
+void DataStore<TStruct>::restore_current_record()
+{
+	int index = _manifest.get_current_record();
+	DataStoreManifest::Record record;
+
+	if(index < 0 || _manifest.get_record(index, &record) != RET_OK ||
+		(record.flags & DataStoreManifest::RECORD_MISMATCH))
+	{
+		return;
+	}
+
+	File f = open_file(&record, FILE_READ);
+	if(!f || f.isDirectory())
+		return;
+
+	if(record.flags & DataStoreManifest::RECORD_ENCODED)
+	{
+		if(_layout == NULL)
+		{
+			f.close();
+			return;
+		}
+
+		// Decoded again on first commit, history is only valid for the file
+		// commit switches to
+		size_t valid_size = 0;
+		record.entries = 0;
+		scan_encoded_file(f, &record, &_codec_history, &valid_size);
+		_codec_history_valid = false;
+	}
+	else
+	{
+		size_t offset = data_offset(&record);
+		int file_entries = f.size() > offset ? (f.size() - offset) / sizeof(Entry) : 0;
+
+		if(file_entries <= record.entries)
+		{
+			f.close();
+			return;
+		}
+
+		Entry entry;
+		f.seek(offset + record.entries * sizeof(Entry));
+
+		while(record.entries < file_entries && f.read((uint8_t*)&entry, sizeof(entry)) == sizeof(entry))
+		{
+			uint64_t tstamp = entry.data.timestamp;
+
+			if(record.entries == 0 || tstamp < record.min_tstamp)
+				record.min_tstamp = tstamp;
+			if(record.entries == 0 || tstamp > record.max_tstamp)
+				record.max_tstamp = tstamp;
+
+			record.entries++;
+		}
+	}
+
+	f.close();
+
+	_manifest.cache_current_record(&record);
+}
+
+/******************************************************************************
+ * Load manifest if not loaded yet. If it doesn't exist or is invalid, it is
+ * rebuilt from the store dir. The current record is restored by the
+ * manifest's load (see restore_manifest_record()).
+ ******************************************************************************/
+template <class TStruct>
+RetResult DataStore<TStruct>::load_manifest()
+{
+	if(_manifest.is_loaded())
+		return RET_OK;
+
+	_current_record_index = -1;
+	_current_data_file_path[0] = '\0';
+
+	if(_manifest.load() == RET_OK)
+		return RET_OK;
+
+	return rebuild_manifest();
+}
+
+/******************************************************************************
+ * Rebuild manifest by scanning the store dir. Only needed once, when there is
+ * no manifest yet (eg. first boot after updating from a version without
+ * manifests) or it got corrupted.
+ * Writing continues to the smallest non full file, like before manifests.
+ * Files are told apart by their header, files of another format are listed
+ * (so they are evicted eventually) but never read or written.
+ ******************************************************************************/
+template <class TStruct>
+RetResult DataStore<TStruct>::rebuild_manifest()
+{
+	debug_print(F("Rebuilding manifest of store: "));
+	debug_println(_dir_path);
+
+	if(_manifest.create() != RET_OK)
+		return RET_ERROR;
+
+	File dir = Storage::fs().open(_dir_path);
+	if(!dir)
+	{
+		// No dir means no files
+		return _manifest.set_current_record(-1);
+	}
+
+	int smallest_index = -1;
+	int smallest_entries = _max_entries_per_file;
+	File cur_file;
+
+	while(cur_file = dir.openNextFile())
+	{
+		// File name is <dir>/<tstamp>_<postfix>
+		const char *name = strrchr(cur_file.name(), '/');
+		unsigned int name_tstamp = 0, name_postfix = 0;
+
+		if(name == NULL || sscanf(name + 1, "%u_%u", &name_tstamp, &name_postfix) != 2)
+		{
+			debug_print(F("Not a data file, skipping: "));
+			debug_println(cur_file.name());
+			continue;
+		}
+
+		DataStoreManifest::Record record = {0};
+		record.name_tstamp = name_tstamp;
+		record.name_postfix = name_postfix;
+
+		FileHeader header;
+		DataStoreFileFormat format = read_file_header(cur_file, &header);
+
+		if(format == DATA_STORE_FILE_MISMATCH)
+		{
+			// Entries can't be read, only its header is known
+			record.flags |= DataStoreManifest::RECORD_HEADER | DataStoreManifest::RECORD_MISMATCH;
+			record.min_tstamp = header.first_tstamp;
+			record.max_tstamp = header.first_tstamp;
+		}
+		else if(format == DATA_STORE_FILE_CURRENT)
+		{
+			record.flags |= DataStoreManifest::RECORD_HEADER;
+
+			// Encoded file is kept as encoded even if its end doesn't decode
+			if(header.flags & FILE_ENCODED)
+			{
+				size_t valid_size = 0;
+				cur_file.seek(0);
+				scan_encoded_file(cur_file, &record, &_codec_history, &valid_size);
+
+				record.flags |= DataStoreManifest::RECORD_ENCODED;
+				_codec_history_valid = false;
+			}
+		}
+		else if(_layout != NULL)
+		{
+			// Legacy files of an encoding store may still be raw (written before
+			// encoding was enabled). Only a file that fully decodes is taken as
+			// encoded.
+			size_t valid_size = 0;
+			if(scan_encoded_file(cur_file, &record, &_codec_history, &valid_size) == RET_OK)
+			{
+				record.flags |= DataStoreManifest::RECORD_ENCODED;
+			}
+			else
+			{
+				record.entries = 0;
+				cur_file.seek(0);
+			}
+
+			_codec_history_valid = false;
+		}
+
+		Entry entry;
+		while(!(record.flags & (DataStoreManifest::RECORD_ENCODED | DataStoreManifest::RECORD_MISMATCH)) &&
+			cur_file.read((uint8_t*)&entry, sizeof(entry)) == sizeof(entry))
+		{
+			uint64_t tstamp = entry.data.timestamp;
+
+			if(record.entries == 0 || tstamp < record.min_tstamp)
+				record.min_tstamp = tstamp;
+			if(record.entries == 0 || tstamp > record.max_tstamp)
+				record.max_tstamp = tstamp;
+
+			record.entries++;
+		}
+
+		int index = 0;
+		if(_manifest.append_record(&record, &index) != RET_OK)
+			return RET_ERROR;
+
+		if(!(record.flags & DataStoreManifest::RECORD_MISMATCH) && record.entries < smallest_entries)
+		{
+			smallest_entries = record.entries;
+			smallest_index = index;
+		}
+	}
+	cur_file.close();
+	dir.close();
+
+	return _manifest.set_current_record(smallest_index);
+}
+
+/******************************************************************************
+ * Store data in a ring log instead of SPIFFS files. Ring log must have been
+ * begin()ed with record size sizeof(Entry). Files already in SPIFFS are still
+ * read (before ring log data) until they are deleted.
+ ******************************************************************************/
+template <class TStruct>
+void DataStore<TStruct>::set_ring_log(RingLog *ring_log)
+{
+	if(ring_log != NULL && ring_log->get_record_size() != sizeof(Entry))
+	{
+		debug_println(F("Ring log record size doesn't match store entry size."));
+		return;
+	}
+
+	_ring_log = ring_log;
+}
+
+/******************************************************************************
+ * Get ring log, NULL if store uses SPIFFS only
+ * Used by reader.
+ ******************************************************************************/
+template <class TStruct>
+RingLog* DataStore<TStruct>::get_ring_log()
+{
+	return _ring_log;
+}
+
+/******************************************************************************
+ * Write files as encoded blocks (see DataStoreCodec) instead of raw entries.
+ * Must be set before the first commit. Files already written raw are still
+ * read, but never appended to.
+ * Columnar blocks compress less when commits are small (a block per commit)
+ * but let readers skip blocks outside a time range without decoding them.
+ * The layout's id is the store's schema id, written to file headers.
+ * @param layout Field layout of TStruct, NULL for raw entries. Not copied.
+ * @param layout_field_count Fields in layout
+ * @param block_layout Rows or columns
+ ******************************************************************************/
+template <class TStruct>
+RetResult DataStore<TStruct>::set_encoding(const DataStoreCodec::Field *layout, int layout_field_count,
+	DataStoreCodec::BlockLayout block_layout)
+{
+	if(layout != NULL && DataStoreCodec::check_layout(layout, layout_field_count, sizeof(TStruct)) != RET_OK)
+	{
+		debug_println(F("Invalid encoding layout, store stays raw."));
+		return RET_ERROR;
+	}
+
+	_layout = layout;
+	_layout_field_count = layout != NULL ? layout_field_count : 0;
+	_block_layout = block_layout;
+	_codec_history_valid = false;
+
+	if(layout != NULL)
+		_schema_id = DataStoreCodec::layout_id(layout, layout_field_count);
+
+	return RET_OK;
+}
+
+/******************************************************************************
+ * Get encoding layout, NULL if store writes raw entries
+ * Used by reader.
+ ******************************************************************************/
+template <class TStruct>
+const DataStoreCodec::Field* DataStore<TStruct>::get_encoding(int *layout_field_count) const
+{
+	if(layout_field_count != NULL)
+		*layout_field_count = _layout_field_count;
+
+	return _layout;
+}
+
+/******************************************************************************
+ * Get id of schema written to file headers, 0 if unknown
+ ******************************************************************************/
+template <class TStruct>
+uint32_t DataStore<TStruct>::get_schema_id() const
+{
+	return _schema_id;
+}
+
+/******************************************************************************
+ * Get max entries per file
+ ******************************************************************************/
+template <class TStruct>
+int DataStore<TStruct>::get_max_entries_per_file() const
+{
+	return _max_entries_per_file;
+}
+
+/******************************************************************************
+ * Get store manifest
+ * Used by reader.
+ ******************************************************************************/
+template <class TStruct>
+DataStoreManifest* DataStore<TStruct>::get_manifest()
+{
+	return &_manifest;
+}
+
+/******************************************************************************
+ * Mark leading entries of a data file as submitted, so readers skip them
+ * Used by reader. Goes through the store so the current record in RAM (which
+ * the manifest keeps for it between writes) stays in sync.
+ * @param record_index Manifest record of file
+ * @param acked_entries Entries from start of file
+ ******************************************************************************/
+template <class TStruct>
+RetResult DataStore<TStruct>::set_acked_entries(int record_index, uint16_t acked_entries)
+{
+	if(record_index == _current_record_index)
+	{
+		_current_record.acked_entries = acked_entries;
+		return _manifest.update_record(record_index, &_current_record);
+	}
+
+	DataStoreManifest::Record record;
+	if(_manifest.get_record(record_index, &record) != RET_OK)
+		return RET_ERROR;
+
+	record.acked_entries = acked_entries;
+
+	return _manifest.update_record(record_index, &record);
+}
+
+/******************************************************************************
+ * Delete a data file by its manifest record, eg. once all its entries were
+ * submitted. Readers delete the file they are reading with
+ * DataStoreReader::delete_file().
+ ******************************************************************************/
+template <class TStruct>
+RetResult DataStore<TStruct>::delete_file(int record_index)
+{
+	DataStoreManifest::Record record;
+	if(_manifest.get_record(record_index, &record) != RET_OK)
+		return RET_ERROR;
+
+	if(record.flags & DataStoreManifest::RECORD_DELETED)
+		return RET_OK;
+
+	return remove_file(record_index, &record);
+}
+
+/******************************************************************************
+ * Open data file of a manifest record
+ * Parent dirs are created when opening for writing.
+ ******************************************************************************/
+template <class TStruct>
+File DataStore<TStruct>::open_file(const DataStoreManifest::Record *record, const char *mode)
+{
+	char path[FILE_PATH_BUFFER_SIZE] = {0};
+	_manifest.get_file_path(record, path, sizeof(path));
+
+	if(strcmp(mode, FILE_READ) != 0)
+		Storage::make_dirs(path);
+
+	return Storage::fs().open(path, mode);
+}
+
+/******************************************************************************
+ * Merge undersized data files into full ones
+ * Files end up partly filled after failed commits and resets, and partly
+ * submitted after failed call homes. Their entries are rewritten oldest
+ * first into full files, leaving out submitted entries and ones that fail
+ * CRC, and the originals are deleted. A file is only deleted once all of its
+ * entries are in merged files, so a reset in between at worst leaves some
+ * entries in two files.
+ * Encoded files, files of another format and the file currently written to
+ * are left as they are. Merged files get a header.
+ * Runs before sleep, see SleepScheduler.
+ * @param budget_ms Stop merging files after this long, the rest are merged
+ *		  next time
+ * @param files_merged Files merged or removed (output var)
+ ******************************************************************************/
+template <class TStruct>
+RetResult DataStore<TStruct>::cleanup_store(uint32_t budget_ms, int *files_merged)
+{
+	*files_merged = 0;
+
+	if(_max_entries_per_file > DATA_STORE_COMPACT_MAX_ENTRIES)
+		return RET_ERROR;
+
+	if(Flash::mount() != RET_OK || load_manifest() != RET_OK)
+		return RET_ERROR;
+
+	// Set at first file to merge. Only merging counts, so the full files at
+	// the front don't use up the budget every time.
+	uint32_t t_start = 0;
+	bool started = false;
+
+	// Entries of next merged file and records of the files they come from.
+	// Last source may continue in the file after.
+	Entry merged[DATA_STORE_COMPACT_MAX_ENTRIES];
+	DataStoreManifest::Record sources[DATA_STORE_COMPACT_MAX_ENTRIES];
+	int source_indexes[DATA_STORE_COMPACT_MAX_ENTRIES];
+	int merged_count = 0, source_count = 0;
+
+	// Merged entries are not all of their sources', a lone source is rewritten
+	bool merged_dropped = false;
+
+	// Merged files are appended after the records iterated. Opened as a
+	// reader, so the manifest is not compacted under the loop.
+	int current_index = _manifest.get_current_record();
+	uint32_t record_count = _manifest.get_record_count();
+
+	_manifest.reader_opened();
+
+	File records = _manifest.open_records();
+	DataStoreManifest::Record record;
+	int index = 0;
+	RetResult ret = RET_OK;
+
+	while(ret == RET_OK && _manifest.read_next_record(records, &record, &index) && (uint32_t)index < record_count)
+	{
+		if(index == current_index ||
+			(record.flags & (DataStoreManifest::RECORD_ENCODED | DataStoreManifest::RECORD_MISMATCH)))
+		{
+			continue;
+		}
+
+		if(record.entries >= _max_entries_per_file && record.acked_entries == 0)
+			continue;
+
+		if(!started)
+		{
+			t_start = millis();
+			started = true;
+		}
+		else if((uint32_t)(millis() - t_start) >= budget_ms)
+		{
+			break;
+		}
+
+		Entry entries[DATA_STORE_COMPACT_MAX_ENTRIES];
+		bool dropped = false;
+		int count = read_live_entries(&record, entries, &dropped);
+
+		if(count < 0)
+			continue;
+
+		// Nothing left to keep
+		if(count == 0)
+		{
+			if(remove_file(index, &record) == RET_OK)
+				(*files_merged)++;
+
+			continue;
+		}
+
+		sources[source_count] = record;
+		source_indexes[source_count] = index;
+		source_count++;
+		merged_dropped |= dropped;
+
+		int taken = 0;
+
+		while(taken < count)
+		{
+			int n = count - taken;
+			if(n > _max_entries_per_file - merged_count)
+				n = _max_entries_per_file - merged_count;
+
+			memcpy(&merged[merged_count], &entries[taken], n * sizeof(Entry));
+			merged_count += n;
+			taken += n;
+
+			if(merged_count < _max_entries_per_file)
+				break;
+
+			// Merged file full. A source split over the next one is deleted after it.
+			bool split = taken < count;
+
+			ret = write_merged_file(merged, merged_count, sources, source_indexes,
+				split ? source_count - 1 : source_count, files_merged);
+			if(ret != RET_OK)
+				break;
+
+			merged_count = 0;
+			source_count = 0;
+			merged_dropped = split;
+
+			if(split)
+			{
+				sources[0] = record;
+				source_indexes[0] = index;
+				source_count = 1;
+			}
+		}
+	}
+
+	records.close();
+
+	// What is left is written even if not full, unless it is a file as it was
+	if(ret == RET_OK && merged_count > 0 && (source_count > 1 || merged_dropped))
+		ret = write_merged_file(merged, merged_count, sources, source_indexes, source_count, files_merged);
+
+	_manifest.reader_closed();
+
+	if(*files_merged > 0)
+	{
+		debug_print(F("Store compacted: "));
+		debug_print(_dir_path);
+		debug_print(F(", files merged: "));
+		debug_println(*files_merged, DEC);
+	}
+
+	return ret;
+}
+
+/******************************************************************************
+ * Read entries of a data file that are not submitted and pass CRC
+ * @param entries Buffer of DATA_STORE_COMPACT_MAX_ENTRIES
+ * @param dropped Set if any entries were left out (output var)
+ * @return Entries read, -1 if file could not be read
+ ******************************************************************************/
+template <class TStruct>
+int DataStore<TStruct>::read_live_entries(const DataStoreManifest::Record *record, Entry *entries, bool *dropped)
+{
+	File f = open_file(record, FILE_READ);
+	if(!f)
+		return -1;
+
+	size_t file_size = f.size() - data_offset(record);
+	f.seek(data_offset(record));
+
+	int file_entries = f.read((uint8_t*)entries, DATA_STORE_COMPACT_MAX_ENTRIES * sizeof(Entry)) / sizeof(Entry);
+	f.close();
+
+	int count = 0;
+
+	for(int i = record->acked_entries; i < file_entries; i++)
+	{
+		if(Utils::crc32((uint8_t*)&entries[i].data, sizeof(TStruct)) != entries[i].crc32)
+			continue;
+
+		if(count != i)
+			entries[count] = entries[i];
+
+		count++;
+	}
+
+	// Partly written trailing entry counts as dropped
+	*dropped = count * sizeof(Entry) != file_size;
+
+	return count;
+}
+
+/******************************************************************************
+ * Write entries to a new data file and delete the files they came from
+ * Named after the oldest source. Record is added before the file is written
+ * and updated after, same as when the store starts a new file.
+ * @param sources Records of files entries came from, oldest first
+ * @param source_count Sources to delete, all of their entries are written
+ *		  by now
+ * @param files_merged Incremented by sources deleted
+ ******************************************************************************/
+template <class TStruct>
+RetResult DataStore<TStruct>::write_merged_file(const Entry *entries, int count,
+	const DataStoreManifest::Record *sources, const int *source_indexes, int source_count, int *files_merged)
+{
+	char path[FILE_PATH_BUFFER_SIZE] = {0};
+	DataStoreManifest::Record record = {0};
+	record.name_tstamp = sources[0].name_tstamp;
+	record.flags = DataStoreManifest::RECORD_HEADER;
+
+	if(decide_new_file_path(&record, path, sizeof(path)) != RET_OK)
+		return RET_ERROR;
+
+	int index = 0;
+	if(_manifest.append_record(&record, &index, false) != RET_OK)
+		return RET_ERROR;
+
+	File f = open_file(&record, FILE_WRITE);
+	if(!f)
+	{
+		debug_print(F("Could not create merged file: "));
+		debug_println(path);
+		_manifest.delete_record(index);
+		return RET_ERROR;
+	}
+
+	Flash::count_create();
+
+	if(write_file_header(f, entries[0].data.timestamp, false) != RET_OK)
+	{
+		f.close();
+		remove_file(index, &record);
+		return RET_ERROR;
+	}
+
+	size_t written = f.write((uint8_t*)entries, count * sizeof(Entry));
+	f.close();
+
+	Flash::count_write(_dir_path, sizeof(FileHeader), written);
+
+	if(written != count * sizeof(Entry))
+	{
+		debug_println(F("Could not write merged file."));
+		remove_file(index, &record);
+		return RET_ERROR;
+	}
+
+	for(int i = 0; i < count; i++)
+	{
+		uint64_t tstamp = entries[i].data.timestamp;
+
+		if(record.entries == 0 || tstamp < record.min_tstamp)
+			record.min_tstamp = tstamp;
+		if(record.entries == 0 || tstamp > record.max_tstamp)
+			record.max_tstamp = tstamp;
+
+		record.entries++;
+	}
+
+	if(_manifest.update_record(index, &record) != RET_OK)
+		return RET_ERROR;
+
+	for(int i = 0; i < source_count; i++)
+	{
+		if(remove_file(source_indexes[i], &sources[i]) == RET_OK)
+			(*files_merged)++;
+	}
+
+	return RET_OK;
+}
+
+/******************************************************************************
+ * Delete a data file and its record
+ ******************************************************************************/
+template <class TStruct>
+RetResult DataStore<TStruct>::remove_file(int record_index, const DataStoreManifest::Record *record)
+{
+	char path[FILE_PATH_BUFFER_SIZE] = {0};
+	_manifest.get_file_path(record, path, sizeof(path));
+
+	// A file already gone only leaves its record to delete
+	if(Storage::fs().remove(path))
+		Flash::count_delete();
+	else if(Storage::fs().exists(path))
+		return RET_ERROR;
+
+	return _manifest.delete_record(record_index);
+}
+
+/******************************************************************************
+ * Rewrite legacy data files (no header) with a header, and flag files whose
+ * header doesn't match the store
+ * Run once at first boot after an OTA. Legacy files are copied in a single
+ * streaming pass each, a block of entries at a time: raw entries that fail
+ * CRC (eg. of an entry struct that changed) or were submitted are left out,
+ * encoded files are copied up to their last valid block. Copies are added to
+ * the manifest like merged files and the originals deleted after, so a reset
+ * in between at worst leaves entries in two files.
+ * Legacy files left (eg. flash full) are still read as before.
+ * @param files_upgraded Files rewritten with a header (output var)
+ * @param files_dropped Files deleted, nothing in them readable (output var)
+ ******************************************************************************/
+template <class TStruct>
+RetResult DataStore<TStruct>::upgrade_files(int *files_upgraded, int *files_dropped)
+{
+	*files_upgraded = 0;
+	*files_dropped = 0;
+
+	if(Flash::mount() != RET_OK || load_manifest() != RET_OK)
+		return RET_ERROR;
+
+	// Copies are appended after the records iterated. Opened as a reader, so
+	// the manifest is not compacted under the loop.
+	uint32_t record_count = _manifest.get_record_count();
+
+	_manifest.reader_opened();
+
+	File records = _manifest.open_records();
+	DataStoreManifest::Record record;
+	int index = 0;
+	RetResult ret = RET_OK;
+
+	while(_manifest.read_next_record(records, &record, &index) && (uint32_t)index < record_count)
+	{
+		if(record.flags & DataStoreManifest::RECORD_MISMATCH)
+			continue;
+
+		// Written with a header, only check it still matches
+		if(record.flags & DataStoreManifest::RECORD_HEADER)
+		{
+			File f = open_file(&record, FILE_READ);
+			FileHeader header;
+
+			if(f && read_file_header(f, &header) == DATA_STORE_FILE_MISMATCH)
+			{
+				record.flags |= DataStoreManifest::RECORD_MISMATCH;
+				_manifest.update_record(index, &record);
+			}
+
+			f.close();
+			continue;
+		}
+
+		bool dropped = false;
+
+		ret = upgrade_file(index, &record, &dropped);
+		if(ret != RET_OK)
+			break;
+
+		if(dropped)
+			(*files_dropped)++;
+		else
+			(*files_upgraded)++;
+	}
+
+	records.close();
+	_manifest.reader_closed();
+
+	// Current file may have been replaced or flagged, it is checked again on
+	// next commit
+	_current_record_index = -1;
+	_current_data_file_path[0] = '\0';
+
+	if(*files_upgraded > 0 || *files_dropped > 0)
+	{
+		debug_print(F("Store files upgraded: "));
+		debug_print(_dir_path);
+		debug_print(F(", upgraded: "));
+		debug_print(*files_upgraded, DEC);
+		debug_print(F(", dropped: "));
+		debug_println(*files_dropped, DEC);
+	}
+
+	return ret;
+}
+
+/******************************************************************************
+ * Copy a legacy data file to a new one with a header and delete it
+ * The copy stays the current file if the original was.
+ * @param record Record of legacy file
+ * @param dropped Set if nothing was left to copy and file was only deleted
+ *		  (output var)
+ ******************************************************************************/
+template <class TStruct>
+RetResult DataStore<TStruct>::upgrade_file(int record_index, DataStoreManifest::Record *record, bool *dropped)
+{
+	*dropped = false;
+
+	File src = open_file(record, FILE_READ);
+
+	// Listed but never created
+	if(!src)
+	{
+		*dropped = true;
+		return _manifest.delete_record(record_index);
+	}
+
+	bool encoded = record->flags & DataStoreManifest::RECORD_ENCODED;
+
+	DataStoreManifest::Record new_record = {0};
+	new_record.name_tstamp = record->name_tstamp;
+	new_record.flags = record->flags | DataStoreManifest::RECORD_HEADER;
+
+	char path[FILE_PATH_BUFFER_SIZE] = {0};
+	int new_index = 0;
+
+	if(decide_new_file_path(&new_record, path, sizeof(path)) != RET_OK ||
+		_manifest.append_record(&new_record, &new_index, record_index == _manifest.get_current_record()) != RET_OK)
+	{
+		src.close();
+		return RET_ERROR;
+	}
+
+	File dst = open_file(&new_record, FILE_WRITE);
+	if(!dst)
+	{
+		debug_print(F("Could not create upgraded file: "));
+		debug_println(path);
+		src.close();
+		_manifest.delete_record(new_index);
+		return RET_ERROR;
+	}
+
+	Flash::count_create();
+
+	RetResult ret = write_file_header(dst, record->min_tstamp, encoded);
+	size_t pos = sizeof(FileHeader);
+
+	if(ret == RET_OK && encoded)
+	{
+		// Blocks are copied as they are, up to the first one that doesn't decode
+		size_t valid_size = 0;
+		scan_encoded_file(src, &new_record, &_codec_history, &valid_size);
+		_codec_history_valid = false;
+
+		new_record.acked_entries = record->acked_entries;
+		src.seek(0);
+
+		uint8_t block[DATA_STORE_CODEC_BLOCK_SIZE];
+
+		while(ret == RET_OK && pos - sizeof(FileHeader) < valid_size)
+		{
+			size_t size = valid_size - (pos - sizeof(FileHeader));
+			if(size > sizeof(block))
+				size = sizeof(block);
+
+			size_t written = 0;
+			if(src.read(block, size) == size)
+				written = dst.write(block, size);
+
+			Flash::count_write(_dir_path, pos, written);
+			pos += written;
+
+			if(written != size)
+				ret = RET_ERROR;
+		}
+	}
+	else if(ret == RET_OK)
+	{
+		// Submitted entries and ones failing CRC are left out
+		Entry entries[DATA_STORE_READ_BLOCK_ENTRIES];
+		int count = 0;
+
+		src.seek(record->acked_entries * sizeof(Entry));
+
+		while(ret == RET_OK &&
+			(count = src.read((uint8_t*)entries, sizeof(entries)) / sizeof(Entry)) > 0)
+		{
+			int kept = 0;
+
+			for(int i = 0; i < count; i++)
+			{
+				if(Utils::crc32((uint8_t*)&entries[i].data, sizeof(TStruct)) != entries[i].crc32)
+					continue;
+
+				uint64_t tstamp = entries[i].data.timestamp;
+
+				if(new_record.entries == 0 || tstamp < new_record.min_tstamp)
+					new_record.min_tstamp = tstamp;
+				if(new_record.entries == 0 || tstamp > new_record.max_tstamp)
+					new_record.max_tstamp = tstamp;
+
+				new_record.entries++;
+
+				if(kept != i)
+					entries[kept] = entries[i];
+
+				kept++;
+			}
+
+			size_t written = dst.write((uint8_t*)entries, kept * sizeof(Entry));
+			Flash::count_write(_dir_path, pos, written);
+			pos += written;
+
+			if(written != kept * sizeof(Entry))
+				ret = RET_ERROR;
+		}
+	}
+
+	src.close();
+	dst.close();
+
+	if(ret != RET_OK)
+	{
+		debug_print(F("Could not write upgraded file: "));
+		debug_println(path);
+		remove_file(new_index, &new_record);
+		return RET_ERROR;
+	}
+
+	// Nothing readable, both go
+	if(new_record.entries == 0)
+	{
+		*dropped = true;
+		remove_file(new_index, &new_record);
+		return remove_file(record_index, record);
+	}
+
+	if(_manifest.update_record(new_index, &new_record) != RET_OK)
+		return RET_ERROR;
 
+	return remove_file(record_index, record);
 }
 
 // Forward declarations
@@ -0,0 +1,890 @@
+#include "data_store_codec.h"
+#include <string.h>
+#include "utils.h"
+
+namespace DataStoreCodec
+{
+	//
+	// Private functions
+	//
+	uint64_t field_mask(int size);
+	uint64_t load_field(const uint8_t *src, int size);
+	void store_field(uint8_t *dst, int size, uint64_t value);
+	int64_t sign_extend(uint64_t value, int size);
+	uint64_t field_value(const Field *field, const History *history, int offset, const uint8_t *cur, bool *changed);
+	int varint_max_size(int size);
+	int write_varint(uint8_t *dst, uint64_t value);
+	int read_varint(const uint8_t *src, int size, uint64_t *value);
+	void push_history(History *history, const uint8_t *entry, size_t entry_size);
+	int encode_entry(const Field *layout, int field_count, size_t entry_size, History *history,
+		const uint8_t *entry, uint8_t *out, int out_size);
+	int encode_columns(const Field *layout, int field_count, const uint8_t *entries, size_t entry_stride,
+		int entry_count, uint8_t *out, int out_size);
+	int compare_field(const Field *field, const uint8_t *a, const uint8_t *b);
+	bool column_varies(const Field *field, int offset, const uint8_t *entries, size_t entry_stride, int entry_count);
+	int skip_varints(const uint8_t *src, int size, int count);
+
+	/******************************************************************************
+	 * Check that a layout describes an entry and can be encoded in a block
+	 * @param layout Field sizes/kinds, in struct order
+	 * @param field_count Fields in layout
+	 * @param entry_size sizeof() the entry struct
+	 ******************************************************************************/
+	RetResult check_layout(const Field *layout, int field_count, size_t entry_size)
+	{
+		if(layout == NULL || field_count < 1 || field_count > DATA_STORE_CODEC_MAX_FIELDS ||
+			entry_size > (size_t)DATA_STORE_CODEC_MAX_ENTRY_SIZE)
+		{
+			return RET_ERROR;
+		}
+
+		// First field is the timestamp, used for block time ranges
+		if(layout[0].kind == FIELD_RAW || layout[0].type != COLUMN_UNSIGNED)
+			return RET_ERROR;
+
+		size_t total_size = 0;
+		int worst_entry_size = (field_count + 7) / 8;
+
+		for(int i = 0; i < field_count; i++)
+		{
+			int size = layout[i].size;
+
+			if(layout[i].kind == FIELD_RAW)
+			{
+				worst_entry_size += size;
+			}
+			else
+			{
+				if((size != 1 && size != 2 && size != 4 && size != 8) || layout[i].type == COLUMN_BYTES)
+					return RET_ERROR;
+
+				worst_entry_size += varint_max_size(size);
+			}
+
+			total_size += size;
+		}
+
+		if(total_size != entry_size)
+			return RET_ERROR;
+
+		// Keyframe is raw
+		if(worst_entry_size < (int)entry_size)
+			worst_entry_size = entry_size;
+
+		// At least one entry must always fit in a block, in either layout
+		int worst_columnar_size = get_summary_size(layout, field_count) + (field_count + 7) / 8 + entry_size;
+		if(worst_columnar_size > worst_entry_size)
+			worst_entry_size = worst_columnar_size;
+
+		if(sizeof(BlockHeader) + worst_entry_size > (size_t)DATA_STORE_CODEC_BLOCK_SIZE)
+			return RET_ERROR;
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * Forget previous entries. Next block will be a keyframe.
+	 ******************************************************************************/
+	void reset_history(History *history)
+	{
+		history->count = 0;
+	}
+
+	/******************************************************************************
+	 * Encode as many entries as fit into a block
+	 * @param history Entries before the first one, updated with encoded entries
+	 * @param entries First entry
+	 * @param entry_stride Bytes from one entry to the next (entries may be in
+	 * 		larger structs, eg. DataStore::Entry)
+	 * @param entry_count Entries available
+	 * @param block Output buffer, header followed by payload
+	 * @param block_size Output buffer size
+	 * @param entries_encoded Entries that fit in the block
+	 * @return Size of block incl. header, -1 on error
+	 ******************************************************************************/
+	int encode_block(const Field *layout, int field_count, size_t entry_size, History *history,
+		const uint8_t *entries, size_t entry_stride, int entry_count, uint8_t *block, int block_size,
+		int *entries_encoded)
+	{
+		*entries_encoded = 0;
+
+		if(block_size < (int)sizeof(BlockHeader))
+			return -1;
+
+		BlockHeader header = {0};
+		header.flags = history->count == 0 ? BLOCK_KEYFRAME : 0;
+
+		uint8_t *payload = block + sizeof(BlockHeader);
+		int payload_size = 0;
+		int payload_max = block_size - sizeof(BlockHeader);
+
+		// Entry count is 8 bit
+		if(entry_count > 0xFF)
+			entry_count = 0xFF;
+
+		for(int i = 0; i < entry_count; i++)
+		{
+			// Encode into history copy, so an entry that doesn't fit leaves it untouched
+			History next = *history;
+
+			int size = encode_entry(layout, field_count, entry_size, &next,
+				entries + i * entry_stride, payload + payload_size, payload_max - payload_size);
+
+			if(size < 0)
+				break;
+
+			*history = next;
+			payload_size += size;
+			header.entries++;
+		}
+
+		if(header.entries == 0)
+			return -1;
+
+		header.payload_size = payload_size;
+		header.crc32 = Utils::crc32(payload, payload_size);
+		memcpy(block, &header, sizeof(header));
+
+		*entries_encoded = header.entries;
+
+		return sizeof(BlockHeader) + payload_size;
+	}
+
+	/******************************************************************************
+	 * Read and sanity check a block header
+	 ******************************************************************************/
+	RetResult read_block_header(const uint8_t *data, int size, BlockHeader *header)
+	{
+		if(size < (int)sizeof(BlockHeader))
+			return RET_ERROR;
+
+		memcpy(header, data, sizeof(BlockHeader));
+
+		if(header->entries == 0 ||
+			header->payload_size > DATA_STORE_CODEC_BLOCK_SIZE - sizeof(BlockHeader))
+		{
+			return RET_ERROR;
+		}
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * Check block payload against header CRC
+	 ******************************************************************************/
+	bool block_crc_valid(const BlockHeader *header, const uint8_t *payload)
+	{
+		return Utils::crc32((uint8_t*)payload, header->payload_size) == header->crc32;
+	}
+
+	/******************************************************************************
+	 * Decode a single entry of a block payload
+	 * @param keyframe Entry is the first of a keyframe block
+	 * @param payload Start of encoded entry
+	 * @param payload_size Bytes left in payload
+	 * @param entry Output entry
+	 * @return Bytes of payload consumed, -1 on error
+	 ******************************************************************************/
+	int decode_entry(const Field *layout, int field_count, size_t entry_size, History *history,
+		bool keyframe, const uint8_t *payload, int payload_size, uint8_t *entry)
+	{
+		if(keyframe)
+		{
+			if(payload_size < (int)entry_size)
+				return -1;
+
+			memcpy(entry, payload, entry_size);
+			reset_history(history);
+			push_history(history, entry, entry_size);
+
+			return entry_size;
+		}
+
+		// Delta entries need the previous one
+		if(history->count == 0)
+			return -1;
+
+		int bitmap_size = (field_count + 7) / 8;
+		if(payload_size < bitmap_size)
+			return -1;
+
+		const uint8_t *bitmap = payload;
+		int pos = bitmap_size;
+		int offset = 0;
+
+		for(int i = 0; i < field_count; i++)
+		{
+			const Field *field = &layout[i];
+			bool changed = bitmap[i / 8] & (1 << (i % 8));
+
+			if(field->kind == FIELD_RAW)
+			{
+				if(changed)
+				{
+					if(pos + field->size > payload_size)
+						return -1;
+
+					memcpy(entry + offset, payload + pos, field->size);
+					pos += field->size;
+				}
+				else
+				{
+					memcpy(entry + offset, history->prev[0] + offset, field->size);
+				}
+			}
+			else
+			{
+				uint64_t mask = field_mask(field->size);
+				uint64_t prev = load_field(history->prev[0] + offset, field->size);
+				uint64_t delta = 0;
+
+				if(field->kind == FIELD_DELTA2 && history->count == 2)
+					delta = prev - load_field(history->prev[1] + offset, field->size);
+
+				if(changed)
+				{
+					uint64_t zigzag = 0;
+					int size = read_varint(payload + pos, payload_size - pos, &zigzag);
+					if(size < 0)
+						return -1;
+
+					pos += size;
+					delta += (zigzag >> 1) ^ (0 - (zigzag & 1));
+				}
+
+				store_field(entry + offset, field->size, (prev + delta) & mask);
+			}
+
+			offset += field->size;
+		}
+
+		push_history(history, entry, entry_size);
+
+		return pos;
+	}
+
+	/******************************************************************************
+	 * Encode as many entries as fit into a columnar block
+	 * Block doesn't depend on entries before it.
+	 * @param entries First entry
+	 * @param entry_stride Bytes from one entry to the next
+	 * @param entry_count Entries available
+	 * @param block Output buffer, header followed by payload
+	 * @param block_size Output buffer size
+	 * @param entries_encoded Entries that fit in the block
+	 * @return Size of block incl. header, -1 on error
+	 ******************************************************************************/
+	int encode_columnar_block(const Field *layout, int field_count, size_t entry_size,
+		const uint8_t *entries, size_t entry_stride, int entry_count, uint8_t *block, int block_size,
+		int *entries_encoded)
+	{
+		*entries_encoded = 0;
+
+		if(block_size < (int)sizeof(BlockHeader))
+			return -1;
+
+		if(entry_count > 0xFF)
+			entry_count = 0xFF;
+
+		uint8_t *payload = block + sizeof(BlockHeader);
+		int payload_size = -1;
+
+		// Columns can't be cut short, retry with fewer entries until they fit
+		while(entry_count > 0)
+		{
+			payload_size = encode_columns(layout, field_count, entries, entry_stride, entry_count,
+				payload, block_size - sizeof(BlockHeader));
+
+			if(payload_size >= 0)
+				break;
+
+			entry_count--;
+		}
+
+		if(entry_count == 0)
+			return -1;
+
+		BlockHeader header = {0};
+		header.entries = entry_count;
+		header.flags = BLOCK_KEYFRAME | BLOCK_COLUMNAR;
+		header.payload_size = payload_size;
+		header.crc32 = Utils::crc32(payload, payload_size);
+		memcpy(block, &header, sizeof(header));
+
+		*entries_encoded = entry_count;
+
+		return sizeof(BlockHeader) + payload_size;
+	}
+
+	/******************************************************************************
+	 * Size of the column summary at the start of a columnar block payload
+	 * Summary holds min then max of every non raw column, as raw field values.
+	 ******************************************************************************/
+	int get_summary_size(const Field *layout, int field_count)
+	{
+		int size = 0;
+
+		for(int i = 0; i < field_count; i++)
+		{
+			if(layout[i].kind != FIELD_RAW)
+				size += 2 * layout[i].size;
+		}
+
+		return size;
+	}
+
+	/******************************************************************************
+	 * Get min/max of a column from a block summary
+	 * @param column Non raw column
+	 * @param min Output, field size
+	 * @param max Output, field size
+	 ******************************************************************************/
+	void get_column_range(const Field *layout, int field_count, const uint8_t *summary, int column,
+		uint8_t *min, uint8_t *max)
+	{
+		int offset = 0;
+
+		for(int i = 0; i < column && i < field_count; i++)
+		{
+			if(layout[i].kind != FIELD_RAW)
+				offset += 2 * layout[i].size;
+		}
+
+		memcpy(min, summary + offset, layout[column].size);
+		memcpy(max, summary + offset + layout[column].size, layout[column].size);
+	}
+
+	/******************************************************************************
+	 * Check if any entry of a block can be in a timestamp range, from its summary
+	 * @param from Start of range (incl.)
+	 * @param to End of range (incl.)
+	 ******************************************************************************/
+	bool summary_in_time_range(const Field *layout, int field_count, const uint8_t *summary,
+		uint64_t from, uint64_t to)
+	{
+		// Timestamp is the first column, so its min/max are at the start
+		uint64_t min = load_field(summary, layout[0].size);
+		uint64_t max = load_field(summary + layout[0].size, layout[0].size);
+
+		return min <= to && max >= from;
+	}
+
+	/******************************************************************************
+	 * Find the start of every column of a columnar block
+	 * @param cursor Output, positioned at first entry
+	 ******************************************************************************/
+	RetResult begin_columnar_block(const Field *layout, int field_count, const BlockHeader *header,
+		const uint8_t *payload, ColumnCursor *cursor)
+	{
+		if(!(header->flags & BLOCK_COLUMNAR))
+			return RET_ERROR;
+
+		int bitmap_size = (field_count + 7) / 8;
+		int pos = get_summary_size(layout, field_count);
+		const uint8_t *bitmap = payload + pos;
+
+		pos += bitmap_size;
+
+		for(int i = 0; i < field_count; i++)
+		{
+			const Field *field = &layout[i];
+			bool varies = bitmap[i / 8] & (1 << (i % 8));
+
+			cursor->pos[i] = pos;
+
+			if(field->kind == FIELD_RAW)
+			{
+				pos += varies ? header->entries * field->size : field->size;
+			}
+			else if(varies)
+			{
+				// First value raw, then a varint per entry
+				pos += field->size;
+
+				int size = skip_varints(payload + pos, header->payload_size - pos, header->entries - 1);
+				if(size < 0)
+					return RET_ERROR;
+
+				pos += size;
+			}
+
+			if(pos > header->payload_size)
+				return RET_ERROR;
+		}
+
+		if(pos != header->payload_size)
+			return RET_ERROR;
+
+		cursor->entry = 0;
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * Decode next entry of a columnar block
+	 * @param history Reset when decoding the first entry
+	 * @param cursor From begin_columnar_block(), advanced to next entry
+	 * @param entry Output entry
+	 ******************************************************************************/
+	RetResult decode_columnar_entry(const Field *layout, int field_count, size_t entry_size, History *history,
+		const BlockHeader *header, const uint8_t *payload, ColumnCursor *cursor, uint8_t *entry)
+	{
+		if(cursor->entry >= header->entries)
+			return RET_ERROR;
+
+		if(cursor->entry == 0)
+			reset_history(history);
+
+		const uint8_t *bitmap = payload + get_summary_size(layout, field_count);
+
+		int offset = 0;
+		int summary_offset = 0;
+
+		for(int i = 0; i < field_count; i++)
+		{
+			const Field *field = &layout[i];
+			bool varies = bitmap[i / 8] & (1 << (i % 8));
+			int pos = cursor->pos[i];
+
+			if(field->kind == FIELD_RAW)
+			{
+				memcpy(entry + offset, payload + pos + (varies ? cursor->entry * field->size : 0), field->size);
+			}
+			else
+			{
+				if(!varies)
+				{
+					// Same in all entries, min of column
+					memcpy(entry + offset, payload + summary_offset, field->size);
+				}
+				else if(cursor->entry == 0)
+				{
+					memcpy(entry + offset, payload + pos, field->size);
+					cursor->pos[i] += field->size;
+				}
+				else
+				{
+					uint64_t zigzag = 0;
+					int size = read_varint(payload + pos, header->payload_size - pos, &zigzag);
+					if(size < 0)
+						return RET_ERROR;
+
+					cursor->pos[i] += size;
+
+					uint64_t prev = load_field(history->prev[0] + offset, field->size);
+					uint64_t delta = (zigzag >> 1) ^ (0 - (zigzag & 1));
+
+					if(field->kind == FIELD_DELTA2 && history->count == 2)
+						delta += prev - load_field(history->prev[1] + offset, field->size);
+
+					store_field(entry + offset, field->size, (prev + delta) & field_mask(field->size));
+				}
+
+				summary_offset += 2 * field->size;
+			}
+
+			offset += field->size;
+		}
+
+		push_history(history, entry, entry_size);
+		cursor->entry++;
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * Encode entries column by column: summary, bitmap of columns that vary,
+	 * then every column. A column that doesn't vary takes no space (raw columns
+	 * keep a single value). A column that does is its first value followed by
+	 * a varint per entry, like rows.
+	 * @return Bytes written to out, -1 if they don't fit
+	 ******************************************************************************/
+	int encode_columns(const Field *layout, int field_count, const uint8_t *entries, size_t entry_stride,
+		int entry_count, uint8_t *out, int out_size)
+	{
+		int bitmap_size = (field_count + 7) / 8;
+		int pos = get_summary_size(layout, field_count);
+
+		if(pos + bitmap_size > out_size)
+			return -1;
+
+		//
+		// Summary
+		//
+		int summary_pos = 0;
+		int offset = 0;
+
+		for(int i = 0; i < field_count; i++)
+		{
+			const Field *field = &layout[i];
+
+			if(field->kind != FIELD_RAW)
+			{
+				const uint8_t *min = entries + offset;
+				const uint8_t *max = entries + offset;
+
+				for(int j = 1; j < entry_count; j++)
+				{
+					const uint8_t *val = entries + j * entry_stride + offset;
+
+					if(compare_field(field, val, min) < 0)
+						min = val;
+					if(compare_field(field, val, max) > 0)
+						max = val;
+				}
+
+				memcpy(out + summary_pos, min, field->size);
+				memcpy(out + summary_pos + field->size, max, field->size);
+				summary_pos += 2 * field->size;
+			}
+
+			offset += field->size;
+		}
+
+		//
+		// Columns
+		//
+		uint8_t *bitmap = out + pos;
+		memset(bitmap, 0, bitmap_size);
+		pos += bitmap_size;
+		offset = 0;
+
+		for(int i = 0; i < field_count; i++)
+		{
+			const Field *field = &layout[i];
+			bool varies = column_varies(field, offset, entries, entry_stride, entry_count);
+
+			if(varies)
+				bitmap[i / 8] |= 1 << (i % 8);
+
+			if(field->kind == FIELD_RAW)
+			{
+				int values = varies ? entry_count : 1;
+
+				if(pos + values * field->size > out_size)
+					return -1;
+
+				for(int j = 0; j < values; j++)
+				{
+					memcpy(out + pos, entries + j * entry_stride + offset, field->size);
+					pos += field->size;
+				}
+			}
+			else if(varies)
+			{
+				if(pos + field->size > out_size)
+					return -1;
+
+				memcpy(out + pos, entries + offset, field->size);
+				pos += field->size;
+
+				// Reuse row prediction: history holds the entries before j
+				History history = {{{0}}, 0};
+				push_history(&history, entries, offset + field->size);
+
+				for(int j = 1; j < entry_count; j++)
+				{
+					const uint8_t *val = entries + j * entry_stride;
+					bool changed = false;
+					uint8_t varint[10];
+
+					int size = write_varint(varint, field_value(field, &history, offset, val + offset, &changed));
+
+					if(pos + size > out_size)
+						return -1;
+
+					memcpy(out + pos, varint, size);
+					pos += size;
+
+					push_history(&history, val, offset + field->size);
+				}
+			}
+
+			offset += field->size;
+		}
+
+		return pos;
+	}
+
+	/******************************************************************************
+	 * Compare two values of a field by its column type
+	 * @return <0, 0, >0 like memcmp
+	 ******************************************************************************/
+	int compare_field(const Field *field, const uint8_t *a, const uint8_t *b)
+	{
+		if(field->type == COLUMN_FLOAT)
+		{
+			double val_a = 0, val_b = 0;
+
+			if(field->size == sizeof(float))
+			{
+				float f_a, f_b;
+				memcpy(&f_a, a, sizeof(f_a));
+				memcpy(&f_b, b, sizeof(f_b));
+				val_a = f_a;
+				val_b = f_b;
+			}
+			else
+			{
+				memcpy(&val_a, a, sizeof(val_a));
+				memcpy(&val_b, b, sizeof(val_b));
+			}
+
+			return val_a < val_b ? -1 : (val_a > val_b ? 1 : 0);
+		}
+		else if(field->type == COLUMN_SIGNED)
+		{
+			int64_t val_a = sign_extend(load_field(a, field->size), field->size);
+			int64_t val_b = sign_extend(load_field(b, field->size), field->size);
+
+			return val_a < val_b ? -1 : (val_a > val_b ? 1 : 0);
+		}
+		else
+		{
+			uint64_t val_a = load_field(a, field->size);
+			uint64_t val_b = load_field(b, field->size);
+
+			return val_a < val_b ? -1 : (val_a > val_b ? 1 : 0);
+		}
+	}
+
+	/******************************************************************************
+	 * Check if a field has different values in a run of entries
+	 ******************************************************************************/
+	bool column_varies(const Field *field, int offset, const uint8_t *entries, size_t entry_stride, int entry_count)
+	{
+		for(int j = 1; j < entry_count; j++)
+		{
+			if(memcmp(entries + j * entry_stride + offset, entries + offset, field->size) != 0)
+				return true;
+		}
+
+		return false;
+	}
+
+	/******************************************************************************
+	 * Encode a single entry after the ones in history
+	 * @return Bytes written to out, -1 if it doesn't fit
+	 ******************************************************************************/
+	int encode_entry(const Field *layout, int field_count, size_t entry_size, History *history,
+		const uint8_t *entry, uint8_t *out, int out_size)
+	{
+		// First entry of file/block is stored as is
+		if(history->count == 0)
+		{
+			if(out_size < (int)entry_size)
+				return -1;
+
+			memcpy(out, entry, entry_size);
+			push_history(history, entry, entry_size);
+
+			return entry_size;
+		}
+
+		int bitmap_size = (field_count + 7) / 8;
+		if(out_size < bitmap_size)
+			return -1;
+
+		uint8_t *bitmap = out;
+		memset(bitmap, 0, bitmap_size);
+
+		int pos = bitmap_size;
+		int offset = 0;
+
+		for(int i = 0; i < field_count; i++)
+		{
+			const Field *field = &layout[i];
+			bool changed = false;
+
+			if(field->kind == FIELD_RAW)
+			{
+				if(memcmp(entry + offset, history->prev[0] + offset, field->size) != 0)
+				{
+					if(pos + field->size > out_size)
+						return -1;
+
+					memcpy(out + pos, entry + offset, field->size);
+					pos += field->size;
+					changed = true;
+				}
+			}
+			else
+			{
+				uint64_t value = field_value(field, history, offset, entry + offset, &changed);
+
+				if(changed)
+				{
+					uint8_t varint[10];
+					int size = write_varint(varint, value);
+
+					if(pos + size > out_size)
+						return -1;
+
+					memcpy(out + pos, varint, size);
+					pos += size;
+				}
+			}
+
+			if(changed)
+				bitmap[i / 8] |= 1 << (i % 8);
+
+			offset += field->size;
+		}
+
+		push_history(history, entry, entry_size);
+
+		return pos;
+	}
+
+	/******************************************************************************
+	 * Zigzag encoded difference of field from its predicted value
+	 * Prediction is the previous value, plus the previous difference for
+	 * FIELD_DELTA2. Arithmetic is modulo field width so any value round trips.
+	 * @param changed Set to true when the field isn't equal to prediction
+	 ******************************************************************************/
+	uint64_t field_value(const Field *field, const History *history, int offset, const uint8_t *cur, bool *changed)
+	{
+		uint64_t mask = field_mask(field->size);
+		uint64_t prev = load_field(history->prev[0] + offset, field->size);
+		uint64_t predicted = prev;
+
+		if(field->kind == FIELD_DELTA2 && history->count == 2)
+			predicted += prev - load_field(history->prev[1] + offset, field->size);
+
+		int64_t diff = sign_extend((load_field(cur, field->size) - predicted) & mask, field->size);
+
+		*changed = diff != 0;
+
+		return ((uint64_t)diff << 1) ^ (uint64_t)(diff >> 63);
+	}
+
+	/******************************************************************************
+	 * Add entry to history
+	 ******************************************************************************/
+	void push_history(History *history, const uint8_t *entry, size_t entry_size)
+	{
+		if(history->count > 0)
+			memcpy(history->prev[1], history->prev[0], entry_size);
+
+		memcpy(history->prev[0], entry, entry_size);
+
+		if(history->count < 2)
+			history->count++;
+	}
+
+	/******************************************************************************
+	 * Mask of a field's bits
+	 ******************************************************************************/
+	uint64_t field_mask(int size)
+	{
+		return size >= 8 ? 0xFFFFFFFFFFFFFFFFULL : ((1ULL << (size * 8)) - 1);
+	}
+
+	/******************************************************************************
+	 * Load little endian field of 1 - 8 bytes
+	 ******************************************************************************/
+	uint64_t load_field(const uint8_t *src, int size)
+	{
+		uint64_t value = 0;
+
+		for(int i = size - 1; i >= 0; i--)
+			value = (value << 8) | src[i];
+
+		return value;
+	}
+
+	/******************************************************************************
+	 * Store little endian field of 1 - 8 bytes
+	 ******************************************************************************/
+	void store_field(uint8_t *dst, int size, uint64_t value)
+	{
+		for(int i = 0; i < size; i++)
+		{
+			dst[i] = value & 0xFF;
+			value >>= 8;
+		}
+	}
+
+	/******************************************************************************
+	 * Sign extend field of 1 - 8 bytes to 64 bits
+	 ******************************************************************************/
+	int64_t sign_extend(uint64_t value, int size)
+	{
+		if(size >= 8)
+			return (int64_t)value;
+
+		uint64_t sign_bit = 1ULL << (size * 8 - 1);
+
+		return (int64_t)((value ^ sign_bit) - sign_bit);
+	}
+
+	/******************************************************************************
+	 * Max varint size of a zigzag encoded field of size bytes
+	 ******************************************************************************/
+	int varint_max_size(int size)
+	{
+		return (size * 8 + 6) / 7;
+	}
+
+	/******************************************************************************
+	 * Write LEB128 varint, at most 10 bytes
+	 * @return Bytes written
+	 ******************************************************************************/
+	int write_varint(uint8_t *dst, uint64_t value)
+	{
+		int size = 0;
+
+		do
+		{
+			uint8_t byte = value & 0x7F;
+			value >>= 7;
+
+			if(value)
+				byte |= 0x80;
+
+			dst[size++] = byte;
+		} while(value);
+
+		return size;
+	}
+
+	/******************************************************************************
+	 * Skip a number of LEB128 varints
+	 * @return Bytes skipped, -1 if truncated
+	 ******************************************************************************/
+	int skip_varints(const uint8_t *src, int size, int count)
+	{
+		int pos = 0;
+
+		for(int i = 0; i < count; i++)
+		{
+			uint64_t value = 0;
+			int len = read_varint(src + pos, size - pos, &value);
+			if(len < 0)
+				return -1;
+
+			pos += len;
+		}
+
+		return pos;
+	}
+
+	/******************************************************************************
+	 * Read LEB128 varint
+	 * @return Bytes read, -1 if truncated or too long
+	 ******************************************************************************/
+	int read_varint(const uint8_t *src, int size, uint64_t *value)
+	{
+		*value = 0;
+
+		for(int i = 0; i < size && i < 10; i++)
+		{
+			*value |= (uint64_t)(src[i] & 0x7F) << (7 * i);
+
+			if(!(src[i] & 0x80))
+				return i + 1;
+		}
+
+		return -1;
+	}
+}
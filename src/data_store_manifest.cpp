@@ -0,0 +1,851 @@
+#include "data_store_manifest.h"
+#include "utils.h"
+#include "common.h"
+#include "flash.h"
+
+/** First manifest in the list of all manifests */
+DataStoreManifest *DataStoreManifest::_first = NULL;
+
+/** Priority and quota of a store */
+struct StoreQuota
+{
+	const char *dir_path;
+	DataStorePriority priority;
+	/** Data files guaranteed when flash runs out, 0 for no quota */
+	int max_files;
+};
+
+/** Store priorities and quotas. Stores not listed are primary, without quota.
+ * Quotas don't limit a store while there is space, they decide what goes
+ * first when there isn't. */
+const StoreQuota STORE_QUOTAS[] = {
+	{WATER_SENSOR_DATA_PATH, DATA_STORE_PRIORITY_PRIMARY, 0},
+	{ATMOS41_DATA_PATH, DATA_STORE_PRIORITY_PRIMARY, 0},
+	{SOIL_MOISTURE_DATA_PATH, DATA_STORE_PRIORITY_PRIMARY, 0},
+	{FO_DATA_STORE_PATH, DATA_STORE_PRIORITY_SECONDARY, 0},
+	{LIGHTNING_DATA_PATH, DATA_STORE_PRIORITY_SECONDARY, 0},
+	{LOG_DATA_PATH, DATA_STORE_PRIORITY_LOG, 256},
+	{SDI12_LOG_DATA_PATH, DATA_STORE_PRIORITY_DEBUG, 32}
+};
+
+/******************************************************************************
+ * Find priority and quota of a store, NULL if not listed
+ ******************************************************************************/
+const StoreQuota* find_store_quota(const char *store_dir_path)
+{
+	for(unsigned int i = 0; i < sizeof(STORE_QUOTAS) / sizeof(STORE_QUOTAS[0]); i++)
+	{
+		if(strcmp(STORE_QUOTAS[i].dir_path, store_dir_path) == 0)
+			return &STORE_QUOTAS[i];
+	}
+
+	return NULL;
+}
+
+/******************************************************************************
+ * Constructor
+ * Manifests add themselves to a list so that all of them can be printed or
+ * invalidated (eg. when formatting) without knowing every store.
+ * @param store_dir_path Dir in flash of the store the manifest describes
+ ******************************************************************************/
+DataStoreManifest::DataStoreManifest(const char *store_dir_path)
+{
+	_store_dir_path = store_dir_path;
+	snprintf(_path, sizeof(_path), "%s%s", DATA_STORE_MANIFEST_DIR, store_dir_path);
+
+	const StoreQuota *quota = find_store_quota(store_dir_path);
+	if(quota != NULL)
+	{
+		_priority = quota->priority;
+		_max_files = quota->max_files;
+	}
+
+	_next = _first;
+	_first = this;
+}
+
+/******************************************************************************
+ * Destructor
+ * Remove from list of all manifests
+ ******************************************************************************/
+DataStoreManifest::~DataStoreManifest()
+{
+	for(DataStoreManifest **m = &_first; *m != NULL; m = &(*m)->_next)
+	{
+		if(*m == this)
+		{
+			*m = _next;
+			break;
+		}
+	}
+}
+
+/******************************************************************************
+ * Default constructor (private)
+ ******************************************************************************/
+DataStoreManifest::DataStoreManifest()
+{}
+
+/******************************************************************************
+ * Load manifest header from flash
+ * Compacts the manifest if it has become sparse, then has the store restore
+ * the current record.
+ * @return RET_ERROR if manifest doesn't exist or is invalid, in which case
+ * 		   the store must rebuild it
+ ******************************************************************************/
+RetResult DataStoreManifest::load()
+{
+	_loaded = false;
+	_current_cached = false;
+	_current_dirty = false;
+
+	File f = Storage::fs().open(_path, FILE_READ);
+
+	// Any path opens as a dir on SPIFFS when not a file
+	if(!f || f.isDirectory())
+	{
+		debug_print(F("No manifest: "));
+		debug_println(_path);
+		return RET_ERROR;
+	}
+
+	if(f.read((uint8_t*)&_header, sizeof(_header)) != sizeof(_header))
+	{
+		debug_println(F("Could not read manifest header."));
+		return RET_ERROR;
+	}
+
+	if(_header.magic != DATA_STORE_MANIFEST_MAGIC || _header.version != DATA_STORE_MANIFEST_VERSION ||
+		_header.record_size != sizeof(Record) || _header.crc32 != header_crc())
+	{
+		debug_print(F("Invalid manifest: "));
+		debug_println(_path);
+		return RET_ERROR;
+	}
+
+	// A record append may have been interrupted after the header was written
+	if(f.size() < sizeof(Header) + _header.record_count * sizeof(Record))
+	{
+		debug_println(F("Manifest truncated."));
+		return RET_ERROR;
+	}
+
+	f.close();
+
+	_loaded = true;
+
+	if(_header.record_count >= DATA_STORE_MANIFEST_COMPACT_MIN_RECORDS &&
+		_header.live_files < _header.record_count / 2)
+	{
+		compact();
+	}
+
+	if(_loaded && _restore_callback != NULL)
+		_restore_callback(_restore_store);
+
+	return RET_OK;
+}
+
+/******************************************************************************
+ * Create an empty manifest, replacing any existing one
+ ******************************************************************************/
+RetResult DataStoreManifest::create()
+{
+	memset(&_header, 0, sizeof(_header));
+	_header.magic = DATA_STORE_MANIFEST_MAGIC;
+	_header.version = DATA_STORE_MANIFEST_VERSION;
+	_header.record_size = sizeof(Record);
+	_header.current_record = -1;
+
+	_current_cached = false;
+	_current_dirty = false;
+
+	Storage::make_dirs(_path);
+
+	File f = Storage::fs().open(_path, FILE_WRITE);
+	if(!f)
+	{
+		debug_print(F("Could not create manifest: "));
+		debug_println(_path);
+		_loaded = false;
+		return RET_ERROR;
+	}
+
+	Flash::count_create();
+
+	_loaded = write_header(f) == RET_OK;
+
+	return _loaded ? RET_OK : RET_ERROR;
+}
+
+/******************************************************************************
+ * Forget loaded header. Must be called when the manifest file is changed
+ * behind the manifest's back (eg. partition formatted).
+ ******************************************************************************/
+void DataStoreManifest::unload()
+{
+	_loaded = false;
+	_current_cached = false;
+	_current_dirty = false;
+}
+
+/******************************************************************************
+ * Check if header has been loaded
+ ******************************************************************************/
+bool DataStoreManifest::is_loaded() const
+{
+	return _loaded;
+}
+
+/******************************************************************************
+ * Set callback that brings the current record up to date on every load, so
+ * that it is restored whoever loads the manifest
+ * @param store Passed to callback
+ ******************************************************************************/
+void DataStoreManifest::set_restore_callback(RestoreCallback callback, void *store)
+{
+	_restore_callback = callback;
+	_restore_store = store;
+}
+
+/******************************************************************************
+ * Append a record and make it the current record
+ * @param record Record to append
+ * @param index Index of new record
+ * @param make_current Make it the current record (not done for files written
+ *		  whole, eg. when compacting)
+ ******************************************************************************/
+RetResult DataStoreManifest::append_record(const Record *record, int *index, bool make_current)
+{
+	if(!_loaded)
+		return RET_ERROR;
+
+	// Nothing left to keep, start over instead of growing the file
+	if(_header.live_files == 0 && _header.record_count > 0 && _open_readers == 0)
+	{
+		if(create() != RET_OK)
+			return RET_ERROR;
+	}
+	// Files are deleted from the front while new ones are appended (eg. when
+	// evicting), the manifest would grow until next load
+	else if(_header.record_count >= DATA_STORE_MANIFEST_COMPACT_MIN_RECORDS &&
+		_header.live_files < _header.record_count / 2)
+	{
+		compact();
+
+		if(!_loaded)
+			return RET_ERROR;
+	}
+
+	// Record being left gets its final entry count
+	if(make_current && flush_current_record() != RET_OK)
+		return RET_ERROR;
+
+	File f = Storage::fs().open(_path, "r+");
+	if(!f)
+	{
+		debug_println(F("Could not open manifest for writing."));
+		return RET_ERROR;
+	}
+
+	// Record first, header last. If interrupted in between, the header
+	// still describes a valid file.
+	size_t pos = sizeof(Header) + _header.record_count * sizeof(Record);
+	f.seek(pos);
+	size_t written = f.write((uint8_t*)record, sizeof(Record));
+	Flash::count_write(_store_dir_path, pos, written, true);
+
+	if(written != sizeof(Record))
+	{
+		debug_println(F("Could not write manifest record."));
+		return RET_ERROR;
+	}
+
+	*index = _header.record_count;
+
+	_header.record_count++;
+	if(!(record->flags & RECORD_DELETED))
+		_header.live_files++;
+	if(make_current)
+	{
+		_header.current_record = *index;
+		_current = *record;
+		_current_cached = true;
+		_current_dirty = false;
+	}
+
+	return write_header(f);
+}
+
+/******************************************************************************
+ * Overwrite a record
+ ******************************************************************************/
+RetResult DataStoreManifest::update_record(int index, const Record *record)
+{
+	if(!_loaded || index < 0 || (uint32_t)index >= _header.record_count)
+		return RET_ERROR;
+
+	File f = Storage::fs().open(_path, "r+");
+	if(!f)
+	{
+		debug_println(F("Could not open manifest for writing."));
+		return RET_ERROR;
+	}
+
+	size_t pos = sizeof(Header) + index * sizeof(Record);
+	f.seek(pos);
+	size_t written = f.write((uint8_t*)record, sizeof(Record));
+	Flash::count_write(_store_dir_path, pos, written, true);
+
+	if(written != sizeof(Record))
+	{
+		debug_println(F("Could not write manifest record."));
+		return RET_ERROR;
+	}
+
+	if(index == _header.current_record)
+	{
+		_current = *record;
+		_current_cached = true;
+		_current_dirty = false;
+	}
+
+	return RET_OK;
+}
+
+/******************************************************************************
+ * Update the current record in RAM only, eg. its entry count after a commit.
+ * Written to file with the next write of the record, or when another record
+ * becomes current.
+ ******************************************************************************/
+RetResult DataStoreManifest::cache_current_record(const Record *record)
+{
+	if(!_loaded || _header.current_record < 0)
+		return RET_ERROR;
+
+	_current = *record;
+	_current_cached = true;
+	_current_dirty = true;
+
+	return RET_OK;
+}
+
+/******************************************************************************
+ * Flag a record as deleted. If it is the current record, the store will have
+ * to start a new file.
+ ******************************************************************************/
+RetResult DataStoreManifest::delete_record(int index)
+{
+	Record record;
+	if(get_record(index, &record) != RET_OK)
+		return RET_ERROR;
+
+	if(record.flags & RECORD_DELETED)
+		return RET_OK;
+
+	File f = Storage::fs().open(_path, "r+");
+	if(!f)
+	{
+		debug_println(F("Could not open manifest for writing."));
+		return RET_ERROR;
+	}
+
+	record.flags |= RECORD_DELETED;
+
+	size_t pos = sizeof(Header) + index * sizeof(Record);
+	f.seek(pos);
+	size_t written = f.write((uint8_t*)&record, sizeof(Record));
+	Flash::count_write(_store_dir_path, pos, written, true);
+
+	if(written != sizeof(Record))
+	{
+		debug_println(F("Could not write manifest record."));
+		return RET_ERROR;
+	}
+
+	_header.live_files--;
+	if(_header.current_record == index)
+	{
+		_header.current_record = -1;
+		_current_cached = false;
+		_current_dirty = false;
+	}
+
+	return write_header(f);
+}
+
+/******************************************************************************
+ * Read a single record
+ ******************************************************************************/
+RetResult DataStoreManifest::get_record(int index, Record *record)
+{
+	if(!_loaded || index < 0 || (uint32_t)index >= _header.record_count)
+		return RET_ERROR;
+
+	if(_current_cached && index == _header.current_record)
+	{
+		*record = _current;
+		return RET_OK;
+	}
+
+	File f = Storage::fs().open(_path, FILE_READ);
+	if(!f)
+		return RET_ERROR;
+
+	f.seek(sizeof(Header) + index * sizeof(Record));
+	if(f.read((uint8_t*)record, sizeof(Record)) != sizeof(Record))
+		return RET_ERROR;
+
+	return RET_OK;
+}
+
+/******************************************************************************
+ * Open manifest for iterating records with read_next_record()
+ ******************************************************************************/
+File DataStoreManifest::open_records()
+{
+	if(!_loaded)
+		return File();
+
+	File f = Storage::fs().open(_path, FILE_READ);
+	if(!f || f.isDirectory())
+		return File();
+
+	f.seek(sizeof(Header));
+
+	return f;
+}
+
+/******************************************************************************
+ * Read next record that is not deleted
+ * @param f File returned by open_records()
+ * @param record Record read
+ * @param index Index of record read
+ * @return False when there are no more records
+ ******************************************************************************/
+bool DataStoreManifest::read_next_record(File &f, Record *record, int *index)
+{
+	if(!f)
+		return false;
+
+	while(true)
+	{
+		int cur_index = (f.position() - sizeof(Header)) / sizeof(Record);
+
+		// Records appended after the header was read are included
+		if((uint32_t)cur_index >= _header.record_count)
+			return false;
+
+		if(f.read((uint8_t*)record, sizeof(Record)) != sizeof(Record))
+			return false;
+
+		if(!(record->flags & RECORD_DELETED))
+		{
+			if(_current_cached && cur_index == _header.current_record)
+				*record = _current;
+
+			*index = cur_index;
+			return true;
+		}
+	}
+}
+
+/******************************************************************************
+ * Set record of file currently written to
+ ******************************************************************************/
+RetResult DataStoreManifest::set_current_record(int index)
+{
+	if(!_loaded)
+		return RET_ERROR;
+
+	if(_header.current_record == index)
+		return RET_OK;
+
+	if(flush_current_record() != RET_OK)
+		return RET_ERROR;
+
+	File f = Storage::fs().open(_path, "r+");
+	if(!f)
+	{
+		debug_println(F("Could not open manifest for writing."));
+		return RET_ERROR;
+	}
+
+	_header.current_record = index;
+	_current_cached = false;
+
+	return write_header(f);
+}
+
+/******************************************************************************
+ * Get record of file currently written to, -1 if none
+ ******************************************************************************/
+int DataStoreManifest::get_current_record() const
+{
+	return _loaded ? _header.current_record : -1;
+}
+
+/******************************************************************************
+ * Get number of data files in store
+ ******************************************************************************/
+uint32_t DataStoreManifest::get_live_files() const
+{
+	return _header.live_files;
+}
+
+/******************************************************************************
+ * Get number of records in manifest (incl. deleted)
+ ******************************************************************************/
+uint32_t DataStoreManifest::get_record_count() const
+{
+	return _header.record_count;
+}
+
+/******************************************************************************
+ * Build path of a record's data file
+ ******************************************************************************/
+void DataStoreManifest::get_file_path(const Record *record, char *buff, int buff_size) const
+{
+	snprintf(buff, buff_size, "%s/%d_%d", _store_dir_path, (int)record->name_tstamp, (int)record->name_postfix);
+}
+
+/******************************************************************************
+ * Get priority of store's data
+ ******************************************************************************/
+DataStorePriority DataStoreManifest::get_priority() const
+{
+	return _priority;
+}
+
+/******************************************************************************
+ * Get max data files of store, 0 if it has no quota
+ ******************************************************************************/
+int DataStoreManifest::get_max_files() const
+{
+	return _max_files;
+}
+
+/******************************************************************************
+ * Delete oldest data file of store, without it being submitted
+ * @param keep_current Don't evict the file currently written to
+ * @return RET_ERROR if there is no file to evict
+ ******************************************************************************/
+RetResult DataStoreManifest::evict_oldest(bool keep_current)
+{
+	Record record;
+	int index = 0;
+
+	// Readers track records by index
+	if(_open_readers > 0 || find_oldest_record(&record, &index, keep_current) != RET_OK)
+		return RET_ERROR;
+
+	char path[FILE_PATH_BUFFER_SIZE] = {0};
+	get_file_path(&record, path, sizeof(path));
+
+	debug_print(F("Evicting data file: "));
+	debug_println(path);
+
+	// A file already gone only leaves its record to delete
+	if(Storage::fs().remove(path))
+		Flash::count_delete();
+	else if(Storage::fs().exists(path))
+		return RET_ERROR;
+
+	if(delete_record(index) != RET_OK)
+		return RET_ERROR;
+
+	Flash::count_evict(_store_dir_path);
+
+	return RET_OK;
+}
+
+/******************************************************************************
+ * Evict a file to make room for a store
+ * The oldest file of a store over its quota is evicted, or if none is, of the
+ * lowest priority store. Stores of higher priority than the requester are
+ * never touched and neither are stores being read. A store's data is evicted
+ * oldest first, the file the requester is writing to is kept.
+ * @param requester Manifest of store that needs room
+ * @return RET_ERROR if there is nothing to evict
+ ******************************************************************************/
+RetResult DataStoreManifest::evict(DataStoreManifest *requester)
+{
+	DataStoreManifest *victim = NULL;
+	bool victim_over_quota = false;
+	uint32_t victim_tstamp = 0;
+
+	for(DataStoreManifest *m = _first; m != NULL; m = m->_next)
+	{
+		if(m->_priority > requester->_priority || m->_open_readers > 0)
+			continue;
+
+		if(!m->_loaded && m->load() != RET_OK)
+			continue;
+
+		Record record;
+		int index = 0;
+
+		if(m->find_oldest_record(&record, &index, m == requester) != RET_OK)
+			continue;
+
+		bool over_quota = m->_max_files > 0 && m->_header.live_files > (uint32_t)m->_max_files;
+
+		// Over quota first, then lowest priority, then oldest file
+		if(victim == NULL || (over_quota && !victim_over_quota) ||
+			(over_quota == victim_over_quota && (m->_priority < victim->_priority ||
+			(m->_priority == victim->_priority && record.name_tstamp < victim_tstamp))))
+		{
+			victim = m;
+			victim_over_quota = over_quota;
+			victim_tstamp = record.name_tstamp;
+		}
+	}
+
+	if(victim == NULL)
+	{
+		debug_println(F("No data file to evict."));
+		return RET_ERROR;
+	}
+
+	return victim->evict_oldest(victim == requester);
+}
+
+/******************************************************************************
+ * Readers must call these before/after iterating records
+ ******************************************************************************/
+void DataStoreManifest::reader_opened()
+{
+	_open_readers++;
+}
+
+void DataStoreManifest::reader_closed()
+{
+	if(_open_readers > 0)
+		_open_readers--;
+}
+
+/******************************************************************************
+ * Print store file count, entries and time span
+ * Reads only this store's records.
+ ******************************************************************************/
+void DataStoreManifest::print_summary()
+{
+	if(!_loaded && load() != RET_OK)
+	{
+		debug_print(_store_dir_path);
+		debug_println(F(" [no manifest]"));
+		return;
+	}
+
+	debug_print(_store_dir_path);
+
+	uint32_t entries = 0;
+	uint64_t min_tstamp = 0, max_tstamp = 0;
+
+	File f = open_records();
+	Record record;
+	int index = 0;
+
+	while(read_next_record(f, &record, &index))
+	{
+		entries += record.entries;
+
+		if(record.entries == 0)
+			continue;
+
+		if(min_tstamp == 0 || record.min_tstamp < min_tstamp)
+			min_tstamp = record.min_tstamp;
+		if(record.max_tstamp > max_tstamp)
+			max_tstamp = record.max_tstamp;
+	}
+
+	debug_print(F(" files: "));
+	debug_print(_header.live_files, DEC);
+	debug_print(F(" entries: "));
+	debug_print(entries, DEC);
+	debug_print(F(" from: "));
+	debug_print((unsigned long)min_tstamp, DEC);
+	debug_print(F(" to: "));
+	debug_println((unsigned long)max_tstamp, DEC);
+}
+
+/******************************************************************************
+ * Print summary of all stores
+ ******************************************************************************/
+void DataStoreManifest::print_all()
+{
+	for(DataStoreManifest *m = _first; m != NULL; m = m->_next)
+	{
+		m->print_summary();
+	}
+}
+
+/******************************************************************************
+ * Unload all manifests (eg. after formatting)
+ ******************************************************************************/
+void DataStoreManifest::unload_all()
+{
+	for(DataStoreManifest *m = _first; m != NULL; m = m->_next)
+	{
+		m->unload();
+	}
+}
+
+/******************************************************************************
+ * Get priority of the data in a store dir, without the store's manifest
+ * (eg. when migrating files between file systems)
+ ******************************************************************************/
+DataStorePriority DataStoreManifest::get_dir_priority(const char *store_dir_path)
+{
+	const StoreQuota *quota = find_store_quota(store_dir_path);
+
+	return quota != NULL ? quota->priority : DATA_STORE_PRIORITY_PRIMARY;
+}
+
+/******************************************************************************
+ * Write header to an open manifest file
+ ******************************************************************************/
+RetResult DataStoreManifest::write_header(File &f)
+{
+	_header.crc32 = header_crc();
+
+	f.seek(0);
+	size_t written = f.write((uint8_t*)&_header, sizeof(_header));
+	Flash::count_write(_store_dir_path, 0, written, true);
+
+	if(written != sizeof(_header))
+	{
+		debug_println(F("Could not write manifest header."));
+		return RET_ERROR;
+	}
+
+	return RET_OK;
+}
+
+/******************************************************************************
+ * Write changes of the current record kept in RAM, if any
+ ******************************************************************************/
+RetResult DataStoreManifest::flush_current_record()
+{
+	if(!_current_dirty || _header.current_record < 0)
+		return RET_OK;
+
+	return update_record(_header.current_record, &_current);
+}
+
+/******************************************************************************
+ * Rewrite manifest keeping only records not deleted
+ * Done in a temp file which replaces the manifest when complete.
+ ******************************************************************************/
+RetResult DataStoreManifest::compact()
+{
+	if(_open_readers > 0)
+		return RET_ERROR;
+
+	debug_print(F("Compacting manifest: "));
+	debug_println(_path);
+
+	// Manifest path may be of max length, room for the postfix
+	char tmp_path[FILE_PATH_BUFFER_SIZE + 1] = {0};
+	snprintf(tmp_path, sizeof(tmp_path), "%s~", _path);
+
+	File src = open_records();
+	File dst = Storage::fs().open(tmp_path, FILE_WRITE);
+	if(!src || !dst)
+	{
+		debug_println(F("Could not open manifest files for compaction."));
+		return RET_ERROR;
+	}
+
+	Flash::count_create();
+
+	Header new_header = _header;
+	new_header.record_count = 0;
+	new_header.current_record = -1;
+
+	// Header placeholder, rewritten when records are done
+	size_t pos = dst.write((uint8_t*)&new_header, sizeof(new_header));
+	Flash::count_write(_store_dir_path, 0, pos, true);
+
+	Record record;
+	int index = 0;
+
+	while(read_next_record(src, &record, &index))
+	{
+		size_t written = dst.write((uint8_t*)&record, sizeof(record));
+		Flash::count_write(_store_dir_path, pos, written, true);
+		pos += written;
+
+		if(written != sizeof(record))
+		{
+			debug_println(F("Could not write compacted manifest."));
+			dst.close();
+			if(Storage::fs().remove(tmp_path))
+				Flash::count_delete();
+			return RET_ERROR;
+		}
+
+		if(index == _header.current_record)
+			new_header.current_record = new_header.record_count;
+
+		new_header.record_count++;
+	}
+
+	src.close();
+
+	Header old_header = _header;
+	_header = new_header;
+	_header.live_files = new_header.record_count;
+
+	if(write_header(dst) != RET_OK)
+	{
+		_header = old_header;
+		dst.close();
+		if(Storage::fs().remove(tmp_path))
+			Flash::count_delete();
+		return RET_ERROR;
+	}
+
+	dst.close();
+
+	if(!Storage::fs().remove(_path) || !Storage::fs().rename(tmp_path, _path))
+	{
+		debug_println(F("Could not replace manifest."));
+		_loaded = false;
+		return RET_ERROR;
+	}
+
+	Flash::count_delete();
+
+	// Current record was copied as cached
+	_current_dirty = false;
+
+	return RET_OK;
+}
+
+/******************************************************************************
+ * Find oldest data file (first record not deleted, records are in creation order)
+ * @param keep_current Skip file currently written to
+ ******************************************************************************/
+RetResult DataStoreManifest::find_oldest_record(Record *record, int *index, bool keep_current)
+{
+	File f = open_records();
+
+	while(read_next_record(f, record, index))
+	{
+		if(keep_current && *index == _header.current_record)
+			continue;
+
+		return RET_OK;
+	}
+
+	return RET_ERROR;
+}
+
+/******************************************************************************
+ * CRC32 of header fields
+ ******************************************************************************/
+uint32_t DataStoreManifest::header_crc() const
+{
+	return Utils::crc32((uint8_t*)&_header, sizeof(_header) - sizeof(_header.crc32));
+}
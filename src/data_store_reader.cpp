@@ -16,7 +16,7 @@
 * @param store Store object to read from
 ******************************************************************************/
 template <class TStruct>
-DataStoreReader<TStruct>::DataStoreReader(const DataStore<TStruct> *store)
+DataStoreReader<TStruct>::DataStoreReader(DataStore<TStruct> *store)
 {
 	_store = store;
 }
@@ -35,8 +35,7 @@ DataStoreReader<TStruct>::DataStoreReader()
 template <class TStruct>
 DataStoreReader<TStruct>::~DataStoreReader()
 {
-	_dir.close();
-	_cur_file.close();
+	reset();
 }
 
 /******************************************************************************
@@ -48,7 +47,7 @@ RetResult DataStoreReader<TStruct>::begin()
 	// todo: what happens if begin is not called? next should return false
 	if(Flash::mount() != RET_OK)
 	{
-		debug_println(F("Could not start SPIFFS."));
+		debug_println(F("Could not mount flash."));
 		return RET_ERROR;
 	}
 
@@ -59,70 +58,422 @@ RetResult DataStoreReader<TStruct>::begin()
 
 /******************************************************************************
 * Get next file in store
+* Files are returned in creation order and then groups of ring log records,
+* or newest first (set_order()), ring log first.
 * @return True while there are still files in store
 ******************************************************************************/
 template <class TStruct>
 bool DataStoreReader<TStruct>::next_file()
 {
-	bool success = false;
-
-	//
-	// Open first file and switch to reading
-	//
 	if(_state_files == STATE_PREPARE)
-	{
-		_dir = SPIFFS.open(_store->get_dir_path());
+		begin_next_source();
 
-		// Can't open dir means there are no files (dirs in SPIFFS are virtual)
-		if(!_dir)
+	while(true)
+	{
+		//
+		// Get next file
+		//
+		if(_state_files == STATE_READING)
 		{
-			_state_files = STATE_READING_FINISHED;
+			_cur_file.close();
+
+			DataStoreManifest::Record record;
+
+			// No more files, continue with ring log if not read yet
+			if(!next_record(&record))
+			{
+				debug_println(F("No more files to open."));
+				_records.close();
+				_manifest->reader_closed();
+				begin_next_source();
+				continue;
+			}
+
+			// Entries of another format (eg. before an OTA), left until evicted
+			if(record.flags & DataStoreManifest::RECORD_MISMATCH)
+				continue;
+
+			// Every entry was submitted but file wasn't deleted (eg. reset before
+			// it could be), delete it now
+			if(record.entries > 0 && record.acked_entries >= record.entries)
+			{
+				char path[FILE_PATH_BUFFER_SIZE] = {0};
+				_manifest->get_file_path(&record, path, sizeof(path));
+				if(Storage::fs().remove(path))
+					Flash::count_delete();
+				_manifest->delete_record(_cur_record_index);
+				continue;
+			}
+
+			// Manifest knows the time range of every file, skip without opening
+			if(_time_range_set && record.entries > 0 &&
+				(record.max_tstamp < _time_from || record.min_tstamp > _time_to))
+			{
+				continue;
+			}
+
+			char path[FILE_PATH_BUFFER_SIZE] = {0};
+			_manifest->get_file_path(&record, path, sizeof(path));
+
+			_cur_file = Storage::fs().open(path, FILE_READ);
+			_cur_file_encoded = record.flags & DataStoreManifest::RECORD_ENCODED;
+			_layout = _store->get_encoding(&_layout_field_count);
+
+			// File in manifest but not in flash (eg. reset before it was created), drop it
+			if(!_cur_file || _cur_file.isDirectory())
+			{
+				debug_print(F("File in manifest missing: "));
+				debug_println(path);
+				_cur_file.close();
+				_manifest->delete_record(_cur_record_index);
+				continue;
+			}
+
+			// Header is checked once, file is flagged so it is not opened again
+			_cur_file_data_offset = 0;
+
+			if(record.flags & DataStoreManifest::RECORD_HEADER)
+			{
+				typename DataStore<TStruct>::FileHeader header;
+
+				if(_store->read_file_header(_cur_file, &header) != DATA_STORE_FILE_CURRENT)
+				{
+					debug_print(F("Data file of another format, skipping: "));
+					debug_println(path);
+
+					_cur_file.close();
+					record.flags |= DataStoreManifest::RECORD_MISMATCH;
+					_manifest->update_record(_cur_record_index, &record);
+					continue;
+				}
+
+				_cur_file_data_offset = sizeof(header);
+			}
+
+			// New file to read, let entry reader know
+			reset_data_state();
+
+			// Continue after entries submitted before
+			if(record.acked_entries > 0)
+				skip_acked_entries(record.acked_entries);
+
+			return true;
 		}
-		else
+
+		//
+		// Get next group of ring log records. Each group is up to max entries per
+		// file records so it can be handled like a file.
+		//
+		if(_state_files == STATE_READING_RING_LOG)
 		{
-			_state_files = STATE_READING;
+			if(_ring_log->is_end(&_ring_cursor))
+			{
+				begin_next_source();
+				continue;
+			}
+
+			_ring_file_start = _ring_cursor;
+			_ring_file_entries = 0;
+
+			reset_data_state();
+
+			return true;
 		}
+
+		//
+		// Done
+		//
+		return false;
 	}
+}
 
-	//
-	// Get next file
-	//
-	if(_state_files == STATE_READING)
+/******************************************************************************
+* Switch to the next source not read yet: files then ring log, or the other
+* way round when reading newest first (a store with a ring log writes its new
+* entries there, its files are older). Finish when both are read.
+******************************************************************************/
+template <class TStruct>
+void DataStoreReader<TStruct>::begin_next_source()
+{
+	bool ring_log_first = _order == DATA_STORE_READ_NEWEST_FIRST;
+
+	if(ring_log_first && !_ring_log_done && begin_ring_log())
+		return;
+
+	if(!_files_done && begin_files())
+		return;
+
+	if(!ring_log_first && !_ring_log_done && begin_ring_log())
+		return;
+
+	_state_files = STATE_READING_FINISHED;
+}
+
+/******************************************************************************
+* Open manifest and switch to reading files
+* @return False if store has no files (no manifest)
+******************************************************************************/
+template <class TStruct>
+bool DataStoreReader<TStruct>::begin_files()
+{
+	_files_done = true;
+	_manifest = _store->get_manifest();
+
+	// No manifest means there are no files
+	if(_store->load_manifest() != RET_OK || !(_records = _manifest->open_records()))
+		return false;
+
+	_manifest->reader_opened();
+
+	_order_started = false;
+	_order_batch_count = 0;
+	_order_batch_pos = 0;
+
+	_state_files = STATE_READING;
+
+	return true;
+}
+
+/******************************************************************************
+* Switch to reading ring log
+* @return False if store has no ring log or it is not read
+******************************************************************************/
+template <class TStruct>
+bool DataStoreReader<TStruct>::begin_ring_log()
+{
+	_ring_log_done = true;
+	_ring_log = _store->get_ring_log();
+
+	if(!_ring_log_enabled || _ring_log == NULL || !_ring_log->is_ready())
+		return false;
+
+	_cur_file_encoded = false;
+	_ring_log->get_tail(&_ring_cursor);
+	_state_files = STATE_READING_RING_LOG;
+
+	return true;
+}
+
+/******************************************************************************
+* Read record of next file to open, in reader's order and file range
+* @param record Record read, its index becomes the current record index
+* @return False when there are no more files
+******************************************************************************/
+template <class TStruct>
+bool DataStoreReader<TStruct>::next_record(DataStoreManifest::Record *record)
+{
+	if(_order == DATA_STORE_READ_NEWEST_FIRST)
+		return next_newest_record(record);
+
+	while(_manifest->read_next_record(_records, record, &_cur_record_index))
 	{
-		_cur_file = _dir.openNextFile();
+		if(file_in_range(record))
+			return true;
+	}
 
-		// No more files, finish
-		if(!_cur_file)
-		{
-			debug_println(F("No more files to open. Finish."));
-			_state_files = STATE_READING_FINISHED;
-		}
-		else
-		{
-			success = true;
+	return false;
+}
 
-			// New file to read, let entry reader know
-			reset_data_state();
+/******************************************************************************
+* Read record of next newest file
+* Files are ordered by their newest entry (ties by creation order) a batch at
+* a time, so reading N files newest first takes N / DATA_STORE_READ_ORDER_BATCH
+* passes over the manifest and no memory per file.
+******************************************************************************/
+template <class TStruct>
+bool DataStoreReader<TStruct>::next_newest_record(DataStoreManifest::Record *record)
+{
+	while(true)
+	{
+		if(_order_batch_pos >= _order_batch_count && !fill_order_batch())
+			return false;
+
+		_order_last = _order_batch[_order_batch_pos++];
+		_order_started = true;
+
+		_cur_record_index = _order_last.index;
+
+		// Re-read, it may have changed since the batch was filled
+		if(_manifest->get_record(_cur_record_index, record) == RET_OK &&
+			!(record->flags & DataStoreManifest::RECORD_DELETED))
+		{
+			return true;
 		}
 	}
+}
+
+/******************************************************************************
+* Find the DATA_STORE_READ_ORDER_BATCH newest files older than the last one
+* returned, in a single pass over the manifest
+* @return False if there are no more files
+******************************************************************************/
+template <class TStruct>
+bool DataStoreReader<TStruct>::fill_order_batch()
+{
+	_order_batch_count = 0;
+	_order_batch_pos = 0;
+
+	_records.close();
+	if(!(_records = _manifest->open_records()))
+		return false;
 
-	//
-	// Done
-	//
-	if(_state_files == STATE_READING_FINISHED)
+	DataStoreManifest::Record record;
+	int index = 0;
+
+	while(_manifest->read_next_record(_records, &record, &index))
 	{
-		success = false;
+		if(!file_in_range(&record))
+			continue;
+
+		// Returned already
+		if(_order_started && (record.max_tstamp > _order_last.max_tstamp ||
+			(record.max_tstamp == _order_last.max_tstamp && index >= _order_last.index)))
+		{
+			continue;
+		}
+
+		// Insert newest first, a tie before the records created earlier.
+		// When the batch is full the oldest is dropped.
+		int pos = _order_batch_count;
+		while(pos > 0 && _order_batch[pos - 1].max_tstamp <= record.max_tstamp)
+			pos--;
+
+		if(pos >= DATA_STORE_READ_ORDER_BATCH)
+			continue;
+
+		if(_order_batch_count < DATA_STORE_READ_ORDER_BATCH)
+			_order_batch_count++;
+
+		for(int i = _order_batch_count - 1; i > pos; i--)
+			_order_batch[i] = _order_batch[i - 1];
+
+		_order_batch[pos].index = index;
+		_order_batch[pos].max_tstamp = record.max_tstamp;
 	}
 
-	return success;
+	return _order_batch_count > 0;
 }
 
 /******************************************************************************
-* Get next item in current file
+* Check if a file is in file range, true if no range set. Files with no
+* entries have no time bounds and are always read.
+******************************************************************************/
+template <class TStruct>
+bool DataStoreReader<TStruct>::file_in_range(const DataStoreManifest::Record *record) const
+{
+	return !_file_range_set || record->entries == 0 ||
+		(record->max_tstamp >= _file_from && record->max_tstamp <= _file_to);
+}
+
+/******************************************************************************
+* Get next item in current file, in time range if one is set
 * @return True while there are still entries in current file
 ******************************************************************************/
 template <class TStruct>
 TStruct* DataStoreReader<TStruct>::next_entry()
+{
+	TStruct *entry = NULL;
+
+	while((entry = read_next_entry()) != NULL)
+	{
+		if(in_time_range(entry->timestamp))
+			break;
+	}
+
+	return entry;
+}
+
+/******************************************************************************
+* Read up to max entries of current file at once, into a span
+* Raw files are read with a single read() straight into the span's buffer,
+* instead of a read per entry. Encoded files and ring logs have no entries in
+* flash to use in place, they are decoded into the buffer entry by entry.
+* Entries read are acked by ack() as with next_entry().
+* @return True while entries were read from current file, even if all of them
+*         were dropped (span is empty)
+******************************************************************************/
+template <class TStruct>
+bool DataStoreReader<TStruct>::next_entries(DataStoreSpan<TStruct> *span, int max_entries)
+{
+	span->count = 0;
+	span->crc_failures = 0;
+
+	if(max_entries > span->capacity)
+		max_entries = span->capacity;
+
+	if(_state_data == STATE_PREPARE && (_state_files == STATE_READING || _state_files == STATE_READING_RING_LOG))
+		_state_data = STATE_READING;
+
+	if(_state_data != STATE_READING || max_entries <= 0)
+		return false;
+
+	int count = 0;
+
+	if(_cur_file_encoded || _state_files == STATE_READING_RING_LOG)
+	{
+		while(count < max_entries && read_next_entry() != NULL)
+			span->buff[count++] = _cur_entry;
+
+		// Decoded entries come from blocks that passed their CRC
+		filter_entries(span, count, !_cur_file_encoded);
+	}
+	else
+	{
+		size_t entry_size = sizeof(typename DataStore<TStruct>::Entry);
+
+		count = _cur_file.read((uint8_t*)span->buff, max_entries * entry_size) / entry_size;
+
+		// End of file. A partly written entry at the end is ignored, as by next_entry().
+		if(count < max_entries)
+			_state_data = STATE_READING_FINISHED;
+
+		_file_entries_read += count;
+
+		filter_entries(span, count, true);
+	}
+
+	return count > 0;
+}
+
+/******************************************************************************
+* Keep entries of a span that pass their CRC and are in time range, moving
+* them to the front of the buffer. CRCs of the whole block are checked in
+* one pass, entries are only moved when some before them were dropped.
+* @param count Entries read into span buffer
+* @param check_crc Check entry CRCs (not set for decoded entries)
+******************************************************************************/
+template <class TStruct>
+void DataStoreReader<TStruct>::filter_entries(DataStoreSpan<TStruct> *span, int count, bool check_crc)
+{
+	int kept = 0;
+
+	for(int i = 0; i < count; i++)
+	{
+		typename DataStore<TStruct>::Entry *entry = &span->buff[i];
+
+		if(check_crc && Utils::crc32((uint8_t*)&entry->data, sizeof(entry->data)) != entry->crc32)
+		{
+			span->crc_failures++;
+			continue;
+		}
+
+		if(!in_time_range(entry->data.timestamp))
+			continue;
+
+		if(kept != i)
+			span->buff[kept] = *entry;
+
+		kept++;
+	}
+
+	span->count = kept;
+}
+
+/******************************************************************************
+* Read next item in current file
+******************************************************************************/
+template <class TStruct>
+TStruct* DataStoreReader<TStruct>::read_next_entry()
 {
 	bool success = false;
 
@@ -130,13 +481,33 @@ TStruct* DataStoreReader<TStruct>::next_entry()
 	if(_state_data == STATE_PREPARE)
 	{
 		// If reading of files in progress, only then proceed to data reading
-		if(_state_files == STATE_READING)
+		if(_state_files == STATE_READING || _state_files == STATE_READING_RING_LOG)
 			_state_data = STATE_READING;
 		else
 			success = false;
 	}
 
-	if(_state_data == STATE_READING)
+	if(_state_data == STATE_READING && _state_files == STATE_READING_RING_LOG)
+	{
+		if(_ring_file_entries < _store->get_max_entries_per_file() &&
+			_ring_log->read_next(&_ring_cursor, &_cur_entry))
+		{
+			_ring_file_entries++;
+			success = true;
+		}
+		else
+		{
+			_state_data = STATE_READING_FINISHED;
+		}
+	}
+	else if(_state_data == STATE_READING && _cur_file_encoded)
+	{
+		if(next_encoded_entry())
+			success = true;
+		else
+			_state_data = STATE_READING_FINISHED;
+	}
+	else if(_state_data == STATE_READING)
 	{
 		int bytes_read = _cur_file.readBytes((char*)&_cur_entry, sizeof(_cur_entry));
 
@@ -161,10 +532,115 @@ TStruct* DataStoreReader<TStruct>::next_entry()
 		return NULL;
 	else
 	{
+		_file_entries_read++;
 		return &_cur_entry.data;
 	}
 }
 
+/******************************************************************************
+* Decode next entry of an encoded file into current entry
+* Reading stops at the first block that fails its CRC, since entries after it
+* can't be decoded.
+* @return True if an entry was decoded
+******************************************************************************/
+template <class TStruct>
+bool DataStoreReader<TStruct>::next_encoded_entry()
+{
+	if(_block_entries_read >= _block_header.entries && !read_block())
+		return false;
+
+	if(_block_header.flags & DataStoreCodec::BLOCK_COLUMNAR)
+	{
+		if(DataStoreCodec::decode_columnar_entry(_layout, _layout_field_count, sizeof(TStruct), &_history,
+			&_block_header, _block, &_column_cursor, (uint8_t*)&_cur_entry.data) != RET_OK)
+		{
+			debug_println(F("Could not decode entry."));
+			return false;
+		}
+	}
+	else
+	{
+		bool keyframe = _block_entries_read == 0 && (_block_header.flags & DataStoreCodec::BLOCK_KEYFRAME);
+
+		int size = DataStoreCodec::decode_entry(_layout, _layout_field_count, sizeof(TStruct), &_history,
+			keyframe, _block + _block_pos, _block_header.payload_size - _block_pos, (uint8_t*)&_cur_entry.data);
+
+		if(size < 0)
+		{
+			debug_println(F("Could not decode entry."));
+			return false;
+		}
+
+		_block_pos += size;
+	}
+
+	_block_entries_read++;
+
+	return true;
+}
+
+/******************************************************************************
+* Read next block of current encoded file and check its CRC
+* When a time range is set, columnar blocks outside it are skipped by their
+* summary, without reading the rest of the block.
+******************************************************************************/
+template <class TStruct>
+bool DataStoreReader<TStruct>::read_block()
+{
+	if(_layout == NULL)
+	{
+		debug_println(F("Encoded file in store without encoding."));
+		return false;
+	}
+
+	int summary_size = DataStoreCodec::get_summary_size(_layout, _layout_field_count);
+	bool block_read = false;
+
+	while(true)
+	{
+		if(_cur_file.read(_block, sizeof(_block_header)) != sizeof(_block_header))
+			return false;
+
+		if(DataStoreCodec::read_block_header(_block, sizeof(_block_header), &_block_header) != RET_OK)
+			break;
+
+		int bytes_read = 0;
+
+		if(_time_range_set && (_block_header.flags & DataStoreCodec::BLOCK_COLUMNAR) &&
+			summary_size <= _block_header.payload_size)
+		{
+			bytes_read = _cur_file.read(_block, summary_size);
+			if(bytes_read != summary_size)
+				break;
+
+			if(!DataStoreCodec::summary_in_time_range(_layout, _layout_field_count, _block, _time_from, _time_to))
+			{
+				_cur_file.seek(_block_header.payload_size - summary_size, SeekCur);
+				continue;
+			}
+		}
+
+		bytes_read += _cur_file.read(_block + bytes_read, _block_header.payload_size - bytes_read);
+		block_read = bytes_read == _block_header.payload_size;
+		break;
+	}
+
+	if(!block_read ||
+		!DataStoreCodec::block_crc_valid(&_block_header, _block) ||
+		((_block_header.flags & DataStoreCodec::BLOCK_COLUMNAR) &&
+			DataStoreCodec::begin_columnar_block(_layout, _layout_field_count, &_block_header, _block, &_column_cursor) != RET_OK))
+	{
+		debug_println(F("Invalid block, rest of file skipped."));
+		_block_header.entries = 0;
+		return false;
+	}
+
+	_block_entries_read = 0;
+	_block_pos = 0;
+
+	return true;
+}
+
 /******************************************************************************
  * Check if current entry's CRC is valid
  ******************************************************************************/
@@ -174,6 +650,10 @@ bool DataStoreReader<TStruct>::entry_crc_valid()
 	if(_state_data != STATE_READING)
 		return false;
 
+	// Entries are only decoded from blocks that passed their CRC
+	if(_cur_file_encoded && _state_files == STATE_READING)
+		return true;
+
 	return Utils::crc32( (uint8_t*)&_cur_entry.data, sizeof(_cur_entry.data) ) == _cur_entry.crc32;
 }
 
@@ -183,6 +663,13 @@ bool DataStoreReader<TStruct>::entry_crc_valid()
 template <class TStruct>
 RetResult DataStoreReader<TStruct>::delete_file()
 {
+	// Ring log records read so far in this group are consumed
+	if(_state_files == STATE_READING_RING_LOG)
+	{
+		reset_data_state();
+		return _ring_log->consume(&_ring_file_start, &_ring_cursor);
+	}
+
 	if(!_cur_file)
 		return RET_ERROR;
 
@@ -192,8 +679,11 @@ RetResult DataStoreReader<TStruct>::delete_file()
 
 	_cur_file.close();
 
-	if(SPIFFS.remove(path))
+	if(Storage::fs().remove(path))
 	{
+		Flash::count_delete();
+		_manifest->delete_record(_cur_record_index);
+
 		reset_data_state();
 
 		return RET_OK;
@@ -204,6 +694,173 @@ RetResult DataStoreReader<TStruct>::delete_file()
 	}
 }
 
+/******************************************************************************
+ * Acknowledge all entries read so far from the current file (eg. after they
+ * were submitted). They are not returned again by any reader of the store,
+ * so a file that fails to submit halfway is only retried from where it
+ * failed. Ring log records are consumed.
+ * delete_file() must still be called once the whole file is done.
+ ******************************************************************************/
+template <class TStruct>
+RetResult DataStoreReader<TStruct>::ack()
+{
+	if(_state_files == STATE_READING_RING_LOG)
+	{
+		if(_ring_log->consume(&_ring_file_start, &_ring_cursor) != RET_OK)
+			return RET_ERROR;
+
+		_ring_file_start = _ring_cursor;
+		return RET_OK;
+	}
+
+	if(_state_files != STATE_READING || !_cur_file)
+		return RET_ERROR;
+
+	return _store->set_acked_entries(_cur_record_index, _file_entries_read);
+}
+
+/******************************************************************************
+ * Mark position in current file, to ack the entries read so far (or delete
+ * the file) later with ack(mark) / delete_file(mark). In the ring log, the
+ * next mark starts where this one ends.
+ ******************************************************************************/
+template <class TStruct>
+void DataStoreReader<TStruct>::mark(DataStoreReadMark *mark)
+{
+	memset(mark, 0, sizeof(*mark));
+	mark->record_index = -1;
+
+	if(_state_files == STATE_READING_RING_LOG)
+	{
+		mark->ring_log = true;
+		mark->ring_from = _ring_file_start;
+		mark->ring_to = _ring_cursor;
+
+		_ring_file_start = _ring_cursor;
+	}
+	else if(_state_files == STATE_READING && _cur_file)
+	{
+		mark->record_index = _cur_record_index;
+		mark->entries_read = _file_entries_read;
+	}
+}
+
+/******************************************************************************
+ * Acknowledge entries read up to a mark, as ack() does, whether the reader is
+ * still in the mark's file or not. Ring log records since the previous mark
+ * are consumed.
+ ******************************************************************************/
+template <class TStruct>
+RetResult DataStoreReader<TStruct>::ack(const DataStoreReadMark *mark)
+{
+	if(mark->ring_log)
+		return _ring_log->consume(&mark->ring_from, &mark->ring_to);
+
+	if(mark->record_index < 0)
+		return RET_ERROR;
+
+	return _store->set_acked_entries(mark->record_index, mark->entries_read);
+}
+
+/******************************************************************************
+ * Delete file of a mark, once all of it was submitted. Ring log records since
+ * the previous mark are consumed.
+ ******************************************************************************/
+template <class TStruct>
+RetResult DataStoreReader<TStruct>::delete_file(const DataStoreReadMark *mark)
+{
+	if(mark->ring_log)
+		return ack(mark);
+
+	if(mark->record_index < 0)
+		return RET_ERROR;
+
+	// Still reading it, file must be closed first
+	if(_state_files == STATE_READING && _cur_file && mark->record_index == _cur_record_index)
+		return delete_file();
+
+	return _store->delete_file(mark->record_index);
+}
+
+/******************************************************************************
+ * Skip entries acknowledged by a previous reader, at start of file
+ * Raw entries are fixed size so they are seeked over, encoded ones must be
+ * decoded since entries depend on previous ones.
+ ******************************************************************************/
+template <class TStruct>
+void DataStoreReader<TStruct>::skip_acked_entries(int acked_entries)
+{
+	if(_cur_file_encoded)
+	{
+		while(_file_entries_read < acked_entries && read_next_entry() != NULL)
+			;
+	}
+	else if(_cur_file.seek(_cur_file_data_offset + acked_entries * sizeof(_cur_entry)))
+	{
+		_file_entries_read = acked_entries;
+	}
+}
+
+/******************************************************************************
+ * Only return entries with timestamps in a range. Files and columnar blocks
+ * entirely outside the range are skipped without reading them.
+ * delete_file() still deletes whole files.
+ * @param from Start of range (incl.), in units of entry timestamps
+ * @param to End of range (incl.)
+ ******************************************************************************/
+template <class TStruct>
+void DataStoreReader<TStruct>::set_time_range(uint64_t from, uint64_t to)
+{
+	_time_range_set = true;
+	_time_from = from;
+	_time_to = to;
+}
+
+/******************************************************************************
+ * Only read files with their newest entry in a range (bounds kept by the
+ * manifest). Files are returned whole, unlike with set_time_range(), so their
+ * entries can be acked and the files deleted. Ring log is not filtered.
+ * Must be set before reading.
+ * @param from Start of range (incl.), in units of entry timestamps
+ * @param to End of range (incl.)
+ ******************************************************************************/
+template <class TStruct>
+void DataStoreReader<TStruct>::set_file_range(uint64_t from, uint64_t to)
+{
+	_file_range_set = true;
+	_file_from = from;
+	_file_to = to;
+}
+
+/******************************************************************************
+ * Set order files are returned in (DATA_STORE_READ_OLDEST_FIRST by default).
+ * Entries of a file are always returned oldest first. Must be set before
+ * reading.
+ ******************************************************************************/
+template <class TStruct>
+void DataStoreReader<TStruct>::set_order(DataStoreReadOrder order)
+{
+	_order = order;
+}
+
+/******************************************************************************
+ * Set if store's ring log is read along with its files (default)
+ ******************************************************************************/
+template <class TStruct>
+void DataStoreReader<TStruct>::set_ring_log_enabled(bool enabled)
+{
+	_ring_log_enabled = enabled;
+}
+
+/******************************************************************************
+ * Check if a timestamp is in the time range, true if no range set
+ ******************************************************************************/
+template <class TStruct>
+bool DataStoreReader<TStruct>::in_time_range(uint64_t tstamp) const
+{
+	return !_time_range_set || (tstamp >= _time_from && tstamp <= _time_to);
+}
+
 /******************************************************************************
  * Reset reader to enable re-iteration
  ******************************************************************************/
@@ -213,8 +870,16 @@ void DataStoreReader<TStruct>::reset()
 	// Close open files if any
 	_cur_file.close();
 
-	// Close dir handle
-	_dir.close();
+	// Close manifest handle
+	_records.close();
+
+	if(_state_files == STATE_READING)
+		_manifest->reader_closed();
+
+	_state_files = STATE_PREPARE;
+	_files_done = false;
+	_ring_log_done = false;
+	reset_data_state();
 }
 
 /******************************************************************************
@@ -225,6 +890,12 @@ template <class TStruct>
 RetResult DataStoreReader<TStruct>::reset_data_state()
 {
 	_state_data = STATE_PREPARE;
+	_file_entries_read = 0;
+
+	_block_header.entries = 0;
+	_block_entries_read = 0;
+	_block_pos = 0;
+	DataStoreCodec::reset_history(&_history);
 
 	return RET_OK;
 }
@@ -0,0 +1,196 @@
+#include "deep_sleep.h"
+#include "esp_attr.h"
+#include "const.h"
+#include "common.h"
+#include "crc.h"
+#include "water_sensor_data.h"
+#include "atmos41_data.h"
+#include "soil_moisture_data.h"
+#include "lightning_data.h"
+#include "fo_data.h"
+#include "sdi12_log.h"
+#include "log.h"
+
+namespace DeepSleep
+{
+	/******************************************************************************
+	 * Privates
+	 ******************************************************************************/
+
+	/** Header of a parked block, followed by its data */
+	struct ParkHeader
+	{
+		/** CRC32 of key */
+		uint32_t key;
+
+		/** Data size */
+		uint16_t size;
+
+		/** CRC32 of data */
+		uint32_t crc32;
+	}__attribute__((packed));
+
+	/** Parked blocks, one after the other */
+	RTC_DATA_ATTR uint8_t _park[DEEP_SLEEP_PARK_SIZE];
+
+	/** Bytes of _park in use */
+	RTC_DATA_ATTR uint16_t _parked_bytes = 0;
+
+	template <typename TStore>
+	RetResult park_store(TStore *store);
+
+	/******************************************************************************
+	 * Keep data in RTC memory until the next wake up
+	 * @param key Identifies data, must be unique among parked blocks
+	 * @return RET_ERROR if there is no room left
+	 ******************************************************************************/
+	RetResult park(const char *key, const void *data, size_t size)
+	{
+		if(_parked_bytes + sizeof(ParkHeader) + size > sizeof(_park))
+			return RET_ERROR;
+
+		ParkHeader header;
+		header.key = Crc::crc32(key, strlen(key));
+		header.size = size;
+		header.crc32 = Crc::crc32(data, size);
+
+		memcpy(_park + _parked_bytes, &header, sizeof(header));
+		memcpy(_park + _parked_bytes + sizeof(header), data, size);
+
+		_parked_bytes += sizeof(header) + size;
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * Get parked data
+	 * @param data Output buffer
+	 * @param max_size Size of output buffer
+	 * @param size Size of data (output var), 0 if nothing parked with this key
+	 * @return RET_ERROR if data is corrupt or doesn't fit
+	 ******************************************************************************/
+	RetResult unpark(const char *key, void *data, size_t max_size, size_t *size)
+	{
+		uint32_t key_crc = Crc::crc32(key, strlen(key));
+		uint16_t offset = 0;
+		ParkHeader header;
+
+		*size = 0;
+
+		while(offset + sizeof(header) <= _parked_bytes)
+		{
+			memcpy(&header, _park + offset, sizeof(header));
+			offset += sizeof(header);
+
+			if(offset + header.size > _parked_bytes)
+				return RET_ERROR;
+
+			if(header.key == key_crc)
+			{
+				if(header.size > max_size || header.crc32 != Crc::crc32(_park + offset, header.size))
+					return RET_ERROR;
+
+				memcpy(data, _park + offset, header.size);
+				*size = header.size;
+
+				return RET_OK;
+			}
+
+			offset += header.size;
+		}
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * Drop all parked data
+	 ******************************************************************************/
+	void clear()
+	{
+		_parked_bytes = 0;
+	}
+
+	/******************************************************************************
+	 * Bytes of RTC memory used by parked data, incl. headers
+	 ******************************************************************************/
+	size_t get_parked_bytes()
+	{
+		return _parked_bytes;
+	}
+
+	/******************************************************************************
+	 * Park buffers of all stores, right before going to deep sleep
+	 * Stores whose buffer doesn't fit are committed to flash instead.
+	 ******************************************************************************/
+	RetResult park_state()
+	{
+		RetResult ret = RET_OK;
+
+		clear();
+
+		if(park_store(WaterSensorData::get_store()) != RET_OK)
+			ret = RET_ERROR;
+		if(park_store(Atmos41Data::get_store()) != RET_OK)
+			ret = RET_ERROR;
+		if(park_store(SoilMoistureData::get_store()) != RET_OK)
+			ret = RET_ERROR;
+		if(park_store(LightningData::get_store()) != RET_OK)
+			ret = RET_ERROR;
+		if(park_store(FoData::get_store()) != RET_OK)
+			ret = RET_ERROR;
+		if(park_store(SDI12Log::get_store()) != RET_OK)
+			ret = RET_ERROR;
+		if(park_store(Log::get_store()) != RET_OK)
+			ret = RET_ERROR;
+
+		debug_print(F("Parked in RTC memory (bytes): "));
+		debug_println(_parked_bytes, DEC);
+
+		return ret;
+	}
+
+	/******************************************************************************
+	 * Put parked buffers back to their stores, after waking up from deep sleep
+	 ******************************************************************************/
+	RetResult restore_state()
+	{
+		RetResult ret = RET_OK;
+
+		if(WaterSensorData::get_store()->restore_buffer() != RET_OK)
+			ret = RET_ERROR;
+		if(Atmos41Data::get_store()->restore_buffer() != RET_OK)
+			ret = RET_ERROR;
+		if(SoilMoistureData::get_store()->restore_buffer() != RET_OK)
+			ret = RET_ERROR;
+		if(LightningData::get_store()->restore_buffer() != RET_OK)
+			ret = RET_ERROR;
+		if(FoData::get_store()->restore_buffer() != RET_OK)
+			ret = RET_ERROR;
+		if(SDI12Log::get_store()->restore_buffer() != RET_OK)
+			ret = RET_ERROR;
+		if(Log::get_store()->restore_buffer() != RET_OK)
+			ret = RET_ERROR;
+
+		if(ret != RET_OK)
+			debug_println_e(F("Could not restore parked store buffers."));
+
+		clear();
+
+		return ret;
+	}
+
+	/******************************************************************************
+	 * Park buffer of a store, commit it if it doesn't fit
+	 ******************************************************************************/
+	template <typename TStore>
+	RetResult park_store(TStore *store)
+	{
+		if(store->park_buffer() == RET_OK)
+			return RET_OK;
+
+		debug_print_w(F("No room in RTC memory, committing store: "));
+		debug_println(store->get_dir_path());
+
+		return store->commit();
+	}
+} // DeepSleep
@@ -0,0 +1,302 @@
+#include "deflate_encoder.h"
+#include <string.h>
+
+/** Shortest and longest match */
+const int DEFLATE_MIN_MATCH = 3;
+const int DEFLATE_MAX_MATCH = 258;
+
+/** Empty hash chain */
+const uint16_t DEFLATE_NIL = 0xFFFF;
+
+const int DEFLATE_END_OF_BLOCK = 256;
+
+/** Length codes 257-285: base lengths and extra bits */
+const uint16_t DEFLATE_LENGTH_BASE[] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59,
+	67, 83, 99, 115, 131, 163, 195, 227, 258};
+const uint8_t DEFLATE_LENGTH_EXTRA[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+	4, 4, 4, 4, 5, 5, 5, 5, 0};
+
+/** Distance codes 0-29: base distances and extra bits */
+const uint16_t DEFLATE_DISTANCE_BASE[] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385,
+	513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+const uint8_t DEFLATE_DISTANCE_EXTRA[] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7,
+	8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+const int DEFLATE_LENGTH_CODES = sizeof(DEFLATE_LENGTH_BASE) / sizeof(DEFLATE_LENGTH_BASE[0]);
+const int DEFLATE_DISTANCE_CODES = sizeof(DEFLATE_DISTANCE_BASE) / sizeof(DEFLATE_DISTANCE_BASE[0]);
+
+/******************************************************************************
+ * Start a stream: a single final block with fixed Huffman codes
+ * @param out Sink compressed bytes are written to
+ ******************************************************************************/
+void DeflateEncoder::begin(HttpBodySink *out)
+{
+	_out = out;
+	_pos = 0;
+	_end = 0;
+	_bits = 0;
+	_bit_count = 0;
+	_out_buff_size = 0;
+	_out_size = 0;
+	_failed = false;
+
+	for(int i = 0; i < (1 << DEFLATE_HASH_BITS); i++)
+		_head[i] = DEFLATE_NIL;
+
+	// BFINAL, BTYPE 01 (fixed Huffman)
+	put_bits(1, 1);
+	put_bits(1, 2);
+}
+
+/******************************************************************************
+ * Compress data. Up to a max match length of it is kept as lookahead until
+ * more is written or the stream is finished.
+ ******************************************************************************/
+RetResult DeflateEncoder::write(const uint8_t *data, int size)
+{
+	while(size > 0 && !_failed)
+	{
+		if(_end == (int)sizeof(_window))
+			slide();
+
+		int len = sizeof(_window) - _end;
+		if(len > size)
+			len = size;
+
+		memcpy(_window + _end, data, len);
+		_end += len;
+		data += len;
+		size -= len;
+
+		compress(false);
+	}
+
+	return _failed ? RET_ERROR : RET_OK;
+}
+
+/******************************************************************************
+ * Compress the lookahead and end the stream
+ ******************************************************************************/
+RetResult DeflateEncoder::finish()
+{
+	compress(true);
+
+	put_literal(DEFLATE_END_OF_BLOCK);
+
+	// Pad last byte
+	if(_bit_count > 0)
+		put_bits(0, 8 - _bit_count);
+
+	flush_out();
+
+	return _failed ? RET_ERROR : RET_OK;
+}
+
+/******************************************************************************
+ * Compressed bytes written so far
+ ******************************************************************************/
+int DeflateEncoder::get_out_size()
+{
+	return _out_size;
+}
+
+/******************************************************************************
+ * Code bytes while a max length match fits in the lookahead, or all of them
+ * when flushing. Matches are taken greedily.
+ ******************************************************************************/
+void DeflateEncoder::compress(bool flush)
+{
+	int min_lookahead = flush ? 1 : DEFLATE_MAX_MATCH;
+
+	while(_end - _pos >= min_lookahead)
+	{
+		int distance = 0;
+		int length = _end - _pos >= DEFLATE_MIN_MATCH ? longest_match(&distance) : 0;
+
+		if(length >= DEFLATE_MIN_MATCH)
+		{
+			put_match(length, distance);
+
+			for(int i = 0; i < length; i++, _pos++)
+			{
+				if(_pos + DEFLATE_MIN_MATCH <= _end)
+					insert_hash(_pos);
+			}
+		}
+		else
+		{
+			put_literal(_window[_pos]);
+
+			if(_pos + DEFLATE_MIN_MATCH <= _end)
+				insert_hash(_pos);
+
+			_pos++;
+		}
+	}
+}
+
+/******************************************************************************
+ * Find longest match for the bytes at _pos, following its hash chain back up
+ * to DEFLATE_MAX_CHAIN positions within the window
+ * @return Match length, 0 if none
+ ******************************************************************************/
+int DeflateEncoder::longest_match(int *distance)
+{
+	const uint8_t *p = _window + _pos;
+
+	int max_len = _end - _pos < DEFLATE_MAX_MATCH ? _end - _pos : DEFLATE_MAX_MATCH;
+	int best = 0;
+	int chain = DEFLATE_MAX_CHAIN;
+	uint16_t cand = _head[hash(_pos)];
+
+	// Chain slots are reused after a window, only closer positions are valid
+	while(cand != DEFLATE_NIL && cand < _pos && _pos - cand < DEFLATE_WINDOW_SIZE && chain-- > 0)
+	{
+		const uint8_t *c = _window + cand;
+
+		if(c[best] == p[best])
+		{
+			int len = 0;
+			while(len < max_len && c[len] == p[len])
+				len++;
+
+			if(len > best)
+			{
+				best = len;
+				*distance = _pos - cand;
+
+				if(len >= max_len)
+					break;
+			}
+		}
+
+		uint16_t next = _prev[cand & (DEFLATE_WINDOW_SIZE - 1)];
+		if(next == DEFLATE_NIL || next >= cand)
+			break;
+
+		cand = next;
+	}
+
+	return best;
+}
+
+/******************************************************************************
+ * Add position to its hash chain, 3 bytes must follow it
+ ******************************************************************************/
+void DeflateEncoder::insert_hash(int pos)
+{
+	uint32_t h = hash(pos);
+
+	_prev[pos & (DEFLATE_WINDOW_SIZE - 1)] = _head[h];
+	_head[h] = pos;
+}
+
+/******************************************************************************
+ * Hash of the 3 bytes at a position
+ ******************************************************************************/
+uint32_t DeflateEncoder::hash(int pos)
+{
+	const uint8_t *p = _window + pos;
+
+	return ((uint32_t)p[0] << 16 | (uint32_t)p[1] << 8 | p[2]) * 2654435761u >> (32 - DEFLATE_HASH_BITS);
+}
+
+/******************************************************************************
+ * Drop the oldest window of history to make room for input
+ ******************************************************************************/
+void DeflateEncoder::slide()
+{
+	memmove(_window, _window + DEFLATE_WINDOW_SIZE, _end - DEFLATE_WINDOW_SIZE);
+	_pos -= DEFLATE_WINDOW_SIZE;
+	_end -= DEFLATE_WINDOW_SIZE;
+
+	for(int i = 0; i < (1 << DEFLATE_HASH_BITS); i++)
+		_head[i] = _head[i] == DEFLATE_NIL || _head[i] < DEFLATE_WINDOW_SIZE ?
+			DEFLATE_NIL : _head[i] - DEFLATE_WINDOW_SIZE;
+
+	for(int i = 0; i < DEFLATE_WINDOW_SIZE; i++)
+		_prev[i] = _prev[i] == DEFLATE_NIL || _prev[i] < DEFLATE_WINDOW_SIZE ?
+			DEFLATE_NIL : _prev[i] - DEFLATE_WINDOW_SIZE;
+}
+
+/******************************************************************************
+ * Write bits, LSB first
+ ******************************************************************************/
+void DeflateEncoder::put_bits(uint32_t bits, int count)
+{
+	_bits |= bits << _bit_count;
+	_bit_count += count;
+
+	while(_bit_count >= 8)
+	{
+		_out_buff[_out_buff_size++] = _bits & 0xFF;
+		_bits >>= 8;
+		_bit_count -= 8;
+
+		if(_out_buff_size == DEFLATE_OUT_BUFF_SIZE)
+			flush_out();
+	}
+}
+
+/******************************************************************************
+ * Write a Huffman code, these go MSB first
+ ******************************************************************************/
+void DeflateEncoder::put_code(uint32_t code, int length)
+{
+	uint32_t reversed = 0;
+
+	for(int i = 0; i < length; i++)
+		reversed |= ((code >> i) & 1) << (length - 1 - i);
+
+	put_bits(reversed, length);
+}
+
+/******************************************************************************
+ * Write a literal/length symbol with its fixed code
+ ******************************************************************************/
+void DeflateEncoder::put_literal(int literal)
+{
+	if(literal < 144)
+		put_code(0x30 + literal, 8);
+	else if(literal < 256)
+		put_code(0x190 + literal - 144, 9);
+	else if(literal < 280)
+		put_code(literal - 256, 7);
+	else
+		put_code(0xC0 + literal - 280, 8);
+}
+
+/******************************************************************************
+ * Write a match: length code and extra bits, distance code and extra bits
+ ******************************************************************************/
+void DeflateEncoder::put_match(int length, int distance)
+{
+	int code = DEFLATE_LENGTH_CODES - 1;
+	while(DEFLATE_LENGTH_BASE[code] > length)
+		code--;
+
+	put_literal(257 + code);
+	put_bits(length - DEFLATE_LENGTH_BASE[code], DEFLATE_LENGTH_EXTRA[code]);
+
+	code = DEFLATE_DISTANCE_CODES - 1;
+	while(DEFLATE_DISTANCE_BASE[code] > distance)
+		code--;
+
+	put_code(code, 5);
+	put_bits(distance - DEFLATE_DISTANCE_BASE[code], DEFLATE_DISTANCE_EXTRA[code]);
+}
+
+/******************************************************************************
+ * Pass buffered output to the sink
+ ******************************************************************************/
+void DeflateEncoder::flush_out()
+{
+	if(_out_buff_size == 0 || _failed)
+		return;
+
+	if(_out->write(_out_buff, _out_buff_size) != RET_OK)
+		_failed = true;
+
+	_out_size += _out_buff_size;
+	_out_buff_size = 0;
+}
@@ -0,0 +1,172 @@
+#include "entry_schema.h"
+#include "common.h"
+#include <string.h>
+
+namespace EntrySchema
+{
+	/******************************************************************************
+	 * Id of what is sent of a schema's entries: its schema_id() plus keys,
+	 * decimals and flags of its fields. Sent with binary telemetry, so the
+	 * decoder can tell which schema (and version of it) entries were built with.
+	 *****************************************************************************/
+	uint32_t telemetry_id(const Field *fields, int count)
+	{
+		uint32_t hash = schema_id(fields, count);
+
+		for(int i = 0; i < count; i++)
+		{
+			for(const char *c = fields[i].key; c != NULL && *c != '\0'; c++)
+				hash = DataStoreCodec::hash_byte(hash, *c);
+
+			// Key terminator, NULL key hashes as empty
+			hash = DataStoreCodec::hash_byte(hash, 0);
+			hash = DataStoreCodec::hash_byte(hash, fields[i].decimals);
+			hash = DataStoreCodec::hash_byte(hash, fields[i].flags);
+		}
+
+		return hash;
+	}
+
+	/******************************************************************************
+	 * 10^decimals of a float field, a value is sent as round(value * scale) /
+	 * scale. Up to 6 decimals.
+	 *****************************************************************************/
+	double decimals_scale(const Field *field)
+	{
+		static const double POW10[] = {1, 10, 100, 1000, 10000, 100000, 1000000};
+
+		return POW10[field->decimals < 6 ? field->decimals : 6];
+	}
+
+	/******************************************************************************
+	 * Read a field of an entry
+	 * @param entry Entry of the struct the field belongs to
+	 * @return Value, integers up to 32 bits are exact
+	 *****************************************************************************/
+	double get_value(const Field *field, const void *entry)
+	{
+		const uint8_t *src = (const uint8_t*)entry + field->offset;
+
+		switch(field->type)
+		{
+		case TYPE_FLOAT:
+			if(field->size == sizeof(double))
+			{
+				double value;
+				memcpy(&value, src, sizeof(value));
+				return value;
+			}
+			else
+			{
+				float value;
+				memcpy(&value, src, sizeof(value));
+				return value;
+			}
+
+		case TYPE_SIGNED:
+		{
+			// Sign extend from field size
+			int64_t value = 0;
+			memcpy(&value, src, field->size);
+
+			int shift = (sizeof(value) - field->size) * 8;
+			return (double)((int64_t)((uint64_t)value << shift) >> shift);
+		}
+
+		default:
+		{
+			uint64_t value = 0;
+			memcpy(&value, src, field->size);
+			return (double)value;
+		}
+		}
+	}
+
+	/******************************************************************************
+	 * Write a field of an entry
+	 * Integers are truncated, out of range values wrap like a cast would
+	 *****************************************************************************/
+	void set_value(const Field *field, void *entry, double value)
+	{
+		uint8_t *dst = (uint8_t*)entry + field->offset;
+
+		switch(field->type)
+		{
+		case TYPE_FLOAT:
+			if(field->size == sizeof(double))
+			{
+				memcpy(dst, &value, sizeof(value));
+			}
+			else
+			{
+				float float_value = value;
+				memcpy(dst, &float_value, sizeof(float_value));
+			}
+			break;
+
+		case TYPE_BOOL:
+		{
+			bool bool_value = value != 0;
+			memcpy(dst, &bool_value, field->size);
+			break;
+		}
+
+		default:
+		{
+			// Little endian, low bytes are the field
+			int64_t int_value = (int64_t)value;
+			memcpy(dst, &int_value, field->size);
+			break;
+		}
+		}
+	}
+
+	/******************************************************************************
+	 * Check if all FLAG_ZERO_GROUP fields of an entry are zero, so they are not
+	 * sent. False if the schema has no such fields.
+	 *****************************************************************************/
+	bool is_zero_group_empty(const Field *fields, int count, const void *entry)
+	{
+		bool has_group = false;
+
+		for(int i = 0; i < count; i++)
+		{
+			if(!(fields[i].flags & FLAG_ZERO_GROUP))
+				continue;
+
+			if(get_value(&fields[i], entry) != 0)
+				return false;
+
+			has_group = true;
+		}
+
+		return has_group;
+	}
+
+	/******************************************************************************
+	 * Print every field of an entry, one per line
+	 *****************************************************************************/
+	void print(const Field *fields, int count, const void *entry)
+	{
+		for(int i = 0; i < count; i++)
+		{
+			double value = get_value(&fields[i], entry);
+
+			debug_print(fields[i].label);
+			debug_print(F(": "));
+
+			if(fields[i].type == TYPE_FLOAT)
+			{
+				debug_println(value, fields[i].decimals == DECIMALS_ALL ? 2 : fields[i].decimals);
+			}
+			else if(fields[i].type == TYPE_SIGNED)
+			{
+				debug_println((long)value, DEC);
+			}
+			else
+			{
+				debug_println((unsigned long)value, DEC);
+			}
+		}
+	}
+}
@@ -0,0 +1,81 @@
+#include "esp_partition_flash.h"
+#include "common.h"
+
+/******************************************************************************
+ * EspPartitionFlash
+ * Thin wrapper over the esp_partition API. Partition must be declared in the
+ * partition table (see partitions_datalog.csv).
+ ******************************************************************************/
+
+/******************************************************************************
+ * Constructor
+ ******************************************************************************/
+EspPartitionFlash::EspPartitionFlash()
+{}
+
+/******************************************************************************
+ * Find data partition by label
+ * @param label Partition label
+ ******************************************************************************/
+RetResult EspPartitionFlash::begin(const char *label)
+{
+	_partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+
+	if(_partition == NULL)
+	{
+		debug_print(F("Partition not found: "));
+		debug_println(label);
+		return RET_ERROR;
+	}
+
+	debug_print(F("Partition "));
+	debug_print(label);
+	debug_print(F(" at: "));
+	debug_print(_partition->address, HEX);
+	debug_print(F(" size: "));
+	debug_println(_partition->size, DEC);
+
+	return RET_OK;
+}
+
+/******************************************************************************
+ * Check if partition has been found
+ ******************************************************************************/
+bool EspPartitionFlash::is_ready() const
+{
+	return _partition != NULL;
+}
+
+RetResult EspPartitionFlash::read(uint32_t addr, void *dest, size_t size)
+{
+	if(_partition == NULL)
+		return RET_ERROR;
+
+	return esp_partition_read(_partition, addr, dest, size) == ESP_OK ? RET_OK : RET_ERROR;
+}
+
+RetResult EspPartitionFlash::write(uint32_t addr, const void *src, size_t size)
+{
+	if(_partition == NULL)
+		return RET_ERROR;
+
+	return esp_partition_write(_partition, addr, src, size) == ESP_OK ? RET_OK : RET_ERROR;
+}
+
+RetResult EspPartitionFlash::erase_sector(uint32_t addr)
+{
+	if(_partition == NULL)
+		return RET_ERROR;
+
+	return esp_partition_erase_range(_partition, addr, SPI_FLASH_SEC_SIZE) == ESP_OK ? RET_OK : RET_ERROR;
+}
+
+uint32_t EspPartitionFlash::get_size() const
+{
+	return _partition == NULL ? 0 : _partition->size;
+}
+
+uint32_t EspPartitionFlash::get_sector_size() const
+{
+	return SPI_FLASH_SEC_SIZE;
+}
@@ -1,45 +1,82 @@
 #include "flash.h"
-#include "SPIFFS.h"
+#include "storage.h"
+#include "app_config.h"
 #include "utils.h"
 #include "const.h"
 #include "struct.h"
 #include "log.h"
+#include "data_store_manifest.h"
 #include "common.h"
+#include "rtc.h"
+#include "esp_attr.h"
 
 namespace Flash
 {
+	/** Wear counters */
+	RTC_DATA_ATTR Stats _stats = {0};
+
+	StoreStats* get_store_stats(const char *dir_path);
+
 	/********************************************************************************
-	* Mount SPIFFS partition
+	* Mount data partition with the storage backend. If it doesn't mount and a
+	* backend to migrate from is set, store files are moved from it.
+	* Called before every flash access, mount stats only count real mounts.
 	*******************************************************************************/
 	RetResult mount()
 	{
 		int tries = 2;
 		bool success = false;
+		bool was_mounted = Storage::is_mounted();
+		uint32_t t_start = millis();
+
+		if(_stats.since_tstamp == 0)
+			_stats.since_tstamp = RTC::get_timestamp();
 
 		while(tries--)
 		{
-			if(SPIFFS.begin(false, "/spiffs", 25))
+			if(Storage::begin(false, STORAGE_MAX_OPEN_FILES))
 			{
 				success = true;
 				break;
 			}
 			else
 			{
-				debug_println(F("Could not mount SPIFFS."));
+				debug_print(F("Could not mount "));
+				debug_println(Storage::get_name());
 				if(tries > 1)
 					debug_println(F("Retrying..."));					
 			}
 		}
 
+#if STORAGE_MIGRATE_FROM
+		// Partition may still be formatted with the previous backend
+		if(!success)
+		{
+			int files_migrated = 0, files_dropped = 0;
+
+			if(Storage::migrate(Storage::get_backend(STORAGE_MIGRATE_FROM), &files_migrated, &files_dropped) == RET_OK)
+			{
+				// Backlog too big to migrate, previous backend kept for now
+				if(Storage::get_backend()->id != STORAGE_MIGRATE_FROM)
+					Log::log(Log::STORAGE_MIGRATED, files_migrated, files_dropped);
+
+				success = true;
+			}
+		}
+#endif
+
 		// If mounting failed, format partition then try mounting again
 		if(!success)
 		{
-			debug_println(F("Could not mount SPIFFS, formatting partition..."));
-			SPIFFS.format();
+			debug_println(F("Could not mount partition, formatting..."));
+			DataStoreManifest::unload_all();
+			Storage::format();
 
-			if(SPIFFS.begin(false, "/spiffs", 50))
+			if(Storage::begin(false, STORAGE_MAX_OPEN_FILES * 2))
 			{
 				debug_println(F("Partition mount successful."));
+				_stats.mounts++;
+				_stats.mount_ms = millis() - t_start;
 				return RET_OK;
 			}
 			else
@@ -51,6 +88,12 @@ namespace Flash
 			}
 		}
 
+		if(!was_mounted)
+		{
+			_stats.mounts++;
+			_stats.mount_ms = millis() - t_start;
+		}
+
 		return RET_OK;
 	}
 
@@ -65,7 +108,7 @@ namespace Flash
 			return RET_ERROR;
 		}
 
-		File f = SPIFFS.open(path, FILE_READ);
+		File f = Storage::fs().open(path, FILE_READ);
 
 		// File doesn't exist
 		if(!f)
@@ -85,18 +128,23 @@ namespace Flash
 	}
 
 	/********************************************************************************
-	* Print all files and dirs in flash
+	* Print flash usage and a summary of every data store, from store manifests
+	* @param list_files Also list every file in flash. Slow, SPIFFS has to scan
+	*                   the whole partition for every dir.
 	*******************************************************************************/
-	void ls()
+	void ls(bool list_files)
 	{
 		Utils::print_separator(F("Flash memory contents"));
 
+		debug_print(F("File system: "));
+		debug_println(Storage::get_name());
+
 		debug_print(F("Size: "));
-		debug_print(SPIFFS.totalBytes());
+		debug_print(Storage::total_bytes());
 		debug_println("bytes");
 
 		debug_print(F("Free: "));
-		debug_print(SPIFFS.totalBytes() - SPIFFS.usedBytes());
+		debug_print(get_free_bytes());
 		debug_println("bytes");
 
 		if(Flash::mount() != RET_OK)
@@ -104,7 +152,17 @@ namespace Flash
 		    return;
 		}
 
-		File root = SPIFFS.open("/");
+		DataStoreManifest::print_all();
+
+		print_stats();
+
+		if(!list_files)
+		{
+			Utils::print_separator(F("End flash memory contents"));
+			return;
+		}
+
+		File root = Storage::fs().open("/");
 		if(!root)
 		{
 			debug_println(F("Could not open root."));
@@ -134,12 +192,26 @@ namespace Flash
 		Utils::print_separator(F("End flash memory contents"));
 	}
 
+	/********************************************************************************
+	* Get free bytes in partition (must be mounted)
+	*******************************************************************************/
+	size_t get_free_bytes()
+	{
+		size_t total = Storage::total_bytes();
+		size_t used = Storage::used_bytes();
+
+		return used < total ? total - used : 0;
+	}
+
 	/******************************************************************************
-	 * Format SPIFFS and log
+	 * Format partition and log
 	 *****************************************************************************/
 	RetResult format()
 	{
-		if(SPIFFS.format())
+		// Manifests in RAM no longer match flash
+		DataStoreManifest::unload_all();
+
+		if(Storage::format())
 		{
 			Log::log(Log::SPIFFS_FORMATTED);
 			return RET_OK;
@@ -150,4 +222,154 @@ namespace Flash
 			return RET_ERROR;
 		}
 	}
+
+	/******************************************************************************
+	 * Count a file write
+	 * @param dir_path Dir of store the file belongs to
+	 * @param pos Position in file the write starts at
+	 * @param size Bytes written
+	 * @param manifest Write is to the store's manifest
+	 *****************************************************************************/
+	void count_write(const char *dir_path, size_t pos, size_t size, bool manifest)
+	{
+		if(size == 0)
+			return;
+
+		_stats.writes++;
+		_stats.bytes_written += size;
+
+		// Every data page touched is programmed, plus the object index page
+		_stats.pages_programmed += (pos + size - 1) / FLASH_SPIFFS_PAGE_DATA_SIZE -
+			pos / FLASH_SPIFFS_PAGE_DATA_SIZE + 1 + 1;
+
+		StoreStats *store = get_store_stats(dir_path);
+		if(store == NULL)
+			return;
+
+		store->writes++;
+		if(manifest)
+			store->manifest_bytes += size;
+		else
+			store->data_bytes += size;
+	}
+
+	/******************************************************************************
+	 * Count a file created or truncated
+	 *****************************************************************************/
+	void count_create()
+	{
+		_stats.files_created++;
+	}
+
+	/******************************************************************************
+	 * Count a file deleted
+	 *****************************************************************************/
+	void count_delete()
+	{
+		_stats.files_deleted++;
+	}
+
+	/******************************************************************************
+	 * Count a data file evicted from a store, after it has been deleted
+	 *****************************************************************************/
+	void count_evict(const char *dir_path)
+	{
+		_stats.files_evicted++;
+
+		StoreStats *store = get_store_stats(dir_path);
+		if(store != NULL)
+			store->files_evicted++;
+	}
+
+	/******************************************************************************
+	 * Count a write to raw flash
+	 *****************************************************************************/
+	void count_raw_write(size_t size)
+	{
+		_stats.raw_writes++;
+		_stats.raw_bytes_written += size;
+	}
+
+	/******************************************************************************
+	 * Count a raw flash sector erase
+	 *****************************************************************************/
+	void count_raw_erase()
+	{
+		_stats.raw_erases++;
+	}
+
+	/******************************************************************************
+	 * Get wear counters
+	 *****************************************************************************/
+	const Stats* get_stats()
+	{
+		return &_stats;
+	}
+
+	/******************************************************************************
+	 * Estimated SPIFFS block erases. Every programmed page is erased again once
+	 * its block is garbage collected.
+	 *****************************************************************************/
+	uint32_t get_est_erases()
+	{
+		return _stats.pages_programmed / FLASH_SPIFFS_PAGES_PER_BLOCK;
+	}
+
+	/******************************************************************************
+	 * Reset wear counters
+	 *****************************************************************************/
+	void reset_stats()
+	{
+		memset(&_stats, 0, sizeof(_stats));
+	}
+
+	/******************************************************************************
+	 * Print wear counters
+	 *****************************************************************************/
+	void print_stats()
+	{
+		Utils::print_separator(F("Flash wear"));
+
+		debug_printf("Since: %u, mounts: %u, last mount: %u ms\n", _stats.since_tstamp, _stats.mounts,
+			_stats.mount_ms);
+		debug_printf("Files - writes: %u, bytes: %u, pages (est.): %u, erases (est.): %u\n", _stats.writes,
+			_stats.bytes_written, _stats.pages_programmed, get_est_erases());
+		debug_printf("Files - created: %u, deleted: %u, evicted: %u\n", _stats.files_created, _stats.files_deleted,
+			_stats.files_evicted);
+		debug_printf("Raw - writes: %u, bytes: %u, erases: %u\n", _stats.raw_writes, _stats.raw_bytes_written,
+			_stats.raw_erases);
+
+		for(int i = 0; i < _stats.store_count; i++)
+		{
+			debug_printf("%s - writes: %u, data: %u B, manifest: %u B, evicted: %u\n", _stats.stores[i].dir_path,
+				_stats.stores[i].writes, _stats.stores[i].data_bytes, _stats.stores[i].manifest_bytes,
+				_stats.stores[i].files_evicted);
+		}
+
+		Utils::print_separator(NULL);
+	}
+
+	/******************************************************************************
+	 * Find counters of a store, add them if not there
+	 * @return NULL if table is full
+	 *****************************************************************************/
+	StoreStats* get_store_stats(const char *dir_path)
+	{
+		if(dir_path == NULL)
+			return NULL;
+
+		for(int i = 0; i < _stats.store_count; i++)
+		{
+			if(_stats.stores[i].dir_path == dir_path || strcmp(_stats.stores[i].dir_path, dir_path) == 0)
+				return &_stats.stores[i];
+		}
+
+		if(_stats.store_count >= FLASH_STATS_MAX_STORES)
+			return NULL;
+
+		StoreStats *store = &_stats.stores[_stats.store_count++];
+		store->dir_path = dir_path;
+
+		return store;
+	}
 }
\ No newline at end of file
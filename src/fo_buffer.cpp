@@ -18,7 +18,21 @@ RetResult FoBuffer::add_packet(FoDecodedPacket *packet)
         _first_packet_tstamp = RTC::get_timestamp();
     _last_packet_tstamp = RTC::get_timestamp();
 
-    memcpy(&_buffer[_packet_count], packet, sizeof(FoDecodedPacket));
+    if(_packet_count == 0)
+        _first_rain = packet->rain;
+    _last_rain = packet->rain;
+
+    _temp_total += packet->temp;
+    _hum_total += packet->hum;
+    _wind_speed_total += packet->wind_speed;
+    _wind_gust_total += packet->wind_gust;
+    _uv_total += packet->uv;
+    _uv_index_total += packet->uv_index;
+    _light_total += packet->light;
+    _solar_radiation_total += packet->solar_radiation;
+
+    _wind_dir_sin_total += sin(Utils::deg_to_rad(packet->wind_dir));
+    _wind_dir_cos_total += cos(Utils::deg_to_rad(packet->wind_dir));
 
     _packet_count++;
 
@@ -30,6 +44,8 @@ RetResult FoBuffer::add_packet(FoDecodedPacket *packet)
         debug_println(" seconds passed since last commit, commiting FoSniffer buffer.");
         commit_buffer();
     }
+
+    return RET_OK;
 }
 
 /******************************************************************************
@@ -39,6 +55,12 @@ void FoBuffer::clear()
 {
     _first_packet_tstamp = 0;
     _packet_count = 0;
+
+    _temp_total = _hum_total = 0;
+    _wind_speed_total = _wind_gust_total = 0;
+    _solar_radiation_total = 0;
+    _uv_total = _uv_index_total = _light_total = 0;
+    _wind_dir_sin_total = _wind_dir_cos_total = 0;
 }
 
 /******************************************************************************
@@ -51,38 +73,8 @@ RetResult FoBuffer::commit_buffer()
     if(_packet_count < 1)
         return RET_OK;
 
-    //
-    // Aggregate data
-    //
-
-    // Totals of params to calc averages
-    float hum_total = 0, temp_total = 0;
-    float wind_speed_total = 0, wind_gust_total = 0;
-    float solar_radiation_total = 0;
-    uint32_t uv_total = 0, uv_index_total = 0, light_total = 0;
-
-    // Total of sin/cos of wind dir, used to calculate mean angle
-    float wind_dir_sin_total = 0, wind_dir_cos_total = 0;
-
-    for(int i = 0; i < _packet_count; i++)
-    {
-        FoDecodedPacket *cur_packet = &_buffer[i];
-
-        temp_total += cur_packet->temp;
-        hum_total += cur_packet->hum;
-        wind_speed_total += cur_packet->wind_speed;
-        wind_gust_total += cur_packet->wind_gust;
-        uv_total += cur_packet->uv;
-        uv_index_total += cur_packet->uv_index;
-        light_total += cur_packet->light;
-        solar_radiation_total += cur_packet->solar_radiation;
-
-        wind_dir_sin_total += sin(Utils::deg_to_rad(cur_packet->wind_dir));
-        wind_dir_cos_total += cos(Utils::deg_to_rad(cur_packet->wind_dir));
-    }
-
     // Calc wind dir avg
-    float wind_dir_avg = atan2(wind_dir_sin_total / _packet_count, wind_dir_cos_total / _packet_count);
+    float wind_dir_avg = atan2(_wind_dir_sin_total / _packet_count, _wind_dir_cos_total / _packet_count);
 
     wind_dir_avg = Utils::rad_to_deg(wind_dir_avg);
     if(wind_dir_avg < 0)
@@ -100,22 +92,22 @@ RetResult FoBuffer::commit_buffer()
     entry.timestamp = _first_packet_tstamp;
     entry.packets = _packet_count;
 
-    entry.temp = (float)temp_total / _packet_count;
-    entry.hum = (float)hum_total / _packet_count;
+    entry.temp = (float)_temp_total / _packet_count;
+    entry.hum = (float)_hum_total / _packet_count;
     entry.wind_dir = (uint16_t)wind_dir_avg;
-    entry.wind_speed = (float)wind_speed_total / _packet_count;
-    entry.wind_gust = (float)wind_gust_total / _packet_count;
-    entry.uv = uv_total / _packet_count;
-    entry.uv_index = uv_index_total / _packet_count;
-    entry.light = light_total / _packet_count;
-    entry.solar_radiation = solar_radiation_total / _packet_count;
-    entry.rain = _buffer[_packet_count - 1].rain;
+    entry.wind_speed = (float)_wind_speed_total / _packet_count;
+    entry.wind_gust = (float)_wind_gust_total / _packet_count;
+    entry.uv = _uv_total / _packet_count;
+    entry.uv_index = _uv_index_total / _packet_count;
+    entry.light = _light_total / _packet_count;
+    entry.solar_radiation = _solar_radiation_total / _packet_count;
+    entry.rain = _last_rain;
 
     // Calc hourly rate from previous commit
     if(_last_packet_tstamp > _first_packet_tstamp)
     {
         uint32_t time_diff_sec = _last_packet_tstamp - _first_packet_tstamp;
-        float rain_diff = entry.rain - _buffer[0].rain;
+        float rain_diff = entry.rain - _first_rain;
         float rate_hr = (60 * 60 / time_diff_sec) * rain_diff;
         rate_hr = (int)(rate_hr * 100 + 0.5) / 100.0;
 
@@ -1,15 +1,56 @@
 #include "fo_data.h"
 #include "log.h"
+#include "esp_attr.h"
 
 namespace FoData
 {
+	/**
+	 * Schema of entries. Packet/wakeup counts, rain counter and light values
+	 * repeat or drift slowly, so all fields are stored as deltas. Wakeups are
+	 * only kept for debugging, not sent.
+	 */
+	constexpr EntrySchema::Field SCHEMA[] = {
+		ENTRY_SCHEMA_FIELD(StoreEntry, timestamp, NULL, "Timestamp", 0, FIELD_DELTA2, EntrySchema::FLAG_NONE),
+		ENTRY_SCHEMA_FIELD(StoreEntry, packets, FO_DATA_KEY_PACKETS, "Packets",
+			0, FIELD_DELTA, EntrySchema::FLAG_NONE),
+		ENTRY_SCHEMA_FIELD(StoreEntry, wakeups, NULL, "Wakeups",
+			0, FIELD_DELTA, EntrySchema::FLAG_NONE),
+		ENTRY_SCHEMA_FIELD(StoreEntry, temp, FO_DATA_KEY_TEMP, "Temperature",
+			EntrySchema::DECIMALS_ALL, FIELD_DELTA, EntrySchema::FLAG_NONE),
+		ENTRY_SCHEMA_FIELD(StoreEntry, hum, FO_DATA_KEY_HUMIDITY, "Humidity",
+			0, FIELD_DELTA, EntrySchema::FLAG_NONE),
+		ENTRY_SCHEMA_FIELD(StoreEntry, rain, FO_DATA_KEY_RAIN, "Rain",
+			EntrySchema::DECIMALS_ALL, FIELD_DELTA, EntrySchema::FLAG_NONE),
+		ENTRY_SCHEMA_FIELD(StoreEntry, rain_hourly, FO_DATA_KEY_RAIN_RATE_HR, "Rain rate (hr)",
+			EntrySchema::DECIMALS_ALL, FIELD_DELTA, EntrySchema::FLAG_NONE),
+		ENTRY_SCHEMA_FIELD(StoreEntry, wind_dir, FO_DATA_KEY_WIND_DIR, "Wind dir",
+			0, FIELD_DELTA, EntrySchema::FLAG_NONE),
+		ENTRY_SCHEMA_FIELD(StoreEntry, wind_speed, FO_DATA_KEY_WIND_SPEED, "Wind speed",
+			EntrySchema::DECIMALS_ALL, FIELD_DELTA, EntrySchema::FLAG_NONE),
+		ENTRY_SCHEMA_FIELD(StoreEntry, wind_gust, FO_DATA_KEY_WIND_GUST, "Wind gust",
+			EntrySchema::DECIMALS_ALL, FIELD_DELTA, EntrySchema::FLAG_NONE),
+		ENTRY_SCHEMA_FIELD(StoreEntry, uv, FO_DATA_KEY_UV, "UV",
+			0, FIELD_DELTA, EntrySchema::FLAG_NONE),
+		ENTRY_SCHEMA_FIELD(StoreEntry, uv_index, FO_DATA_KEY_UV_INDEX, "UV index",
+			0, FIELD_DELTA, EntrySchema::FLAG_NONE),
+		ENTRY_SCHEMA_FIELD(StoreEntry, light, FO_DATA_KEY_LIGHT, "Light",
+			0, FIELD_DELTA, EntrySchema::FLAG_NONE),
+		ENTRY_SCHEMA_FIELD(StoreEntry, solar_radiation, FO_DATA_KEY_SOLAR_RADIATION, "Solar radiation",
+			0, FIELD_DELTA, EntrySchema::FLAG_NONE)
+	};
+	ENTRY_SCHEMA_CHECK(StoreEntry, SCHEMA);
+
+	/** Store encoding, generated from schema */
+	typedef EntrySchema::CodecLayout<SCHEMA, ENTRY_SCHEMA_FIELD_COUNT(SCHEMA)> EncodingLayout;
+
 	/**
 	 * Private vars
 	 */
-	DataStore<StoreEntry> store(FO_DATA_STORE_PATH, FO_DATA_STORE_ENTRIES_PER_SUBMIT_REQ);
+	DataStore<StoreEntry> store(FO_DATA_STORE_PATH, FO_DATA_STORE_ENTRIES_PER_SUBMIT_REQ,
+		EncodingLayout::fields, ENTRY_SCHEMA_FIELD_COUNT(SCHEMA));
 
-    /** FO wakeup count */
-    int _wakeup_count = 0;
+    /** FO wakeup count, kept over deep sleep */
+    RTC_DATA_ATTR int _wakeup_count = 0;
 
     /******************************************************************************
     * Add entry to store
@@ -46,6 +87,15 @@ namespace FoData
         _wakeup_count++;
     }
 
+    /******************************************************************************
+    * Get entry schema
+    ******************************************************************************/
+    const EntrySchema::Field* get_schema(int *field_count)
+    {
+        *field_count = ENTRY_SCHEMA_FIELD_COUNT(SCHEMA);
+        return SCHEMA;
+    }
+
     /********************************************************************************
 	* Print all data from a struct
 	* @param data Data structure
@@ -54,7 +104,7 @@ namespace FoData
 	{
 		Utils::print_separator(F("FO Data"));
 
-        Serial.println(F("FO data print not implemented"));
+		EntrySchema::print(SCHEMA, ENTRY_SCHEMA_FIELD_COUNT(SCHEMA), data);
 
 		Utils::print_separator(NULL);
 	}
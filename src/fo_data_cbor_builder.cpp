@@ -0,0 +1,14 @@
+#include "fo_data_cbor_builder.h"
+#include "common.h"
+
+/******************************************************************************
+ * Add packet to request
+ * Values are generated from the entry schema, see FoData::get_schema()
+ *****************************************************************************/
+RetResult FoDataCborBuilder::add(const FoData::StoreEntry *entry)
+{
+	int field_count = 0;
+	const EntrySchema::Field *fields = FoData::get_schema(&field_count);
+
+	return add_schema_entry(entry, fields, field_count);
+}
@@ -9,6 +9,7 @@
 #include "fo_data.h"
 #include "log.h"
 #include "fo_buffer.h"
+#include "esp_attr.h"
 
 namespace FoSniffer
 {
@@ -20,8 +21,12 @@ namespace FoSniffer
 	uint8_t calc_checksum(uint8_t const buff[]);	
 	uint8_t uv_to_index(int uv);
 
+	//
+	// Vars marked RTC_DATA_ATTR are kept over deep sleep
+	//
+
 	/** Time of last valid packet */
-	uint32_t _last_packet_tstamp = 0;
+	RTC_DATA_ATTR uint32_t _last_packet_tstamp = 0;
 
 	/** Last received packet */
 	// TODO: Useless along with get_packet??? Never needed externall
@@ -42,20 +47,20 @@ namespace FoSniffer
 	 * Considered in sync when packet received succesfully at expected time (ie. after
 	 * waiting known number of seconds from last packet)
 	*/
-	bool _in_sync = false;
+	RTC_DATA_ATTR bool _in_sync = false;
 
 	/** 
 	 * Number of successive failures to sniff weather station
 	 */ 
-	uint8_t _rx_failures = 0;
+	RTC_DATA_ATTR uint8_t _rx_failures = 0;
 
 	/**
 	 * Tstamp of last sync attempt. 
 	 */
-	uint32_t _last_sync_tstamp = 0;
+	RTC_DATA_ATTR uint32_t _last_sync_tstamp = 0;
 
-	/** Holds last X decoded packets */
-	FoBuffer _packet_buff;
+	/** Aggregates decoded packets */
+	RTC_DATA_ATTR FoBuffer _packet_buff;
 
 	/******************************************************************************
 	 * Init
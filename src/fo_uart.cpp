@@ -4,23 +4,28 @@
 #include "fo_data.h"
 #include "fo_buffer.h"
 #include "device_config.h"
+#include "esp_attr.h"
 
 namespace FoUart
 {
+	//
+	// Vars marked RTC_DATA_ATTR are kept over deep sleep
+	//
+
 	/** Time of last valid packet */
-	uint32_t _last_packet_tstamp = 0;
+	RTC_DATA_ATTR uint32_t _last_packet_tstamp = 0;
 
     /** Last received packet */
 	// TODO: Useless along with get_packet??? Never needed externall
 	FoDecodedPacket _last_decoded_packet = {0};
 
-	/** Holds last X parsed packets */
-	FoBuffer _packet_buff;
+	/** Aggregates parsed packets */
+	RTC_DATA_ATTR FoBuffer _packet_buff;
 
 	/** 
 	 * Number of successive failures to sniff weather station
 	 */ 
-	uint8_t _rx_failures = 0;
+	RTC_DATA_ATTR uint8_t _rx_failures = 0;
 
     /******************************************************************************
 	 * Init
@@ -0,0 +1,105 @@
+#include "gzip_body.h"
+#include "crc.h"
+#include "Arduino.h"
+
+/** Member header: deflate, no name or time, unknown OS */
+const uint8_t GZIP_HEADER[] = {0x1F, 0x8B, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF};
+
+/** Trailer: CRC32 and size of plain body */
+const int GZIP_TRAILER_SIZE = 8;
+
+/******************************************************************************
+ * Constructor
+ * @param body Body to compress
+ ******************************************************************************/
+GzipBodyWriter::GzipBodyWriter(HttpBodyWriter *body)
+{
+	_body = body;
+}
+
+/******************************************************************************
+ * Write header, compressed body and trailer to sink
+ ******************************************************************************/
+RetResult GzipBodyWriter::write(HttpBodySink *sink)
+{
+	_crc = 0;
+	_body_size = 0;
+	_compress_us = 0;
+
+	if(sink->write(GZIP_HEADER, sizeof(GZIP_HEADER)) != RET_OK)
+		return RET_ERROR;
+
+	_encoder.begin(sink);
+
+	if(_body->write(this) != RET_OK)
+		return RET_ERROR;
+
+	uint32_t start = micros();
+	RetResult ret = _encoder.finish();
+	_compress_us += micros() - start;
+
+	if(ret != RET_OK)
+		return RET_ERROR;
+
+	uint8_t trailer[GZIP_TRAILER_SIZE];
+
+	for(int i = 0; i < 4; i++)
+	{
+		trailer[i] = (_crc >> (i * 8)) & 0xFF;
+		trailer[4 + i] = ((uint32_t)_body_size >> (i * 8)) & 0xFF;
+	}
+
+	return sink->write(trailer, sizeof(trailer));
+}
+
+/******************************************************************************
+ * Compressed length is only known once written
+ ******************************************************************************/
+int GzipBodyWriter::get_length()
+{
+	return -1;
+}
+
+const char* GzipBodyWriter::get_content_encoding()
+{
+	return "gzip";
+}
+
+/******************************************************************************
+ * Plain body written by the wrapped body, compressed on the fly
+ ******************************************************************************/
+RetResult GzipBodyWriter::write(const uint8_t *data, int size)
+{
+	_crc = Crc::crc32_update(_crc, data, size);
+	_body_size += size;
+
+	uint32_t start = micros();
+	RetResult ret = _encoder.write(data, size);
+	_compress_us += micros() - start;
+
+	return ret;
+}
+
+/******************************************************************************
+ * Plain size of last body written
+ ******************************************************************************/
+int GzipBodyWriter::get_body_size()
+{
+	return _body_size;
+}
+
+/******************************************************************************
+ * Compressed size of last body written, incl. gzip header and trailer
+ ******************************************************************************/
+int GzipBodyWriter::get_compressed_size()
+{
+	return sizeof(GZIP_HEADER) + _encoder.get_out_size() + GZIP_TRAILER_SIZE;
+}
+
+/******************************************************************************
+ * Time spent compressing last body written
+ ******************************************************************************/
+uint32_t GzipBodyWriter::get_compress_us()
+{
+	return _compress_us;
+}
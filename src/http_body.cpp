@@ -0,0 +1,128 @@
+#include "http_body.h"
+#include <stdio.h>
+#include <string.h>
+
+/******************************************************************************
+ * Write a string, without its terminator
+ ******************************************************************************/
+RetResult HttpBodySink::write(const char *str)
+{
+	return write((const uint8_t*)str, strlen(str));
+}
+
+/******************************************************************************
+ * Content-Encoding of body, NULL if sent as it is
+ ******************************************************************************/
+const char* HttpBodyWriter::get_content_encoding()
+{
+	return NULL;
+}
+
+/******************************************************************************
+ * Constructor
+ * @param out Sink pieces are passed to
+ * @param chunked Frame pieces as chunks (body length not sent beforehand)
+ ******************************************************************************/
+HttpBodyStream::HttpBodyStream(HttpBodySink *out, bool chunked)
+{
+	_out = out;
+	_chunked = chunked;
+}
+
+/******************************************************************************
+ * Default constructor (private)
+ ******************************************************************************/
+HttpBodyStream::HttpBodyStream()
+{}
+
+RetResult HttpBodyStream::write(const uint8_t *data, int size)
+{
+	_body_size += size;
+
+	while(size > 0 && !_failed)
+	{
+		int len = HTTP_BODY_CHUNK_SIZE - _buff_size;
+		if(len > size)
+			len = size;
+
+		memcpy(_buff + _buff_size, data, len);
+		_buff_size += len;
+		data += len;
+		size -= len;
+
+		if(_buff_size == HTTP_BODY_CHUNK_SIZE)
+			flush();
+	}
+
+	return _failed ? RET_ERROR : RET_OK;
+}
+
+/******************************************************************************
+ * Pass on rest of body, and the last (empty) chunk when chunked
+ * @return RET_ERROR if any write to sink failed
+ ******************************************************************************/
+RetResult HttpBodyStream::finish()
+{
+	flush();
+
+	if(_chunked)
+		send((const uint8_t*)"0\r\n\r\n", 5);
+
+	return _failed ? RET_ERROR : RET_OK;
+}
+
+/******************************************************************************
+ * Body bytes written so far
+ ******************************************************************************/
+int HttpBodyStream::get_body_size()
+{
+	return _body_size;
+}
+
+/******************************************************************************
+ * Bytes passed to sink so far, incl. chunk framing
+ ******************************************************************************/
+int HttpBodyStream::get_bytes_sent()
+{
+	return _bytes_sent;
+}
+
+/******************************************************************************
+ * Pass on collected piece
+ ******************************************************************************/
+RetResult HttpBodyStream::flush()
+{
+	if(_buff_size == 0)
+		return RET_OK;
+
+	if(_chunked)
+	{
+		char size_line[12];
+		snprintf(size_line, sizeof(size_line), "%X\r\n", _buff_size);
+
+		send((const uint8_t*)size_line, strlen(size_line));
+		send(_buff, _buff_size);
+		send((const uint8_t*)"\r\n", 2);
+	}
+	else
+	{
+		send(_buff, _buff_size);
+	}
+
+	_buff_size = 0;
+
+	return _failed ? RET_ERROR : RET_OK;
+}
+
+RetResult HttpBodyStream::send(const uint8_t *data, int size)
+{
+	if(_failed || _out->write(data, size) != RET_OK)
+	{
+		_failed = true;
+		return RET_ERROR;
+	}
+
+	_bytes_sent += size;
+
+	return RET_OK;
+}
@@ -1,9 +1,30 @@
 #include "http_request.h"
 #include "common.h"
 #include "wifi_modem.h"
+#include "http_session.h"
 
 // TODO: Comment everything
 
+/******************************************************************************
+* Sink writing a streamed body to the HTTP client
+******************************************************************************/
+class HttpClientSink : public HttpBodySink
+{
+public:
+	HttpClientSink(HttpClient *client) : _client(client)
+	{}
+
+	using HttpBodySink::write;
+
+	RetResult write(const uint8_t *data, int size)
+	{
+		return _client->write(data, size) == (size_t)size ? RET_OK : RET_ERROR;
+	}
+
+private:
+	HttpClient *_client;
+};
+
 /******************************************************************************
 * Constructor
 * @param modem TinyGsm object
@@ -23,7 +44,7 @@ HttpRequest::HttpRequest(TinyGsm *modem, const char *server)
 ******************************************************************************/
 RetResult HttpRequest::get(const char *path, char *resp_buff, int resp_buff_size)
 {
-	return req(METHOD_GET, path, resp_buff, resp_buff_size, NULL, 0, NULL);
+	return req(METHOD_GET, path, resp_buff, resp_buff_size, NULL, 0, NULL, NULL);
 }
 
 /******************************************************************************
@@ -38,24 +59,32 @@ RetResult HttpRequest::get(const char *path, char *resp_buff, int resp_buff_size
 RetResult HttpRequest::post(const char *path, const unsigned char *body, int body_len, char *content_type, 
 	char *resp_buff, int resp_buff_size)
 {
-	return req(METHOD_POST, path, resp_buff, resp_buff_size, body, body_len, content_type);
+	return req(METHOD_POST, path, resp_buff, resp_buff_size, body, body_len, NULL, content_type);
+}
+
+/******************************************************************************
+* Execute POST request with a streamed body
+* Sent with Content-Length if the body knows its length, chunked otherwise.
+* @param path URL path
+* @param body Body writer, its write() is called once
+* @param content_type Content-type header
+* @param resp_buff Buffer for response. Can be NULL
+* @param resp_buff_size Response buffer size. 0 if no buffer
+******************************************************************************/
+RetResult HttpRequest::post(const char *path, HttpBodyWriter *body, const char *content_type,
+	char *resp_buff, int resp_buff_size)
+{
+	return req(METHOD_POST, path, resp_buff, resp_buff_size, NULL, 0, body, content_type);
 }
 
 /******************************************************************************
 * Execute a request
+* Goes over the open HttpSession to the server if any, over a connection of
+* its own otherwise.
 ******************************************************************************/
 RetResult HttpRequest::req(Method method, const char *path, char *resp_buff, int resp_buff_size,
-	const unsigned char *body, int body_len, char *content_type)
+	const unsigned char *body, int body_len, HttpBodyWriter *body_writer, const char *content_type)
 {
-	// Use WiFi client in WiFi mode
-	#if WIFI_DATA_SUBMISSION
-		WiFiClient client;
-	#else
-		TinyGsmClient client(*_modem);
-	#endif
-
-    HttpClient http_client(client, _server, _port);
-
 	debug_print(F("Request to: "));
 	debug_print(_server);
 	debug_println(path);
@@ -68,18 +97,57 @@ RetResult HttpRequest::req(Method method, const char *path, char *resp_buff, int
         return RET_ERROR;
     }
 
-	http_client.setTimeout(HTTP_CLIENT_STREAM_TIMEOUT);
-	http_client.setHttpResponseTimeout(HTTL_CLIENT_REPONSE_TIMEOUT);
+	if(HttpSession::is_open_for(_server, _port))
+	{
+		RetResult ret = exchange(HttpSession::begin_request(), method, path, resp_buff, resp_buff_size,
+			body, body_len, body_writer, content_type);
+
+		// Connection is kept open for next request
+		HttpSession::end_request(ret == RET_OK);
+
+		return ret;
+	}
+
+	// Use WiFi client in WiFi mode
+	#if WIFI_DATA_SUBMISSION
+		WiFiClient client;
+	#else
+		TinyGsmClient client(*_modem);
+	#endif
+
+    HttpClient http_client(client, _server, _port);
+
+	RetResult ret = exchange(&http_client, method, path, resp_buff, resp_buff_size, body, body_len,
+		body_writer, content_type);
+
+    http_client.stop();
+
+	return ret;
+}
+
+/******************************************************************************
+* Send a request and read its response over a client
+******************************************************************************/
+RetResult HttpRequest::exchange(HttpClient *http_client, Method method, const char *path, char *resp_buff,
+	int resp_buff_size, const unsigned char *body, int body_len, HttpBodyWriter *body_writer,
+	const char *content_type)
+{
+	http_client->setTimeout(HTTP_CLIENT_STREAM_TIMEOUT);
+	http_client->setHttpResponseTimeout(HTTL_CLIENT_REPONSE_TIMEOUT);
 
 	int ret = 0;
 
 	if(method == METHOD_GET)
 	{
-		ret = http_client.get(path);
+		ret = http_client->get(path);
+	}
+	else if(method == METHOD_POST && body_writer != NULL)
+	{
+		ret = post_streamed(http_client, path, body_writer, content_type);
 	}
 	else if(method == METHOD_POST)
 	{
-		ret = http_client.post(path, content_type, body_len, body);
+		ret = http_client->post(path, content_type, body_len, body);
 	}
 
     if(ret != 0)
@@ -89,7 +157,7 @@ RetResult HttpRequest::req(Method method, const char *path, char *resp_buff, int
         return RET_ERROR;
     }
 
-    _response_code = http_client.responseStatusCode();
+    _response_code = http_client->responseStatusCode();
     debug_print(F("Response code: "));
     debug_println(_response_code, DEC);
     if(!_response_code)
@@ -98,7 +166,7 @@ RetResult HttpRequest::req(Method method, const char *path, char *resp_buff, int
         return RET_ERROR;
     }
 
-    int content_length = http_client.contentLength();
+    int content_length = http_client->contentLength();
 
     debug_print(F("Content length: "));
     debug_println(content_length, DEC);
@@ -110,7 +178,7 @@ RetResult HttpRequest::req(Method method, const char *path, char *resp_buff, int
 		// If header not set, read until stream has no more bytes or buffer is full
 		int bytes_to_read = content_length > 0 && content_length < resp_buff_size ? content_length : resp_buff_size;
 
-		bytes_read = http_client.readBytes(resp_buff, bytes_to_read);
+		bytes_read = http_client->readBytes(resp_buff, bytes_to_read);
 
 		if(content_length > 0 && bytes_read != bytes_to_read)
 		{
@@ -130,13 +198,57 @@ RetResult HttpRequest::req(Method method, const char *path, char *resp_buff, int
 		}
 	}
 
-    http_client.stop();
-
     _response_length = bytes_read;
     
     return RET_OK;
 }
 
+/******************************************************************************
+* Send a POST request with a streamed body, the body is passed to the client
+* in HTTP_BODY_CHUNK_SIZE pieces
+* @return 0 on success, HttpClient error otherwise
+******************************************************************************/
+int HttpRequest::post_streamed(HttpClient *http_client, const char *path, HttpBodyWriter *body,
+	const char *content_type)
+{
+	int length = body->get_length();
+
+	http_client->beginRequest();
+
+	int ret = http_client->post(path);
+	if(ret != 0)
+		return ret;
+
+	http_client->sendHeader(HTTP_HEADER_CONTENT_TYPE, content_type);
+
+	if(body->get_content_encoding() != NULL)
+		http_client->sendHeader("Content-Encoding", body->get_content_encoding());
+
+	if(length >= 0)
+		http_client->sendHeader(HTTP_HEADER_CONTENT_LENGTH, length);
+	else
+		http_client->sendHeader("Transfer-Encoding", "chunked");
+
+	http_client->beginBody();
+
+	HttpClientSink client_sink(http_client);
+	HttpBodyStream stream(&client_sink, length < 0);
+
+	if(body->write(&stream) != RET_OK || stream.finish() != RET_OK ||
+		(length >= 0 && stream.get_body_size() != length))
+	{
+		debug_println(F("Could not write request body."));
+		return HTTP_ERROR_API;
+	}
+
+	debug_print(F("Body bytes: "));
+	debug_println(stream.get_body_size(), DEC);
+
+	http_client->endRequest();
+
+	return 0;
+}
+
 /******************************************************************************
 * Get response code after request has been executed
 ******************************************************************************/
@@ -0,0 +1,230 @@
+#include "http_session.h"
+#include "http_request.h"
+#include "common.h"
+#include "gsm.h"
+#include "log.h"
+#include "wifi_modem.h"
+#include <string.h>
+
+namespace HttpSession
+{
+	//
+	// Private vars
+	//
+	#if WIFI_DATA_SUBMISSION
+		typedef WiFiClient SessionClient;
+	#else
+		typedef TinyGsmClient SessionClient;
+	#endif
+
+	/** Requests sent over session and connections opened for them */
+	int _requests = 0;
+	int _connects = 0;
+
+	/******************************************************************************
+	 * Connection of the session, a modem socket with an HTTP client over it
+	 ******************************************************************************/
+	class SessionSocket : public UploadSocket
+	{
+	public:
+		SessionSocket(int mux, const char *server, int port)
+		{
+			#if WIFI_DATA_SUBMISSION
+				_client = new WiFiClient();
+			#else
+				_client = new TinyGsmClient(*GSM::get_modem(), mux);
+			#endif
+
+			_http_client = new HttpClient(*_client, server, port);
+			_http_client->connectionKeepAlive();
+		}
+
+		~SessionSocket()
+		{
+			_http_client->stop();
+
+			delete _http_client;
+			delete _client;
+		}
+
+		/******************************************************************************
+		 * Get client for a request, HttpClient reconnects by itself if the
+		 * connection is closed (first request, after a failure or closed by server)
+		 ******************************************************************************/
+		HttpClient* begin_request()
+		{
+			if(!_client->connected())
+				_connects++;
+
+			_requests++;
+
+			_http_client->setTimeout(HTTP_CLIENT_STREAM_TIMEOUT);
+			_http_client->setHttpResponseTimeout(HTTL_CLIENT_REPONSE_TIMEOUT);
+
+			return _http_client;
+		}
+
+		/******************************************************************************
+		 * Connection of a failed request may be left mid-request or broken, it is
+		 * dropped so the next request starts a clean one
+		 ******************************************************************************/
+		void drop()
+		{
+			debug_println(F("Request failed, dropping session connection."));
+			_http_client->stop();
+		}
+
+		/******************************************************************************
+		 * Send a request, without waiting for its response
+		 ******************************************************************************/
+		RetResult send(const char *path, HttpBodyWriter *body, const char *content_type)
+		{
+			int ret = HttpRequest::post_streamed(begin_request(), path, body, content_type);
+
+			if(ret != 0)
+			{
+				debug_print(F("Could not send request. Error: "));
+				debug_println(ret, DEC);
+				drop();
+				return RET_ERROR;
+			}
+
+			return RET_OK;
+		}
+
+		/******************************************************************************
+		 * Read response of request sent. Its body is skipped, the next request
+		 * starts after it.
+		 ******************************************************************************/
+		int read_response()
+		{
+			int response_code = _http_client->responseStatusCode();
+
+			if(response_code <= 0)
+			{
+				drop();
+				return 0;
+			}
+
+			int content_length = _http_client->contentLength();
+			char c = 0;
+
+			while(content_length-- > 0 && _http_client->readBytes(&c, 1) == 1)
+				;
+
+			return response_code;
+		}
+
+	private:
+		SessionClient *_client = NULL;
+		HttpClient *_http_client = NULL;
+	};
+
+	/** Sockets of session, NULL when no session open */
+	SessionSocket *_sockets[UPLOAD_PIPELINE_MAX_SOCKETS] = {NULL};
+	int _socket_count = 0;
+
+	char _server[URL_HOST_BUFFER_SIZE] = "";
+	int _port = 0;
+
+	/******************************************************************************
+	 * Open a session to a server. Connections are opened by first requests.
+	 * A session already open is closed.
+	 ******************************************************************************/
+	RetResult open(const char *server, int port)
+	{
+		close();
+
+		if(strlen(server) >= sizeof(_server))
+		{
+			debug_println_e(F("Session server name too long."));
+			return RET_ERROR;
+		}
+
+		strncpy(_server, server, sizeof(_server));
+		_port = port;
+		_requests = 0;
+		_connects = 0;
+
+		_socket_count = UPLOAD_PIPELINE_SOCKETS;
+		if(_socket_count > UPLOAD_PIPELINE_MAX_SOCKETS)
+			_socket_count = UPLOAD_PIPELINE_MAX_SOCKETS;
+
+		for(int i = 0; i < _socket_count; i++)
+			_sockets[i] = new SessionSocket(HTTP_SESSION_FIRST_MUX + i, _server, _port);
+
+		debug_print(F("HTTP session opened to: "));
+		debug_println(_server);
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * Close connections and session, requests open their own connections again
+	 ******************************************************************************/
+	void close()
+	{
+		if(_socket_count == 0)
+			return;
+
+		for(int i = 0; i < _socket_count; i++)
+		{
+			delete _sockets[i];
+			_sockets[i] = NULL;
+		}
+
+		_socket_count = 0;
+
+		debug_print(F("HTTP session closed. Requests: "));
+		debug_print(_requests, DEC);
+		debug_print(F(" - Connections: "));
+		debug_println(_connects, DEC);
+
+		Log::log(Log::HTTP_SESSION_CLOSED, _requests, _connects);
+	}
+
+	/******************************************************************************
+	 * Check if requests to a server and port go over the session
+	 ******************************************************************************/
+	bool is_open_for(const char *server, int port)
+	{
+		return _socket_count > 0 && port == _port && strcmp(server, _server) == 0;
+	}
+
+	/******************************************************************************
+	 * Get client for a request, over the session's first connection
+	 * Must be followed by end_request().
+	 ******************************************************************************/
+	HttpClient* begin_request()
+	{
+		if(_socket_count == 0)
+			return NULL;
+
+		return _sockets[0]->begin_request();
+	}
+
+	/******************************************************************************
+	 * Finish a request. Connection of a failed request is dropped.
+	 ******************************************************************************/
+	void end_request(bool success)
+	{
+		if(!success && _socket_count > 0)
+			_sockets[0]->drop();
+	}
+
+	/******************************************************************************
+	 * Get sockets of session for pipelined uploads
+	 * @param sockets Array sockets are returned in
+	 * @param max_sockets Max sockets to return
+	 * @return Sockets returned, 0 if no session open
+	 ******************************************************************************/
+	int get_upload_sockets(UploadSocket **sockets, int max_sockets)
+	{
+		int count = _socket_count < max_sockets ? _socket_count : max_sockets;
+
+		for(int i = 0; i < count; i++)
+			sockets[i] = _sockets[i];
+
+		return count;
+	}
+}
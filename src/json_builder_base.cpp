@@ -19,6 +19,70 @@ JsonBuilderBase<TStruct, TDocSize>::JsonBuilderBase()
     reset();
 }
 
+/******************************************************************************
+ * Add an entry described by a schema: timestamp (ms) and the values of
+ * fields that have a key. Floats are rounded to the decimals of their field,
+ * bools are sent as ints. Fields flagged FLAG_ZERO_GROUP are left out when
+ * they are all zero.
+ * @param timestamp_key Key of entry timestamp, first field of schema
+ *****************************************************************************/
+template <typename TStruct, int TDocSize>
+RetResult JsonBuilderBase<TStruct, TDocSize>::add_schema_entry(const TStruct *entry,
+	const EntrySchema::Field *fields, int field_count, const char *timestamp_key)
+{
+	JsonObject json_entry = _root_array.createNestedObject();
+
+	json_entry[timestamp_key] = (long long)EntrySchema::get_value(&fields[0], entry) * 1000;
+	JsonObject values = json_entry.createNestedObject("values");
+
+	bool skip_zero_group = EntrySchema::is_zero_group_empty(fields, field_count, entry);
+	const char *last_key = NULL;
+
+	for(int i = 0; i < field_count; i++)
+	{
+		const EntrySchema::Field *field = &fields[i];
+
+		if(field->key == NULL || (skip_zero_group && (field->flags & EntrySchema::FLAG_ZERO_GROUP)))
+			continue;
+
+		double value = EntrySchema::get_value(field, entry);
+
+		switch(field->type)
+		{
+		case EntrySchema::TYPE_FLOAT:
+			if(field->decimals == EntrySchema::DECIMALS_ALL)
+			{
+				values[field->key] = value;
+			}
+			else
+			{
+				double scale = EntrySchema::decimals_scale(field);
+				values[field->key] = round(value * scale) / scale;
+			}
+			break;
+
+		case EntrySchema::TYPE_BOOL:
+			values[field->key] = (int)value;
+			break;
+
+		default:
+			values[field->key] = (long long)value;
+			break;
+		}
+
+		last_key = field->key;
+	}
+
+	// If last key didn't fit into object, doc is full
+	if(last_key != NULL && !values.containsKey(last_key))
+	{
+		debug_println_e(F("Could not add entry to JSON."));
+		return RET_ERROR;
+	}
+
+	return RET_OK;
+}
+
 /******************************************************************************
  * Build and write output json to buffer
  *****************************************************************************/
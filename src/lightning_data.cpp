@@ -2,10 +2,22 @@
 
 namespace LightningData
 {
+	/** Schema of entries. Time of strike is also sent as a value. */
+	constexpr EntrySchema::Field SCHEMA[] = {
+		ENTRY_SCHEMA_FIELD(Entry, timestamp, LIGHTNING_DATA_KEY_TIMESTAMP, "Timestamp",
+			0, FIELD_DELTA2, EntrySchema::FLAG_NONE),
+		ENTRY_SCHEMA_FIELD(Entry, distance, LIGHTNING_DATA_KEY_DISTANCE, "Distance (km)",
+			0, FIELD_DELTA, EntrySchema::FLAG_NONE),
+		ENTRY_SCHEMA_FIELD(Entry, energy, LIGHTNING_DATA_KEY_ENERGY, "Energy",
+			0, FIELD_DELTA, EntrySchema::FLAG_NONE)
+	};
+	ENTRY_SCHEMA_CHECK(Entry, SCHEMA);
+
 	/** 
 	 * Store for lIGHTNING sensor data
 	 */
-    DataStore<LightningData::Entry> store(LIGHTNING_DATA_PATH, LIGHTNING_DATA_ENTRIES_PER_SUBMIT_REQ);
+    DataStore<LightningData::Entry> store(LIGHTNING_DATA_PATH, LIGHTNING_DATA_ENTRIES_PER_SUBMIT_REQ,
+        EntrySchema::schema_id(SCHEMA, ENTRY_SCHEMA_FIELD_COUNT(SCHEMA)));
 
     /******************************************************************************
     * Add Lightning data to tore
@@ -28,19 +40,21 @@ namespace LightningData
         return &store;
     }
 
+    /******************************************************************************
+    * Get entry schema
+    ******************************************************************************/
+    const EntrySchema::Field* get_schema(int *field_count)
+    {
+        *field_count = ENTRY_SCHEMA_FIELD_COUNT(SCHEMA);
+        return SCHEMA;
+    }
+
     /********************************************************************************
 	 * Print all data from a Lightning data strcut
 	 * @param data Lightning data structure
 	 *******************************************************************************/
 	void print(const LightningData::Entry *data)
 	{
-		debug_print(F("Timestamp: "));
-		debug_println(data->timestamp);
-
-		debug_print(F("Distance (km): "));
-		debug_println(data->distance);
-
-		debug_print(F("Energy: "));
-		debug_println(data->energy);
+		EntrySchema::print(SCHEMA, ENTRY_SCHEMA_FIELD_COUNT(SCHEMA), data);
 	}
 } // namespace LightningData
@@ -0,0 +1,14 @@
+#include "lightning_data_cbor_builder.h"
+#include "common.h"
+
+/******************************************************************************
+ * Add packet to request
+ * Values are generated from the entry schema, see LightningData::get_schema()
+ *****************************************************************************/
+RetResult LightningDataCborBuilder::add(const LightningData::Entry *entry)
+{
+	int field_count = 0;
+	const EntrySchema::Field *fields = LightningData::get_schema(&field_count);
+
+	return add_schema_entry(entry, fields, field_count);
+}
@@ -1,9 +1,11 @@
-#include "SPIFFS.h"
+#include "storage.h"
 #include "log.h"
 #include "const.h"
 #include "rtc.h"
 #include "utils.h"
 #include "common.h"
+#include "esp_attr.h"
+#include "rom/rtc.h"
 
 namespace Log
 {
@@ -19,14 +21,86 @@ namespace Log
 	 * This works only if RTC works and tracks time correctly and there are no logs stored
 	 * with a future timestamp because RTC was reset.
 	 */
-	uint32_t _last_log_tstamp = 0;
-	int _last_log_tstamp_counter = 0;
+	RTC_DATA_ATTR uint32_t _last_log_tstamp = 0;
+	RTC_DATA_ATTR int _last_log_tstamp_counter = 0;
 
 	/**
 	 * When disabled, all logs are ignored until enabled again.
 	 */
 	bool _enabled = true;
 
+	/**
+	 * Log entries not yet written to the store, oldest first (ring buffer)
+	 * Logs are written to flash in batches instead of one append per log.
+	 */
+	struct Stage
+	{
+		/** LOG_STAGE_MAGIC when initialized */
+		uint32_t magic;
+
+		/** Index of oldest entry */
+		uint16_t head;
+
+		/** Entries in stage */
+		uint16_t count;
+
+		/** Entries overwritten because stage was full, logged on next flush */
+		uint32_t overflowed;
+
+		Entry entries[LOG_STAGE_CAPACITY];
+
+		/** CRC32 of all of the above */
+		uint32_t crc32;
+	};
+
+	/**
+	 * Stage is kept in RTC memory so it survives sleep. RTC_DATA_ATTR vars are
+	 * reloaded by the bootloader on every reset other than deep sleep wake up,
+	 * noinit ones are not, so the stage survives resets too. Checked by begin().
+	 */
+	RTC_NOINIT_ATTR Stage _stage;
+
+	/** Stage has been checked since boot */
+	bool _stage_ready = false;
+
+	/** Stage is being written to the store */
+	bool _flushing = false;
+
+	void stage_entry(const Entry *entry);
+	uint32_t stage_crc();
+	uint32_t get_stage_age_sec();
+	uint32_t get_flushed_age_sec();
+
+	/******************************************************************************
+	* Check log stage in RTC memory, keep its entries if valid. If it was lost
+	* (eg. brown-out), log it.
+	* Called on boot, once storage is available.
+	******************************************************************************/
+	void begin()
+	{
+		_stage_ready = true;
+
+		if(_stage.magic == LOG_STAGE_MAGIC && _stage.crc32 == stage_crc() &&
+			_stage.head < LOG_STAGE_CAPACITY && _stage.count <= LOG_STAGE_CAPACITY)
+		{
+			debug_print(F("Staged log entries: "));
+			debug_println(_stage.count, DEC);
+			return;
+		}
+
+		memset(&_stage, 0, sizeof(_stage));
+		_stage.magic = LOG_STAGE_MAGIC;
+		_stage.crc32 = stage_crc();
+
+		// RTC memory is random after power on, there is nothing to report
+		RESET_REASON reason = rtc_get_reset_reason(0);
+		if(reason != POWERON_RESET)
+		{
+			debug_println(F("Log stage lost."));
+			log(LOG_STAGE_LOST, reason, get_flushed_age_sec());
+		}
+	}
+
 	/******************************************************************************
 	* Create log entry with current timestamp.
 	* @param code Error code
@@ -77,12 +151,45 @@ namespace Log
 			return RET_ERROR;
 		}
 
-		store.add(&entry);
-		store.commit();
+		if(!_stage_ready)
+			begin();
+
+		stage_entry(&entry);
+
+		if(!_flushing &&
+			(_stage.count >= LOG_STAGE_FLUSH_ENTRIES || get_stage_age_sec() >= LOG_STAGE_MAX_AGE_SEC))
+		{
+			commit();
+		}
 
 		return RET_OK;
 	}
 
+	/******************************************************************************
+	* Add entry to stage. When full, oldest entry is overwritten.
+	******************************************************************************/
+	void stage_entry(const Entry *entry)
+	{
+		if(_stage.count >= LOG_STAGE_CAPACITY)
+		{
+			_stage.overflowed++;
+
+			// Entries being flushed must stay where they are, drop the new one
+			if(_flushing)
+			{
+				_stage.crc32 = stage_crc();
+				return;
+			}
+
+			_stage.head = (_stage.head + 1) % LOG_STAGE_CAPACITY;
+			_stage.count--;
+		}
+
+		_stage.entries[(_stage.head + _stage.count) % LOG_STAGE_CAPACITY] = *entry;
+		_stage.count++;
+		_stage.crc32 = stage_crc();
+	}
+
 	/******************************************************************************
 	* Get pointer to store (for use with reader)
 	******************************************************************************/
@@ -92,11 +199,109 @@ namespace Log
 	}
 
 	/******************************************************************************
-	* Commit log data store to flash
+	* Write staged entries to the store
+	* Entries are written a store buffer at a time and removed from the stage
+	* once committed, so a failure leaves the rest staged for next time.
 	******************************************************************************/
 	RetResult commit()
 	{
-		return store.commit();
+		if(!_stage_ready)
+			begin();
+
+		if(_flushing)
+			return RET_ERROR;
+
+		_flushing = true;
+
+		RetResult ret = RET_OK;
+
+		while(_stage.count > 0)
+		{
+			int chunk = _stage.count < DATA_STORE_BUFFER_ELEMENTS ? _stage.count : DATA_STORE_BUFFER_ELEMENTS;
+
+			for(int i = 0; i < chunk; i++)
+				store.add(&_stage.entries[(_stage.head + i) % LOG_STAGE_CAPACITY]);
+
+			if(store.commit() != RET_OK)
+			{
+				debug_println(F("Could not write staged logs."));
+				store.clear_buffer();
+				ret = RET_ERROR;
+				break;
+			}
+
+			_stage.head = (_stage.head + chunk) % LOG_STAGE_CAPACITY;
+			_stage.count -= chunk;
+			_stage.crc32 = stage_crc();
+		}
+
+		_flushing = false;
+
+		if(ret == RET_OK && _stage.overflowed > 0)
+		{
+			uint32_t overflowed = _stage.overflowed;
+			_stage.overflowed = 0;
+			_stage.crc32 = stage_crc();
+
+			log(LOG_STAGE_OVERFLOW, overflowed);
+		}
+
+		return ret;
+	}
+
+	/******************************************************************************
+	* Number of entries not yet written to the store
+	******************************************************************************/
+	int get_staged_count()
+	{
+		if(!_stage_ready)
+			begin();
+
+		return _stage.count;
+	}
+
+	/******************************************************************************
+	* CRC of stage, excl. the CRC itself
+	******************************************************************************/
+	uint32_t stage_crc()
+	{
+		return Utils::crc32((uint8_t*)&_stage, sizeof(_stage) - sizeof(_stage.crc32));
+	}
+
+	/******************************************************************************
+	* Seconds since oldest staged entry was logged, 0 if stage empty
+	******************************************************************************/
+	uint32_t get_stage_age_sec()
+	{
+		if(_stage.count == 0)
+			return 0;
+
+		uint32_t oldest = _stage.entries[_stage.head].timestamp / 1000;
+		uint32_t now = RTC::get_timestamp();
+
+		// Clock went back, flush instead of waiting for it to catch up
+		return now >= oldest ? now - oldest : LOG_STAGE_MAX_AGE_SEC;
+	}
+
+	/******************************************************************************
+	* Seconds since newest log entry in flash, 0 if unknown
+	* Bounds the time range of entries lost with the stage.
+	******************************************************************************/
+	uint32_t get_flushed_age_sec()
+	{
+		DataStoreManifest *manifest = store.get_manifest();
+		DataStoreManifest::Record record;
+
+		if(store.load_manifest() != RET_OK ||
+			manifest->get_record(manifest->get_current_record(), &record) != RET_OK || record.entries == 0)
+		{
+			return 0;
+		}
+
+		uint32_t newest = record.max_tstamp / 1000;
+		uint32_t now = RTC::get_timestamp();
+
+		return now > newest ? now - newest : 0;
 	}
 
 	/********************************************************************************
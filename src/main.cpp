@@ -6,6 +6,7 @@
 #include "call_home.h"
 #include "const.h"
 #include "flash.h"
+#include "data_log.h"
 #include "globals.h"
 #include "water_sensor_data.h"
 #include "utils.h"
@@ -21,7 +22,7 @@
 #include "device_config.h"
 #include "battery.h"
 #include "int_env_sensor.h"
-#include <SPIFFS.h>
+#include "storage.h"
 #include "ota.h"
 #include "atmos41.h"
 #include "rom/rtc.h"
@@ -52,12 +53,67 @@
 #include "water_presence.h"
 #include "aquatroll.h"
 
+/******************************************************************************
+ * Setup after waking up from deep sleep
+ * Only inits what is needed to handle the wake up reasons. Config mode check,
+ * flash listing, boot logs, self tests, SIM check and time sync were done on
+ * the full boot before the first deep sleep and are skipped. Sleep schedule
+ * and module state are kept in RTC memory.
+ *****************************************************************************/
+void resume_setup()
+{
+	Utils::serial_style(STYLE_BLUE);
+	Utils::print_separator(F("RESUMING FROM DEEP SLEEP"));
+	Utils::serial_style(STYLE_RESET);
+
+	DeviceConfig::init();
+
+	Wire.begin(PIN_I2C1_SDA, PIN_I2C1_SCL, 100000);
+	RTC::init();
+
+	#ifdef TCALL_H
+		Utils::ip5306_set_power_boost_state(false);
+	#endif
+
+	IntEnvSensor::init();
+	Battery::init();
+	BatteryGauge::init();
+	SolarMonitor::init();
+	Flash::mount();
+	DataLog::init();
+	Log::begin();
+	GSM::init();
+	WaterSensors::init();
+	WaterLevel::init();
+	WaterPresence::init();
+	Atmos41::init();
+
+	if(FO_SOURCE == FO_SOURCE_SNIFFER)
+		FoSniffer::init();
+	else if(FO_SOURCE == FO_SOURCE_UART)
+		FoUart::init();
+
+	// Wake up source is reset with the device
+	if(FLAGS.LIGHTNING_SENSOR_ENABLED)
+		Lightning::on();
+
+	// Restore parked data and sync time, loop() handles wake up reasons next
+	SleepScheduler::resume();
+}
+
 /******************************************************************************
  * Setup
  *****************************************************************************/
 void setup() 
 {
 	Serial.begin(115200);
+
+	// Woke up from deep sleep, skip full boot
+	if(SleepScheduler::deep_sleep_wakeup())
+	{
+		resume_setup();
+		return;
+	}
 		
 	Utils::serial_style(STYLE_BLUE);
 	Utils::print_separator(F("BOOTING"));
@@ -190,6 +246,8 @@ void setup()
 	delay(100);
 	Flash::mount();
 	Flash::ls();
+	DataLog::init();
+	Log::begin();
 	GSM::init();
 	WaterSensors::init();
 	WaterLevel::init();
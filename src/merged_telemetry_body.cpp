@@ -0,0 +1,144 @@
+#include "merged_telemetry_body.h"
+#include "common.h"
+#include <stdio.h>
+
+/******************************************************************************
+ * Constructor
+ * @param streams Streams to merge, up to TELEMETRY_MAX_MERGED_STREAMS
+ * @param max_bytes Body bytes of a request
+ *****************************************************************************/
+MergedTelemetryBody::MergedTelemetryBody(TelemetryStream **streams, int stream_count, int max_bytes)
+{
+	if(stream_count > TELEMETRY_MAX_MERGED_STREAMS)
+		stream_count = TELEMETRY_MAX_MERGED_STREAMS;
+
+	for(int i = 0; i < stream_count; i++)
+		_streams[i] = streams[i];
+
+	_stream_count = stream_count;
+	_max_bytes = max_bytes;
+}
+
+/******************************************************************************
+ * Default constructor (private)
+ *****************************************************************************/
+MergedTelemetryBody::MergedTelemetryBody()
+{}
+
+/******************************************************************************
+ * Start next request
+ * @return False if no stream has entries left, nothing to send
+ *****************************************************************************/
+bool MergedTelemetryBody::begin()
+{
+	uint64_t tstamp = 0;
+
+	_body_size = 0;
+	_entry_count = 0;
+	_object_count = 0;
+
+	return next_tstamp(&tstamp);
+}
+
+/******************************************************************************
+ * Write request JSON, an object per timestamp
+ * Must be called once per begin().
+ *****************************************************************************/
+RetResult MergedTelemetryBody::write(HttpBodySink *sink)
+{
+	char head[48];
+	uint64_t tstamp = 0;
+
+	_sink = sink;
+
+	if(write("[") != RET_OK)
+		return RET_ERROR;
+
+	while(_body_size < _max_bytes && next_tstamp(&tstamp))
+	{
+		snprintf(head, sizeof(head), "%s{\"ts\":%llu,\"values\":{", _object_count > 0 ? "," : "",
+			(unsigned long long)tstamp);
+
+		if(write(head) != RET_OK)
+			return RET_ERROR;
+
+		bool first = true;
+
+		for(int i = 0; i < _stream_count; i++)
+		{
+			uint64_t stream_tstamp = 0;
+
+			if(!_streams[i]->peek(&stream_tstamp) || stream_tstamp != tstamp)
+				continue;
+
+			if((!first && write(",") != RET_OK) || _streams[i]->write_values(this) != RET_OK)
+				return RET_ERROR;
+
+			first = false;
+			_entry_count++;
+		}
+
+		if(write("}}") != RET_OK)
+			return RET_ERROR;
+
+		_object_count++;
+	}
+
+	return write("]");
+}
+
+/******************************************************************************
+ * Length is not known before writing
+ *****************************************************************************/
+int MergedTelemetryBody::get_length()
+{
+	return -1;
+}
+
+/******************************************************************************
+ * Pass body to sink, counting its bytes
+ *****************************************************************************/
+RetResult MergedTelemetryBody::write(const uint8_t *data, int size)
+{
+	_body_size += size;
+
+	return _sink->write(data, size);
+}
+
+/******************************************************************************
+ * Entries written to request
+ *****************************************************************************/
+int MergedTelemetryBody::get_entry_count()
+{
+	return _entry_count;
+}
+
+/******************************************************************************
+ * Objects (distinct timestamps) written to request
+ *****************************************************************************/
+int MergedTelemetryBody::get_object_count()
+{
+	return _object_count;
+}
+
+/******************************************************************************
+ * Get oldest timestamp of the streams' next entries
+ * @return False if no stream has entries left
+ *****************************************************************************/
+bool MergedTelemetryBody::next_tstamp(uint64_t *tstamp)
+{
+	bool found = false;
+
+	for(int i = 0; i < _stream_count; i++)
+	{
+		uint64_t stream_tstamp = 0;
+
+		if(_streams[i]->peek(&stream_tstamp) && (!found || stream_tstamp < *tstamp))
+		{
+			*tstamp = stream_tstamp;
+			found = true;
+		}
+	}
+
+	return found;
+}
@@ -12,6 +12,12 @@
 #include "device_config.h"
 #include "flash.h"
 #include "common.h"
+#include "water_sensor_data.h"
+#include "atmos41_data.h"
+#include "soil_moisture_data.h"
+#include "lightning_data.h"
+#include "fo_data.h"
+#include "sdi12_log.h"
 
 namespace OTA
 {
@@ -290,6 +296,46 @@ namespace OTA
 		return RET_OK;
 	}
 
+	/******************************************************************************
+	 * Upgrade files of a store to the current file format
+	 *****************************************************************************/
+	template <typename TStore>
+	void upgrade_store(TStore *store, int *files_upgraded, int *files_dropped)
+	{
+		int store_files_upgraded = 0, store_files_dropped = 0;
+
+		if(store->upgrade_files(&store_files_upgraded, &store_files_dropped) != RET_OK)
+		{
+			debug_print_w(F("Could not upgrade store files: "));
+			debug_println(store->get_dir_path());
+		}
+
+		*files_upgraded += store_files_upgraded;
+		*files_dropped += store_files_dropped;
+	}
+
+	/******************************************************************************
+	 * Rewrite store files written by older firmware with a file header, and
+	 * flag files of entries this firmware can't read, so readers skip them
+	 * without opening them. Done once the new firmware passed its self test,
+	 * files are left as they are for a rollback.
+	 *****************************************************************************/
+	void upgrade_stores()
+	{
+		int files_upgraded = 0, files_dropped = 0;
+
+		upgrade_store(WaterSensorData::get_store(), &files_upgraded, &files_dropped);
+		upgrade_store(Atmos41Data::get_store(), &files_upgraded, &files_dropped);
+		upgrade_store(SoilMoistureData::get_store(), &files_upgraded, &files_dropped);
+		upgrade_store(FoData::get_store(), &files_upgraded, &files_dropped);
+		upgrade_store(LightningData::get_store(), &files_upgraded, &files_dropped);
+		upgrade_store(Log::get_store(), &files_upgraded, &files_dropped);
+		upgrade_store(SDI12Log::get_store(), &files_upgraded, &files_dropped);
+
+		if(files_upgraded > 0 || files_dropped > 0)
+			Log::log(Log::STORES_UPGRADED, files_upgraded, files_dropped);
+	}
+
 	/******************************************************************************
 	 * Ran on first boot after new OTA is flashed
 	 *****************************************************************************/
@@ -318,6 +364,8 @@ namespace OTA
 			}
 
 			Log::log(Log::OTA_SELF_TEST_PASSED);
+
+			upgrade_stores();
 		}
 		else
 		{
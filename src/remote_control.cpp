@@ -11,6 +11,7 @@
 #include "utils.h"
 #include "ota.h"
 #include "call_home.h"
+#include "data_store_manifest.h"
 #include "test_utils.h"
 #include "fo_sniffer.h"
 #include "rtc.h"
@@ -380,9 +381,10 @@ namespace RemoteControl
 
 			// TODO: Submit logs before formatting SPIFFS?
 
-			int bytes_before_format = SPIFFS.usedBytes();
+			int bytes_before_format = Storage::used_bytes();
 
-			if(SPIFFS.format())
+			DataStoreManifest::unload_all();
+			if(Storage::format())
 			{
 				debug_println(F("Format complete"));
 
@@ -0,0 +1,507 @@
+#include "ring_log.h"
+#include "const.h"
+#include "utils.h"
+#include "common.h"
+#include "flash.h"
+
+/******************************************************************************
+ * RingLog
+ * Region layout: N sectors, each starting with a SectorHeader followed by as
+ * many slots (SlotHeader + record) as fit. Sectors are written in ring order,
+ * every newly opened sector gets the next sequence number, so the newest
+ * sector (head) is the one with the highest seq and the sectors before it in
+ * ring order with consecutive seqs hold older data (the oldest is the tail).
+ *
+ * A slot is written with a single write. A slot whose header is erased is
+ * free; a written slot whose CRC doesn't match was torn by a reset and is
+ * skipped. Consuming a record only clears bits of its state byte. A sector is
+ * erased when the tail moves past it or when the head needs it (eviction).
+ ******************************************************************************/
+
+/******************************************************************************
+ * Constructor
+ * Call begin() before use.
+ ******************************************************************************/
+RingLog::RingLog()
+{}
+
+/******************************************************************************
+ * Attach to a region of flash and recover head/tail
+ * Sectors that don't belong to the ring (corrupt headers, different record
+ * size, not in sequence) are erased.
+ * @param flash Flash the region is on
+ * @param offset Region start, sector aligned
+ * @param size Region size, multiple of sector size, at least 2 sectors
+ * @param record_size Size of records stored
+ ******************************************************************************/
+RetResult RingLog::begin(RawFlash *flash, uint32_t offset, uint32_t size, uint16_t record_size)
+{
+	_ready = false;
+	memset(&_stats, 0, sizeof(_stats));
+
+	_flash = flash;
+	_offset = offset;
+	_sector_size = flash->get_sector_size();
+	_sector_count = size / _sector_size;
+	_record_size = record_size;
+	_slots_per_sector = (_sector_size - sizeof(SectorHeader)) / (sizeof(SlotHeader) + record_size);
+
+	if(offset % _sector_size != 0 || offset + size > flash->get_size() || _sector_count < 2 ||
+		record_size > RING_LOG_MAX_RECORD_SIZE || _slots_per_sector < 1)
+	{
+		debug_println(F("Invalid ring log region."));
+		return RET_ERROR;
+	}
+
+	//
+	// Find head (highest seq)
+	//
+	bool found = false;
+	SectorHeader header;
+
+	for(uint32_t i = 0; i < _sector_count; i++)
+	{
+		if(_flash->read(_offset + i * _sector_size, &header, sizeof(header)) != RET_OK)
+			return RET_ERROR;
+
+		if(header.magic != RING_LOG_SECTOR_MAGIC || header.crc32 != sector_header_crc(&header) ||
+			header.record_size != _record_size)
+		{
+			continue;
+		}
+
+		if(!found || header.seq > _head_seq)
+		{
+			found = true;
+			_head_seq = header.seq;
+			_head_sector = i;
+		}
+	}
+
+	if(!found)
+	{
+		// Empty (or foreign) region, start over
+		_head_seq = 0;
+		if(open_sector(0) != RET_OK)
+			return RET_ERROR;
+
+		_tail_sector = _tail_slot = 0;
+		_ready = true;
+		return RET_OK;
+	}
+
+	//
+	// Walk back from head while sectors are in sequence to find the tail.
+	// Anything else is stale and erased so it can't be mistaken for data later.
+	//
+	_tail_sector = _head_sector;
+	uint32_t expected_seq = _head_seq;
+
+	for(uint32_t i = 1; i < _sector_count; i++)
+	{
+		uint32_t prev = (_tail_sector + _sector_count - 1) % _sector_count;
+
+		if(_flash->read(_offset + prev * _sector_size, &header, sizeof(header)) != RET_OK)
+			return RET_ERROR;
+
+		if(header.magic != RING_LOG_SECTOR_MAGIC || header.crc32 != sector_header_crc(&header) ||
+			header.record_size != _record_size || header.seq != expected_seq - 1)
+		{
+			break;
+		}
+
+		_tail_sector = prev;
+		expected_seq--;
+	}
+
+	for(uint32_t s = next_sector(_head_sector); s != _tail_sector; s = next_sector(s))
+	{
+		uint32_t magic = 0;
+		if(_flash->read(_offset + s * _sector_size, &magic, sizeof(magic)) != RET_OK)
+			return RET_ERROR;
+
+		// Erased sectors don't need to be erased again
+		if(magic != 0xFFFFFFFF)
+		{
+			Flash::count_raw_erase();
+			_flash->erase_sector(_offset + s * _sector_size);
+			_stats.sectors_erased++;
+		}
+	}
+
+	//
+	// Head slot is the first free slot in head sector
+	//
+	SlotHeader slot_header;
+	for(_head_slot = 0; _head_slot < _slots_per_sector; _head_slot++)
+	{
+		if(!read_slot_header(_head_sector, _head_slot, &slot_header))
+			return RET_ERROR;
+
+		if(slot_header.state == SLOT_EMPTY && slot_header.crc32 == 0xFFFFFFFF)
+			break;
+	}
+
+	_tail_slot = 0;
+	_ready = true;
+
+	return recover_tail();
+}
+
+/******************************************************************************
+ * Check if begin() succeeded
+ ******************************************************************************/
+bool RingLog::is_ready() const
+{
+	return _ready;
+}
+
+/******************************************************************************
+ * Append a record at head. If the ring is full, the oldest sector is erased
+ * and its records are lost.
+ * @param record Record of record_size bytes
+ ******************************************************************************/
+RetResult RingLog::append(const void *record)
+{
+	if(!_ready)
+		return RET_ERROR;
+
+	if(_head_slot >= _slots_per_sector)
+	{
+		uint32_t next = next_sector(_head_sector);
+
+		// Ring full, evict oldest sector
+		if(next == _tail_sector)
+		{
+			Cursor cursor = {_tail_sector, _tail_slot};
+			SlotHeader header;
+
+			for(; cursor.slot < _slots_per_sector; cursor.slot++)
+			{
+				if(read_slot_header(cursor.sector, cursor.slot, &header) && header.state == SLOT_WRITTEN)
+					_stats.evicted++;
+			}
+
+			_tail_sector = next_sector(next);
+			_tail_slot = 0;
+		}
+
+		if(open_sector(next) != RET_OK)
+			return RET_ERROR;
+	}
+
+	// Header and record written at once, a reset in between leaves a bad CRC
+	uint8_t slot[sizeof(SlotHeader) + RING_LOG_MAX_RECORD_SIZE];
+	SlotHeader *header = (SlotHeader*)slot;
+
+	memset(header, 0xFF, sizeof(SlotHeader));
+	header->state = SLOT_WRITTEN;
+	header->crc32 = record_crc(record);
+	memcpy(slot + sizeof(SlotHeader), record, _record_size);
+
+	Flash::count_raw_write(sizeof(SlotHeader) + _record_size);
+	if(_flash->write(slot_addr(_head_sector, _head_slot), slot, sizeof(SlotHeader) + _record_size) != RET_OK)
+	{
+		debug_println(F("Could not write ring log slot."));
+
+		// Slot may be partially written, don't reuse it
+		_head_slot++;
+		return RET_ERROR;
+	}
+
+	_head_slot++;
+	_stats.appended++;
+
+	return RET_OK;
+}
+
+/******************************************************************************
+ * Get position of oldest record, to start reading from
+ ******************************************************************************/
+void RingLog::get_tail(Cursor *cursor) const
+{
+	cursor->sector = _tail_sector;
+	cursor->slot = _tail_slot;
+}
+
+/******************************************************************************
+ * Read next valid record
+ * Consumed and torn slots are skipped.
+ * @param cursor Position to read from, advanced past the record read
+ * @param record Buffer of record_size bytes
+ * @param record_pos If not NULL, set to position of the record read
+ * @return False when head reached
+ ******************************************************************************/
+bool RingLog::read_next(Cursor *cursor, void *record, Cursor *record_pos)
+{
+	if(!_ready)
+		return false;
+
+	SlotHeader header;
+
+	while(!is_end(cursor))
+	{
+		if(cursor->slot >= _slots_per_sector)
+		{
+			cursor->sector = next_sector(cursor->sector);
+			cursor->slot = 0;
+			continue;
+		}
+
+		Cursor pos = *cursor;
+		cursor->slot++;
+
+		if(!read_slot_header(pos.sector, pos.slot, &header) || header.state != SLOT_WRITTEN)
+			continue;
+
+		if(_flash->read(slot_addr(pos.sector, pos.slot) + sizeof(SlotHeader), record, _record_size) != RET_OK)
+			continue;
+
+		if(record_crc(record) != header.crc32)
+		{
+			_stats.invalid_slots++;
+			continue;
+		}
+
+		if(record_pos != NULL)
+			*record_pos = pos;
+
+		return true;
+	}
+
+	return false;
+}
+
+/******************************************************************************
+ * Mark records in [from, to) as consumed and move tail past consumed records.
+ * Sectors left behind by the tail are erased.
+ ******************************************************************************/
+RetResult RingLog::consume(const Cursor *from, const Cursor *to)
+{
+	if(!_ready)
+		return RET_ERROR;
+
+	Cursor cursor = *from;
+	SlotHeader header;
+	uint8_t state = SLOT_CONSUMED;
+
+	while(!is_end(&cursor) && !(cursor.sector == to->sector && cursor.slot == to->slot))
+	{
+		if(cursor.slot >= _slots_per_sector)
+		{
+			cursor.sector = next_sector(cursor.sector);
+			cursor.slot = 0;
+			continue;
+		}
+
+		if(read_slot_header(cursor.sector, cursor.slot, &header) && header.state == SLOT_WRITTEN)
+		{
+			Flash::count_raw_write(sizeof(state));
+			if(_flash->write(slot_addr(cursor.sector, cursor.slot), &state, sizeof(state)) != RET_OK)
+				return RET_ERROR;
+
+			_stats.consumed++;
+		}
+
+		cursor.slot++;
+	}
+
+	return recover_tail();
+}
+
+/******************************************************************************
+ * Erase whole region
+ ******************************************************************************/
+RetResult RingLog::erase_all()
+{
+	if(!_ready)
+		return RET_ERROR;
+
+	for(uint32_t s = 0; s < _sector_count; s++)
+	{
+		Flash::count_raw_erase();
+		if(_flash->erase_sector(_offset + s * _sector_size) != RET_OK)
+			return RET_ERROR;
+
+		_stats.sectors_erased++;
+	}
+
+	// Sector 0 was just erased, open_sector() erases it once more. Not worth
+	// special-casing, this is rare.
+	if(open_sector(0) != RET_OK)
+		return RET_ERROR;
+
+	_tail_sector = _tail_slot = 0;
+
+	return RET_OK;
+}
+
+/******************************************************************************
+ * Count records not consumed yet. Reads every slot header between tail and
+ * head.
+ ******************************************************************************/
+uint32_t RingLog::count()
+{
+	uint32_t records = 0;
+	Cursor cursor;
+	SlotHeader header;
+
+	get_tail(&cursor);
+
+	while(!is_end(&cursor))
+	{
+		if(cursor.slot >= _slots_per_sector)
+		{
+			cursor.sector = next_sector(cursor.sector);
+			cursor.slot = 0;
+			continue;
+		}
+
+		if(read_slot_header(cursor.sector, cursor.slot, &header) && header.state == SLOT_WRITTEN)
+			records++;
+
+		cursor.slot++;
+	}
+
+	return records;
+}
+
+/******************************************************************************
+ * Records that can be stored before eviction starts
+ ******************************************************************************/
+uint32_t RingLog::get_capacity() const
+{
+	return (_sector_count - 1) * _slots_per_sector;
+}
+
+uint16_t RingLog::get_record_size() const
+{
+	return _record_size;
+}
+
+const RingLog::Stats* RingLog::get_stats() const
+{
+	return &_stats;
+}
+
+/******************************************************************************
+ * Print region and head/tail info
+ ******************************************************************************/
+void RingLog::print_info()
+{
+	debug_printf("Ring log @%X: %u sectors, %u records/sector, head: %u/%u, tail: %u/%u, records: %u\n",
+		_offset, _sector_count, _slots_per_sector, _head_sector, _head_slot,
+		_tail_sector, _tail_slot, count());
+}
+
+/******************************************************************************
+ * Erase a sector and make it the head sector
+ ******************************************************************************/
+RetResult RingLog::open_sector(uint32_t sector)
+{
+	Flash::count_raw_erase();
+	if(_flash->erase_sector(_offset + sector * _sector_size) != RET_OK)
+	{
+		debug_println(F("Could not erase ring log sector."));
+		return RET_ERROR;
+	}
+
+	_stats.sectors_erased++;
+
+	SectorHeader header;
+	memset(&header, 0xFF, sizeof(header));
+	header.magic = RING_LOG_SECTOR_MAGIC;
+	header.seq = _head_seq + 1;
+	header.record_size = _record_size;
+	header.crc32 = sector_header_crc(&header);
+
+	Flash::count_raw_write(sizeof(header));
+	if(_flash->write(_offset + sector * _sector_size, &header, sizeof(header)) != RET_OK)
+	{
+		debug_println(F("Could not write ring log sector header."));
+		return RET_ERROR;
+	}
+
+	_head_seq = header.seq;
+	_head_sector = sector;
+	_head_slot = 0;
+
+	return RET_OK;
+}
+
+/******************************************************************************
+ * Move tail to the first written slot, erasing sectors left behind
+ ******************************************************************************/
+RetResult RingLog::recover_tail()
+{
+	SlotHeader header;
+
+	while(!(_tail_sector == _head_sector && _tail_slot >= _head_slot))
+	{
+		if(_tail_slot >= _slots_per_sector)
+		{
+			// Nothing left in this sector
+			Flash::count_raw_erase();
+			if(_flash->erase_sector(_offset + _tail_sector * _sector_size) != RET_OK)
+				return RET_ERROR;
+
+			_stats.sectors_erased++;
+
+			_tail_sector = next_sector(_tail_sector);
+			_tail_slot = 0;
+			continue;
+		}
+
+		if(!read_slot_header(_tail_sector, _tail_slot, &header))
+			return RET_ERROR;
+
+		if(header.state == SLOT_WRITTEN)
+			break;
+
+		_tail_slot++;
+	}
+
+	return RET_OK;
+}
+
+/******************************************************************************
+ * Read header of a slot
+ ******************************************************************************/
+bool RingLog::read_slot_header(uint32_t sector, uint32_t slot, SlotHeader *header)
+{
+	return _flash->read(slot_addr(sector, slot), header, sizeof(SlotHeader)) == RET_OK;
+}
+
+/******************************************************************************
+ * Address of a slot in flash
+ ******************************************************************************/
+uint32_t RingLog::slot_addr(uint32_t sector, uint32_t slot) const
+{
+	return _offset + sector * _sector_size + sizeof(SectorHeader) + slot * (sizeof(SlotHeader) + _record_size);
+}
+
+/******************************************************************************
+ * Next sector in ring order
+ ******************************************************************************/
+uint32_t RingLog::next_sector(uint32_t sector) const
+{
+	return (sector + 1) % _sector_count;
+}
+
+/******************************************************************************
+ * Check if cursor reached head
+ ******************************************************************************/
+bool RingLog::is_end(const Cursor *cursor) const
+{
+	return cursor->sector == _head_sector && cursor->slot >= _head_slot;
+}
+
+uint32_t RingLog::sector_header_crc(const SectorHeader *header) const
+{
+	return Utils::crc32((uint8_t*)header, sizeof(SectorHeader) - sizeof(header->crc32));
+}
+
+uint32_t RingLog::record_crc(const void *record) const
+{
+	return Utils::crc32((uint8_t*)record, _record_size);
+}
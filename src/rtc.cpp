@@ -10,6 +10,7 @@
 #include "utils.h"
 #include "http_request.h"
 #include "common.h"
+#include "esp_attr.h"
 
 namespace RTC
 {
@@ -21,6 +22,9 @@ namespace RTC
     /** Tick of last RTC sync */
     uint32_t _last_sync_tick = 0;
 
+    /** Timestamp of last RTC sync. Unlike ticks, valid after deep sleep. */
+    RTC_DATA_ATTR uint32_t _last_sync_tstamp = 0;
+
     //
     // Private functions
     //
@@ -171,6 +175,7 @@ namespace RTC
 
         // Keep track of last time sync, failed or not
         _last_sync_tick = millis();
+        _last_sync_tstamp = get_timestamp();
 
         return ret;
     }
@@ -521,6 +526,14 @@ namespace RTC
         return _last_sync_tick;
     }
 
+    /******************************************************************************
+     * Get timestamp of last sync, 0 if not synced since power on
+     *****************************************************************************/
+    uint32_t get_last_sync_tstamp()
+    {
+        return _last_sync_tstamp;
+    }
+
     /******************************************************************************
     * Check timestamp for validity by comparing to a recent tstamp
     ******************************************************************************/
@@ -8,7 +8,7 @@
  *****************************************************************************/
 namespace SDI12Log
 {
-	DataStore<SDI12Log::Entry> store("/sdi12", 8);
+	DataStore<SDI12Log::Entry> store(SDI12_LOG_DATA_PATH, 8);
 
 	/******************************************************************************
 	 * Add entry
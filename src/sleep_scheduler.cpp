@@ -1,5 +1,7 @@
 #include <HardwareSerial.h>
 #include <esp_sleep.h>
+#include "esp_attr.h"
+#include "rom/rtc.h"
 #include "sleep_scheduler.h"
 #include "common.h"
 #include "const.h"
@@ -12,6 +14,12 @@
 #include "fo_sniffer.h"
 #include "fo_uart.h"
 #include "fo_data.h"
+#include "deep_sleep.h"
+#include "water_sensor_data.h"
+#include "atmos41_data.h"
+#include "soil_moisture_data.h"
+#include "lightning_data.h"
+#include "sdi12_log.h"
 
 namespace SleepScheduler
 {
@@ -20,7 +28,16 @@ namespace SleepScheduler
 	//
 
 	/** Timestamp of last time device went to sleep */
-	uint32_t _t_last_sleep = 0;
+	RTC_DATA_ATTR uint32_t _t_last_sleep = 0;
+
+	/** Seconds device went to sleep for */
+	RTC_DATA_ATTR int _sleep_sec = 0;
+
+	/** Set right before deep sleep, device is expected to resume */
+	RTC_DATA_ATTR bool _deep_sleep_pending = false;
+
+	/** Resumed from deep sleep, wake up reasons not handled yet */
+	bool _resumed = false;
 
 	/** Millis of last time device woke up from sleep */
 	uint32_t _t_last_wakeup_ms = 0;
@@ -31,7 +48,7 @@ namespace SleepScheduler
 	uint32_t _t_last_event_ms = 0;
 
 	/** Reasons of last wake up event */
-	int _last_wakeup_reasons = 0;
+	RTC_DATA_ATTR int _last_wakeup_reasons = 0;
 
 	//
 	// Private functions
@@ -39,12 +56,28 @@ namespace SleepScheduler
 	RetResult get_current_schedule(SleepScheduler::WakeupScheduleEntry *schedule_out);
 	RetResult decide_schedule(SleepScheduler::WakeupScheduleEntry schedule_out[]);
 	int calc_secs_to_event(uint32_t t_now_sec, int event_interval_secs);
+	void deep_sleep();
+	void handle_wakeup();
+	void compact_stores();
+	template <typename TStore>
+	void compact_store(TStore *store, uint32_t t_start, int *files_merged);
 
 	/******************************************************************************
 	* Decide minutes to sleep and go to sleep
 	******************************************************************************/
 	RetResult sleep_to_next()
 	{
+		// Woke up from deep sleep in setup(), handle wake up reasons first
+		if(_resumed)
+		{
+			_resumed = false;
+			return RET_OK;
+		}
+
+		// Flash writes are put off while battery is low
+		if(Battery::get_current_mode() == BATTERY_MODE_NORMAL)
+			compact_stores();
+
 		// Sleep time will be calculated using this timestamp as a reference
 		uint32_t t_now_sec = RTC::get_timestamp();
 
@@ -141,16 +174,126 @@ namespace SleepScheduler
 		// Sleep
 		//
 		_t_last_sleep = RTC::get_timestamp();	
+		_sleep_sec = next_event_seconds_left;
 
 		Serial.flush();
 		
 		esp_sleep_enable_timer_wakeup((uint64_t)next_event_seconds_left * 1000000);
-		esp_light_sleep_start();
 
-		//
-		// Wake up
-		//
+		if(FLAGS.DEEP_SLEEP_ENABLED)
+		{
+			// Device resets on wake up and setup() continues with resume()
+			deep_sleep();
+		}
+		else
+		{
+			esp_light_sleep_start();
+		}
+
+		handle_wakeup();
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * Resume after waking up from deep sleep, called early in setup()
+	 * Puts parked store buffers back and completes the wake up like
+	 * sleep_to_next() does after light sleep. The next sleep_to_next() call
+	 * returns immediately so the wake up reasons are handled first.
+	 * @return RET_ERROR if boot is not a deep sleep wake up, full boot needed
+	 ******************************************************************************/
+	RetResult resume()
+	{
+		if(!deep_sleep_wakeup())
+			return RET_ERROR;
+
+		_deep_sleep_pending = false;
+
+		DeepSleep::restore_state();
+
+		handle_wakeup();
+
+		_resumed = true;
+
+		return RET_OK;
+	}
 
+	/******************************************************************************
+	 * Boot is a wake up from deep sleep this module put the device in
+	 * RTC_DATA_ATTR vars are reset on any other boot, so state is valid.
+	 ******************************************************************************/
+	bool deep_sleep_wakeup()
+	{
+		return _deep_sleep_pending && rtc_get_reset_reason(0) == DEEPSLEEP_RESET;
+	}
+
+	/******************************************************************************
+	 * Go to deep sleep, timer wake up must be set
+	 * Does not return on the device, RTC memory is all that is kept.
+	 ******************************************************************************/
+	void deep_sleep()
+	{
+		// Staged logs are kept in RTC memory, store buffers are parked
+		DeepSleep::park_state();
+
+		Log::log(Log::DEEP_SLEEP, DeepSleep::get_parked_bytes());
+
+		_deep_sleep_pending = true;
+
+		Serial.flush();
+		esp_deep_sleep_start();
+	}
+
+	/******************************************************************************
+	 * Merge undersized store files, so readers and call home open fewer files
+	 * DATA_STORE_COMPACT_BUDGET_MS is shared by all stores, most important
+	 * first. Whatever is left is merged before the next sleep.
+	 ******************************************************************************/
+	void compact_stores()
+	{
+		uint32_t t_start = millis();
+		int files_merged = 0;
+
+		compact_store(WaterSensorData::get_store(), t_start, &files_merged);
+		compact_store(Atmos41Data::get_store(), t_start, &files_merged);
+		compact_store(SoilMoistureData::get_store(), t_start, &files_merged);
+		compact_store(FoData::get_store(), t_start, &files_merged);
+		compact_store(LightningData::get_store(), t_start, &files_merged);
+		compact_store(Log::get_store(), t_start, &files_merged);
+		compact_store(SDI12Log::get_store(), t_start, &files_merged);
+
+		if(files_merged > 0)
+			Log::log(Log::STORES_COMPACTED, files_merged, millis() - t_start);
+	}
+
+	/******************************************************************************
+	 * Compact a store with what is left of the time budget
+	 ******************************************************************************/
+	template <typename TStore>
+	void compact_store(TStore *store, uint32_t t_start, int *files_merged)
+	{
+		uint32_t elapsed_ms = millis() - t_start;
+		int store_files_merged = 0;
+
+		if(elapsed_ms >= (uint32_t)DATA_STORE_COMPACT_BUDGET_MS)
+			return;
+
+		if(store->cleanup_store(DATA_STORE_COMPACT_BUDGET_MS - elapsed_ms, &store_files_merged) != RET_OK)
+		{
+			debug_print_w(F("Could not compact store: "));
+			debug_println(store->get_dir_path());
+		}
+
+		*files_merged += store_files_merged;
+	}
+
+	/******************************************************************************
+	 * Complete wake up from sleep
+	 * Corrects drift of the internal clock and syncs it from the external RTC.
+	 * Correction is short, light sleep is used for it in both modes.
+	 ******************************************************************************/
+	void handle_wakeup()
+	{
 		//
 		// ESP32 internal clock drifts, calculate how much time left for actual wakeup time and sleep again
 		//
@@ -164,7 +307,7 @@ namespace SleepScheduler
 
 			if(RTC::tstamp_valid(_t_last_sleep) && RTC::tstamp_valid(t_wakeup))
 			{
-				int underslept_secs = next_event_seconds_left - (t_wakeup - _t_last_sleep);
+				int underslept_secs = _sleep_sec - (t_wakeup - _t_last_sleep);
 				if(underslept_secs > 0 && underslept_secs <= MAX_SLEEP_CORRECTION_SEC)
 				{
 					debug_print(F("Slept at: "));
@@ -216,8 +359,6 @@ namespace SleepScheduler
 		Utils::print_block(F("Waking up!"));
 		RTC::print_time();
 		Utils::serial_style(STYLE_RESET);
-
-		return RET_OK;
 	}
 
 	/******************************************************************************
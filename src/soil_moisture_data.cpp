@@ -5,13 +5,26 @@
 
 namespace SoilMoistureData
 {
+	/** Schema of entries */
+	constexpr EntrySchema::Field SCHEMA[] = {
+		ENTRY_SCHEMA_FIELD(Entry, timestamp, NULL, "Timestamp", 0, FIELD_DELTA2, EntrySchema::FLAG_NONE),
+		ENTRY_SCHEMA_FIELD(Entry, vwc, SOIL_MOISTURE_DATA_KEY_VWC, "VWC",
+			EntrySchema::DECIMALS_ALL, FIELD_DELTA, EntrySchema::FLAG_NONE),
+		ENTRY_SCHEMA_FIELD(Entry, temperature, SOIL_MOISTURE_DATA_KEY_TEMPERATURE, "Temperature",
+			EntrySchema::DECIMALS_ALL, FIELD_DELTA, EntrySchema::FLAG_NONE),
+		ENTRY_SCHEMA_FIELD(Entry, conductivity, SOIL_MOISTURE_DATA_KEY_CONDUCTIVITY, "Conductivity",
+			EntrySchema::DECIMALS_ALL, FIELD_DELTA, EntrySchema::FLAG_NONE)
+	};
+	ENTRY_SCHEMA_CHECK(Entry, SCHEMA);
+
 	/** 
 	 * Store for moisture sensor data
 	 * Number of entries per file is the same as the number of entries in a request packet.
 	 * This way if a request succeeds, a whole file can be deleted, if not the file remains
 	 * to be resent at a later time
 	 */
-    DataStore<SoilMoistureData::Entry> store(SOIL_MOISTURE_DATA_PATH, SOIL_MOISTURE_DATA_ENTRIES_PER_SUBMIT_REQ);
+    DataStore<SoilMoistureData::Entry> store(SOIL_MOISTURE_DATA_PATH, SOIL_MOISTURE_DATA_ENTRIES_PER_SUBMIT_REQ,
+        EntrySchema::schema_id(SCHEMA, ENTRY_SCHEMA_FIELD_COUNT(SCHEMA)));
 
     /******************************************************************************
     * Add water sensor data to storage
@@ -35,22 +48,21 @@ namespace SoilMoistureData
         return &store;
     }
 
+    /******************************************************************************
+    * Get entry schema
+    ******************************************************************************/
+    const EntrySchema::Field* get_schema(int *field_count)
+    {
+        *field_count = ENTRY_SCHEMA_FIELD_COUNT(SCHEMA);
+        return SCHEMA;
+    }
+
     /********************************************************************************
 	 * Print all data from a water sensor data strcut
 	 * @param data Water sensor data structure
 	 *******************************************************************************/
 	void print(const SoilMoistureData::Entry *data)
 	{
-		debug_print(F("Timestamp: "));
-		debug_println(data->timestamp);
-
-		debug_print(F("VWC: "));
-		debug_println(data->vwc);
-
-		debug_print(F("Temperature: "));
-		debug_println(data->temperature);
-
-		debug_print(F("Conductivity: "));
-		debug_println(data->conductivity);
+		EntrySchema::print(SCHEMA, ENTRY_SCHEMA_FIELD_COUNT(SCHEMA), data);
 	}
 }
\ No newline at end of file
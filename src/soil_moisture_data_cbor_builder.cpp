@@ -0,0 +1,14 @@
+#include "soil_moisture_data_cbor_builder.h"
+#include "common.h"
+
+/******************************************************************************
+ * Add packet to request
+ * Values are generated from the entry schema, see SoilMoistureData::get_schema()
+ *****************************************************************************/
+RetResult SoilMoistureDataCborBuilder::add(const SoilMoistureData::Entry *entry)
+{
+	int field_count = 0;
+	const EntrySchema::Field *fields = SoilMoistureData::get_schema(&field_count);
+
+	return add_schema_entry(entry, fields, field_count);
+}
@@ -0,0 +1,450 @@
+#include "storage.h"
+#include "app_config.h"
+#include "common.h"
+#include "flash.h"
+#include "data_store_manifest.h"
+#include "log.h"
+#include "SPIFFS.h"
+
+/** LittleFS is only linked in when used, it needs the LittleFS_esp32 library */
+#if defined(NATIVE) || STORAGE_BACKEND == STORAGE_BACKEND_LITTLEFS || STORAGE_MIGRATE_FROM == STORAGE_BACKEND_LITTLEFS
+#define STORAGE_HAS_LITTLEFS
+#include "LITTLEFS.h"
+#endif
+
+#ifdef NATIVE
+#include "RAMFS.h"
+#endif
+
+namespace Storage
+{
+	/** Backends built in */
+	const Backend BACKENDS[] = {
+		{
+			STORAGE_BACKEND_SPIFFS, "SPIFFS", &SPIFFS, false,
+			[](bool format_on_fail, uint8_t max_open_files) { return SPIFFS.begin(format_on_fail, "/spiffs", max_open_files); },
+			[]() { return SPIFFS.format(); },
+			[]() { return SPIFFS.totalBytes(); },
+			[]() { return SPIFFS.usedBytes(); },
+			[]() { SPIFFS.end(); }
+		},
+#ifdef STORAGE_HAS_LITTLEFS
+		{
+			STORAGE_BACKEND_LITTLEFS, "LittleFS", &LITTLEFS, true,
+			[](bool format_on_fail, uint8_t max_open_files) { return LITTLEFS.begin(format_on_fail, "/littlefs", max_open_files); },
+			[]() { return LITTLEFS.format(); },
+			[]() { return LITTLEFS.totalBytes(); },
+			[]() { return LITTLEFS.usedBytes(); },
+			[]() { LITTLEFS.end(); }
+		},
+#endif
+#ifdef NATIVE
+		{
+			STORAGE_BACKEND_RAM, "RAM", &RAMFS, true,
+			[](bool format_on_fail, uint8_t max_open_files) { return RAMFS.begin(format_on_fail); },
+			[]() { return RAMFS.format(); },
+			[]() { return RAMFS.totalBytes(); },
+			[]() { return RAMFS.usedBytes(); },
+			[]() { RAMFS.end(); }
+		},
+#endif
+	};
+
+	/** Store file being migrated */
+	struct MigrationFile
+	{
+		char path[FILE_PATH_BUFFER_SIZE];
+		uint32_t size;
+		/** Store priority and file creation time, decide write order */
+		DataStorePriority priority;
+		uint32_t name_tstamp;
+		/** Position in staging buffer, -1 if could not be read */
+		int offset;
+	};
+
+	/** Backend in use, STORAGE_BACKEND unless changed with set_backend() */
+	const Backend *_backend = NULL;
+
+	/** Backend in use has been mounted since it was last unmounted */
+	bool _mounted = false;
+
+	const Backend* backend();
+
+	void list_files(fs::FS &fs, const char *dir_path, MigrationFile *files, int *count, int *files_over);
+
+	int compare_files(const void *a, const void *b);
+
+	/******************************************************************************
+	 * File system of backend in use
+	 *****************************************************************************/
+	fs::FS& fs()
+	{
+		return *backend()->fs;
+	}
+
+	/******************************************************************************
+	 * Mount. Returns at once when already mounted.
+	 *****************************************************************************/
+	bool begin(bool format_on_fail, uint8_t max_open_files)
+	{
+		_mounted = backend()->begin(format_on_fail, max_open_files);
+		return _mounted;
+	}
+
+	/******************************************************************************
+	 * Format partition. Does not need to be mounted.
+	 *****************************************************************************/
+	bool format()
+	{
+		return backend()->format();
+	}
+
+	size_t total_bytes()
+	{
+		return backend()->total_bytes();
+	}
+
+	size_t used_bytes()
+	{
+		return backend()->used_bytes();
+	}
+
+	void end()
+	{
+		backend()->end();
+		_mounted = false;
+	}
+
+	/******************************************************************************
+	 * Check if backend in use is mounted, ie. begin() would not mount it again
+	 *****************************************************************************/
+	bool is_mounted()
+	{
+		return _mounted;
+	}
+
+	const char* get_name()
+	{
+		return backend()->name;
+	}
+
+	/******************************************************************************
+	 * Get backend in use
+	 *****************************************************************************/
+	const Backend* get_backend()
+	{
+		return backend();
+	}
+
+	/******************************************************************************
+	 * Get backend by id, NULL if not built in
+	 *****************************************************************************/
+	const Backend* get_backend(int id)
+	{
+		for(unsigned int i = 0; i < sizeof(BACKENDS) / sizeof(BACKENDS[0]); i++)
+		{
+			if(BACKENDS[i].id == id)
+				return &BACKENDS[i];
+		}
+
+		return NULL;
+	}
+
+	/******************************************************************************
+	 * Switch backend. Previous one is unmounted, stores must be remounted with
+	 * Flash::mount(). Only needed when a build uses more than one (migration,
+	 * benchmarks).
+	 *****************************************************************************/
+	RetResult set_backend(int id)
+	{
+		const Backend *new_backend = get_backend(id);
+
+		if(new_backend == NULL)
+		{
+			debug_print_e(F("Storage backend not built in: "));
+			debug_println(id, DEC);
+			return RET_ERROR;
+		}
+
+		if(new_backend == backend())
+			return RET_OK;
+
+		backend()->end();
+		_mounted = false;
+
+		// Manifests in RAM describe the previous file system
+		DataStoreManifest::unload_all();
+
+		_backend = new_backend;
+
+#ifdef NATIVE
+		NativeFs::select(_backend->fs);
+#endif
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * Create missing parent dirs of a file. Nothing to do when dirs are not
+	 * real (SPIFFS).
+	 *****************************************************************************/
+	RetResult make_dirs(const char *file_path)
+	{
+		if(!backend()->has_dirs)
+			return RET_OK;
+
+		char dir_path[FILE_PATH_BUFFER_SIZE];
+		const char *sep = file_path;
+
+		while((sep = strchr(sep + 1, '/')) != NULL)
+		{
+			int len = sep - file_path;
+			if(len >= (int)sizeof(dir_path))
+				return RET_ERROR;
+
+			memcpy(dir_path, file_path, len);
+			dir_path[len] = '\0';
+
+			if(!fs().exists(dir_path) && !fs().mkdir(dir_path))
+			{
+				debug_print_e(F("Could not create dir: "));
+				debug_println(dir_path);
+				return RET_ERROR;
+			}
+		}
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * Move store files from another backend's file system to the one in use,
+	 * reformatting the partition they share.
+	 * Files are staged in RAM, nothing else survives the format. When they are
+	 * more than STORAGE_MIGRATION_MAX_BYTES/FILES the partition is left as it
+	 * is and from becomes the backend in use, migration is tried again on next
+	 * boot once call homes have submitted enough of the backlog.
+	 * Manifests are not copied, stores rebuild them from their dirs.
+	 * @param from Backend the partition is currently formatted with
+	 * @param files_migrated Files written to the new file system
+	 * @param files_dropped Files that could not be read or written
+	 * @return RET_ERROR if the partition is not formatted with from or the new
+	 *		   file system could not be created
+	 *****************************************************************************/
+	RetResult migrate(const Backend *from, int *files_migrated, int *files_dropped)
+	{
+		*files_migrated = 0;
+		*files_dropped = 0;
+
+		if(from == NULL || from == backend())
+			return RET_ERROR;
+
+		if(!from->begin(false, STORAGE_MAX_OPEN_FILES))
+		{
+			debug_print(F("No file system to migrate from: "));
+			debug_println(from->name);
+			return RET_ERROR;
+		}
+
+		debug_print(F("Migrating store files from "));
+		debug_print(from->name);
+		debug_print(F(" to "));
+		debug_println(get_name());
+
+		MigrationFile *files = (MigrationFile*)malloc(sizeof(MigrationFile) * STORAGE_MIGRATION_MAX_FILES);
+		uint8_t *staging = (uint8_t*)malloc(STORAGE_MIGRATION_MAX_BYTES);
+
+		if(files == NULL || staging == NULL)
+		{
+			debug_println_e(F("Not enough memory to migrate."));
+			free(files);
+			free(staging);
+			from->end();
+			return RET_ERROR;
+		}
+
+		int count = 0, files_over = 0;
+		list_files(*from->fs, "/", files, &count, &files_over);
+
+		uint32_t total_bytes = 0;
+		for(int i = 0; i < count; i++)
+			total_bytes += files[i].size;
+
+		if(files_over > 0 || total_bytes > STORAGE_MIGRATION_MAX_BYTES)
+		{
+			debug_print(F("Store files too big to migrate, keeping "));
+			debug_println(from->name);
+
+			Log::log(Log::STORAGE_MIGRATION_DEFERRED, count + files_over, total_bytes);
+
+			free(files);
+			free(staging);
+
+			// Still mounted
+			if(set_backend(from->id) != RET_OK || !begin(false))
+				return RET_ERROR;
+
+			return RET_OK;
+		}
+
+		// Most important first, so that a full partition drops the least
+		qsort(files, count, sizeof(MigrationFile), compare_files);
+
+		uint32_t staged_bytes = 0;
+
+		for(int i = 0; i < count; i++)
+		{
+			files[i].offset = -1;
+
+			File f = from->fs->open(files[i].path, FILE_READ);
+			if(!f || f.read(staging + staged_bytes, files[i].size) != files[i].size)
+				continue;
+
+			files[i].offset = staged_bytes;
+			staged_bytes += files[i].size;
+		}
+
+		from->end();
+
+		RetResult ret = RET_OK;
+		DataStoreManifest::unload_all();
+
+		if(!format() || !begin(false))
+		{
+			debug_print_e(F("Could not create file system: "));
+			debug_println(get_name());
+			ret = RET_ERROR;
+		}
+
+		for(int i = 0; i < count && ret == RET_OK; i++)
+		{
+			if(files[i].offset < 0)
+			{
+				(*files_dropped)++;
+				continue;
+			}
+
+			if(make_dirs(files[i].path) != RET_OK)
+			{
+				(*files_dropped)++;
+				continue;
+			}
+
+			File f = fs().open(files[i].path, FILE_WRITE);
+			if(!f)
+			{
+				(*files_dropped)++;
+				continue;
+			}
+
+			Flash::count_create();
+
+			size_t written = f.write(staging + files[i].offset, files[i].size);
+			Flash::count_write(NULL, 0, written);
+
+			if(written != files[i].size)
+			{
+				// Partial file would fail store CRC checks, drop it
+				f.close();
+				fs().remove(files[i].path);
+				(*files_dropped)++;
+				continue;
+			}
+
+			(*files_migrated)++;
+		}
+
+		free(files);
+		free(staging);
+
+		debug_print(F("Files migrated: "));
+		debug_print(*files_migrated, DEC);
+		debug_print(F(", dropped: "));
+		debug_println(*files_dropped, DEC);
+
+		return ret;
+	}
+
+	/******************************************************************************
+	 * Backend in use
+	 *****************************************************************************/
+	const Backend* backend()
+	{
+		if(_backend == NULL)
+			_backend = get_backend(STORAGE_BACKEND);
+
+		return _backend;
+	}
+
+	/******************************************************************************
+	 * List store files of a dir and its subdirs, manifests excluded. Files over
+	 * STORAGE_MIGRATION_MAX_FILES are only counted.
+	 *****************************************************************************/
+	void list_files(fs::FS &fs, const char *dir_path, MigrationFile *files, int *count, int *files_over)
+	{
+		File dir = fs.open(dir_path);
+		if(!dir || !dir.isDirectory())
+			return;
+
+		File cur_file;
+
+		while(cur_file = dir.openNextFile())
+		{
+			const char *path = cur_file.name();
+
+			// Manifests are rebuilt, migrating them would only take space
+			if(strncmp(path, DATA_STORE_MANIFEST_DIR, strlen(DATA_STORE_MANIFEST_DIR)) == 0 &&
+				path[strlen(DATA_STORE_MANIFEST_DIR)] == '/')
+			{
+				continue;
+			}
+
+			if(cur_file.isDirectory())
+			{
+				char sub_dir_path[FILE_PATH_BUFFER_SIZE];
+				snprintf(sub_dir_path, sizeof(sub_dir_path), "%s", path);
+				list_files(fs, sub_dir_path, files, count, files_over);
+				continue;
+			}
+
+			if(strlen(path) >= FILE_PATH_BUFFER_SIZE || *count >= STORAGE_MIGRATION_MAX_FILES)
+			{
+				(*files_over)++;
+				continue;
+			}
+
+			MigrationFile file;
+			strcpy(file.path, path);
+			file.size = cur_file.size();
+
+			// File name is <store dir>/<tstamp>_<postfix>
+			const char *name = strrchr(path, '/');
+			char store_dir_path[FILE_PATH_BUFFER_SIZE] = {0};
+			memcpy(store_dir_path, path, name - path);
+
+			unsigned int name_tstamp = 0;
+			sscanf(name + 1, "%u_", &name_tstamp);
+
+			file.priority = DataStoreManifest::get_dir_priority(store_dir_path);
+			file.name_tstamp = name_tstamp;
+
+			files[(*count)++] = file;
+		}
+	}
+
+	/******************************************************************************
+	 * Migration order: higher priority first, newer first
+	 *****************************************************************************/
+	int compare_files(const void *a, const void *b)
+	{
+		const MigrationFile *file_a = (const MigrationFile*)a;
+		const MigrationFile *file_b = (const MigrationFile*)b;
+
+		if(file_a->priority != file_b->priority)
+			return file_a->priority > file_b->priority ? -1 : 1;
+
+		if(file_a->name_tstamp != file_b->name_tstamp)
+			return file_a->name_tstamp > file_b->name_tstamp ? -1 : 1;
+
+		return strcmp(file_a->path, file_b->path);
+	}
+}
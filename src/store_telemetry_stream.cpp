@@ -0,0 +1,222 @@
+#include "store_telemetry_stream.h"
+#include "water_sensor_data.h"
+#include "atmos41_data.h"
+#include "soil_moisture_data.h"
+#include "lightning_data.h"
+#include "fo_data.h"
+#include "sdi12_log.h"
+#include "tb_water_sensor_data_json_builder.h"
+#include "tb_atmos41_data_json_builder.h"
+#include "tb_soil_moisture_data_json_builder.h"
+#include "tb_lightning_data_json_builder.h"
+#include "tb_fo_data_json_builder.h"
+#include "tb_sdi12_log_json_builder.h"
+#include "common.h"
+#include <stdlib.h>
+#include <string.h>
+
+/******************************************************************************
+ * Constructor
+ * @param store Store to read
+ *****************************************************************************/
+template <typename TEntry, typename TBuilder>
+StoreTelemetryStream<TEntry, TBuilder>::StoreTelemetryStream(DataStore<TEntry> *store)
+	: _reader(store), _span(_entry_buff, 1)
+{}
+
+/******************************************************************************
+ * Get timestamp of next entry, reading it if not read yet
+ * Files are moved on from as they end, up to the files a request can cover.
+ * @param tstamp Timestamp in ms (output var)
+ * @return False if no entries left, or no more files fit in the request
+ *****************************************************************************/
+template <typename TEntry, typename TBuilder>
+bool StoreTelemetryStream<TEntry, TBuilder>::peek(uint64_t *tstamp)
+{
+	while(!_has_next && !_done)
+	{
+		if(!_file_open)
+		{
+			if(_ended_count >= TELEMETRY_MAX_FILES_PER_REQ)
+				return false;
+
+			if(!_reader.next_file())
+			{
+				_done = true;
+				break;
+			}
+
+			_file_open = true;
+			_has_written_mark = false;
+			_file_written = false;
+		}
+
+		// Entries read so far are all written
+		mark();
+
+		if(!_reader.next_entries(&_span, 1))
+		{
+			_ended[_ended_count++] = _written_mark;
+			_file_open = false;
+			continue;
+		}
+
+		_crc_failures += _span.crc_failures;
+
+		if(_span.count > 0)
+		{
+			// Entry that can't be built is dropped like one that failed its CRC,
+			// the next mark moves past it
+			if(build_entry(_span.get(0)) != RET_OK)
+			{
+				_crc_failures++;
+				continue;
+			}
+
+			_has_next = true;
+		}
+	}
+
+	*tstamp = _tstamp;
+	return _has_next;
+}
+
+/******************************************************************************
+ * Write values of next entry, must be peeked first
+ *****************************************************************************/
+template <typename TEntry, typename TBuilder>
+RetResult StoreTelemetryStream<TEntry, TBuilder>::write_values(HttpBodySink *sink)
+{
+	if(!_has_next)
+		return RET_ERROR;
+
+	_has_next = false;
+	_file_written = true;
+
+	return sink->write((const uint8_t*)_values, _values_len);
+}
+
+/******************************************************************************
+ * Request with the entries written succeeded. Files read to their end are
+ * deleted, entries written of the current one acked.
+ *****************************************************************************/
+template <typename TEntry, typename TBuilder>
+RetResult StoreTelemetryStream<TEntry, TBuilder>::ack_request()
+{
+	RetResult ret = RET_OK;
+
+	for(int i = 0; i < _ended_count; i++)
+	{
+		if(_reader.delete_file(&_ended[i]) != RET_OK)
+			ret = RET_ERROR;
+	}
+
+	_ended_count = 0;
+
+	// Next entry (if read) is left out of the mark, it goes in the next request
+	if(_file_open && _file_written)
+	{
+		if(_reader.ack(&_written_mark) != RET_OK)
+			ret = RET_ERROR;
+
+		_has_written_mark = false;
+		_file_written = false;
+	}
+
+	return ret;
+}
+
+/******************************************************************************
+ * Request failed, entries not acked are read again from the first file
+ *****************************************************************************/
+template <typename TEntry, typename TBuilder>
+void StoreTelemetryStream<TEntry, TBuilder>::rollback()
+{
+	_reader.reset();
+
+	_has_next = false;
+	_file_open = false;
+	_done = false;
+	_has_written_mark = false;
+	_file_written = false;
+	_ended_count = 0;
+}
+
+/******************************************************************************
+ * Start a submission over, as for a new stream. The reader is closed, so the
+ * store's manifest can be compacted or evicted from between submissions.
+ *****************************************************************************/
+template <typename TEntry, typename TBuilder>
+void StoreTelemetryStream<TEntry, TBuilder>::reset()
+{
+	rollback();
+
+	_crc_failures = 0;
+}
+
+/******************************************************************************
+ * Entries that failed their CRC or couldn't be built, dropped
+ *****************************************************************************/
+template <typename TEntry, typename TBuilder>
+int StoreTelemetryStream<TEntry, TBuilder>::get_crc_failures()
+{
+	return _crc_failures;
+}
+
+/******************************************************************************
+ * Build JSON of an entry, a one entry array: [{"ts":...,"values":{...}}]
+ * Timestamp and values are taken from it.
+ *****************************************************************************/
+template <typename TEntry, typename TBuilder>
+RetResult StoreTelemetryStream<TEntry, TBuilder>::build_entry(const TEntry *entry)
+{
+	_builder.reset();
+
+	if(_builder.add(entry) != RET_OK)
+		return RET_ERROR;
+
+	_builder.build(_entry_json, sizeof(_entry_json), false);
+
+	int len = strlen(_entry_json);
+	const char *ts = strstr(_entry_json, "\"ts\":");
+	const char *values = strstr(_entry_json, "\"values\":{");
+
+	// Truncated or not a single entry
+	if(len >= (int)sizeof(_entry_json) - 1 || ts == NULL || values == NULL ||
+		strcmp(_entry_json + len - 3, "}}]") != 0)
+	{
+		debug_println_e(F("Could not build entry JSON."));
+		return RET_ERROR;
+	}
+
+	_tstamp = strtoull(ts + 5, NULL, 10);
+	_values = values + 10;
+	_values_len = _entry_json + len - 3 - _values;
+
+	return RET_OK;
+}
+
+/******************************************************************************
+ * Mark reader after the entries read of the current file. Ring log marks only
+ * hold the records since the previous one, the range is kept from the first.
+ *****************************************************************************/
+template <typename TEntry, typename TBuilder>
+void StoreTelemetryStream<TEntry, TBuilder>::mark()
+{
+	DataStoreReadMark mark;
+	_reader.mark(&mark);
+
+	if(_has_written_mark)
+		mark.ring_from = _written_mark.ring_from;
+
+	_written_mark = mark;
+	_has_written_mark = true;
+}
+
+// Forward declarations
+template class StoreTelemetryStream<WaterSensorData::Entry, TbWaterSensorDataJsonBuilder>;
+template class StoreTelemetryStream<Atmos41Data::Entry, TbAtmos41DataJsonBuilder>;
+template class StoreTelemetryStream<SoilMoistureData::Entry, TbSoilMoistureDataJsonBuilder>;
+template class StoreTelemetryStream<LightningData::Entry, TbLightningDataJsonBuilder>;
+template class StoreTelemetryStream<FoData::StoreEntry, TbFoDataJsonBuilder>;
+template class StoreTelemetryStream<SDI12Log::Entry, TbSDI12LogJsonBuilder>;
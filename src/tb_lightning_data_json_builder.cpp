@@ -4,24 +4,12 @@
 
 /******************************************************************************
  * Add packet to request
+ * Values are generated from the entry schema, see LightningData::get_schema()
  *****************************************************************************/
 RetResult TbLightningDataJsonBuilder::add(const LightningData::Entry *entry)
 {
-	JsonObject json_entry = _root_array.createNestedObject();
+	int field_count = 0;
+	const EntrySchema::Field *fields = LightningData::get_schema(&field_count);
 
-	json_entry[LIGHTNING_DATA_KEY_TIMESTAMP] = (long long)entry->timestamp * 1000;
-	JsonObject values = json_entry.createNestedObject("values");
-
-	values[LIGHTNING_DATA_KEY_TIMESTAMP] = entry->timestamp;
-	values[LIGHTNING_DATA_KEY_DISTANCE] = entry->distance;
-	
-	// Check the last one, no need to check all, if last doesnt fit into
-	// the json doc, doc is full already
-	if((values[LIGHTNING_DATA_KEY_ENERGY] = entry->energy) == false)
-	{
-		debug_println(F("Could not add lightning data to JSON."));
-		return RET_ERROR;
-	}
-
-	return RET_OK;
-} 
\ No newline at end of file
+	return add_schema_entry(entry, fields, field_count, LIGHTNING_DATA_KEY_TIMESTAMP);
+}
@@ -4,24 +4,12 @@
 
 /******************************************************************************
  * Add packet to request
+ * Values are generated from the entry schema, see SoilMoistureData::get_schema()
  *****************************************************************************/
 RetResult TbSoilMoistureDataJsonBuilder::add(const SoilMoistureData::Entry *entry)
 {
-	JsonObject json_entry = _root_array.createNestedObject();
+	int field_count = 0;
+	const EntrySchema::Field *fields = SoilMoistureData::get_schema(&field_count);
 
-	json_entry[SOIL_MOISTURE_DATA_KEY_TIMESTAMP] = (long long)entry->timestamp * 1000;
-	JsonObject values = json_entry.createNestedObject("values");
-
-	values[SOIL_MOISTURE_DATA_KEY_VWC] = entry->vwc;
-	values[SOIL_MOISTURE_DATA_KEY_TEMPERATURE] = entry->temperature;
-	
-	// Check the last one, no need to check all, if last doesnt fit into
-	// the json doc, doc is full already
-	if((values[SOIL_MOISTURE_DATA_KEY_CONDUCTIVITY] = entry->conductivity) == false)
-	{
-		debug_println(F("Could not add soil moisture sensor data to JSON."));
-		return RET_ERROR;
-	}
-
-	return RET_OK;
-} 
\ No newline at end of file
+	return add_schema_entry(entry, fields, field_count, SOIL_MOISTURE_DATA_KEY_TIMESTAMP);
+}
@@ -4,47 +4,12 @@
 
 /******************************************************************************
  * Add packet to request
+ * Values are generated from the entry schema, see WaterSensorData::get_schema()
  *****************************************************************************/
 RetResult TbWaterSensorDataJsonBuilder::add(const WaterSensorData::Entry *entry)
 {
-	JsonObject json_entry = _root_array.createNestedObject();
+	int field_count = 0;
+	const EntrySchema::Field *fields = WaterSensorData::get_schema(&field_count);
 
-	json_entry[WATER_SENSOR_DATA_KEY_TIMESTAMP] = (long long)entry->timestamp * 1000;
-	JsonObject values = json_entry.createNestedObject("values");
-
-	// Do not include water quality fields if they are all 0
-	// The same does not apply for the water level sensor
-	// TODO: Should this function fail if no keys are added at all (both wl and quality)
-	// Because calling functions keeps track of how many entries there are in the packet
-	// Another possible solution is to add an int entry_count member and a getter which will
-	// be used by calling function
-	if(entry->dissolved_oxygen != 0 || entry->temperature != 0 ||
-		entry->ph != 0 || entry->conductivity != 0 || entry->ph != 0 ||
-		entry->orp != 0 || entry->pressure != 0 || entry->depth_cm != 0 ||
-		entry->depth_ft != 0 || entry->tss != 0)
-	{
-		values[WATER_SENSOR_DATA_KEY_DISSOLVED_OXYGEN] = entry->dissolved_oxygen;
-		values[WATER_SENSOR_DATA_KEY_TEMPERATURE] = entry->temperature;
-		values[WATER_SENSOR_DATA_KEY_CONDUCTIVITY] = entry->conductivity;
-		values[WATER_SENSOR_DATA_KEY_PH] = entry->ph;
-		values[WATER_SENSOR_DATA_KEY_ORP] = entry->orp;
-		values[WATER_SENSOR_DATA_KEY_PRESSURE] = entry->pressure;
-		values[WATER_SENSOR_DATA_KEY_DEPTH_CM] = entry->depth_cm;
-		values[WATER_SENSOR_DATA_KEY_DEPTH_FT] = entry->depth_ft;
-		values[WATER_SENSOR_DATA_KEY_TSS] = entry->tss;
-	}
-
-	values[WATER_SENSOR_DATA_KEY_WATER_LEVEL] = entry->water_level;
-	values[WATER_SENSOR_DATA_KEY_WATER_PRESENCE] = (int)entry->presence;
-
-	// If lastkey didn't fit into object, object buffer is not large enough
-	if(!values.containsKey(WATER_SENSOR_DATA_KEY_WATER_PRESENCE))
-	{
-		debug_println_e(F("Could not add sensor data to JSON."));
-		return RET_ERROR;
-	}
-
-
-
-	return RET_OK;
-} 
\ No newline at end of file
+	return add_schema_entry(entry, fields, field_count, WATER_SENSOR_DATA_KEY_TIMESTAMP);
+}
@@ -0,0 +1,293 @@
+#include "telemetry_json_body.h"
+#include "tb_water_sensor_data_json_builder.h"
+#include "tb_atmos41_data_json_builder.h"
+#include "tb_soil_moisture_data_json_builder.h"
+#include "tb_lightning_data_json_builder.h"
+#include "tb_fo_data_json_builder.h"
+#include "tb_log_json_builder.h"
+#include "tb_sdi12_log_json_builder.h"
+#include "common.h"
+#include <string.h>
+
+/******************************************************************************
+ * Constructor
+ * @param reader Reader with the file to submit open
+ * @param span Buffer entries are read into
+ *****************************************************************************/
+template <typename TEntry, typename TBuilder>
+TelemetryJsonBody<TEntry, TBuilder>::TelemetryJsonBody(DataStoreReader<TEntry> *reader,
+	DataStoreSpan<TEntry> *span)
+{
+	_reader = reader;
+	_span = span;
+}
+
+/******************************************************************************
+ * Default constructor (private)
+ *****************************************************************************/
+template <typename TEntry, typename TBuilder>
+TelemetryJsonBody<TEntry, TBuilder>::TelemetryJsonBody()
+{}
+
+/******************************************************************************
+ * Pack entries of the next files in requests when a file ends
+ * @param files Source of next files, NULL for a file per request
+ * @param max_bytes Body bytes to pack up to, the last entry may go over it
+ *****************************************************************************/
+template <typename TEntry, typename TBuilder>
+void TelemetryJsonBody<TEntry, TBuilder>::set_packing(TelemetryFileSource *files, int max_bytes)
+{
+	_files = files;
+	_max_bytes = max_bytes;
+}
+
+/******************************************************************************
+ * Start next request of current file, reading until its first valid entry
+ * When packing, files without valid entries are covered and passed.
+ * @param max_entries Max valid entries in request
+ * @return False if no more valid entries, nothing to send. The files read
+ *         are covered by get_files() all the same.
+ *****************************************************************************/
+template <typename TEntry, typename TBuilder>
+bool TelemetryJsonBody<TEntry, TBuilder>::begin(int max_entries)
+{
+	_max_entries = max_entries;
+	_entry_count = 0;
+	_entries_read = 0;
+	_crc_failures = 0;
+	_more_entries = true;
+	_span->count = 0;
+	_body_size = 0;
+
+	_covered_count = 1;
+	_covered[0].entry_count = 0;
+	_file_marked = false;
+
+	while(_span->count == 0)
+	{
+		if(!_more_entries && !next_file())
+			break;
+
+		read_entries();
+	}
+
+	if(_entry_count == 0)
+		end_file();
+
+	return _entry_count > 0;
+}
+
+/******************************************************************************
+ * Write request JSON, reading the rest of its entries
+ * Must be called once per begin().
+ *****************************************************************************/
+template <typename TEntry, typename TBuilder>
+RetResult TelemetryJsonBody<TEntry, TBuilder>::write(HttpBodySink *sink)
+{
+	bool first = true;
+
+	if(sink->write("[") != RET_OK)
+		return RET_ERROR;
+
+	while(true)
+	{
+		for(int i = 0; i < _span->count; i++)
+		{
+			if(write_entry(sink, _span->get(i), first) != RET_OK)
+				return RET_ERROR;
+
+			first = false;
+		}
+
+		_span->count = 0;
+
+		if(get_read_count() <= 0)
+			break;
+
+		if(!_more_entries && !next_file())
+			break;
+
+		read_entries();
+	}
+
+	end_file();
+
+	return sink->write("]");
+}
+
+/******************************************************************************
+ * Length is not known before writing
+ *****************************************************************************/
+template <typename TEntry, typename TBuilder>
+int TelemetryJsonBody<TEntry, TBuilder>::get_length()
+{
+	return -1;
+}
+
+/******************************************************************************
+ * Check if file has entries after the ones of the request
+ *****************************************************************************/
+template <typename TEntry, typename TBuilder>
+bool TelemetryJsonBody<TEntry, TBuilder>::has_more_entries()
+{
+	return _more_entries;
+}
+
+/******************************************************************************
+ * Valid entries in request
+ *****************************************************************************/
+template <typename TEntry, typename TBuilder>
+int TelemetryJsonBody<TEntry, TBuilder>::get_entry_count()
+{
+	return _entry_count;
+}
+
+/******************************************************************************
+ * Entries read from file for request, incl. ones that failed their CRC
+ *****************************************************************************/
+template <typename TEntry, typename TBuilder>
+int TelemetryJsonBody<TEntry, TBuilder>::get_entries_read()
+{
+	return _entries_read;
+}
+
+template <typename TEntry, typename TBuilder>
+int TelemetryJsonBody<TEntry, TBuilder>::get_crc_failures()
+{
+	return _crc_failures;
+}
+
+/******************************************************************************
+ * Files covered by request, in the order read. All but the last one were read
+ * to their end, the last one too unless has_more_entries().
+ * Valid once the request is written, or begin() found nothing to send.
+ *****************************************************************************/
+template <typename TEntry, typename TBuilder>
+const TelemetryBodyFile* TelemetryJsonBody<TEntry, TBuilder>::get_files(int *count)
+{
+	*count = _covered_count;
+	return _covered;
+}
+
+/******************************************************************************
+ * Entry bytes written to request, without the enclosing brackets
+ *****************************************************************************/
+template <typename TEntry, typename TBuilder>
+int TelemetryJsonBody<TEntry, TBuilder>::get_body_size()
+{
+	return _body_size;
+}
+
+/******************************************************************************
+ * Read next block of entries of request into span
+ *****************************************************************************/
+template <typename TEntry, typename TBuilder>
+void TelemetryJsonBody<TEntry, TBuilder>::read_entries()
+{
+	_more_entries = _reader->next_entries(_span, get_read_count());
+
+	_entries_read += _span->count + _span->crc_failures;
+	_crc_failures += _span->crc_failures;
+	_entry_count += _span->count;
+
+	_covered[_covered_count - 1].entry_count += _span->count;
+}
+
+/******************************************************************************
+ * Entries that can still be read for request: up to max entries and, when
+ * packing, as many as fit in the byte budget at the average size so far
+ *****************************************************************************/
+template <typename TEntry, typename TBuilder>
+int TelemetryJsonBody<TEntry, TBuilder>::get_read_count()
+{
+	int count = _max_entries - _entry_count;
+
+	if(_files != NULL && _body_size > 0)
+	{
+		int fit = (_max_bytes - _body_size) / (_body_size / _entry_count + 1);
+
+		if(fit < count)
+			count = fit;
+	}
+
+	return count;
+}
+
+/******************************************************************************
+ * Go on with the next file of the source, once the current one is read to
+ * its end
+ * @return False if not packing, no more files or too many covered
+ *****************************************************************************/
+template <typename TEntry, typename TBuilder>
+bool TelemetryJsonBody<TEntry, TBuilder>::next_file()
+{
+	if(_files == NULL || _covered_count >= TELEMETRY_MAX_FILES_PER_REQ)
+		return false;
+
+	// File is marked before the reader leaves it
+	end_file();
+
+	if(!_files->next_file())
+		return false;
+
+	_covered[_covered_count++].entry_count = 0;
+	_file_marked = false;
+	_more_entries = true;
+
+	return true;
+}
+
+/******************************************************************************
+ * Mark reader at end of the entries of current file in request, once
+ *****************************************************************************/
+template <typename TEntry, typename TBuilder>
+void TelemetryJsonBody<TEntry, TBuilder>::end_file()
+{
+	if(_file_marked)
+		return;
+
+	_reader->mark(&_covered[_covered_count - 1].mark);
+	_file_marked = true;
+}
+
+/******************************************************************************
+ * Write JSON object of an entry, comma separated from previous one
+ * Entry is built by the type's builder as a one entry array, whose brackets
+ * are dropped.
+ *****************************************************************************/
+template <typename TEntry, typename TBuilder>
+RetResult TelemetryJsonBody<TEntry, TBuilder>::write_entry(HttpBodySink *sink, const TEntry *entry, bool first)
+{
+	_builder.reset();
+
+	if(_builder.add(entry) != RET_OK)
+		return RET_ERROR;
+
+	_builder.build(_entry_json, sizeof(_entry_json), false);
+
+	int len = strlen(_entry_json);
+
+	// Truncated or empty
+	if(len >= (int)sizeof(_entry_json) - 1 || len < 2)
+	{
+		debug_println_e(F("Could not build entry JSON."));
+		return RET_ERROR;
+	}
+
+	if(!first && sink->write(",") != RET_OK)
+		return RET_ERROR;
+
+	_body_size += len - 2 + (first ? 0 : 1);
+
+	return sink->write((const uint8_t*)_entry_json + 1, len - 2);
+}
+
+
+// Forward declarations
+template class TelemetryJsonBody<WaterSensorData::Entry, TbWaterSensorDataJsonBuilder>;
+template class TelemetryJsonBody<Atmos41Data::Entry, TbAtmos41DataJsonBuilder>;
+template class TelemetryJsonBody<SoilMoistureData::Entry, TbSoilMoistureDataJsonBuilder>;
+template class TelemetryJsonBody<LightningData::Entry, TbLightningDataJsonBuilder>;
+template class TelemetryJsonBody<FoData::StoreEntry, TbFoDataJsonBuilder>;
+template class TelemetryJsonBody<Log::Entry, TbLogJsonBuilder>;
+template class TelemetryJsonBody<SDI12Log::Entry, TbSDI12LogJsonBuilder>;
@@ -0,0 +1,504 @@
+#include "telemetry_upload.h"
+#include "data_store_reader.h"
+#include "telemetry_json_body.h"
+#include "gzip_body.h"
+#include "water_sensor_data.h"
+#include "atmos41_data.h"
+#include "soil_moisture_data.h"
+#include "lightning_data.h"
+#include "fo_data.h"
+#include "sdi12_log.h"
+#include "log.h"
+#include "tb_water_sensor_data_json_builder.h"
+#include "tb_atmos41_data_json_builder.h"
+#include "tb_soil_moisture_data_json_builder.h"
+#include "tb_lightning_data_json_builder.h"
+#include "tb_fo_data_json_builder.h"
+#include "tb_log_json_builder.h"
+#include "tb_sdi12_log_json_builder.h"
+#include "common.h"
+#include <limits.h>
+#include <string.h>
+
+namespace TelemetryUpload
+{
+	//
+	// Private functions
+	//
+	template <typename TEntry>
+	bool next_submit_file(DataStoreReader<TEntry> *reader, bool *backfilling, uint64_t window_start);
+
+	/** Request in flight, kept by its pipeline ticket */
+	struct InFlightRequest
+	{
+		/** Files covered by request, reader positions after their entries */
+		TelemetryBodyFile files[TELEMETRY_MAX_FILES_PER_REQ];
+		int file_count;
+
+		/** First file of request (files counted from 1) and its valid entries */
+		int first_file_seq;
+		int entry_count;
+
+		/** Last request of its last file, which is deleted once it succeeds.
+		 * Files before the last one are always deleted. */
+		bool last_of_file;
+	};
+
+	/******************************************************************************
+	 * Files to submit in order, counted as they are opened. Used by packed
+	 * request bodies to go on with the next file.
+	 ******************************************************************************/
+	template <typename TEntry>
+	class SubmitFiles : public TelemetryFileSource
+	{
+	public:
+		SubmitFiles(DataStoreReader<TEntry> *reader, uint64_t window_start)
+		{
+			_reader = reader;
+			_window_start = window_start;
+		}
+
+		bool next_file()
+		{
+			if(_done || !next_submit_file(_reader, &_backfilling, _window_start))
+			{
+				_done = true;
+				return false;
+			}
+
+			seq++;
+			return true;
+		}
+
+		/** File being read, counted from 1 */
+		int seq = 0;
+
+	private:
+		DataStoreReader<TEntry> *_reader = NULL;
+		uint64_t _window_start = 0;
+
+		/** Files of the priority window are done, reading older ones */
+		bool _backfilling = false;
+
+		/** No more files */
+		bool _done = false;
+	};
+
+	/******************************************************************************
+	 * Read all data from a DataStore, build JSON and submit as telemetry
+	 * Request JSON is streamed to a socket as entries are read. Entries of
+	 * consecutive files are packed in a request up to TELEMETRY_REQ_BODY_BUDGET
+	 * bytes, a file's entries may go in more than one request. While a request
+	 * waits for its response, the next ones are sent over the pipeline's other
+	 * sockets. Entries of every successful request are acked (files it read to
+	 * their end deleted) when its response arrives, so when a request fails
+	 * only the rest of its files is resent next time. Requests of a file already
+	 * in flight when one of them fails aren't acked.
+	 * Files with entries from window_start on go first, newest first, then older
+	 * files are backfilled oldest first.
+	 * @param path URL path of requests
+	 * @param window_start Start of priority window in units of entry timestamps
+	 * @param compress Send request bodies gzip compressed
+	 * @param stats Stats added to, can be NULL
+	 *****************************************************************************/
+	template <typename TEntry, typename TBuilder>
+	RetResult submit_store(DataStore<TEntry> *store, UploadPipeline *pipeline, const char *path,
+		uint64_t window_start, bool compress, DataStoreSubmitStats *stats)
+	{
+		// Keep count of failed CRCs for log
+		int crc_failures = 0;
+		// Total sensor data entries
+		int total_entries = 0;
+		// Total entries submitted (valid entries)
+		int submitted_entries = 0;
+		// Total successfull entries
+		int successfull_entries = 0;
+		// Total number of requests
+		int total_requests = 0;
+		// Number of successfull requests
+		int successfull_requests = 0;
+		// Plain and compressed body bytes, time spent compressing
+		uint32_t body_bytes = 0;
+		uint32_t compressed_bytes = 0;
+		uint32_t compress_us = 0;
+		// Max entries per request, only the body budget limits them until a request fails
+		int req_max_entries = INT_MAX;
+
+		DataStoreReader<TEntry> reader(store);
+
+		// Fresh data first
+		reader.set_order(DATA_STORE_READ_NEWEST_FIRST);
+		reader.set_file_range(window_start, UINT64_MAX);
+
+		SubmitFiles<TEntry> files(&reader, window_start);
+
+		// Entries are read a block at a time while the request is written
+		typename DataStore<TEntry>::Entry entries[DATA_STORE_READ_BLOCK_ENTRIES];
+		DataStoreSpan<TEntry> span(entries, DATA_STORE_READ_BLOCK_ENTRIES);
+
+		// Request body, encoder (only when compressing) and requests in flight are
+		// too big for the loop task's stack, allocated for the submission
+		TelemetryJsonBody<TEntry, TBuilder> *body = new TelemetryJsonBody<TEntry, TBuilder>(&reader, &span);
+		GzipBodyWriter *gzip_body = compress ? new GzipBodyWriter(body) : NULL;
+
+		body->set_packing(&files, TELEMETRY_REQ_BODY_BUDGET);
+
+		InFlightRequest *in_flight = new InFlightRequest[UPLOAD_PIPELINE_MAX_SOCKETS];
+
+		// Last file a request failed for
+		int failed_file_seq = 0;
+		bool file_open = false;
+
+		// Ticket of last request of file being read while in flight, -1 if none
+		int file_last_ticket = -1;
+
+		// No more requests to send, only responses to wait for
+		bool sending_done = false;
+
+		// Submission errors occurred
+		bool submission_failed = false;
+
+		while(true)
+		{
+			//
+			// Complete oldest request when every socket is busy or nothing is left to send
+			//
+			if(pipeline->is_full() || (sending_done && pipeline->get_in_flight() > 0))
+			{
+				bool success = false;
+				int ticket = pipeline->complete(&success);
+				InFlightRequest *req = &in_flight[ticket];
+
+				if(ticket == file_last_ticket)
+					file_last_ticket = -1;
+
+				if(success)
+				{
+					successfull_requests++;
+
+					for(int i = 0; i < req->file_count; i++)
+					{
+						TelemetryBodyFile *file = &req->files[i];
+
+						// Entries after a failed request of the file are resent with it next time
+						if(req->first_file_seq + i == failed_file_seq)
+							continue;
+
+						if(i < req->file_count - 1 || req->last_of_file)
+						{
+							// All entries submitted or failed CRC, file can be deleted
+							reader.delete_file(&file->mark);
+							debug_println(F("Deleting file, all complete"));
+						}
+						else
+						{
+							reader.ack(&file->mark);
+						}
+
+						successfull_entries += file->entry_count;
+					}
+
+					// Link recovered, grow back to the body budget
+					if(req_max_entries < INT_MAX / 2)
+						req_max_entries *= 2;
+					else
+						req_max_entries = INT_MAX;
+				}
+				else
+				{
+					debug_println_e(F("Sending telemetry data failed. Rest of file remains to be retried next time."));
+
+					failed_file_seq = req->first_file_seq + req->file_count - 1;
+
+					// Link is poor, send less per request from now on
+					if(req_max_entries > req->entry_count)
+						req_max_entries = req->entry_count;
+
+					req_max_entries /= 2;
+					if(req_max_entries < TELEMETRY_MIN_ENTRIES_PER_REQ)
+						req_max_entries = TELEMETRY_MIN_ENTRIES_PER_REQ;
+
+					if(total_requests - successfull_requests >= FAILED_TELEMETRY_REQ_THRESHOLD && !submission_failed)
+					{
+						// Max error threshold reached, abort once requests in flight are done
+						submission_failed = true;
+						sending_done = true;
+					}
+				}
+
+				continue;
+			}
+
+			if(sending_done)
+				break;
+
+			//
+			// Send next request
+			//
+
+			// A request of the file failed, rest of it remains to be retried next time
+			if(file_open && failed_file_seq == files.seq)
+				file_open = false;
+
+			if(!file_open)
+			{
+				if(!files.next_file())
+				{
+					sending_done = true;
+					continue;
+				}
+
+				file_open = true;
+				file_last_ticket = -1;
+			}
+
+			// Send only if there are valid entries to be sent. Request ends when
+			// full, or at end of file when no more files are left or fit.
+			int first_file_seq = files.seq;
+			bool sent = false;
+
+			if(body->begin(req_max_entries))
+			{
+				total_requests++;
+
+				int ticket = 0;
+
+				if(gzip_body != NULL)
+				{
+					ticket = pipeline->send(path, gzip_body, "application/json");
+
+					body_bytes += gzip_body->get_body_size();
+					compressed_bytes += gzip_body->get_compressed_size();
+					compress_us += gzip_body->get_compress_us();
+				}
+				else
+				{
+					ticket = pipeline->send(path, body, "application/json");
+				}
+
+				InFlightRequest *req = &in_flight[ticket];
+				const TelemetryBodyFile *covered = body->get_files(&req->file_count);
+
+				memcpy(req->files, covered, req->file_count * sizeof(TelemetryBodyFile));
+				req->first_file_seq = first_file_seq;
+				req->entry_count = body->get_entry_count();
+				req->last_of_file = !body->has_more_entries();
+
+				file_last_ticket = ticket;
+				sent = true;
+			}
+
+			total_entries += body->get_entries_read();
+			crc_failures += body->get_crc_failures();
+			submitted_entries += body->get_entry_count();
+
+			if(!sent)
+			{
+				// Rest of files failed CRC. The first one is deleted with its last
+				// request if in flight, now otherwise, the others are deleted now.
+				int file_count = 0;
+				const TelemetryBodyFile *covered = body->get_files(&file_count);
+
+				for(int i = 0; i < file_count; i++)
+				{
+					if(i == 0 && file_last_ticket >= 0)
+						in_flight[file_last_ticket].last_of_file = true;
+					else
+						reader.delete_file(&covered[i].mark);
+				}
+			}
+
+			if(!body->has_more_entries())
+				file_open = false;
+		}
+
+		delete[] in_flight;
+		delete gzip_body;
+		delete body;
+
+		// Print report
+		int failed_requests = total_requests - successfull_requests;
+
+		debug_print(F("Total entries: "));
+		debug_println(total_entries, DEC);
+		debug_print(F("Submitted entries: "));
+		debug_println(submitted_entries, DEC);
+		debug_print(F("Successful entries: "));
+		debug_println(successfull_entries, DEC);
+		debug_print(F("Entries failed CRC32: "));
+		debug_println(crc_failures, DEC);
+		debug_println();
+
+		// Output operation stats (add to provided)
+		if(stats != nullptr)
+		{
+			stats->total_entries += total_entries;
+			stats->submitted_entries += submitted_entries;
+			stats->successful_entries += successfull_entries;
+			stats->crc_failed_entries += crc_failures;
+			stats->total_requests += total_requests;
+			stats->failed_requests += failed_requests;
+			stats->body_bytes += body_bytes;
+			stats->compressed_bytes += compressed_bytes;
+			stats->compress_us += compress_us;
+		}
+
+		return submission_failed ? RET_ERROR : RET_OK;
+	}
+
+	/******************************************************************************
+	 * Submit the entries of several stores merged in time order, values that
+	 * share a timestamp joined (see MergedTelemetryBody). Requests are sent one
+	 * at a time, up to TELEMETRY_REQ_BODY_BUDGET bytes each. Entries of every
+	 * successful request are acked, after a failed one the streams are read
+	 * again from their acked entries. Streams are reset before and after, they
+	 * can be kept from one submission to the next.
+	 * @param streams Streams of the stores
+	 * @param compress Send request bodies gzip compressed
+	 * @param stats Stats added to, can be NULL
+	 *****************************************************************************/
+	RetResult submit_merged(TelemetryStream **streams, int stream_count, UploadPipeline *pipeline, const char *path,
+		bool compress, DataStoreSubmitStats *stats)
+	{
+		int submitted_entries = 0;
+		int successfull_entries = 0;
+		int total_requests = 0;
+		int successfull_requests = 0;
+		int objects = 0;
+		uint32_t body_bytes = 0;
+		uint32_t compressed_bytes = 0;
+		uint32_t compress_us = 0;
+		bool submission_failed = false;
+
+		for(int i = 0; i < stream_count; i++)
+			streams[i]->reset();
+
+		MergedTelemetryBody body(streams, stream_count, TELEMETRY_REQ_BODY_BUDGET);
+
+		// Encoder is too big for the loop task's stack, allocated only when compressing
+		GzipBodyWriter *gzip_body = compress ? new GzipBodyWriter(&body) : NULL;
+
+		while(body.begin())
+		{
+			total_requests++;
+
+			if(gzip_body != NULL)
+			{
+				pipeline->send(path, gzip_body, "application/json");
+
+				body_bytes += gzip_body->get_body_size();
+				compressed_bytes += gzip_body->get_compressed_size();
+				compress_us += gzip_body->get_compress_us();
+			}
+			else
+			{
+				pipeline->send(path, &body, "application/json");
+			}
+
+			submitted_entries += body.get_entry_count();
+			objects += body.get_object_count();
+
+			bool success = false;
+			pipeline->complete(&success);
+
+			if(success)
+			{
+				successfull_requests++;
+				successfull_entries += body.get_entry_count();
+
+				for(int i = 0; i < stream_count; i++)
+					streams[i]->ack_request();
+			}
+			else
+			{
+				debug_println_e(F("Sending merged telemetry failed. Entries remain to be retried."));
+
+				for(int i = 0; i < stream_count; i++)
+					streams[i]->rollback();
+
+				if(total_requests - successfull_requests >= FAILED_TELEMETRY_REQ_THRESHOLD)
+				{
+					submission_failed = true;
+					break;
+				}
+			}
+		}
+
+		delete gzip_body;
+
+		int crc_failures = 0;
+		for(int i = 0; i < stream_count; i++)
+		{
+			crc_failures += streams[i]->get_crc_failures();
+			streams[i]->reset();
+		}
+
+		debug_print(F("Submitted entries: "));
+		debug_println(submitted_entries, DEC);
+		debug_print(F("Successful entries: "));
+		debug_println(successfull_entries, DEC);
+		debug_print(F("Timestamps (objects): "));
+		debug_println(objects, DEC);
+		debug_print(F("Entries failed CRC32: "));
+		debug_println(crc_failures, DEC);
+		debug_println();
+
+		if(stats != nullptr)
+		{
+			stats->total_entries += submitted_entries + crc_failures;
+			stats->submitted_entries += submitted_entries;
+			stats->successful_entries += successfull_entries;
+			stats->crc_failed_entries += crc_failures;
+			stats->total_requests += total_requests;
+			stats->failed_requests += total_requests - successfull_requests;
+			stats->body_bytes += body_bytes;
+			stats->compressed_bytes += compressed_bytes;
+			stats->compress_us += compress_us;
+		}
+
+		return submission_failed ? RET_ERROR : RET_OK;
+	}
+
+	/******************************************************************************
+	 * Get next file to submit. When the files of the priority window are done,
+	 * the reader is restarted to backfill the files before it, oldest first.
+	 * The ring log is read with the priority window only.
+	 * @param backfilling Set once reading files before the window
+	 *****************************************************************************/
+	template <typename TEntry>
+	bool next_submit_file(DataStoreReader<TEntry> *reader, bool *backfilling, uint64_t window_start)
+	{
+		if(reader->next_file())
+			return true;
+
+		if(*backfilling || window_start == 0)
+			return false;
+
+		debug_println(F("Priority window submitted, backfilling older data."));
+
+		*backfilling = true;
+
+		reader->reset();
+		reader->set_order(DATA_STORE_READ_OLDEST_FIRST);
+		reader->set_file_range(0, window_start - 1);
+		reader->set_ring_log_enabled(false);
+
+		return reader->next_file();
+	}
+
+	// Forward declarations
+	template RetResult submit_store<WaterSensorData::Entry, TbWaterSensorDataJsonBuilder>(
+		DataStore<WaterSensorData::Entry>*, UploadPipeline*, const char*, uint64_t, bool, DataStoreSubmitStats*);
+	template RetResult submit_store<Atmos41Data::Entry, TbAtmos41DataJsonBuilder>(
+		DataStore<Atmos41Data::Entry>*, UploadPipeline*, const char*, uint64_t, bool, DataStoreSubmitStats*);
+	template RetResult submit_store<SoilMoistureData::Entry, TbSoilMoistureDataJsonBuilder>(
+		DataStore<SoilMoistureData::Entry>*, UploadPipeline*, const char*, uint64_t, bool, DataStoreSubmitStats*);
+	template RetResult submit_store<LightningData::Entry, TbLightningDataJsonBuilder>(
+		DataStore<LightningData::Entry>*, UploadPipeline*, const char*, uint64_t, bool, DataStoreSubmitStats*);
+	template RetResult submit_store<FoData::StoreEntry, TbFoDataJsonBuilder>(
+		DataStore<FoData::StoreEntry>*, UploadPipeline*, const char*, uint64_t, bool, DataStoreSubmitStats*);
+	template RetResult submit_store<Log::Entry, TbLogJsonBuilder>(
+		DataStore<Log::Entry>*, UploadPipeline*, const char*, uint64_t, bool, DataStoreSubmitStats*);
+	template RetResult submit_store<SDI12Log::Entry, TbSDI12LogJsonBuilder>(
+		DataStore<SDI12Log::Entry>*, UploadPipeline*, const char*, uint64_t, bool, DataStoreSubmitStats*);
+}
@@ -1,7 +1,8 @@
 #include "tests.h"
 #include <Preferences.h>
 #include "CRC32.h"
-#include "SPIFFS.h"
+#include "crc.h"
+#include "storage.h"
 #include "const.h"
 #include "app_config.h"
 #include "gsm.h"
@@ -37,7 +38,8 @@ namespace Tests
 		[RTC_FROM_GSM] = rtc_from_gsm,
 		[DATA_STORE] = data_store,
 		[WAKEUP_TIMES] = wakeup_times,
-		[DEVICE_CONFIG] = device_config
+		[DEVICE_CONFIG] = device_config,
+		[CRC] = crc
 	};
 
 	/** Test names mapped to their type */
@@ -45,7 +47,8 @@ namespace Tests
 		[RTC_FROM_GSM] = "RTC from GSM",
 		[DATA_STORE] = "Buffered data store",
 		[WAKEUP_TIMES] = "Wake-up times",
-		[DEVICE_CONFIG] = "Device configuration store"
+		[DEVICE_CONFIG] = "Device configuration store",
+		[CRC] = "CRC32 engine"
 	};
 
 	/******************************************************************************
@@ -67,8 +70,11 @@ namespace Tests
 	// Size of a single entry in the data store (header + body)
 	const int DATA_STORE_ENTRY_SIZE = sizeof(DataStore<WaterSensorData::Entry>::Entry);
 
+	// Size of the header every data file starts with
+	const int DATA_STORE_FILE_HEADER_SIZE = sizeof(DataStore<WaterSensorData::Entry>::FileHeader);
+
 	// Size in bytes of a file that doesn't fit any more entries
-	const int DATA_STORE_FULL_FILE_SIZE = DATA_STORE_ENTRY_SIZE *  DATA_STORE_ENTRIES_PER_FILE;
+	const int DATA_STORE_FULL_FILE_SIZE = DATA_STORE_FILE_HEADER_SIZE + DATA_STORE_ENTRY_SIZE *  DATA_STORE_ENTRIES_PER_FILE;
 
 	//
 	// Wakeup times
@@ -76,6 +82,15 @@ namespace Tests
 	// How many wake up "times" to calculate starting from now
 	const int WAKEUP_TIMES_SERIES_LEN = 100;
 
+	//
+	// CRC
+	//
+	// Buffer sizes to compare, from single bytes to whole files
+	const int CRC_TEST_SIZES[] = {1, 7, 53, 256, 1024, 4096};
+
+	// Times each size is computed when timing
+	const int CRC_TEST_ROUNDS = 20;
+
 
 	/******************************************************************************
 	 * Set dummy date in RTC, ask GSM module to update time from NTP and see if
@@ -134,7 +149,7 @@ namespace Tests
 		Utils::serial_style(STYLE_RESET);
 		if(Flash::mount() != RET_OK)
 		{
-			debug_println(F("# Could not begin SPIFFS."));
+			debug_println(F("# Could not mount flash."));
 			return RET_ERROR;
 		}
 
@@ -144,7 +159,8 @@ namespace Tests
 		Utils::serial_style(STYLE_BLUE);
 		debug_println(F("# Formatting"));
 		Utils::serial_style(STYLE_RESET);
-		if(!SPIFFS.format())
+		DataStoreManifest::unload_all();
+		if(!Storage::format())
 		{
 			debug_println(F("# Format failed."));
 			return RET_ERROR;
@@ -188,21 +204,27 @@ namespace Tests
 				return RET_ERROR;
 			}
 
-			expected_bytes_written += DATA_STORE_ENTRY_SIZE;
-
 			// Add to dummy array to confirm later
 			memcpy(&dummy_data_entries[i], &new_entry, sizeof(new_entry));
 
-			// Expected number of files with size DATA_STORE_ENTRY_SIZE * DATA_STORE_ENTRIES_PER_FILE
-			int expected_full_files = ((i+1) * DATA_STORE_ENTRY_SIZE) / DATA_STORE_FULL_FILE_SIZE;
+			// Expected number of files with size DATA_STORE_FULL_FILE_SIZE
+			int expected_full_files = (i+1) / DATA_STORE_ENTRIES_PER_FILE;
 
 			// Other than full files, only one smaller file can exist and it must be of this size.
 			// When 0, last file is full  so there can be more of these which is checked by above
-			int expected_smallest_file_size = ((i+1) * DATA_STORE_ENTRY_SIZE) - expected_full_files * DATA_STORE_FULL_FILE_SIZE;
+			int entries_in_last_file = (i+1) - expected_full_files * DATA_STORE_ENTRIES_PER_FILE;
+			int expected_smallest_file_size = 0;
+
+			if(entries_in_last_file > 0)
+				expected_smallest_file_size = DATA_STORE_FILE_HEADER_SIZE + entries_in_last_file * DATA_STORE_ENTRY_SIZE;
+
+			// Entries and the header of every file
+			expected_bytes_written = (i+1) * DATA_STORE_ENTRY_SIZE +
+				(expected_full_files + (entries_in_last_file > 0 ? 1 : 0)) * DATA_STORE_FILE_HEADER_SIZE;
 			debug_print(F("Smallest file must be: "));
 			debug_println(expected_smallest_file_size);
 			// Iterate all files and check if above above data is true
-			File dir = SPIFFS.open(DATA_STORE_PATH);
+			File dir = Storage::fs().open(DATA_STORE_PATH);
 			if(!dir)
 			{
 				debug_println(F("Could not open data store dir."));
@@ -252,7 +274,7 @@ namespace Tests
 				debug_println(found_full_files, DEC);
 				debug_println(F("Aborting"));
 
-				Flash::ls();
+				Flash::ls(true);
 
 				return RET_ERROR;
 			}
@@ -265,7 +287,7 @@ namespace Tests
 				debug_println(found_smallest_file_size, DEC);
 				debug_println(F("Aborting"));
 
-				Flash::ls();
+				Flash::ls(true);
 
 				return RET_ERROR;
 			}
@@ -278,7 +300,7 @@ namespace Tests
 				debug_println(found_bytes_written, DEC);
 				debug_println(F("Aborting"));
 
-				Flash::ls();
+				Flash::ls(true);
 
 				return RET_ERROR;
 			}
@@ -286,7 +308,7 @@ namespace Tests
 		debug_print(F("Finished creating dummy data. Created entries: "));
 		debug_println(DATA_STORE_ELEMENTS_TO_WRITE, DEC);
 
-		Flash::ls();
+		Flash::ls(true);
 
 		//
 		// Read data back with read and cross check with dummy_data_entries. Find 
@@ -382,14 +404,15 @@ namespace Tests
 		Utils::serial_style(STYLE_BLUE);
 		debug_println(F("# Formatting for clean up."));
 		Utils::serial_style(STYLE_RESET);
-		if(!SPIFFS.format())
+		DataStoreManifest::unload_all();
+		if(!Storage::format())
 		{
 			debug_println(F("# Format failed."));
 			return RET_ERROR;
 		}
 
 		debug_println(F("Done!"));
-		Flash::ls();
+		Flash::ls(true);
 
 		return RET_OK;
 	}
@@ -518,6 +541,62 @@ namespace Tests
 		return RET_OK;
 	}
 
+	/******************************************************************************
+	* CRC32 engine must give the same result as the CRC32 library, which existing
+	* stored data was written with. Also prints the cost per byte of both.
+	******************************************************************************/
+	RetResult crc()
+	{
+		const int max_size = CRC_TEST_SIZES[sizeof(CRC_TEST_SIZES) / sizeof(CRC_TEST_SIZES[0]) - 1];
+
+		// +1 to also check unaligned start
+		uint8_t *buff = (uint8_t*)malloc(max_size + 1);
+		if(buff == NULL)
+		{
+			debug_println(F("Could not allocate buffer."));
+			return RET_ERROR;
+		}
+
+		for(int i = 0; i < max_size + 1; i++)
+			buff[i] = random(256);
+
+		RetResult ret = RET_OK;
+
+		debug_print(F("Engine: "));
+		debug_println(Crc::get_engine_name());
+
+		for(unsigned int i = 0; i < sizeof(CRC_TEST_SIZES) / sizeof(CRC_TEST_SIZES[0]); i++)
+		{
+			int size = CRC_TEST_SIZES[i];
+
+			for(int offset = 0; offset < 2; offset++)
+			{
+				if(Crc::crc32(buff + offset, size) != CRC32::calculate(buff + offset, size))
+				{
+					debug_printf("CRC mismatch, size: %d, offset: %d\n", size, offset);
+					ret = RET_ERROR;
+				}
+			}
+
+			uint32_t t_start = micros();
+			for(int r = 0; r < CRC_TEST_ROUNDS; r++)
+				Crc::crc32(buff, size);
+			uint32_t engine_us = micros() - t_start;
+
+			t_start = micros();
+			for(int r = 0; r < CRC_TEST_ROUNDS; r++)
+				CRC32::calculate(buff, size);
+			uint32_t lib_us = micros() - t_start;
+
+			debug_printf("%5d B - engine: %7.1f ns/B, library: %7.1f ns/B\n", size,
+				engine_us * 1000.0 / (size * CRC_TEST_ROUNDS), lib_us * 1000.0 / (size * CRC_TEST_ROUNDS));
+		}
+
+		free(buff);
+
+		return ret;
+	}
+
 	/******************************************************************************
 	 * Run all tests and print report
 	******************************************************************************/    
@@ -0,0 +1,89 @@
+#include "upload_pipeline.h"
+#include "common.h"
+
+/******************************************************************************
+ * Constructor
+ * @param sockets Sockets to send over, one request in flight on each
+ * @param socket_count Sockets, up to UPLOAD_PIPELINE_MAX_SOCKETS
+ *****************************************************************************/
+UploadPipeline::UploadPipeline(UploadSocket **sockets, int socket_count)
+{
+	if(socket_count > UPLOAD_PIPELINE_MAX_SOCKETS)
+		socket_count = UPLOAD_PIPELINE_MAX_SOCKETS;
+
+	for(int i = 0; i < socket_count; i++)
+	{
+		_sockets[i] = sockets[i];
+		_send_failed[i] = false;
+	}
+
+	_socket_count = socket_count;
+}
+
+/******************************************************************************
+ * Default constructor (private)
+ *****************************************************************************/
+UploadPipeline::UploadPipeline()
+{}
+
+/******************************************************************************
+ * Send a request over the next socket. A request that fails to send is still
+ * completed by complete(), as failed, in its turn.
+ * @param body Body writer, written before returning so it can be reused
+ * @return Ticket of request, -1 if pipeline is full
+ *****************************************************************************/
+int UploadPipeline::send(const char *path, HttpBodyWriter *body, const char *content_type)
+{
+	if(is_full())
+		return -1;
+
+	int ticket = (_head + _in_flight) % _socket_count;
+
+	_send_failed[ticket] = _sockets[ticket]->send(path, body, content_type) != RET_OK;
+	_in_flight++;
+
+	return ticket;
+}
+
+/******************************************************************************
+ * Wait for the response of the oldest request in flight
+ * @param success Request succeeded (output var)
+ * @return Ticket of request, -1 if none in flight
+ *****************************************************************************/
+int UploadPipeline::complete(bool *success)
+{
+	if(_in_flight == 0)
+		return -1;
+
+	int ticket = _head;
+	int response_code = _send_failed[ticket] ? 0 : _sockets[ticket]->read_response();
+
+	*success = response_code == 200;
+
+	if(!*success)
+	{
+		debug_print(F("Pipelined request failed. Response code: "));
+		debug_println(response_code, DEC);
+	}
+
+	_head = (_head + 1) % _socket_count;
+	_in_flight--;
+
+	return ticket;
+}
+
+/******************************************************************************
+ * Every socket has a request in flight, one must complete before sending
+ *****************************************************************************/
+bool UploadPipeline::is_full()
+{
+	return _in_flight >= _socket_count;
+}
+
+/******************************************************************************
+ * Requests sent and not completed yet
+ *****************************************************************************/
+int UploadPipeline::get_in_flight()
+{
+	return _in_flight;
+}
@@ -1,9 +1,9 @@
 #include <Arduino.h>
 #include "utils.h"
-#include "SPIFFS.h"
+#include "storage.h"
 #include "app_config.h"
 #include "struct.h"
-#include "CRC32.h"
+#include "crc.h"
 #include "Wire.h"
 #include "const.h"
 #include "device_config.h"
@@ -137,7 +137,7 @@ namespace Utils
 	 *******************************************************************************/
 	uint32_t crc32(uint8_t *buff, uint32_t buff_size)
 	{
-		return CRC32::calculate((uint8_t*)buff, buff_size);
+		return Crc::crc32(buff, buff_size);
 	}
 
 	/******************************************************************************
@@ -5,13 +5,50 @@
 
 namespace WaterSensorData
 {
+	/**
+	 * Schema of entries. Timestamps advance by the measurement interval and the
+	 * rest change little between measurements, so all are stored as deltas.
+	 * Water quality values are only sent when the quality sensor gave any, the
+	 * water level sensor is separate.
+	 */
+	constexpr EntrySchema::Field SCHEMA[] = {
+		ENTRY_SCHEMA_FIELD(Entry, timestamp, NULL, "Timestamp", 0, FIELD_DELTA2, EntrySchema::FLAG_NONE),
+		ENTRY_SCHEMA_FIELD(Entry, temperature, WATER_SENSOR_DATA_KEY_TEMPERATURE, "Temperature",
+			EntrySchema::DECIMALS_ALL, FIELD_DELTA, EntrySchema::FLAG_ZERO_GROUP),
+		ENTRY_SCHEMA_FIELD(Entry, dissolved_oxygen, WATER_SENSOR_DATA_KEY_DISSOLVED_OXYGEN, "Diss. oxygen",
+			EntrySchema::DECIMALS_ALL, FIELD_DELTA, EntrySchema::FLAG_ZERO_GROUP),
+		ENTRY_SCHEMA_FIELD(Entry, conductivity, WATER_SENSOR_DATA_KEY_CONDUCTIVITY, "Conductivity",
+			EntrySchema::DECIMALS_ALL, FIELD_DELTA, EntrySchema::FLAG_ZERO_GROUP),
+		ENTRY_SCHEMA_FIELD(Entry, ph, WATER_SENSOR_DATA_KEY_PH, "PH",
+			EntrySchema::DECIMALS_ALL, FIELD_DELTA, EntrySchema::FLAG_ZERO_GROUP),
+		ENTRY_SCHEMA_FIELD(Entry, orp, WATER_SENSOR_DATA_KEY_ORP, "ORP",
+			EntrySchema::DECIMALS_ALL, FIELD_DELTA, EntrySchema::FLAG_ZERO_GROUP),
+		ENTRY_SCHEMA_FIELD(Entry, pressure, WATER_SENSOR_DATA_KEY_PRESSURE, "Pressure",
+			EntrySchema::DECIMALS_ALL, FIELD_DELTA, EntrySchema::FLAG_ZERO_GROUP),
+		ENTRY_SCHEMA_FIELD(Entry, depth_cm, WATER_SENSOR_DATA_KEY_DEPTH_CM, "Depth (cm)",
+			EntrySchema::DECIMALS_ALL, FIELD_DELTA, EntrySchema::FLAG_ZERO_GROUP),
+		ENTRY_SCHEMA_FIELD(Entry, depth_ft, WATER_SENSOR_DATA_KEY_DEPTH_FT, "Depth (ft)",
+			EntrySchema::DECIMALS_ALL, FIELD_DELTA, EntrySchema::FLAG_ZERO_GROUP),
+		ENTRY_SCHEMA_FIELD(Entry, tss, WATER_SENSOR_DATA_KEY_TSS, "TSS",
+			EntrySchema::DECIMALS_ALL, FIELD_DELTA, EntrySchema::FLAG_ZERO_GROUP),
+		ENTRY_SCHEMA_FIELD(Entry, presence, WATER_SENSOR_DATA_KEY_WATER_PRESENCE, "Water Presence",
+			0, FIELD_DELTA, EntrySchema::FLAG_NONE),
+		ENTRY_SCHEMA_FIELD(Entry, water_level, WATER_SENSOR_DATA_KEY_WATER_LEVEL, "Water level",
+			EntrySchema::DECIMALS_ALL, FIELD_DELTA, EntrySchema::FLAG_NONE)
+	};
+	ENTRY_SCHEMA_CHECK(Entry, SCHEMA);
+
+	/** Store encoding, generated from schema */
+	typedef EntrySchema::CodecLayout<SCHEMA, ENTRY_SCHEMA_FIELD_COUNT(SCHEMA)> EncodingLayout;
+
 	/** 
 	 * Store for water sensor data
 	 * Number of entries per file is the same as the number of entries in a request packet.
 	 * This way if a request succeeds, a whole file can be deleted, if not the file remains
 	 * to be resent at a later time
 	 */
-    DataStore<WaterSensorData::Entry> store(WATER_SENSOR_DATA_PATH, WATER_SENSOR_DATA_ENTRIES_PER_SUBMIT_REQ);
+    DataStore<WaterSensorData::Entry> store(WATER_SENSOR_DATA_PATH, WATER_SENSOR_DATA_ENTRIES_PER_SUBMIT_REQ,
+		EncodingLayout::fields, ENTRY_SCHEMA_FIELD_COUNT(SCHEMA));
 
     /******************************************************************************
     * Add water sensor data to storage
@@ -35,43 +72,21 @@ namespace WaterSensorData
         return &store;
     }
 
+    /******************************************************************************
+    * Get entry schema
+    ******************************************************************************/
+    const EntrySchema::Field* get_schema(int *field_count)
+    {
+        *field_count = ENTRY_SCHEMA_FIELD_COUNT(SCHEMA);
+        return SCHEMA;
+    }
+
     /********************************************************************************
 	 * Print all data from a water sensor data strcut
 	 * @param data Water sensor data structure
 	 *******************************************************************************/
 	void print(const WaterSensorData::Entry *data)
 	{
-		debug_print(F("Timestamp: "));
-		debug_println(data->timestamp);
-
-		debug_print(F("Temperature: "));
-		debug_println(data->temperature);
-
-		debug_print(F("Diss. oxygen: "));
-		debug_println(data->dissolved_oxygen);
-
-		debug_print(F("Conductivity: "));
-		debug_println(data->conductivity);
-
-		debug_print(F("PH: "));
-		debug_println(data->ph);
-
-		debug_print(F("ORP: "));
-		debug_println(data->orp);
-
-		debug_print(F("Pressure: "));
-		debug_println(data->pressure);
-
-		debug_print(F("Depth (cm): "));
-		debug_println(data->depth_cm);
-
-		debug_print(F("Depth (ft): "));
-		debug_println(data->depth_ft);
-
-		debug_print(F("Water level: "));
-		debug_println(data->water_level);
-
-		debug_print(F("Water Presence: "));
-		debug_println(data->presence);
+		EntrySchema::print(SCHEMA, ENTRY_SCHEMA_FIELD_COUNT(SCHEMA), data);
 	}
 }
\ No newline at end of file
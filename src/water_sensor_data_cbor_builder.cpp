@@ -0,0 +1,14 @@
+#include "water_sensor_data_cbor_builder.h"
+#include "common.h"
+
+/******************************************************************************
+ * Add packet to request
+ * Values are generated from the entry schema, see WaterSensorData::get_schema()
+ *****************************************************************************/
+RetResult WaterSensorDataCborBuilder::add(const WaterSensorData::Entry *entry)
+{
+	int field_count = 0;
+	const EntrySchema::Field *fields = WaterSensorData::get_schema(&field_count);
+
+	return add_schema_entry(entry, fields, field_count);
+}